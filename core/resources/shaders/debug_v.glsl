@@ -1,10 +1,14 @@
-#version 330 core
+#version 430 core
 
 layout (location = 0) in vec3 aPos; 
 layout (location = 1) in vec3 aColor; // for lines
 
-uniform mat4 projection;
-uniform mat4 view;
+// per view, bound by the renderer for each pass
+layout (std140, binding = 0) uniform view_data {
+    mat4 view;
+    mat4 projection;
+    vec3 view_position;
+};
 uniform mat4 model;
 
 out vec3 fragColor;
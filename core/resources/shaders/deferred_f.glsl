@@ -1,22 +1,46 @@
-#version 330 core
-layout (location = 0) out vec3 g_position;
-layout (location = 1) out vec3 g_normal;
-layout (location = 2) out vec4 g_albedo_specular;
+#version 430 core
+// packed g-buffer (core/gbuffer.h)
+layout (location = 0) out vec4 g_albedo_metallic;
+layout (location = 1) out vec4 g_normal_roughness;
 
-in vec2 TexCoords;
-in vec3 FragPos;
 in vec3 Normal;
+in vec2 TexCoord;
+in vec3 Tangentout;
+in vec3 Bitangentout;
 
-uniform sampler2D texture_diffuse1;
-uniform sampler2D texture_specular1;
+uniform bool has_diffuse;
+uniform bool has_normal;
+uniform bool has_metallic_roughness;
+uniform sampler2D diffuse;
+uniform sampler2D normal;
+uniform sampler2D metallic_roughness;
 
-void main() {    
-    // store the fragment position vector in the first gbuffer texture
-    g_position = FragPos;
-    // also store the per-fragment normals into the gbuffer
-    g_normal = normalize(Normal);
-    // and the diffuse per-fragment color
-    g_albedo_specular.rgb = texture(texture_diffuse1, TexCoords).rgb;
-    // store specular intensity in gAlbedoSpec's alpha component
-    g_albedo_specular.a = texture(texture_specular1, TexCoords).r;
-}  
\ No newline at end of file
+// unit vector onto the octahedron folded into a square, 0..1 for the unorm target
+vec2 OctEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+void main() {
+    vec3 N = normalize(Normal);
+    if (has_normal) {
+        // xy only, z follows from unit length
+        vec3 normalMap;
+        normalMap.xy = texture(normal, TexCoord).rg * 2.0 - 1.0;
+        normalMap.z = sqrt(max(1.0 - dot(normalMap.xy, normalMap.xy), 0.0));
+        mat3 TBN = mat3(normalize(Tangentout), normalize(Bitangentout), N);
+        N = normalize(TBN * normalMap);
+    }
+
+    float metallic = 0.0;
+    float roughness = 0.5;
+    if (has_metallic_roughness) {
+        vec3 mrSample = texture(metallic_roughness, TexCoord).rgb;
+        metallic = mrSample.b;
+        roughness = mrSample.g;
+    }
+
+    g_albedo_metallic = vec4(texture(diffuse, TexCoord).rgb, metallic);
+    g_normal_roughness = vec4(OctEncode(N), roughness, 1.0);
+}
@@ -1,60 +1,63 @@
-#version 330 core
+#version 430 core
 out vec4 FragColor;
 
-in vec2 TexCoords;
+// fullscreen lighting over the packed g-buffer (core/gbuffer.h), the lights and shadows of lighting.glsl
+// with the world position rebuilt from depth
 
-uniform sampler2D g_position;
-uniform sampler2D g_normal;
-uniform sampler2D g_albedo_specular;
+// per view, bound by the renderer for each pass
+layout (std140, binding = 0) uniform view_data {
+    mat4 view;
+    mat4 projection;
+    vec3 view_position;
+};
 
-uniform int debug_mode;
+#include "lighting.glsl"
 
-struct Light {
-    vec3 Position;
-    vec3 Color;
-    float Linear;
-    float Quadratic;
-    float Intensity;
-};
+uniform sampler2D g_albedo_metallic;
+uniform sampler2D g_normal_roughness;
+uniform sampler2D g_depth;
+uniform mat4 inverse_view_projection; // camera
 
-uniform Light light;
-uniform vec3 viewPos;
+vec3 OctDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main() {
-    if (debug_mode == 999) {
-        FragColor = vec4(0.0, 1.0, 0.0, 1.0); // Bright green
-        return;
-    }
-
-    // Retrieve data from G-buffer
-    vec3 FragPos = texture(g_position, TexCoords).rgb;
-    vec3 Normal = texture(g_normal, TexCoords).rgb;
-    vec3 Albedo = texture(g_albedo_specular, TexCoords).rgb;
-    float Specular = texture(g_albedo_specular, TexCoords).a;
-
-    // Blinn-Phong lighting calculations
-    vec3 lighting = Albedo * 0.1; // ambient component
-    vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 lightDir = normalize(light.Position - FragPos);
-    
-    // Diffuse
-    float diff = max(dot(Normal, lightDir), 0.0);
-    vec3 diffuse = light.Color * diff * Albedo;
-    
-    // Specular
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
-    vec3 specular = light.Color * spec * Specular;
-    
-    // Attenuation
-    float distance = length(light.Position - FragPos);
-    float attenuation = 1.0 / (1.0 + light.Linear * distance + 
-                                light.Quadratic * (distance * distance));
-    
-    diffuse *= attenuation;
-    specular *= attenuation;
-    
-    lighting += diffuse + specular;
-    
-    FragColor = vec4(lighting, 1.0);
-}
\ No newline at end of file
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(g_depth, pixel, 0).r;
+    // nothing drawn here, the skybox fills it
+    if (depth >= 1.0)
+        discard;
+
+    vec4 albedo_metallic = texelFetch(g_albedo_metallic, pixel, 0);
+    vec4 normal_roughness = texelFetch(g_normal_roughness, pixel, 0);
+    vec3 albedo = albedo_metallic.rgb;
+    float metallic = albedo_metallic.a;
+    float roughness = normal_roughness.b;
+    vec3 N = OctDecode(normal_roughness.xy);
+
+    vec2 uv = (gl_FragCoord.xy) / vec2(textureSize(g_depth, 0));
+    vec4 world = inverse_view_projection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 P = world.xyz / world.w;
+    float view_depth = -(view * vec4(P, 1.0)).z;
+
+    vec3 V = normalize(view_position - P);
+    vec3 F0 = mix(vec3(0.04), albedo, metallic);
+
+    vec3 Lo = vec3(0.0);
+    Lo += CalculatePointLights(P, view_depth, N, V, F0, albedo, metallic, roughness);
+    Lo += CalculateDirectionalLight(P, view_depth, N, V, F0, albedo, metallic, roughness);
+    Lo += CalculateSpotLight(P, light_projection * light_view * vec4(P, 1.0), N, V, F0, albedo, metallic, roughness);
+
+    vec3 color = vec3(0.0001) * albedo + Lo;
+    color = color / (color + vec3(1.0));
+    color = pow(color, vec3(1.0/2.2));
+
+    FragColor = vec4(color, 1.0);
+    // the skybox and debug lines after this depth test against the scene
+    gl_FragDepth = depth;
+}
@@ -1,10 +1,6 @@
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoords;
-
-out vec2 TexCoords;
-
+#version 430 core
+// one triangle over the whole screen, no vertex buffer
 void main() {
-    gl_Position = vec4(aPos, 1.0);
-    TexCoords = aTexCoords;
-}
\ No newline at end of file
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
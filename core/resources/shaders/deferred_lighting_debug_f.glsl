@@ -1,37 +1,46 @@
-#version 330 core
+#version 430 core
 out vec4 FragColor;
 
-in vec2 TexCoords;
-
-uniform sampler2D g_position;
-uniform sampler2D g_normal;
-uniform sampler2D g_albedo_specular;
+// one packed g-buffer channel at a time, picked in the deferred window
+uniform sampler2D g_albedo_metallic;
+uniform sampler2D g_normal_roughness;
+uniform sampler2D g_depth;
 uniform int debug_mode;
 
+vec3 OctDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main() {
-    vec4 result = vec4(0.0);
-    
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 albedo_metallic = texelFetch(g_albedo_metallic, pixel, 0);
+    vec4 normal_roughness = texelFetch(g_normal_roughness, pixel, 0);
+    float depth = texelFetch(g_depth, pixel, 0).r;
+
+    vec3 result;
     switch(debug_mode) {
-        case 0: // Position (RGB)
-            result = vec4(texture(g_position, TexCoords).rgb, 1.0);
+        case 0: // albedo
+            result = albedo_metallic.rgb;
             break;
-        case 1: // Normal (RGB)
-            result = vec4(texture(g_normal, TexCoords).rgb, 1.0);
+        case 1: // world normal
+            result = OctDecode(normal_roughness.xy) * 0.5 + 0.5;
             break;
-        case 2: // Albedo (RGB)
-            result = vec4(texture(g_albedo_specular, TexCoords).rgb, 1.0);
+        case 2: // metallic
+            result = vec3(albedo_metallic.a);
             break;
-        case 3: // Specular (Alpha of Albedo Texture)
-            float specular = texture(g_albedo_specular, TexCoords).a;
-            result = vec4(specular, specular, specular, 1.0);
+        case 3: // roughness
+            result = vec3(normal_roughness.b);
             break;
-        case 4: // Depth Visualization
-            float depth = gl_FragCoord.z;
-            result = vec4(vec3(depth), 1.0);
+        case 4: // depth, stretched so near geometry isnt all white
+            result = vec3(pow(depth, 64.0));
             break;
         default:
-            result = vec4(1.0, 0.0, 1.0, 1.0); // Magenta error color
+            result = vec3(1.0, 0.0, 1.0); // magenta error color
     }
-    
-    FragColor = result;
-}
\ No newline at end of file
+
+    FragColor = vec4(result, 1.0);
+}
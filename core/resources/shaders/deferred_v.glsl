@@ -1,20 +1,39 @@
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNor;
-layout (location = 2) in vec2 aTexCoord;
+#version 430 core
+#include "vertex_format.glsl"
 
-out vec2 TexCoord;
-out vec3 FragPos;  // position in world space --> cam too
-out vec3 Normal;   // normal in world space  --> move to camera space prolly both
+struct instance {
+    mat4 model;
+    mat3 normal_matrix;
+};
+// filled by the render queue, one entry per drawn entity
+layout (std430, binding = 1) readonly buffer instance_buffer {
+    instance instances[];
+};
+// base instance + gl_InstanceID, fed by the geometry pool
+layout (location = 5) in uint instance_id;
+// per view, bound by the renderer for each pass
+layout (std140, binding = 0) uniform view_data {
+    mat4 view;
+    mat4 projection;
+    vec3 view_position;
+};
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// no world position out, the lighting pass rebuilds it from depth
+out vec3 Normal;   // normal in world space
+out vec2 TexCoord;
+out vec3 Tangentout;
+out vec3 Bitangentout;
 
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));  // Transform to world space
-    Normal = aNor; //vec3(transpose(inverse(model))) * aNor;  // Correct normal transform
+    mat4 model = instances[instance_id].model;
+    mat3 normal_matrix = instances[instance_id].normal_matrix;
+    vec3 normal, tangent, bitangent;
+    decode_frame(normal, tangent, bitangent);
+
+    Normal = normalize(normal_matrix * normal);
+    TexCoord = vertex_uv;
+    Tangentout = normalize(normal_matrix * tangent);
+    Bitangentout = normalize(normal_matrix * bitangent);
 
-    gl_Position = projection * view * vec4(FragPos, 1.0);
-    TexCoord = aTexCoord;
+    gl_Position = projection * view * model * vec4(vertex_position, 1.0);
 }
@@ -142,7 +142,10 @@ void main() {
         vec3 B = normalize(frag_bitangent);
         
         // Get normal from normal map and transform to world space
-        vec3 normal_map_value = texture(normal_map, tex_coord).rgb * 2.0 - 1.0;
+        // cooked maps only carry x and y
+        vec3 normal_map_value;
+        normal_map_value.xy = texture(normal_map, tex_coord).rg * 2.0 - 1.0;
+        normal_map_value.z = sqrt(max(1.0 - dot(normal_map_value.xy, normal_map_value.xy), 0.0));
         mat3 TBN = mat3(T, B, N);
         N = normalize(TBN * normal_map_value);
     }
@@ -1,11 +1,7 @@
 #version 330 core
 
 // Input vertex attributes
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec2 tex_coord;
-layout (location = 3) in vec3 tangent;
-layout (location = 4) in vec3 bitangent;
+#include "vertex_format.glsl"
 
 // Output to fragment shader
 out vec3 frag_position;
@@ -19,8 +15,14 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 uniform mat3 normal_matrix; // Inverse transpose of model matrix for normal transformation
+uniform vec3 position_offset; // mesh dequantize, set by Mesh::draw
+uniform vec3 position_scale;
 
 void main() {
+    vec3 position = position_offset + vertex_position * position_scale;
+    vec3 normal, tangent, bitangent;
+    decode_frame(normal, tangent, bitangent);
+
     // Calculate vertex position in world space
     frag_position = vec3(model * vec4(position, 1.0));
     
@@ -30,7 +32,7 @@ void main() {
     frag_bitangent = normalize(normal_matrix * bitangent);
     
     // Pass texture coordinates to fragment shader
-    frag_tex_coord = tex_coord;
+    frag_tex_coord = vertex_uv;
     
     // Calculate final position
     gl_Position = projection * view * model * vec4(position, 1.0);
@@ -1,13 +1,23 @@
 #version 430 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNor;
-layout (location = 2) in vec2 aTexCoord;
-layout (location = 3) in vec3 Tangent;
-layout (location = 4) in vec3 Bitangent;
+// only the position is read
+layout (location = VERTEX_POSITION_LOCATION) in vec3 aPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+struct instance {
+    mat4 model;
+    mat3 normal_matrix;
+};
+// filled by the render queue, one entry per drawn entity
+layout (std430, binding = 1) readonly buffer instance_buffer {
+    instance instances[];
+};
+// base instance + gl_InstanceID, fed by the geometry pool
+layout (location = 5) in uint instance_id;
+// per view, bound by the renderer for each pass
+layout (std140, binding = 0) uniform view_data {
+    mat4 view;
+    mat4 projection;
+    vec3 view_position;
+};
 // uniform mat3 normal_matrix;
 
 void main() {
@@ -20,5 +30,6 @@ void main() {
     Tangentout = normalize(normal_matrix * Tangent);
     Bitangentout = normalize(normal_matrix * Bitangent);*/
 
+    mat4 model = instances[instance_id].model;
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
@@ -0,0 +1,237 @@
+// lights, shadows and the pbr brdf shared by the forward (fragment.glsl) and deferred (deferred_light_f.glsl) paths,
+// everything takes the world position so either one can feed it
+
+// lights and shadow matrices, uploaded once per frame
+layout (std140, binding = 1) uniform light_data {
+    mat4 light_view;
+    mat4 light_projection;
+    mat4 cascade_matrices[4];  // directional light, projection * view per cascade
+    vec3 spot_light_position;
+    float spot_light_intensity;
+    vec3 spot_light_direction;
+    float spot_light_inner_cone;
+    vec3 spot_light_color;
+    float spot_light_outer_cone;
+    vec3 directional_light_direction;
+    float directional_light_intensity;
+    vec3 directional_light_color;
+    uvec4 cluster_grid;   // clusters x, y, z, max lights per cluster
+    vec4 cluster_params;  // tile size in pixels, depth slice scale, depth slice bias
+    vec4 cascade_splits;  // view space depth where each cascade ends
+};
+
+// clustered point lights, filled by the cluster compute shaders or the cpu binner (clustered_lights.h)
+struct point_light {
+    vec4 position_radius;
+    vec4 color_intensity;
+    ivec4 shadow; // x first shadow_tiles record, -1 unshadowed
+};
+layout (std430, binding = 3) readonly buffer light_buffer {
+    point_light point_lights[];
+};
+layout (std430, binding = 4) readonly buffer light_grid_buffer {
+    uint light_counts[];
+};
+layout (std430, binding = 5) readonly buffer light_index_buffer {
+    uint light_indices[];
+};
+// shadow atlas tiles (shadow_atlas.h), six in a row per point light
+struct shadow_tile {
+    mat4 view_projection;
+    vec4 rect; // uv offset, uv scale in the atlas
+};
+layout (std430, binding = 6) readonly buffer shadow_tile_buffer {
+    shadow_tile shadow_tiles[];
+};
+
+uniform sampler2D shadow_map; // spotlight
+uniform sampler2DArrayShadow directional_shadow_map; // one layer per cascade
+uniform sampler2DShadow shadow_atlas;
+
+const float PI = 3.14159265359;
+
+// Normal Distribution Function (GGX/Trowbridge-Reitz)
+float DistributionGGX(vec3 N, vec3 H, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float NdotH = max(dot(N, H), 0.0);
+    float NdotH2 = NdotH * NdotH;
+
+    float num = a2;
+    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+    denom = PI * denom * denom;
+
+    return num / denom;
+}
+
+// Geometry function (Smith's method)
+float GeometrySchlickGGX(float NdotV, float roughness) {
+    float r = (roughness + 1.0);
+    float k = (r * r) / 8.0;
+
+    float num = NdotV;
+    float denom = NdotV * (1.0 - k) + k;
+
+    return num / denom;
+}
+
+float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
+    float NdotV = max(dot(N, V), 0.0);
+    float NdotL = max(dot(N, L), 0.0);
+    float ggx2 = GeometrySchlickGGX(NdotV, roughness);
+    float ggx1 = GeometrySchlickGGX(NdotL, roughness);
+
+    return ggx1 * ggx2;
+}
+
+// Fresnel equation (Schlick's approximation)
+vec3 fresnelSchlick(float cosTheta, vec3 F0) {
+    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+// fragPosLightSpace is light_projection * light_view * position, the forward path interpolates it from the vertex shader
+float SpotShadowCalculation(vec4 fragPosLightSpace) {
+    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+    projCoords = projCoords * 0.5 + 0.5;
+
+    if(projCoords.z > 1.0)
+        return 0.0;
+
+    float closestDepth = texture(shadow_map, projCoords.xy).r;
+    float currentDepth = projCoords.z;
+
+    float bias = 0.005;
+    float shadow = currentDepth - bias > closestDepth ? 1.0 : 0.0;
+
+    return shadow;
+}
+
+// first cascade whose slice reaches the fragment, 3x3 taps of hardware compared pcf
+float DirectionalShadowCalculation(vec3 P, float view_depth, vec3 N, vec3 L) {
+    int cascade = 0;
+    while (cascade < 4 && view_depth > cascade_splits[cascade])
+        cascade++;
+    if (cascade == 4)
+        return 0.0;
+
+    vec4 fragPosLightSpace = cascade_matrices[cascade] * vec4(P, 1.0);
+    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+    projCoords = projCoords * 0.5 + 0.5;
+
+    if(projCoords.z > 1.0)
+        return 0.0;
+
+    float bias = max(0.002 * (1.0 - dot(N, L)), 0.0005);
+    vec2 texel = 1.0 / vec2(textureSize(directional_shadow_map, 0).xy);
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++)
+        for (int y = -1; y <= 1; y++)
+            lit += texture(directional_shadow_map, vec4(projCoords.xy + vec2(x, y) * texel, cascade, projCoords.z - bias));
+
+    return 1.0 - lit / 9.0;
+}
+
+vec3 CalculateLighting(vec3 L, vec3 radiance, vec3 N, vec3 V, vec3 F0, vec3 albedo, float metallic, float roughness) {
+    vec3 H = normalize(V + L);
+
+    // cook-torrance brdf
+    float NDF = DistributionGGX(N, H, roughness);
+    float G = GeometrySmith(N, V, L, roughness);
+    vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
+
+    vec3 kS = F;
+    vec3 kD = vec3(1.0) - kS;
+    kD *= 1.0 - metallic;
+
+    vec3 numerator = NDF * G * F;
+    float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001;
+    vec3 specular = numerator / denominator;
+
+    float NdotL = max(dot(N, L), 0.0);
+    return (kD * albedo / PI + specular) * radiance * NdotL;
+}
+
+uint ClusterIndex(float view_depth) {
+    uint slice = uint(max(log(max(view_depth, 1e-4)) * cluster_params.z - cluster_params.w, 0.0));
+    uvec3 cluster = uvec3(uvec2(gl_FragCoord.xy / cluster_params.xy), slice);
+    cluster = min(cluster, cluster_grid.xyz - 1u);
+    return cluster.x + cluster.y * cluster_grid.x + cluster.z * cluster_grid.x * cluster_grid.y;
+}
+
+// cube face by major axis, same order the renderer draws them in (+x -x +y -y +z -z)
+float PointShadow(int first, vec3 P, vec3 from_light, vec3 N) {
+    vec3 a = abs(from_light);
+    int face;
+    if (a.x >= a.y && a.x >= a.z)
+        face = from_light.x > 0.0 ? 0 : 1;
+    else if (a.y >= a.z)
+        face = from_light.y > 0.0 ? 2 : 3;
+    else
+        face = from_light.z > 0.0 ? 4 : 5;
+    shadow_tile t = shadow_tiles[first + face];
+
+    // push out along the normal by about a texel, a 90 degree face is 2 * distance wide
+    float tile_size = t.rect.z * float(textureSize(shadow_atlas, 0).x);
+    float texel = 2.0 * max(a.x, max(a.y, a.z)) / tile_size;
+    vec4 p = t.view_projection * vec4(P + N * texel * 1.5, 1.0);
+    vec3 c = p.xyz / p.w * 0.5 + 0.5;
+
+    // stay half a texel inside the tile so filtering never reads the neighbour
+    float h = 0.5 / tile_size;
+    vec2 uv = t.rect.xy + clamp(c.xy, vec2(h), vec2(1.0 - h)) * t.rect.zw;
+    return texture(shadow_atlas, vec3(uv, c.z - 0.0005));
+}
+
+// only the lights binned into this fragment's cluster
+vec3 CalculatePointLights(vec3 P, float view_depth, vec3 N, vec3 V, vec3 F0, vec3 albedo, float metallic, float roughness) {
+    uint cluster = ClusterIndex(view_depth);
+    uint count = light_counts[cluster];
+    uint first = cluster * cluster_grid.w;
+
+    vec3 Lo = vec3(0.0);
+    for (uint i = 0; i < count; i++) {
+        point_light light = point_lights[light_indices[first + i]];
+        vec3 to_light = light.position_radius.xyz - P;
+        float distance = length(to_light);
+        vec3 L = to_light / max(distance, 1e-4);
+
+        // inverse square, windowed to reach zero at the radius so the cluster cutoff doesnt show
+        float falloff = clamp(1.0 - pow(distance / light.position_radius.w, 4.0), 0.0, 1.0);
+        float attenuation = light.color_intensity.w * falloff * falloff / (distance * distance + 1.0);
+        vec3 radiance = light.color_intensity.rgb * attenuation;
+        if (light.shadow.x >= 0)
+            radiance *= PointShadow(light.shadow.x, P, -to_light, N);
+
+        Lo += CalculateLighting(L, radiance, N, V, F0, albedo, metallic, roughness);
+    }
+    return Lo;
+}
+
+vec3 CalculateDirectionalLight(vec3 P, float view_depth, vec3 N, vec3 V, vec3 F0, vec3 albedo, float metallic, float roughness) {
+    vec3 L = normalize(-directional_light_direction); // Light direction points towards the light
+    vec3 radiance = directional_light_color * directional_light_intensity;
+
+    vec3 lighting = CalculateLighting(L, radiance, N, V, F0, albedo, metallic, roughness);
+
+    float shadow = DirectionalShadowCalculation(P, view_depth, N, L);
+    return lighting * (1.0 - shadow);
+}
+
+vec3 CalculateSpotLight(vec3 P, vec4 fragPosLightSpace, vec3 N, vec3 V, vec3 F0, vec3 albedo, float metallic, float roughness) {
+    vec3 L = normalize(spot_light_position - P);
+    float distance = length(spot_light_position - P);
+
+    vec3 spotDir = normalize(spot_light_direction);
+    float theta = dot(L, -spotDir);
+
+    float epsilon = spot_light_inner_cone - spot_light_outer_cone;
+    float intensity = clamp((theta - spot_light_outer_cone) / epsilon, 0.0, 1.0);
+
+    float attenuation = spot_light_intensity / (distance * distance);
+    vec3 radiance = spot_light_color * attenuation * intensity;
+
+    vec3 lighting = CalculateLighting(L, radiance, N, V, F0, albedo, metallic, roughness);
+
+    float shadow = SpotShadowCalculation(fragPosLightSpace);
+    return lighting * (1.0 - shadow);
+}
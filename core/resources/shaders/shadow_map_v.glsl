@@ -1,11 +1,26 @@
-#version 330
+#version 430 core
 
-layout (location = 0) in vec3 aPos;
+// drawn with the geometry pool's position vao, nothing else is fetched
+layout (location = VERTEX_POSITION_LOCATION) in vec3 aPos;
 
-uniform mat4 model;
-uniform mat4 view; // light view
-uniform mat4 projection; // light proj
+struct instance {
+    mat4 model;
+    mat3 normal_matrix;
+};
+// filled by the render queue, one entry per drawn entity
+layout (std430, binding = 1) readonly buffer instance_buffer {
+    instance instances[];
+};
+// base instance + gl_InstanceID, fed by the geometry pool
+layout (location = 5) in uint instance_id;
+// per view, bound by the renderer for each pass
+layout (std140, binding = 0) uniform view_data {
+    mat4 view;
+    mat4 projection;
+    vec3 view_position;
+};
 
 void main() {
+    mat4 model = instances[instance_id].model;
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
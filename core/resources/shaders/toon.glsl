@@ -82,8 +82,10 @@ void main() {
     // Get normal
     vec3 N = normalize(Normal);
     if (has_normal) {
-        vec3 normalMap = texture(normal, TexCoord).rgb;
-        normalMap = normalMap * 2.0 - 1.0;
+        // bc5 maps come without z
+        vec3 normalMap;
+        normalMap.xy = texture(normal, TexCoord).rg * 2.0 - 1.0;
+        normalMap.z = sqrt(max(1.0 - dot(normalMap.xy, normalMap.xy), 0.0));
         
         vec3 T = normalize(Tangentout);
         vec3 B = normalize(Bitangentout);
@@ -1,38 +1,63 @@
 #version 430 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNor;
-layout (location = 2) in vec2 aTexCoord;
-layout (location = 3) in vec3 Tangent;
-layout (location = 4) in vec3 Bitangent;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat3 normal_matrix;
-uniform mat4 light_view;
-uniform mat4 light_projection;
-uniform mat4 dir_light_view;
-uniform mat4 dir_light_projection;
+#include "vertex_format.glsl"
+
+struct instance {
+    mat4 model;
+    mat3 normal_matrix;
+};
+// filled by the render queue, one entry per drawn entity
+layout (std430, binding = 1) readonly buffer instance_buffer {
+    instance instances[];
+};
+// base instance + gl_InstanceID, fed by the geometry pool
+layout (location = 5) in uint instance_id;
+// per view, bound by the renderer for each pass
+layout (std140, binding = 0) uniform view_data {
+    mat4 view;
+    mat4 projection;
+    vec3 view_position;
+};
+// lights and shadow matrices, uploaded once per frame
+layout (std140, binding = 1) uniform light_data {
+    mat4 light_view;
+    mat4 light_projection;
+    mat4 cascade_matrices[4];  // directional light, projection * view per cascade
+    vec3 spot_light_position;
+    float spot_light_intensity;
+    vec3 spot_light_direction;
+    float spot_light_inner_cone;
+    vec3 spot_light_color;
+    float spot_light_outer_cone;
+    vec3 directional_light_direction;
+    float directional_light_intensity;
+    vec3 directional_light_color;
+    uvec4 cluster_grid;   // clusters x, y, z, max lights per cluster
+    vec4 cluster_params;  // tile size in pixels, depth slice scale, depth slice bias
+    vec4 cascade_splits;  // view space depth where each cascade ends
+};
 
 out vec3 FragPos;  // position in world space
 out vec4 FragPosLight;  // position in world space
-out vec4 FragPosLightDirectional;  // position in world space
 out vec3 Normal;   // normal in world space
 out vec2 TexCoord;
 out vec3 Tangentout;
 out vec3 Bitangentout;
 
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    mat4 model = instances[instance_id].model;
+    mat3 normal_matrix = instances[instance_id].normal_matrix;
+    vec3 normal, tangent, bitangent;
+    decode_frame(normal, tangent, bitangent);
+
+    FragPos = vec3(model * vec4(vertex_position, 1.0));
     FragPosLight = light_projection * light_view * vec4(FragPos, 1.0);
-    FragPosLightDirectional = dir_light_projection * dir_light_view * vec4(FragPos, 1.0);
 
-    Normal = normalize(normal_matrix * aNor);
+    Normal = normalize(normal_matrix * normal);
 
-    TexCoord = aTexCoord;
+    TexCoord = vertex_uv;
 
-    Tangentout = normalize(normal_matrix * Tangent);
-    Bitangentout = normalize(normal_matrix * Bitangent);
+    Tangentout = normalize(normal_matrix * tangent);
+    Bitangentout = normalize(normal_matrix * bitangent);
 
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * vec4(vertex_position, 1.0);
 }
@@ -0,0 +1,12 @@
+// geometry pool vertex inputs, Shader::init defines the locations from src/asset/vertex_format_gpu.cpp
+layout (location = VERTEX_POSITION_LOCATION) in vec3 vertex_position; // the mesh's unit box unless positions are float
+layout (location = VERTEX_FRAME_LOCATION) in vec4 vertex_frame;       // tangent frame quaternion, w < 0 is a mirrored bitangent
+layout (location = VERTEX_UV_LOCATION) in vec2 vertex_uv;
+
+// rotation of the quaternion applied to the x (tangent) and z (normal) axes
+void decode_frame(out vec3 normal, out vec3 tangent, out vec3 bitangent) {
+    vec4 q = normalize(vertex_frame);
+    tangent = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+    normal = vec3(2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+    bitangent = cross(normal, tangent) * (q.w < 0.0 ? -1.0 : 1.0);
+}
@@ -1,14 +1,14 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;       // Position
-layout (location = 1) in vec3 aNormal;    // (Optional) Normal
-layout (location = 2) in vec2 aTexCoords; // (Optional) UVs, if you want to sample a texture
+#include "vertex_format.glsl"
 
 // Uniforms
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 uniform float time;
+uniform vec3 position_offset; // back from the mesh's unit box
+uniform vec3 position_scale;
 
 // Outputs to fragment shader
 out vec2 TexCoords; 
@@ -17,6 +17,10 @@ out vec3 Normal;     // Pass transformed normal, if you want lighting
 
 void main()
 {
+    vec3 aPos = position_offset + vertex_position * position_scale;
+    vec3 aNormal, tangent, bitangent;
+    decode_frame(aNormal, tangent, bitangent);
+
     // Apply a simple sine-wave displacement on the mesh
     // You can tweak amplitude/frequency/phase for different wave styles
     float amplitude = 0.04;      // wave height
@@ -42,7 +46,7 @@ void main()
     WorldPos = worldPosition.xyz;
 
     // Pass UVs if your mesh uses them
-    TexCoords = aTexCoords;
+    TexCoords = vertex_uv;
 
     // Finally, project to clip space
     gl_Position = projection * view * worldPosition;
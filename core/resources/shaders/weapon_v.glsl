@@ -1,12 +1,12 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoords;
+#include "vertex_format.glsl"
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform vec3 position_offset;
+uniform vec3 position_scale;
 
 // For a wave effect:
 uniform float time; // pass elapsed time from the CPU
@@ -17,6 +17,10 @@ out vec3 FragPos;
 
 void main()
 {
+    vec3 aPos = position_offset + vertex_position * position_scale;
+    vec3 aNormal, tangent, bitangent;
+    decode_frame(aNormal, tangent, bitangent);
+
     // Simple wave along the y-axis
     float waveAmplitude = 0.01;   // how high the wave goes
     float waveFrequency = 5.0;    // how many waves across the mesh
@@ -26,7 +30,7 @@ void main()
     displacedPos.y += sin(waveFrequency + time * 2.0) * waveAmplitude;
 
     // Standard transformations
-    TexCoords = aTexCoords;
+    TexCoords = vertex_uv;
     
     // Transform normal correctly (assumes model has uniform scale)
     Normal = mat3(transpose(inverse(model))) * aNormal;
@@ -0,0 +1,168 @@
+#include "asset_registry.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cstdio>
+
+namespace Asset_registry {
+    uint64_t budget = 1024ull * 1024 * 1024;
+
+    struct entry {
+        const char* name;
+        uint32_t refs;
+        bool resident;
+        uint64_t cpu_bytes;
+        uint64_t gpu_bytes;
+        uint64_t last_used; // frame of the last add / acquire / release
+    };
+
+    struct type_table {
+        std::vector<entry> entries; // by slot
+        std::unordered_map<asset_key, uint32_t> lookup;
+        evict_fn evict = nullptr;
+        uint32_t evictions = 0;
+    };
+
+    static type_table g_types[TYPE_COUNT];
+    static std::unordered_set<std::string> g_names; // nodes dont move, c_str stays valid
+    static uint64_t g_frame = 0;
+    static uint64_t g_total = 0;
+
+    static const char* TYPE_NAMES[TYPE_COUNT] = { "model", "texture", "shader" };
+
+    const char* intern(const std::string& name) {
+        return g_names.insert(name).first->c_str();
+    }
+
+    void set_evictor(asset_type type, evict_fn fn) {
+        g_types[type].evict = fn;
+    }
+
+    bool find(asset_type type, const std::string& path, uint32_t& slot) {
+        const type_table& t = g_types[type];
+        auto it = t.lookup.find(hash(path));
+        if (it == t.lookup.end())
+            return false;
+        if (path == t.entries[it->second].name) {
+            slot = it->second;
+            return true;
+        }
+        // two paths with one hash, the second one is only found the slow way
+        for (uint32_t i = 0; i < (uint32_t)t.entries.size(); i++) {
+            if (path == t.entries[i].name) {
+                slot = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void add(asset_type type, const std::string& path, uint32_t slot) {
+        type_table& t = g_types[type];
+        assert(slot == t.entries.size());
+        t.entries.push_back({ intern(path), 0, false, 0, 0, g_frame });
+        if (!t.lookup.emplace(hash(path), slot).second)
+            printf("[ASSETS] hash collision on %s\n", path.c_str());
+    }
+
+    const char* name(asset_type type, uint32_t slot) {
+        return g_types[type].entries[slot].name;
+    }
+
+    void acquire(asset_type type, uint32_t slot) {
+        entry& e = g_types[type].entries[slot];
+        e.refs++;
+        e.last_used = g_frame;
+    }
+
+    void release(asset_type type, uint32_t slot) {
+        entry& e = g_types[type].entries[slot];
+        assert(e.refs > 0);
+        e.refs--;
+        e.last_used = g_frame;
+    }
+
+    uint32_t refs(asset_type type, uint32_t slot) {
+        return g_types[type].entries[slot].refs;
+    }
+
+    void set_resident(asset_type type, uint32_t slot, uint64_t cpu_bytes, uint64_t gpu_bytes) {
+        entry& e = g_types[type].entries[slot];
+        if (e.resident)
+            g_total -= e.cpu_bytes + e.gpu_bytes;
+        e.resident = true;
+        e.cpu_bytes = cpu_bytes;
+        e.gpu_bytes = gpu_bytes;
+        e.last_used = g_frame;
+        g_total += cpu_bytes + gpu_bytes;
+    }
+
+    bool resident(asset_type type, uint32_t slot) {
+        return g_types[type].entries[slot].resident;
+    }
+
+    void update() {
+        g_frame++;
+        if (budget == 0 || g_total <= budget)
+            return;
+
+        struct candidate {
+            uint64_t last_used;
+            asset_type type;
+            uint32_t slot;
+        };
+        std::vector<candidate> candidates;
+        for (int type = 0; type < TYPE_COUNT; type++) {
+            const type_table& t = g_types[type];
+            if (!t.evict)
+                continue;
+            for (uint32_t i = 0; i < (uint32_t)t.entries.size(); i++)
+                if (t.entries[i].resident && t.entries[i].refs == 0)
+                    candidates.push_back({ t.entries[i].last_used, (asset_type)type, i });
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const candidate& a, const candidate& b) { return a.last_used < b.last_used; });
+
+        for (const candidate& c : candidates) {
+            if (g_total <= budget)
+                break;
+            type_table& t = g_types[c.type];
+            entry& e = t.entries[c.slot];
+            t.evict(c.slot);
+            printf("[ASSETS] evicted %s %s, %.1f KB\n", TYPE_NAMES[c.type], e.name, (e.cpu_bytes + e.gpu_bytes) / 1024.0);
+            g_total -= e.cpu_bytes + e.gpu_bytes;
+            e.cpu_bytes = e.gpu_bytes = 0;
+            e.resident = false;
+            t.evictions++;
+        }
+    }
+
+    uint64_t total_bytes() {
+        return g_total;
+    }
+
+    type_stats get_stats(asset_type type) {
+        const type_table& t = g_types[type];
+        type_stats s;
+        s.assets = (uint32_t)t.entries.size();
+        for (const entry& e : t.entries) {
+            s.resident += e.resident;
+            s.referenced += e.refs > 0;
+            s.cpu_bytes += e.cpu_bytes;
+            s.gpu_bytes += e.gpu_bytes;
+        }
+        s.evictions = t.evictions;
+        return s;
+    }
+
+    void shutdown() {
+        for (type_table& t : g_types) {
+            t.entries.clear();
+            t.lookup.clear();
+        }
+        g_names.clear();
+        g_total = 0;
+    }
+}
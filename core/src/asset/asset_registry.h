@@ -0,0 +1,76 @@
+#ifndef ASSET_REGISTRY_H
+#define ASSET_REGISTRY_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// bookkeeping shared by the asset managers, the assets themselves stay in the managers' slots
+//   assets are found by a 64 bit fnv-1a hash of their path, names are interned once
+//   owners (entity stores, models for their textures, weapons, fonts) acquire / release slots
+//   managers report cpu and gpu bytes once an asset is resident
+//   update() evicts resident assets nobody references, least recently released first,
+//   until the total is back under budget. an evicted slot resolves to its placeholder again and
+//   the next load of the same path streams it back into the same slot, so handles never dangle
+// main thread only
+namespace Asset_registry {
+    enum asset_type : uint8_t { MODEL, TEXTURE, SHADER, TYPE_COUNT };
+
+    typedef uint64_t asset_key;
+    static const asset_key FNV_OFFSET = 0xcbf29ce484222325ull;
+    static const asset_key FNV_PRIME = 0x100000001b3ull;
+
+    // evictor frees what the slot holds, the registry zeroes its bytes afterwards
+    typedef void (*evict_fn)(uint32_t slot);
+
+    struct type_stats {
+        uint32_t assets = 0;
+        uint32_t resident = 0;
+        uint32_t referenced = 0;
+        uint64_t cpu_bytes = 0;
+        uint64_t gpu_bytes = 0;
+        uint32_t evictions = 0; // since start
+    };
+
+    inline asset_key hash_bytes(const void* data, size_t size, asset_key h = FNV_OFFSET) {
+        const uint8_t* p = (const uint8_t*)data;
+        for (size_t i = 0; i < size; i++) {
+            h ^= p[i];
+            h *= FNV_PRIME;
+        }
+        return h;
+    }
+
+    inline asset_key hash(const std::string& path) {
+        return hash_bytes(path.data(), path.size());
+    }
+
+    // 0 lets nothing be evicted
+    extern uint64_t budget;
+
+    // one copy per distinct name, lives until shutdown
+    const char* intern(const std::string& name);
+
+    void set_evictor(asset_type type, evict_fn fn);
+    // slot of the asset with this path, false if it was never added
+    bool find(asset_type type, const std::string& path, uint32_t& slot);
+    // slots are handed out by the manager, in order
+    void add(asset_type type, const std::string& path, uint32_t slot);
+    const char* name(asset_type type, uint32_t slot);
+
+    void acquire(asset_type type, uint32_t slot);
+    void release(asset_type type, uint32_t slot);
+    uint32_t refs(asset_type type, uint32_t slot);
+    // loaded and counted, only resident assets can be evicted
+    void set_resident(asset_type type, uint32_t slot, uint64_t cpu_bytes, uint64_t gpu_bytes);
+    bool resident(asset_type type, uint32_t slot);
+
+    // once a frame
+    void update();
+    // total cpu + gpu bytes of every resident asset
+    uint64_t total_bytes();
+    type_stats get_stats(asset_type type);
+    void shutdown();
+}
+#endif
@@ -0,0 +1,100 @@
+#ifndef COOKED_MESH_H
+#define COOKED_MESH_H
+
+#include <string>
+#include <cstdint>
+#include <filesystem>
+#include <system_error>
+
+#include <glm/glm.hpp>
+
+#include "mesh_lod.h"
+#include "vertex_format.h"
+
+// .glwm, a model the way Model_ass holds it after import, written by the cook tool next to its source
+// (backpack/scene.gltf -> backpack/scene.gltf.glwm) so loading skips assimp, normalize, the bvh and lod builds
+//   the file is mapped read only, sections are SECTION_ALIGN aligned and addressed by offset from the start
+//   vertices are already in the pool format (both Vertex_format streams, each mesh quantized against its own box),
+//   indices are every mesh's pool run (lod 0 then the coarser levels, see mesh_lod.h),
+//   all of it goes to the geometry pool straight from the mapping
+//   bvh nodes / triangles and the occluder are copied out as they are
+//   texture paths are relative to the model's directory
+// a file older than its source, of another version, or cooked with another vertex format / bvh_node is ignored
+// and the model is imported from source like before
+namespace Cooked_mesh {
+    const uint32_t MAGIC = 0x4d574c47; // "GLWM"
+    const uint32_t VERSION = 2;
+    const uint32_t SECTION_ALIGN = 16;
+    const uint32_t NO_TEXTURE = ~0u;
+    const char* const EXTENSION = ".glwm";
+
+    struct section {
+        uint64_t offset;
+        uint64_t size; // bytes
+    };
+
+    enum section_id {
+        MESHES,
+        POSITIONS,
+        SURFACES,
+        INDICES,
+        BVH_NODES,
+        BVH_TRIS,
+        BVH_TRI_IDS,
+        OCCLUDER_POSITIONS,
+        OCCLUDER_INDICES,
+        STRINGS,
+        SECTION_COUNT
+    };
+
+    struct header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t position_size; // sizeof(packed_position) when cooked, float and unorm16 positions dont mix
+        uint32_t surface_size;  // sizeof(packed_surface)
+        uint32_t bvh_node_size; // sizeof(bvh_node) when cooked
+        uint32_t mesh_count;
+        uint32_t occluder_authored;
+        int32_t lod_count;
+        glm::vec3 aabb_min;
+        glm::vec3 aabb_max;
+        float lod_errors[Mesh_lod::MAX_LODS];
+        uint32_t lod_triangles[Mesh_lod::MAX_LODS];
+        section sections[SECTION_COUNT];
+    };
+
+    struct mesh_record {
+        uint32_t first_vertex;  // into POSITIONS and SURFACES
+        uint32_t vertex_count;
+        glm::vec3 position_offset; // the mesh's Vertex_format::quantization
+        glm::vec3 position_scale;
+        uint32_t first_index;   // into INDICES, the mesh's whole pool run
+        uint32_t index_count;
+        uint32_t lod_count;
+        Mesh_lod::level lods[Mesh_lod::MAX_LODS];
+        uint32_t textures[3];   // albedo, normal, metallic roughness: offsets into STRINGS, NO_TEXTURE if none
+    };
+
+    inline std::string cooked_path(const std::string& source) {
+        return source + EXTENSION;
+    }
+
+    // there is a cooked file and the source wasnt touched after it was written
+    inline bool fresh(const std::string& source) {
+        std::error_code ec;
+        auto cooked_time = std::filesystem::last_write_time(cooked_path(source), ec);
+        if (ec)
+            return false;
+        auto source_time = std::filesystem::last_write_time(source, ec);
+        return ec || source_time <= cooked_time; // no source at all, cooked is all there is
+    }
+
+    // every section inside the file and the mesh table as long as it says
+    inline bool valid(const header& h, size_t file_size) {
+        for (const section& s : h.sections)
+            if (s.offset % SECTION_ALIGN != 0 || s.offset > file_size || s.size > file_size - s.offset)
+                return false;
+        return h.sections[MESHES].size == (uint64_t)h.mesh_count * sizeof(mesh_record);
+    }
+}
+#endif
@@ -26,6 +26,8 @@ public:
 
     Font(const std::string& font_name) {
         atlas_texture_id = Texture_manager::load_from_path("../resources/fonts/" + font_name + "/" + font_name + ".png");
+        // fonts live for the whole run
+        Texture_manager::acquire(atlas_texture_id);
 
         // load glyphs into datastructure
         std::ifstream json_file("../resources/fonts/" + font_name +"/" + font_name + ".json");
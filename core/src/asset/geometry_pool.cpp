@@ -0,0 +1,318 @@
+#include "geometry_pool.h"
+
+#include <algorithm>
+#include <numeric>
+#include <iostream>
+#include <cassert>
+
+#include <glad/glad.h>
+
+namespace Geometry_pool {
+    using Vertex_format::STREAM_COUNT;
+    using Vertex_format::STREAM_STRIDES;
+
+    struct free_range {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // first fit over free ranges sorted by offset, units are elements not bytes
+    struct range_allocator {
+        std::vector<free_range> ranges;
+        uint32_t capacity = 0;
+        uint32_t used = 0;
+
+        void reset(uint32_t new_capacity, uint32_t new_used) {
+            capacity = new_capacity;
+            used = new_used;
+            ranges.clear();
+            if (new_used < new_capacity)
+                ranges.push_back(free_range{ new_used, new_capacity - new_used });
+        }
+
+        bool allocate(uint32_t size, uint32_t& offset) {
+            for (size_t i = 0; i < ranges.size(); i++) {
+                if (ranges[i].size < size)
+                    continue;
+                offset = ranges[i].offset;
+                ranges[i].offset += size;
+                ranges[i].size -= size;
+                if (ranges[i].size == 0)
+                    ranges.erase(ranges.begin() + i);
+                used += size;
+                return true;
+            }
+            return false;
+        }
+
+        void release(uint32_t offset, uint32_t size) {
+            if (size == 0)
+                return;
+            used -= size;
+            auto it = std::lower_bound(ranges.begin(), ranges.end(), offset, [](const free_range& r, uint32_t o) { return r.offset < o; });
+            it = ranges.insert(it, free_range{ offset, size });
+
+            // merge with the next, then the previous neighbour
+            auto next = it + 1;
+            if (next != ranges.end() && it->offset + it->size == next->offset) {
+                it->size += next->size;
+                ranges.erase(next);
+            }
+            if (it != ranges.begin()) {
+                auto prev = it - 1;
+                if (prev->offset + prev->size == it->offset) {
+                    prev->size += it->size;
+                    ranges.erase(it);
+                }
+            }
+        }
+
+        void grow(uint32_t new_capacity) {
+            if (!ranges.empty() && ranges.back().offset + ranges.back().size == capacity)
+                ranges.back().size += new_capacity - capacity;
+            else
+                ranges.push_back(free_range{ capacity, new_capacity - capacity });
+            capacity = new_capacity;
+        }
+    };
+
+    struct pool_state {
+        unsigned int vao = 0;
+        unsigned int position_vao = 0;
+        unsigned int vertex_buffers[STREAM_COUNT] = {};
+        unsigned int index_buffer = 0;
+        unsigned int instance_id_buffer = 0;
+        uint32_t instance_id_count = 0;
+
+        range_allocator vertices;
+        range_allocator indices;
+
+        std::vector<geometry_range> allocations;
+        std::vector<uint8_t> live;
+        std::vector<geometry_handle> free_handles;
+    };
+
+    static pool_state g_pool;
+
+    static const uint32_t INITIAL_VERTICES = 1 << 18;
+    static const uint32_t INITIAL_INDICES = 1 << 20;
+
+    static unsigned int create_buffer(GLenum target, size_t bytes) {
+        unsigned int buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+        glBufferData(target, bytes, nullptr, GL_STATIC_DRAW);
+        return buffer;
+    }
+
+    static void bind_buffers_to_vao() {
+        for (unsigned int vao : { g_pool.vao, g_pool.position_vao }) {
+            glBindVertexArray(vao);
+            uint32_t streams = vao == g_pool.vao ? (uint32_t)STREAM_COUNT : 1u;
+            for (uint32_t s = 0; s < streams; s++)
+                glBindVertexBuffer(s, g_pool.vertex_buffers[s], 0, STREAM_STRIDES[s]);
+            glBindVertexBuffer(INSTANCE_ID_BINDING, g_pool.instance_id_buffer, 0, sizeof(uint32_t));
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_pool.index_buffer);
+        }
+        glBindVertexArray(0);
+    }
+
+    // new buffer of new_bytes with the first old_bytes copied over on the gpu
+    static unsigned int regrow(unsigned int old_buffer, size_t old_bytes, size_t new_bytes) {
+        unsigned int buffer = create_buffer(GL_COPY_WRITE_BUFFER, new_bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, old_buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_bytes);
+        glDeleteBuffers(1, &old_buffer);
+        return buffer;
+    }
+
+    void init() {
+        glGenVertexArrays(1, &g_pool.vao);
+        glGenVertexArrays(1, &g_pool.position_vao);
+        for (uint32_t s = 0; s < STREAM_COUNT; s++)
+            g_pool.vertex_buffers[s] = create_buffer(GL_ARRAY_BUFFER, (size_t)INITIAL_VERTICES * STREAM_STRIDES[s]);
+        g_pool.index_buffer = create_buffer(GL_ARRAY_BUFFER, (size_t)INITIAL_INDICES * sizeof(unsigned int));
+        g_pool.vertices.reset(INITIAL_VERTICES, 0);
+        g_pool.indices.reset(INITIAL_INDICES, 0);
+
+        for (unsigned int vao : { g_pool.vao, g_pool.position_vao }) {
+            glBindVertexArray(vao);
+            Vertex_format::setup_attributes(vao == g_pool.position_vao);
+            glEnableVertexAttribArray(INSTANCE_ID_ATTRIBUTE);
+            glVertexAttribIFormat(INSTANCE_ID_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0);
+            glVertexAttribBinding(INSTANCE_ID_ATTRIBUTE, INSTANCE_ID_BINDING);
+            glVertexBindingDivisor(INSTANCE_ID_BINDING, 1);
+        }
+        glBindVertexArray(0);
+
+        reserve_instance_ids(1024);
+        std::cout << "[GEOMETRY] Pool initialized, " << INITIAL_VERTICES << " vertices (" << Vertex_format::VERTEX_BYTES << " bytes each), " << INITIAL_INDICES << " indices" << std::endl;
+    }
+
+    void cleanup() {
+        glDeleteVertexArrays(1, &g_pool.vao);
+        glDeleteVertexArrays(1, &g_pool.position_vao);
+        glDeleteBuffers(STREAM_COUNT, g_pool.vertex_buffers);
+        glDeleteBuffers(1, &g_pool.index_buffer);
+        glDeleteBuffers(1, &g_pool.instance_id_buffer);
+        g_pool = pool_state();
+    }
+
+    static void write_vertices(const geometry_range& r, const Vertex_format::packed_position* positions, const Vertex_format::packed_surface* surfaces, uint32_t vertex_count) {
+        const void* streams[STREAM_COUNT] = { positions, surfaces };
+        for (uint32_t s = 0; s < STREAM_COUNT; s++) {
+            glBindBuffer(GL_ARRAY_BUFFER, g_pool.vertex_buffers[s]);
+            glBufferSubData(GL_ARRAY_BUFFER, (size_t)r.base_vertex * STREAM_STRIDES[s], (size_t)vertex_count * STREAM_STRIDES[s], streams[s]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    geometry_handle allocate(const Vertex_format::packed_position* positions, const Vertex_format::packed_surface* surfaces, uint32_t vertex_count, const unsigned int* indices, uint32_t index_count) {
+        geometry_range r{ 0, vertex_count, 0, index_count };
+
+        if (!g_pool.vertices.allocate(vertex_count, r.base_vertex)) {
+            uint32_t capacity = g_pool.vertices.capacity;
+            uint32_t new_capacity = std::max(capacity * 2, capacity + vertex_count);
+            for (uint32_t s = 0; s < STREAM_COUNT; s++)
+                g_pool.vertex_buffers[s] = regrow(g_pool.vertex_buffers[s], (size_t)capacity * STREAM_STRIDES[s], (size_t)new_capacity * STREAM_STRIDES[s]);
+            g_pool.vertices.grow(new_capacity);
+            bind_buffers_to_vao();
+            // the grown tail alone fits the request, so this cant fail
+            bool ok = g_pool.vertices.allocate(vertex_count, r.base_vertex);
+            assert(ok);
+            (void)ok;
+        }
+        if (!g_pool.indices.allocate(index_count, r.first_index)) {
+            uint32_t capacity = g_pool.indices.capacity;
+            uint32_t new_capacity = std::max(capacity * 2, capacity + index_count);
+            g_pool.index_buffer = regrow(g_pool.index_buffer, (size_t)capacity * sizeof(unsigned int), (size_t)new_capacity * sizeof(unsigned int));
+            g_pool.indices.grow(new_capacity);
+            bind_buffers_to_vao();
+            // the grown tail alone fits the request, so this cant fail
+            bool ok = g_pool.indices.allocate(index_count, r.first_index);
+            assert(ok);
+            (void)ok;
+        }
+
+        write_vertices(r, positions, surfaces, vertex_count);
+        // through GL_ARRAY_BUFFER so the element binding of whatever vao is bound stays untouched
+        glBindBuffer(GL_ARRAY_BUFFER, g_pool.index_buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, (size_t)r.first_index * sizeof(unsigned int), (size_t)index_count * sizeof(unsigned int), indices);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        geometry_handle h;
+        if (!g_pool.free_handles.empty()) {
+            h = g_pool.free_handles.back();
+            g_pool.free_handles.pop_back();
+            g_pool.allocations[h] = r;
+            g_pool.live[h] = 1;
+        }
+        else {
+            h = (geometry_handle)g_pool.allocations.size();
+            g_pool.allocations.push_back(r);
+            g_pool.live.push_back(1);
+        }
+        return h;
+    }
+
+    void free(geometry_handle handle) {
+        if (handle >= g_pool.allocations.size() || !g_pool.live[handle])
+            return;
+        const geometry_range& r = g_pool.allocations[handle];
+        g_pool.vertices.release(r.base_vertex, r.vertex_count);
+        g_pool.indices.release(r.first_index, r.index_count);
+        g_pool.live[handle] = 0;
+        g_pool.free_handles.push_back(handle);
+    }
+
+    void update_vertices(geometry_handle handle, const Vertex_format::packed_position* positions, const Vertex_format::packed_surface* surfaces, uint32_t vertex_count) {
+        const geometry_range& r = g_pool.allocations[handle];
+        assert(vertex_count <= r.vertex_count);
+        write_vertices(r, positions, surfaces, vertex_count);
+    }
+
+    void defragment() {
+        std::vector<geometry_handle> order;
+        for (geometry_handle h = 0; h < g_pool.allocations.size(); h++)
+            if (g_pool.live[h])
+                order.push_back(h);
+
+        // copy into fresh buffers, packing vertices and indices separately in their current order
+        // every stream moves its ranges the same way, base_vertex is only rewritten after the last one
+        std::sort(order.begin(), order.end(), [](geometry_handle a, geometry_handle b) { return g_pool.allocations[a].base_vertex < g_pool.allocations[b].base_vertex; });
+        for (uint32_t s = 0; s < STREAM_COUNT; s++) {
+            unsigned int vertex_buffer = create_buffer(GL_COPY_WRITE_BUFFER, (size_t)g_pool.vertices.capacity * STREAM_STRIDES[s]);
+            glBindBuffer(GL_COPY_READ_BUFFER, g_pool.vertex_buffers[s]);
+            uint32_t vertex_cursor = 0;
+            for (geometry_handle h : order) {
+                const geometry_range& r = g_pool.allocations[h];
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (size_t)r.base_vertex * STREAM_STRIDES[s], (size_t)vertex_cursor * STREAM_STRIDES[s], (size_t)r.vertex_count * STREAM_STRIDES[s]);
+                vertex_cursor += r.vertex_count;
+            }
+            glDeleteBuffers(1, &g_pool.vertex_buffers[s]);
+            g_pool.vertex_buffers[s] = vertex_buffer;
+        }
+        uint32_t vertex_cursor = 0;
+        for (geometry_handle h : order) {
+            geometry_range& r = g_pool.allocations[h];
+            r.base_vertex = vertex_cursor;
+            vertex_cursor += r.vertex_count;
+        }
+
+        unsigned int index_buffer = create_buffer(GL_COPY_WRITE_BUFFER, (size_t)g_pool.indices.capacity * sizeof(unsigned int));
+        glBindBuffer(GL_COPY_READ_BUFFER, g_pool.index_buffer);
+        std::sort(order.begin(), order.end(), [](geometry_handle a, geometry_handle b) { return g_pool.allocations[a].first_index < g_pool.allocations[b].first_index; });
+        uint32_t index_cursor = 0;
+        for (geometry_handle h : order) {
+            geometry_range& r = g_pool.allocations[h];
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (size_t)r.first_index * sizeof(unsigned int), (size_t)index_cursor * sizeof(unsigned int), (size_t)r.index_count * sizeof(unsigned int));
+            r.first_index = index_cursor;
+            index_cursor += r.index_count;
+        }
+
+        glDeleteBuffers(1, &g_pool.index_buffer);
+        g_pool.index_buffer = index_buffer;
+        g_pool.vertices.reset(g_pool.vertices.capacity, vertex_cursor);
+        g_pool.indices.reset(g_pool.indices.capacity, index_cursor);
+        bind_buffers_to_vao();
+    }
+
+    const geometry_range& get_range(geometry_handle handle) {
+        return g_pool.allocations[handle];
+    }
+
+    unsigned int get_vao() {
+        return g_pool.vao;
+    }
+
+    unsigned int get_position_vao() {
+        return g_pool.position_vao;
+    }
+
+    void reserve_instance_ids(uint32_t count) {
+        if (count <= g_pool.instance_id_count)
+            return;
+        uint32_t new_count = std::max(count, g_pool.instance_id_count * 2);
+        std::vector<uint32_t> ids(new_count);
+        std::iota(ids.begin(), ids.end(), 0u);
+
+        if (!g_pool.instance_id_buffer)
+            glGenBuffers(1, &g_pool.instance_id_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, g_pool.instance_id_buffer);
+        glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(uint32_t), ids.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        g_pool.instance_id_count = new_count;
+        bind_buffers_to_vao();
+    }
+
+    pool_stats get_stats() {
+        pool_stats s;
+        s.vertex_capacity = g_pool.vertices.capacity;
+        s.vertices_used = g_pool.vertices.used;
+        s.index_capacity = g_pool.indices.capacity;
+        s.indices_used = g_pool.indices.used;
+        s.free_ranges = (uint32_t)(g_pool.vertices.ranges.size() + g_pool.indices.ranges.size());
+        s.allocations = (uint32_t)(g_pool.allocations.size() - g_pool.free_handles.size());
+        return s;
+    }
+}
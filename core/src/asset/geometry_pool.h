@@ -0,0 +1,60 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <vector>
+#include <cstdint>
+
+#include "vertex_format.h"
+
+typedef uint32_t geometry_handle;
+
+// every static mesh lives in one big vertex buffer and one big index buffer behind a single vao
+// ranges are sub allocated first fit from a sorted free list that coalesces on free
+// buffers double when full (old contents copied on the gpu), defragment packs live ranges to the front
+//
+// vertices are Vertex_format's two streams, one buffer each, a range is at the same vertex offset in both
+//
+// vao layout
+//   binding 0: positions, binding 1: normal frame + uv, attributes from Vertex_format
+//   binding 2: sequential uint ids with divisor 1, attribute 5, so draws with a base instance
+//              give the shader an index into the instance ssbo without gl_BaseInstance
+// the position vao is the same without binding 1, for depth only passes
+namespace Geometry_pool {
+    const unsigned int INSTANCE_ID_ATTRIBUTE = 5;
+    const unsigned int INSTANCE_ID_BINDING = Vertex_format::STREAM_COUNT;
+
+    struct geometry_range {
+        uint32_t base_vertex;
+        uint32_t vertex_count;
+        uint32_t first_index;
+        uint32_t index_count;
+    };
+
+    struct pool_stats {
+        uint32_t vertex_capacity;
+        uint32_t vertices_used;
+        uint32_t index_capacity;
+        uint32_t indices_used;
+        uint32_t free_ranges; // vertex + index, grows with fragmentation
+        uint32_t allocations;
+    };
+
+    // needs a gl context
+    void init();
+    void cleanup();
+
+    geometry_handle allocate(const Vertex_format::packed_position* positions, const Vertex_format::packed_surface* surfaces, uint32_t vertex_count, const unsigned int* indices, uint32_t index_count);
+    void free(geometry_handle handle);
+    void update_vertices(geometry_handle handle, const Vertex_format::packed_position* positions, const Vertex_format::packed_surface* surfaces, uint32_t vertex_count);
+    // moves every live range to the front of its buffer, handles stay valid
+    void defragment();
+
+    const geometry_range& get_range(geometry_handle handle);
+    unsigned int get_vao();
+    // positions only, same ranges
+    unsigned int get_position_vao();
+    // instance ids 0..count-1 are readable through attribute 5
+    void reserve_instance_ids(uint32_t count);
+    pool_stats get_stats();
+}
+#endif
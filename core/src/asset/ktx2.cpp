@@ -0,0 +1,253 @@
+#include "ktx2.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+namespace Ktx2 {
+    static const uint8_t IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    static const size_t HEADER_BYTES = 80;     // identifier, header and index
+    static const size_t LEVEL_INDEX_BYTES = 24; // offset, length, uncompressed length
+    static const char* USAGE_KEY = "glow.usage";
+
+    // khr data format descriptor bits, see the khronos data format spec
+    static const uint32_t DF_PRIMARIES_BT709 = 1;
+    static const uint32_t DF_TRANSFER_LINEAR = 1;
+    static const uint32_t DF_TRANSFER_SRGB = 2;
+    static const uint32_t DF_SAMPLE_LINEAR = 0x10; // alpha in an srgb format
+
+    struct sample_info {
+        uint8_t channel;
+        uint8_t bits;
+    };
+
+    struct format_info {
+        uint32_t vk_unorm;
+        uint32_t vk_srgb; // 0 when there is none
+        uint8_t color_model;
+        uint8_t sample_count;
+        sample_info samples[2];
+    };
+
+    // indexed by Texture_codec::format
+    static const format_info FORMATS[Texture_codec::FORMAT_COUNT] = {
+        { 131, 132, 128, 1, { { 0, 64 } } },              // bc1 rgb: color
+        { 137, 138, 130, 2, { { 15, 64 }, { 0, 64 } } },  // bc3: alpha, color
+        { 139, 0, 131, 1, { { 0, 64 } } },                // bc4: red
+        { 141, 0, 132, 2, { { 0, 64 }, { 1, 64 } } },     // bc5: red, green
+        { 145, 146, 134, 1, { { 0, 128 } } },             // bc7: color
+    };
+
+    static void put_u32(std::vector<uint8_t>& out, uint32_t v) {
+        for (int b = 0; b < 4; b++)
+            out.push_back((uint8_t)(v >> (8 * b)));
+    }
+
+    static void put_u64(std::vector<uint8_t>& out, uint64_t v) {
+        for (int b = 0; b < 8; b++)
+            out.push_back((uint8_t)(v >> (8 * b)));
+    }
+
+    static uint32_t get_u32(const uint8_t* p) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+
+    static uint64_t get_u64(const uint8_t* p) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        return v;
+    }
+
+    static void pad_to(std::vector<uint8_t>& out, size_t alignment) {
+        while (out.size() % alignment)
+            out.push_back(0);
+    }
+
+    // one basic descriptor block, 4x4 texel blocks, a sample per bc sub block
+    static std::vector<uint8_t> build_dfd(const format_info& f, Texture_codec::format block_format, bool srgb) {
+        std::vector<uint8_t> block;
+        uint32_t block_size = 24 + 16 * f.sample_count;
+        put_u32(block, 0); // vendor khronos, basic descriptor
+        put_u32(block, 2 | block_size << 16); // version 2
+        put_u32(block, f.color_model | DF_PRIMARIES_BT709 << 8 | (srgb ? DF_TRANSFER_SRGB : DF_TRANSFER_LINEAR) << 16);
+        put_u32(block, 3 | 3 << 8); // 4x4x1x1, stored minus one
+        put_u32(block, (uint32_t)Texture_codec::block_bytes(block_format));
+        put_u32(block, 0);
+        uint32_t bit_offset = 0;
+        for (int s = 0; s < f.sample_count; s++) {
+            uint32_t channel = f.samples[s].channel;
+            if (srgb && channel == 15)
+                channel |= DF_SAMPLE_LINEAR;
+            put_u32(block, bit_offset | (uint32_t)(f.samples[s].bits - 1) << 16 | channel << 24);
+            put_u32(block, 0);          // sample position
+            put_u32(block, 0);          // lower
+            put_u32(block, 0xFFFFFFFF); // upper
+            bit_offset += f.samples[s].bits;
+        }
+        std::vector<uint8_t> dfd;
+        put_u32(dfd, (uint32_t)(4 + block.size()));
+        dfd.insert(dfd.end(), block.begin(), block.end());
+        return dfd;
+    }
+
+    // key value entries, sorted by key
+    static void add_key_value(std::vector<uint8_t>& kvd, const char* key, const char* value) {
+        size_t key_bytes = strlen(key) + 1, value_bytes = strlen(value) + 1;
+        put_u32(kvd, (uint32_t)(key_bytes + value_bytes));
+        kvd.insert(kvd.end(), key, key + key_bytes);
+        kvd.insert(kvd.end(), value, value + value_bytes);
+        pad_to(kvd, 4);
+    }
+
+    std::string cooked_path(const std::string& source) {
+        return source + EXTENSION;
+    }
+
+    bool fresh(const std::string& source) {
+        std::error_code ec;
+        auto cooked_time = std::filesystem::last_write_time(cooked_path(source), ec);
+        if (ec)
+            return false;
+        auto source_time = std::filesystem::last_write_time(source, ec);
+        return ec || source_time <= cooked_time;
+    }
+
+    int write(const std::string& path, const Texture_codec::cooked_texture& cooked) {
+        const format_info& f = FORMATS[cooked.block_format];
+        bool srgb = cooked.srgb && f.vk_srgb != 0;
+        uint32_t level_count = (uint32_t)cooked.levels.size();
+        size_t alignment = Texture_codec::block_bytes(cooked.block_format);
+
+        std::vector<uint8_t> dfd = build_dfd(f, cooked.block_format, srgb);
+        std::vector<uint8_t> kvd;
+        add_key_value(kvd, "KTXwriter", "glwm_cook");
+        add_key_value(kvd, USAGE_KEY, Texture_codec::usage_name(cooked.use));
+
+        size_t dfd_offset = HEADER_BYTES + LEVEL_INDEX_BYTES * level_count;
+        size_t kvd_offset = dfd_offset + dfd.size();
+        std::vector<uint64_t> level_offsets(level_count);
+        size_t cursor = kvd_offset + kvd.size();
+        for (uint32_t l = level_count; l-- > 0;) {
+            cursor = (cursor + alignment - 1) / alignment * alignment;
+            level_offsets[l] = cursor;
+            cursor += cooked.levels[l].size();
+        }
+
+        std::vector<uint8_t> file(IDENTIFIER, IDENTIFIER + sizeof(IDENTIFIER));
+        file.reserve(cursor);
+        put_u32(file, srgb ? f.vk_srgb : f.vk_unorm);
+        put_u32(file, 1); // type size, 1 for block compressed
+        put_u32(file, cooked.width);
+        put_u32(file, cooked.height);
+        put_u32(file, 0); // depth
+        put_u32(file, 0); // layers
+        put_u32(file, 1); // faces
+        put_u32(file, level_count);
+        put_u32(file, 0); // no supercompression
+        put_u32(file, (uint32_t)dfd_offset);
+        put_u32(file, (uint32_t)dfd.size());
+        put_u32(file, (uint32_t)kvd_offset);
+        put_u32(file, (uint32_t)kvd.size());
+        put_u64(file, 0); // no supercompression global data
+        put_u64(file, 0);
+        for (uint32_t l = 0; l < level_count; l++) {
+            put_u64(file, level_offsets[l]);
+            put_u64(file, cooked.levels[l].size());
+            put_u64(file, cooked.levels[l].size());
+        }
+        file.insert(file.end(), dfd.begin(), dfd.end());
+        file.insert(file.end(), kvd.begin(), kvd.end());
+        for (uint32_t l = level_count; l-- > 0;) {
+            file.resize(level_offsets[l], 0);
+            file.insert(file.end(), cooked.levels[l].begin(), cooked.levels[l].end());
+        }
+
+        // same as the mesh cooker, renamed over the old one once complete
+        std::string temp = path + ".tmp";
+        FILE* out = fopen(temp.c_str(), "wb");
+        if (!out) {
+            printf("[COOK] cant write %s\n", temp.c_str());
+            return -1;
+        }
+        bool ok = fwrite(file.data(), 1, file.size(), out) == file.size();
+        ok = fclose(out) == 0 && ok;
+        std::error_code ec;
+        if (ok)
+            std::filesystem::rename(temp, path, ec);
+        if (!ok || ec) {
+            std::filesystem::remove(temp, ec);
+            printf("[COOK] failed writing %s\n", path.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    bool parse(const uint8_t* data, size_t size, texture& out) {
+        if (size < HEADER_BYTES || memcmp(data, IDENTIFIER, sizeof(IDENTIFIER)) != 0)
+            return false;
+        uint32_t vk_format = get_u32(data + 12);
+        uint32_t type_size = get_u32(data + 16);
+        uint32_t width = get_u32(data + 20);
+        uint32_t height = get_u32(data + 24);
+        uint32_t depth = get_u32(data + 28);
+        uint32_t layers = get_u32(data + 32);
+        uint32_t faces = get_u32(data + 36);
+        uint32_t level_count = get_u32(data + 40);
+        uint32_t scheme = get_u32(data + 44);
+        uint32_t kvd_offset = get_u32(data + 56);
+        uint32_t kvd_size = get_u32(data + 60);
+        if (type_size != 1 || width == 0 || height == 0 || depth != 0 || layers > 1 || faces != 1 || scheme != 0)
+            return false;
+        if (level_count == 0 || level_count > 32 || HEADER_BYTES + (size_t)LEVEL_INDEX_BYTES * level_count > size)
+            return false;
+        if ((uint64_t)kvd_offset + kvd_size > size)
+            return false;
+
+        int found = -1;
+        for (int f = 0; f < Texture_codec::FORMAT_COUNT; f++) {
+            if (FORMATS[f].vk_unorm == vk_format || (FORMATS[f].vk_srgb != 0 && FORMATS[f].vk_srgb == vk_format)) {
+                found = f;
+                out.srgb = FORMATS[f].vk_srgb == vk_format;
+            }
+        }
+        if (found < 0)
+            return false;
+        out.block_format = (Texture_codec::format)found;
+        out.width = width;
+        out.height = height;
+
+        out.levels.resize(level_count);
+        for (uint32_t l = 0; l < level_count; l++) {
+            const uint8_t* entry = data + HEADER_BYTES + LEVEL_INDEX_BYTES * l;
+            uint64_t offset = get_u64(entry);
+            uint64_t length = get_u64(entry + 8);
+            uint32_t w = width >> l ? width >> l : 1;
+            uint32_t h = height >> l ? height >> l : 1;
+            if (length != Texture_codec::level_bytes(out.block_format, w, h) || offset > size || length > size - offset)
+                return false;
+            out.levels[l] = { data + offset, (size_t)length };
+        }
+
+        out.use = out.block_format == Texture_codec::BC4 ? Texture_codec::SINGLE_CHANNEL : Texture_codec::ALBEDO;
+        const uint8_t* kv = data + kvd_offset;
+        const uint8_t* kv_end = kv + kvd_size;
+        while (kv_end - kv >= 4) {
+            uint32_t length = get_u32(kv);
+            const char* key = (const char*)kv + 4;
+            if (length > (size_t)(kv_end - kv) - 4)
+                break;
+            size_t key_length = strnlen(key, length);
+            if (key_length < length && strcmp(key, USAGE_KEY) == 0) {
+                std::string value(key + key_length + 1, strnlen(key + key_length + 1, length - key_length - 1));
+                for (int u = 0; u < Texture_codec::USAGE_COUNT; u++)
+                    if (value == Texture_codec::usage_name((Texture_codec::usage)u))
+                        out.use = (Texture_codec::usage)u;
+            }
+            kv += 4 + (length + 3) / 4 * 4;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "texture_codec.h"
+
+// the slice of ktx2 the texture cooker writes and Texture_manager reads
+//   one 2d image, no layers / faces / depth, every mip level present, block compressed (Texture_codec formats)
+//   level data is stored smallest first and padded to the block size, the dfd describes the bc format
+//   the usage goes in the "glow.usage" key so the loader knows how to swizzle
+//   no supercompression, blocks are uploaded as they sit in the file
+// cooked files sit next to their source, albedo.png -> albedo.png.ktx2
+namespace Ktx2 {
+    const char* const EXTENSION = ".ktx2";
+
+    struct level_view {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    // views into the parsed bytes
+    struct texture {
+        Texture_codec::format block_format = Texture_codec::BC1;
+        Texture_codec::usage use = Texture_codec::ALBEDO;
+        bool srgb = false;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<level_view> levels; // level 0 first
+    };
+
+    std::string cooked_path(const std::string& source);
+    // there is a cooked file and the source wasnt touched after it was written
+    bool fresh(const std::string& source);
+
+    int write(const std::string& path, const Texture_codec::cooked_texture& cooked);
+    // false for anything this didnt write, or that is cut short
+    bool parse(const uint8_t* data, size_t size, texture& out);
+}
+#endif
@@ -2,11 +2,14 @@
 #define MESH_H
 
 #include <vector>
+#include <cstdint>
 
 #include <glm/glm.hpp>
 
 #include "shader.h"
 #include "material.h"
+#include "mesh_lod.h"
+#include "vertex_format.h"
 
 struct Vertex {
     glm::vec3 Position;
@@ -21,15 +24,54 @@ class Mesh {
         std::vector<Vertex>       vertices;
         std::vector<unsigned int> indices;
         Material material;
+        // lod 0 is indices, coarser ones follow it in the pool, see mesh_lod.h
+        std::vector<Mesh_lod::level> lods;
+        // how the pool's positions map back to model space, see vertex_format.h
+        Vertex_format::quantization quantization;
 
+        // builds the lods, no gl, safe on a loader thread
         Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, Material material);
-        
+        // cooked, packed vertices and the pool run stay in the file mapping until upload, nothing is kept on the cpu
+        Mesh(const Vertex_format::packed_position* positions, const Vertex_format::packed_surface* surfaces, uint32_t vertex_count, const Vertex_format::quantization& quantization,
+            const unsigned int* pool_indices, uint32_t pool_index_count, const Mesh_lod::level* lods, int lod_count);
+        // vertices into the pool format, no gl, once vertices wont change anymore (the importer does it on its thread)
+        // upload packs meshes nobody packed
+        void pack();
+        // puts vertices and every lod's indices into the geometry pool, main thread
+        // this and everything else touching the pool or gl is in mesh_gpu.cpp
+        void upload();
+        // what upload sends
+        size_t upload_bytes() const;
+        // gives the pool range back
+        void release();
+        // indices plus the lod levels as upload sends them, empty after upload and for cooked meshes
+        const std::vector<unsigned int>& get_pool_indices() const { return pool_indices; }
+        // what pack made, empty after upload and for cooked meshes
+        const std::vector<Vertex_format::packed_position>& get_packed_positions() const { return packed_positions; }
+        const std::vector<Vertex_format::packed_surface>& get_packed_surfaces() const { return packed_surfaces; }
+
         void draw(const Shader* shader, bool shadow_pass) const;
         void update_vertex_buffer();
 
-    private:
-        unsigned int VAO, VBO, EBO;
+        // for the render queue, which binds state itself
+        // every mesh shares the geometry pool's vao, draws offset into it with first_index / base_vertex
+        unsigned int get_vao() const;
+        int lod_count() const { return (int)lods.size(); }
+        unsigned int index_count(int lod = 0) const;
+        uint32_t first_index(int lod = 0) const;
+        uint32_t base_vertex() const;
+        uint32_t geometry_id() const { return geometry; }
 
-        void setup_mesh();
+    private:
+        uint32_t geometry = ~0u; // geometry_handle, ~0u until uploaded
+        std::vector<unsigned int> pool_indices; // indices plus the lod levels, dropped after upload
+        std::vector<Vertex_format::packed_position> packed_positions; // dropped after upload too
+        std::vector<Vertex_format::packed_surface> packed_surfaces;
+        // cooked meshes upload from the model's mapping instead, cleared by upload
+        const Vertex_format::packed_position* mapped_positions = nullptr;
+        const Vertex_format::packed_surface* mapped_surfaces = nullptr;
+        const unsigned int* mapped_indices = nullptr;
+        uint32_t mapped_vertex_count = 0;
+        uint32_t mapped_index_count = 0;
 };
 #endif
@@ -0,0 +1,93 @@
+#include "mesh.h"
+#include "texture_manager.h"
+#include "geometry_pool.h"
+
+#define CHECK_GL_ERROR() { \
+    GLenum err = glGetError(); \
+    if (err != GL_NO_ERROR) { \
+        std::cerr << "OpenGL error at line " << __LINE__ << ": " << err << std::endl; \
+    } \
+}
+
+// vertices and indices go into the shared pool instead of a vao / vbo / ebo per mesh
+void Mesh::upload() {
+    if (mapped_positions) {
+        geometry = Geometry_pool::allocate(mapped_positions, mapped_surfaces, mapped_vertex_count, mapped_indices, mapped_index_count); CHECK_GL_ERROR();
+        mapped_positions = nullptr;
+        mapped_surfaces = nullptr;
+        mapped_indices = nullptr;
+        return;
+    }
+    if (packed_positions.size() != vertices.size())
+        pack();
+    geometry = Geometry_pool::allocate(packed_positions.data(), packed_surfaces.data(), (uint32_t)vertices.size(), pool_indices.data(), (uint32_t)pool_indices.size()); CHECK_GL_ERROR();
+    std::vector<unsigned int>().swap(pool_indices);
+    std::vector<Vertex_format::packed_position>().swap(packed_positions);
+    std::vector<Vertex_format::packed_surface>().swap(packed_surfaces);
+}
+
+void Mesh::release() {
+    Geometry_pool::free(geometry);
+    geometry = ~0u;
+}
+
+unsigned int Mesh::get_vao() const {
+    return Geometry_pool::get_vao();
+}
+
+uint32_t Mesh::first_index(int lod) const {
+    return Geometry_pool::get_range(geometry).first_index + lods[lod].first_index;
+}
+
+uint32_t Mesh::base_vertex() const {
+    return Geometry_pool::get_range(geometry).base_vertex;
+}
+
+// todo gonna be way different
+void Mesh::draw(const Shader* shader, bool shadow_pass) const {
+
+    if (!shadow_pass) {
+
+        //shader.setBool("has_diffuse", material.has_albedo);
+        //if (material.has_albedo) {
+        Texture_manager::bind(material.albedo_map, 0);
+        shader->setInt("diffuse", 0);
+        //printf("bound diffuse: %s\n", Texture_manager::get_name(material.albedo_map).c_str());
+    //}
+
+        // a streaming normal map would bind missing.png, go without until it is in
+        bool has_normal = material.has_normal && Texture_manager::ready(material.normal_map);
+        shader->setBool("has_normal", has_normal);
+        if (has_normal) {
+            Texture_manager::bind(material.normal_map, 1);
+            shader->setInt("normal", 1);
+            //printf("bound normal: %s\n", Texture_manager::get_name(material.normal_map).c_str());
+        }
+
+        // Add metallic-roughness texture
+        bool has_metallic_roughness = material.metallic_roughness_map != 0 && Texture_manager::ready(material.metallic_roughness_map);
+        shader->setBool("has_metallic_roughness", has_metallic_roughness);
+        if (has_metallic_roughness) {
+            Texture_manager::bind(material.metallic_roughness_map, 2);
+            shader->setInt("metallic_roughness", 2);
+        }
+    }
+
+    // the render queue folds this into the instance matrix, here it is up to the shader
+    shader->setVec3("position_offset", quantization.offset);
+    shader->setVec3("position_scale", quantization.scale);
+
+    // draw mesh
+    const Geometry_pool::geometry_range& r = Geometry_pool::get_range(geometry);
+    glBindVertexArray(shadow_pass ? Geometry_pool::get_position_vao() : Geometry_pool::get_vao());
+    glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)lods[0].index_count, GL_UNSIGNED_INT, (void*)((size_t)r.first_index * sizeof(unsigned int)), r.base_vertex);
+    glBindVertexArray(0);
+}  
+
+// the bounds can move with the vertices, so everything is packed again
+void Mesh::update_vertex_buffer() {
+    pack();
+    Geometry_pool::update_vertices(geometry, packed_positions.data(), packed_surfaces.data(), (uint32_t)vertices.size());
+    std::vector<Vertex_format::packed_position>().swap(packed_positions);
+    std::vector<Vertex_format::packed_surface>().swap(packed_surfaces);
+}
@@ -0,0 +1,394 @@
+#include "mesh_lod.h"
+#include "mesh.h"
+
+#include <queue>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+    // weights against the squared distance part of the cost, which is scaled by the mesh size squared
+    const float BOUNDARY_WEIGHT = 4.0f;
+    const float NORMAL_WEIGHT = 0.05f;
+    const float UV_WEIGHT = 0.25f;
+    const float MIN_NORMAL_DOT = 0.2f; // triangles that turn further than this count as flipped
+
+    // symmetric 4x4 error quadric
+    struct quadric {
+        double xx, xy, xz, yy, yz, zz, xw, yw, zw, ww;
+
+        void add_plane(const glm::vec3& n, float d, float w) {
+            xx += w * n.x * n.x; xy += w * n.x * n.y; xz += w * n.x * n.z;
+            yy += w * n.y * n.y; yz += w * n.y * n.z; zz += w * n.z * n.z;
+            xw += w * n.x * d; yw += w * n.y * d; zw += w * n.z * d;
+            ww += w * (double)d * d;
+        }
+
+        void add(const quadric& o) {
+            xx += o.xx; xy += o.xy; xz += o.xz; yy += o.yy; yz += o.yz;
+            zz += o.zz; xw += o.xw; yw += o.yw; zw += o.zw; ww += o.ww;
+        }
+
+        double eval(const glm::vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            return xx * x * x + 2.0 * xy * x * y + 2.0 * xz * x * z + yy * y * y + 2.0 * yz * y * z + zz * z * z
+                + 2.0 * (xw * x + yw * y + zw * z) + ww;
+        }
+    };
+
+    enum vertex_kind : uint8_t {
+        KIND_INTERIOR = 0,
+        KIND_BORDER,    // on an open edge, only slides along it
+        KIND_LOCKED     // corner of a border, non manifold, never moves
+    };
+
+    struct candidate {
+        float cost;
+        float error; // distance part only
+        uint32_t from, to;
+        uint32_t from_version, to_version;
+
+        bool operator>(const candidate& o) const { return cost > o.cost; }
+    };
+
+    struct simplifier {
+        const std::vector<Vertex>& vertices;
+        std::vector<uint32_t> corners;          // vertex per triangle corner, rewritten by collapses
+        std::vector<uint8_t> tri_alive;
+        uint32_t alive_count = 0;
+
+        std::vector<uint32_t> pid;              // vertex -> welded position
+        std::vector<glm::vec3> positions;
+        std::vector<std::vector<uint32_t>> pos_tris;
+        std::vector<quadric> quadrics;
+        std::vector<uint8_t> kinds;
+        std::vector<uint8_t> pos_alive;
+        std::vector<uint32_t> versions;
+        float size_sq = 1.0f;
+
+        std::priority_queue<candidate, std::vector<candidate>, std::greater<candidate>> heap;
+
+        // scratch
+        std::vector<uint32_t> remap_from, remap_to;
+        std::vector<uint32_t> neighbours, ring_from, ring_to;
+
+        simplifier(const std::vector<Vertex>& v) : vertices(v) {}
+
+        uint32_t tri_pid(uint32_t t, int c) const { return pid[corners[t * 3 + c]]; }
+
+        bool tri_has(uint32_t t, uint32_t p) const {
+            return tri_pid(t, 0) == p || tri_pid(t, 1) == p || tri_pid(t, 2) == p;
+        }
+
+        glm::vec3 tri_normal(uint32_t t, uint32_t moved, const glm::vec3& to) const {
+            glm::vec3 p[3];
+            for (int c = 0; c < 3; c++) {
+                uint32_t q = tri_pid(t, c);
+                p[c] = q == moved ? to : positions[q];
+            }
+            return glm::cross(p[1] - p[0], p[2] - p[0]);
+        }
+
+        // positions sharing a triangle with p
+        void ring(uint32_t p, std::vector<uint32_t>& out) const {
+            out.clear();
+            for (uint32_t t : pos_tris[p]) {
+                if (!tri_alive[t])
+                    continue;
+                for (int c = 0; c < 3; c++) {
+                    uint32_t n = tri_pid(t, c);
+                    if (n != p && std::find(out.begin(), out.end(), n) == out.end())
+                        out.push_back(n);
+                }
+            }
+        }
+
+        void init(const std::vector<unsigned int>& indices) {
+            corners.assign(indices.begin(), indices.end());
+            uint32_t tri_count = (uint32_t)(corners.size() / 3);
+            tri_alive.assign(tri_count, 1);
+            alive_count = tri_count;
+
+            // weld exact positions, seam copies share one
+            struct key_hash {
+                size_t operator()(const glm::vec3& p) const {
+                    uint32_t b[3];
+                    memcpy(b, &p, sizeof(b));
+                    return (size_t)b[0] * 73856093u ^ (size_t)b[1] * 19349663u ^ (size_t)b[2] * 83492791u;
+                }
+            };
+            std::unordered_map<glm::vec3, uint32_t, key_hash> welded;
+            pid.resize(vertices.size());
+            for (size_t i = 0; i < vertices.size(); i++) {
+                auto it = welded.emplace(vertices[i].Position, (uint32_t)positions.size());
+                if (it.second)
+                    positions.push_back(vertices[i].Position);
+                pid[i] = it.first->second;
+            }
+
+            size_t np = positions.size();
+            pos_tris.assign(np, std::vector<uint32_t>());
+            quadrics.assign(np, quadric{});
+            kinds.assign(np, KIND_INTERIOR);
+            pos_alive.assign(np, 1);
+            versions.assign(np, 0);
+
+            glm::vec3 lo(1e30f), hi(-1e30f);
+            for (const glm::vec3& p : positions) {
+                lo = glm::min(lo, p);
+                hi = glm::max(hi, p);
+            }
+            size_sq = std::max(glm::dot(hi - lo, hi - lo), 1e-8f);
+
+            // edge use counts in welded space find open borders and non manifold edges
+            std::unordered_map<uint64_t, uint32_t> edge_uses;
+            for (uint32_t t = 0; t < tri_count; t++) {
+                uint32_t p[3] = { tri_pid(t, 0), tri_pid(t, 1), tri_pid(t, 2) };
+                if (p[0] == p[1] || p[1] == p[2] || p[0] == p[2]) {
+                    tri_alive[t] = 0;
+                    alive_count--;
+                    continue;
+                }
+                glm::vec3 n = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+                float len = glm::length(n);
+                if (len > 0.0f) {
+                    n /= len;
+                    for (int c = 0; c < 3; c++)
+                        quadrics[p[c]].add_plane(n, -glm::dot(n, positions[p[0]]), 1.0f);
+                }
+                for (int c = 0; c < 3; c++) {
+                    pos_tris[p[c]].push_back(t);
+                    uint32_t a = std::min(p[c], p[(c + 1) % 3]), b = std::max(p[c], p[(c + 1) % 3]);
+                    edge_uses[((uint64_t)a << 32) | b]++;
+                }
+            }
+
+            std::vector<uint8_t> border_edges(np, 0);
+            for (uint32_t t = 0; t < tri_count; t++) {
+                if (!tri_alive[t])
+                    continue;
+                for (int c = 0; c < 3; c++) {
+                    uint32_t a = tri_pid(t, c), b = tri_pid(t, (c + 1) % 3);
+                    uint32_t uses = edge_uses[((uint64_t)std::min(a, b) << 32) | std::max(a, b)];
+                    if (uses > 2) {
+                        kinds[a] = kinds[b] = KIND_LOCKED;
+                    }
+                    else if (uses == 1) {
+                        border_edges[a]++;
+                        border_edges[b]++;
+                        // plane through the edge, perpendicular to the triangle, keeps the border in place
+                        glm::vec3 n = tri_normal(t, ~0u, glm::vec3(0.0f));
+                        glm::vec3 m = glm::cross(positions[b] - positions[a], n);
+                        float len = glm::length(m);
+                        if (len > 0.0f) {
+                            m /= len;
+                            float d = -glm::dot(m, positions[a]);
+                            quadrics[a].add_plane(m, d, BOUNDARY_WEIGHT);
+                            quadrics[b].add_plane(m, d, BOUNDARY_WEIGHT);
+                        }
+                    }
+                }
+            }
+            for (size_t p = 0; p < np; p++)
+                if (kinds[p] != KIND_LOCKED && border_edges[p])
+                    kinds[p] = border_edges[p] == 2 ? KIND_BORDER : KIND_LOCKED;
+
+            for (uint32_t t = 0; t < tri_count; t++)
+                if (tri_alive[t])
+                    for (int c = 0; c < 3; c++) {
+                        push(tri_pid(t, c), tri_pid(t, (c + 1) % 3));
+                        push(tri_pid(t, (c + 1) % 3), tri_pid(t, c));
+                    }
+        }
+
+        // figures out the collapse of position from onto to, false when it would break the mesh
+        bool evaluate(uint32_t from, uint32_t to, float& cost, float& error) {
+            if (kinds[from] == KIND_LOCKED)
+                return false;
+
+            // triangles on the edge, and the positions around each end
+            uint32_t edge_tris = 0;
+            uint32_t shared = 0;
+            for (uint32_t t : pos_tris[from])
+                if (tri_alive[t] && tri_has(t, to))
+                    edge_tris++;
+            if (edge_tris == 0)
+                return false;
+            if (kinds[from] == KIND_BORDER && edge_tris != 1)
+                return false; // a border vertex only moves along the border
+
+            // link condition, the ends may only share the positions across the edge
+            ring(from, ring_from);
+            ring(to, ring_to);
+            for (uint32_t n : ring_from)
+                if (n != to && std::find(ring_to.begin(), ring_to.end(), n) != ring_to.end())
+                    shared++;
+            if (shared != edge_tris)
+                return false;
+
+            // every copy of from needs a copy of to it shares a triangle with
+            remap_from.clear();
+            remap_to.clear();
+            float attribute_cost = 0.0f;
+            for (uint32_t t : pos_tris[from]) {
+                if (!tri_alive[t])
+                    continue;
+                for (int c = 0; c < 3; c++) {
+                    uint32_t v = corners[t * 3 + c];
+                    if (pid[v] != from || std::find(remap_from.begin(), remap_from.end(), v) != remap_from.end())
+                        continue;
+                    uint32_t target = ~0u;
+                    for (uint32_t t2 : pos_tris[from]) {
+                        if (!tri_alive[t2])
+                            continue;
+                        const uint32_t* k = &corners[t2 * 3];
+                        if (k[0] != v && k[1] != v && k[2] != v)
+                            continue;
+                        for (int c2 = 0; c2 < 3 && target == ~0u; c2++)
+                            if (pid[k[c2]] == to)
+                                target = k[c2];
+                        if (target != ~0u)
+                            break;
+                    }
+                    if (target == ~0u)
+                        return false;
+                    remap_from.push_back(v);
+                    remap_to.push_back(target);
+
+                    const Vertex& a = vertices[v];
+                    const Vertex& b = vertices[target];
+                    glm::vec2 duv = a.TexCoords - b.TexCoords;
+                    float c_attr = NORMAL_WEIGHT * (1.0f - glm::dot(a.Normal, b.Normal)) + UV_WEIGHT * glm::dot(duv, duv);
+                    attribute_cost = std::max(attribute_cost, c_attr);
+                }
+            }
+
+            // no flips around the moving end
+            for (uint32_t t : pos_tris[from]) {
+                if (!tri_alive[t] || tri_has(t, to))
+                    continue;
+                glm::vec3 before = tri_normal(t, ~0u, glm::vec3(0.0f));
+                glm::vec3 after = tri_normal(t, from, positions[to]);
+                float lb = glm::length(before), la = glm::length(after);
+                if (la <= 1e-12f || (lb > 0.0f && glm::dot(before, after) < MIN_NORMAL_DOT * lb * la))
+                    return false;
+            }
+
+            quadric q = quadrics[from];
+            q.add(quadrics[to]);
+            double distance = std::max(q.eval(positions[to]), 0.0);
+            error = (float)std::sqrt(distance);
+            cost = (float)distance + attribute_cost * size_sq;
+            return true;
+        }
+
+        void push(uint32_t from, uint32_t to) {
+            float cost, error;
+            if (from == to || !evaluate(from, to, cost, error))
+                return;
+            heap.push({ cost, error, from, to, versions[from], versions[to] });
+        }
+
+        void collapse(uint32_t from, uint32_t to) {
+            for (uint32_t t : pos_tris[from]) {
+                if (!tri_alive[t])
+                    continue;
+                if (tri_has(t, to)) {
+                    tri_alive[t] = 0;
+                    alive_count--;
+                    continue;
+                }
+                for (int c = 0; c < 3; c++) {
+                    uint32_t& v = corners[t * 3 + c];
+                    if (pid[v] != from)
+                        continue;
+                    for (size_t k = 0; k < remap_from.size(); k++)
+                        if (remap_from[k] == v) {
+                            v = remap_to[k];
+                            break;
+                        }
+                }
+                pos_tris[to].push_back(t);
+            }
+            pos_tris[from].clear();
+            pos_alive[from] = 0;
+            quadrics[to].add(quadrics[from]);
+            versions[to]++;
+
+            // drop the dead triangles from the list so it doesnt keep growing
+            std::vector<uint32_t>& list = pos_tris[to];
+            list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t t) { return !tri_alive[t]; }), list.end());
+
+            // only edges at the merged position changed cost, the rest are revalidated when they come off the heap
+            ring(to, neighbours);
+            for (uint32_t n : neighbours) {
+                push(to, n);
+                push(n, to);
+            }
+        }
+
+        // collapses until target triangles are left or nothing valid is, returns the largest error so far
+        void run(uint32_t target, float& max_error) {
+            while (alive_count > target && !heap.empty()) {
+                candidate c = heap.top();
+                heap.pop();
+                if (!pos_alive[c.from] || !pos_alive[c.to] || versions[c.from] != c.from_version || versions[c.to] != c.to_version)
+                    continue;
+                float cost, error;
+                // neighbourhood can have changed without a version bump on these two
+                if (!evaluate(c.from, c.to, cost, error))
+                    continue;
+                max_error = std::max(max_error, error);
+                collapse(c.from, c.to);
+            }
+        }
+    };
+}
+
+namespace Mesh_lod {
+    void build(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<level>& levels) {
+        levels.clear();
+        levels.push_back({ 0, (uint32_t)indices.size(), 0.0f });
+        uint32_t triangles = (uint32_t)(indices.size() / 3);
+        if (triangles < MIN_TRIANGLES)
+            return;
+
+        simplifier s(vertices);
+        s.init(indices);
+
+        float error = 0.0f;
+        uint32_t previous = triangles;
+        for (int l = 1; l < MAX_LODS; l++) {
+            uint32_t target = (uint32_t)(previous * LOD_RATIO);
+            s.run(target, error);
+            if (s.alive_count > previous * LOD_MIN_GAIN || s.alive_count == 0)
+                break;
+
+            level lv;
+            lv.first_index = (uint32_t)indices.size();
+            for (uint32_t t = 0; t < s.tri_alive.size(); t++)
+                if (s.tri_alive[t])
+                    indices.insert(indices.end(), s.corners.begin() + t * 3, s.corners.begin() + t * 3 + 3);
+            lv.index_count = (uint32_t)indices.size() - lv.first_index;
+            lv.error = error;
+            levels.push_back(lv);
+            previous = s.alive_count;
+        }
+    }
+
+    int select(const float* errors, int count, float pixels_per_unit, float threshold, int previous, float hysteresis) {
+        int lod = 0;
+        while (lod + 1 < count && errors[lod + 1] * pixels_per_unit <= threshold)
+            lod++;
+        if (previous < 0 || previous >= count)
+            return lod;
+        // finer than last frame: stay coarse while the old level is only a little over
+        if (lod < previous && errors[previous] * pixels_per_unit <= threshold * (1.0f + hysteresis))
+            return previous;
+        // coarser: only as far as the levels are clearly under
+        while (lod > previous && errors[lod] * pixels_per_unit > threshold * (1.0f - hysteresis))
+            lod--;
+        return lod;
+    }
+}
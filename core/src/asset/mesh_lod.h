@@ -0,0 +1,38 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <vector>
+#include <cstdint>
+
+struct Vertex;
+
+// import time lod chains, quadric error half edge collapse (garland heckbert)
+//   collapses only ever move a vertex onto a neighbour, so every level indexes the original vertices
+//   and all levels share the mesh's vertex range, just with their own run of indices
+//   vertices split for uv / normal seams collapse together: a collapse is only allowed when every copy of the
+//   moving position has a copy of the target next to it, so seams slide along themselves and never tear
+//   open borders stay on the border (boundary planes in the quadric), flips are rejected,
+//   normal / uv differences between the merged copies are added to the cost so attributes survive
+//
+// level 0 is always the input, each next level aims for LOD_RATIO of the triangles before it
+// and is dropped (ending the chain) when it cant get below LOD_MIN_GAIN of it
+namespace Mesh_lod {
+    const int MAX_LODS = 4;
+    const float LOD_RATIO = 0.35f;
+    const float LOD_MIN_GAIN = 0.85f;
+    const uint32_t MIN_TRIANGLES = 64; // smaller meshes keep just level 0
+
+    struct level {
+        uint32_t first_index;  // into the mesh's index run, level 0 starts at 0
+        uint32_t index_count;
+        float error;           // largest distance a surface moved, model space units
+    };
+
+    // appends levels 1.. to indices (level 0 is what is already there) and fills levels, level 0 included
+    void build(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<level>& levels);
+
+    // coarsest level whose error projects under threshold pixels,
+    // a move to a coarser level needs (1 - hysteresis) of that and the previous level is kept up to (1 + hysteresis)
+    int select(const float* errors, int count, float pixels_per_unit, float threshold, int previous, float hysteresis);
+}
+#endif
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -11,6 +12,10 @@
 
 #include "mesh.h"
 #include "shader.h"
+#include "core/bvh.h"
+#include "core/occlusion_culler.h"
+
+namespace Util { class mapped_file; }
 
 class Model_ass {
     public:
@@ -20,21 +25,62 @@ class Model_ass {
             load_model(meshName, scale);
         }
         
+        // import then upload, blocks
         int load_model(const std::string &meshName, float scale = 1.0f);
+        // everything but gl, safe on a loader thread (model_ass_import.cpp, all the cook tool links)
+        // maps the cooked file when there is a fresh one (see cooked_mesh.h), else import_source
+        int import(const std::string &meshName, float scale = 1.0f);
+        // assimp, normalize, bvh, occluder, lods
+        int import_source(const std::string &meshName, float scale = 1.0f);
+        // writes what import_source made for the cooked loader, before upload only
+        int cook(const std::string &cookedName) const;
+        // geometry into the pool and textures requested (and acquired), main thread
+        void upload();
+        size_t upload_bytes() const;
+        // frees the pool ranges and releases the textures upload acquired
+        void release();
+        // what stays on the cpu after upload, vertices and indices are kept for picking / rebuilding
+        size_t cpu_bytes() const;
         void draw(const Shader* shader, bool shadow_pass);	
+        const std::vector<Mesh>& get_meshes() const { return meshes; }
+
+        // per mesh texture files found by import, turned into handles by upload
+        struct texture_paths {
+            std::string albedo;
+            std::string normal;
+            std::string metallic_roughness;
+        };
+        // empty after upload, the cook tool reads which file is used how from here
+        const std::vector<texture_paths>& get_texture_paths() const { return mesh_textures; }
 
         glm::vec3 aabb_min;
         glm::vec3 aabb_max;
+        // triangles of every mesh in model space, shared by all entities using this model
+        Bvh_mesh bvh;
+        // authored "occluder" meshes from the file, else the model's biggest triangles
+        occluder_mesh occluder;
+        // per lod the largest error of any mesh, meshes with a shorter chain count their last level
+        float lod_errors[Mesh_lod::MAX_LODS] = {};
+        uint32_t lod_triangles[Mesh_lod::MAX_LODS] = {};
+        int lod_count = 1;
 
     private:
         // model data
         std::vector<Mesh> meshes;
         std::string directory;
+        std::vector<texture_paths> mesh_textures;
+        // cooked meshes point into it until upload
+        std::shared_ptr<Util::mapped_file> mapping;
 
         // bool gammaCorrection;
 
+        int load_cooked(const std::string& path);
         void process_node(aiNode *node, const aiScene *scene, const std::string& path);
         Mesh process_mesh(aiMesh *mesh, const aiScene *scene, const std::string& path);
         void normalize_model(float scale);
+        void build_bvh();
+        void add_authored_occluder(const aiMesh* mesh);
+        void build_occluder();
+        void gather_lod_errors();
 };
 #endif
@@ -0,0 +1,473 @@
+#include "model_ass.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
+#include <cfloat>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "cooked_mesh.h"
+#include "util/mapped_file.h"
+
+int Model_ass::import(const std::string &path, float scale) {
+    if (Cooked_mesh::fresh(path) && load_cooked(Cooked_mesh::cooked_path(path)) == 0)
+        return 0;
+    return import_source(path, scale);
+}
+
+int Model_ass::import_source(const std::string &path, float scale) {
+    // one importer per call, so loader threads dont share one
+    Assimp::Importer import;
+    const aiScene *scene = import.ReadFile(path, aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals);
+	
+    if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP::" << import.GetErrorString() << std::endl;
+        return -1;
+    }
+    directory = path.substr(0, path.find_last_of('/'));
+    process_node(scene->mRootNode, scene, path);
+    normalize_model(scale);
+    build_bvh();
+    build_occluder();
+    gather_lod_errors();
+    // last thing to touch the vertices
+    for (Mesh& m : meshes)
+        m.pack();
+    return 0;
+}
+
+// nothing is touched until the whole file checked out, a bad one just means importing the source
+int Model_ass::load_cooked(const std::string &path) {
+    using namespace Cooked_mesh;
+    auto file = std::make_shared<Util::mapped_file>();
+    if (!file->open(path))
+        return -1;
+    const uint8_t* base = file->data();
+    const header& h = *(const header*)base;
+    if (file->size() < sizeof(header) || h.magic != MAGIC || h.version != VERSION || h.position_size != sizeof(Vertex_format::packed_position)
+        || h.surface_size != sizeof(Vertex_format::packed_surface) || h.bvh_node_size != sizeof(bvh_node)
+        || !valid(h, file->size()) || h.lod_count < 1 || h.lod_count > Mesh_lod::MAX_LODS) {
+        printf("[MODEL] %s is stale or broken, importing the source\n", path.c_str());
+        return -1;
+    }
+
+    auto at = [&](section_id id) { return base + h.sections[id].offset; };
+    auto count = [&](section_id id, size_t element) { return (size_t)(h.sections[id].size / element); };
+    const mesh_record* records = (const mesh_record*)at(MESHES);
+    const Vertex_format::packed_position* positions = (const Vertex_format::packed_position*)at(POSITIONS);
+    const Vertex_format::packed_surface* surfaces = (const Vertex_format::packed_surface*)at(SURFACES);
+    const unsigned int* indices = (const unsigned int*)at(INDICES);
+    const char* strings = (const char*)at(STRINGS);
+    size_t string_bytes = h.sections[STRINGS].size;
+    const bvh_node* nodes = (const bvh_node*)at(BVH_NODES);
+    const uint32_t* tri_ids = (const uint32_t*)at(BVH_TRI_IDS);
+    size_t node_count = count(BVH_NODES, sizeof(bvh_node));
+    size_t tri_count = count(BVH_TRI_IDS, sizeof(uint32_t));
+
+    bool ok = count(POSITIONS, sizeof(Vertex_format::packed_position)) == count(SURFACES, sizeof(Vertex_format::packed_surface))
+        && count(BVH_TRIS, Bvh_mesh::TRI_FLOATS * sizeof(float)) == tri_count && (string_bytes == 0 || strings[string_bytes - 1] == '\0');
+    uint64_t model_triangles = 0;
+    for (uint32_t i = 0; ok && i < h.mesh_count; i++) {
+        const mesh_record& r = records[i];
+        ok = (uint64_t)r.first_vertex + r.vertex_count <= count(POSITIONS, sizeof(Vertex_format::packed_position))
+            && (uint64_t)r.first_index + r.index_count <= count(INDICES, sizeof(unsigned int))
+            && r.lod_count >= 1 && r.lod_count <= (uint32_t)Mesh_lod::MAX_LODS;
+        for (uint32_t l = 0; ok && l < r.lod_count; l++)
+            ok = (uint64_t)r.lods[l].first_index + r.lods[l].index_count <= r.index_count;
+        for (uint32_t t : r.textures)
+            ok = ok && (t == NO_TEXTURE || t < string_bytes);
+        // the pool draws with base_vertex, an index past the mesh reads another mesh's vertices or off the end
+        unsigned int largest = 0;
+        for (uint32_t k = 0; ok && k < r.index_count; k++)
+            largest = std::max(largest, indices[r.first_index + k]);
+        ok = ok && (r.index_count == 0 || largest < r.vertex_count);
+        if (ok)
+            model_triangles += r.lods[0].index_count / 3;
+    }
+    // children always come after their parent (make_node appends), so a bad file cant send traversal in circles
+    for (size_t n = 0; ok && n < node_count; n++) {
+        const bvh_node& node = nodes[n];
+        ok = node.count ? (uint64_t)node.left_first + node.count <= tri_count
+                        : node.left_first > n && (uint64_t)node.left_first + 1 < node_count;
+    }
+    for (size_t t = 0; ok && t < tri_count; t++)
+        ok = tri_ids[t] < model_triangles;
+    const uint32_t* occluder_indices = (const uint32_t*)at(OCCLUDER_INDICES);
+    for (size_t k = 0; ok && k < count(OCCLUDER_INDICES, sizeof(uint32_t)); k++)
+        ok = occluder_indices[k] < count(OCCLUDER_POSITIONS, sizeof(glm::vec3));
+    if (!ok) {
+        printf("[MODEL] %s is stale or broken, importing the source\n", path.c_str());
+        return -1;
+    }
+
+    // the upload reads the mapping on the main thread, fault it in here
+    file->prefetch();
+    directory = path.substr(0, path.find_last_of('/'));
+    meshes.reserve(h.mesh_count);
+    mesh_textures.reserve(h.mesh_count);
+    for (uint32_t i = 0; i < h.mesh_count; i++) {
+        const mesh_record& r = records[i];
+        Vertex_format::quantization q;
+        q.offset = r.position_offset;
+        q.scale = r.position_scale;
+        meshes.emplace_back(positions + r.first_vertex, surfaces + r.first_vertex, r.vertex_count, q, indices + r.first_index, r.index_count, r.lods, (int)r.lod_count);
+        std::string* paths[3];
+        texture_paths textures;
+        paths[0] = &textures.albedo;
+        paths[1] = &textures.normal;
+        paths[2] = &textures.metallic_roughness;
+        for (int t = 0; t < 3; t++)
+            if (r.textures[t] != NO_TEXTURE)
+                *paths[t] = directory + "/" + (strings + r.textures[t]);
+        mesh_textures.push_back(textures);
+    }
+
+    aabb_min = h.aabb_min;
+    aabb_max = h.aabb_max;
+    lod_count = h.lod_count;
+    for (int l = 0; l < Mesh_lod::MAX_LODS; l++) {
+        lod_errors[l] = h.lod_errors[l];
+        lod_triangles[l] = h.lod_triangles[l];
+    }
+    bvh.assign(nodes, node_count, (const float*)at(BVH_TRIS), tri_ids, tri_count);
+    const glm::vec3* occluder_positions = (const glm::vec3*)at(OCCLUDER_POSITIONS);
+    occluder.positions.assign(occluder_positions, occluder_positions + count(OCCLUDER_POSITIONS, sizeof(glm::vec3)));
+    occluder.indices.assign(occluder_indices, occluder_indices + count(OCCLUDER_INDICES, sizeof(uint32_t)));
+    occluder.authored = h.occluder_authored != 0;
+    mapping = file;
+    return 0;
+}
+
+// sections go out back to back in section_id order, each padded to SECTION_ALIGN
+int Model_ass::cook(const std::string &path) const {
+    using namespace Cooked_mesh;
+    std::vector<mesh_record> records;
+    std::vector<Vertex_format::packed_position> positions;
+    std::vector<Vertex_format::packed_surface> surfaces;
+    std::vector<unsigned int> indices;
+    std::string strings;
+
+    // relative to the model so the cooked file doesnt care where the engine runs from
+    auto add_string = [&](const std::string& texture) -> uint32_t {
+        if (texture.empty())
+            return NO_TEXTURE;
+        std::string relative = std::filesystem::path(texture).lexically_relative(directory).generic_string();
+        if (relative.empty()) {
+            printf("[COOK] %s isnt reachable from %s, dropped\n", texture.c_str(), directory.c_str());
+            return NO_TEXTURE;
+        }
+        uint32_t offset = (uint32_t)strings.size();
+        strings += relative;
+        strings += '\0';
+        return offset;
+    };
+
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const Mesh& m = meshes[i];
+        const std::vector<unsigned int>& pool = m.get_pool_indices();
+        if (pool.empty() || m.get_packed_positions().size() != m.vertices.size() || i >= mesh_textures.size()) {
+            printf("[COOK] %s: cook needs a model straight from import_source\n", path.c_str());
+            return -1;
+        }
+        mesh_record r = {};
+        r.first_vertex = (uint32_t)positions.size();
+        r.vertex_count = (uint32_t)m.vertices.size();
+        r.position_offset = m.quantization.offset;
+        r.position_scale = m.quantization.scale;
+        r.first_index = (uint32_t)indices.size();
+        r.index_count = (uint32_t)pool.size();
+        r.lod_count = (uint32_t)m.lods.size();
+        for (size_t l = 0; l < m.lods.size(); l++)
+            r.lods[l] = m.lods[l];
+        r.textures[0] = add_string(mesh_textures[i].albedo);
+        r.textures[1] = add_string(mesh_textures[i].normal);
+        r.textures[2] = add_string(mesh_textures[i].metallic_roughness);
+        records.push_back(r);
+        positions.insert(positions.end(), m.get_packed_positions().begin(), m.get_packed_positions().end());
+        surfaces.insert(surfaces.end(), m.get_packed_surfaces().begin(), m.get_packed_surfaces().end());
+        indices.insert(indices.end(), pool.begin(), pool.end());
+    }
+
+    header h = {};
+    h.magic = MAGIC;
+    h.version = VERSION;
+    h.position_size = sizeof(Vertex_format::packed_position);
+    h.surface_size = sizeof(Vertex_format::packed_surface);
+    h.bvh_node_size = sizeof(bvh_node);
+    h.mesh_count = (uint32_t)records.size();
+    h.occluder_authored = occluder.authored;
+    h.lod_count = lod_count;
+    h.aabb_min = aabb_min;
+    h.aabb_max = aabb_max;
+    for (int l = 0; l < Mesh_lod::MAX_LODS; l++) {
+        h.lod_errors[l] = lod_errors[l];
+        h.lod_triangles[l] = lod_triangles[l];
+    }
+
+    const void* data[SECTION_COUNT] = {
+        records.data(), positions.data(), surfaces.data(), indices.data(),
+        bvh.get_nodes().data(), bvh.tri_data(), bvh.get_tri_ids().data(),
+        occluder.positions.data(), occluder.indices.data(), strings.data()
+    };
+    size_t sizes[SECTION_COUNT] = {
+        records.size() * sizeof(mesh_record), positions.size() * sizeof(Vertex_format::packed_position),
+        surfaces.size() * sizeof(Vertex_format::packed_surface), indices.size() * sizeof(unsigned int),
+        bvh.get_nodes().size() * sizeof(bvh_node), bvh.triangle_count() * Bvh_mesh::TRI_FLOATS * sizeof(float), bvh.get_tri_ids().size() * sizeof(uint32_t),
+        occluder.positions.size() * sizeof(glm::vec3), occluder.indices.size() * sizeof(uint32_t), strings.size()
+    };
+    auto align = [](uint64_t x) { return (x + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN; };
+    uint64_t offset = align(sizeof(header));
+    for (int s = 0; s < SECTION_COUNT; s++) {
+        h.sections[s] = { offset, sizes[s] };
+        offset = align(offset + sizes[s]);
+    }
+
+    // written next to the real name and renamed over it, a running engine never maps half a file
+    std::string temp = path + ".tmp";
+    FILE* f = fopen(temp.c_str(), "wb");
+    if (!f) {
+        printf("[COOK] cant write %s\n", temp.c_str());
+        return -1;
+    }
+    const char zeros[SECTION_ALIGN] = {};
+    bool ok = fwrite(&h, sizeof(header), 1, f) == 1;
+    uint64_t written = sizeof(header);
+    for (int s = 0; s < SECTION_COUNT && ok; s++) {
+        ok = fwrite(zeros, 1, (size_t)(h.sections[s].offset - written), f) == h.sections[s].offset - written;
+        ok = ok && (sizes[s] == 0 || fwrite(data[s], 1, sizes[s], f) == sizes[s]);
+        written = h.sections[s].offset + sizes[s];
+    }
+    ok = fclose(f) == 0 && ok;
+    std::error_code ec;
+    if (ok)
+        std::filesystem::rename(temp, path, ec);
+    if (!ok || ec) {
+        std::filesystem::remove(temp, ec);
+        printf("[COOK] failed writing %s\n", path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+void Model_ass::process_node(aiNode *node, const aiScene *scene, const std::string& path) {
+    // process all the node's meshes (if any)
+    for(unsigned int i = 0; i < node->mNumMeshes; i++) {
+        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]]; 
+        if (std::string(mesh->mName.C_Str()).find("occluder") != std::string::npos) {
+            add_authored_occluder(mesh);
+            continue;
+        }
+        meshes.push_back(process_mesh(mesh, scene, path));			
+    }
+    // then do the same for each of its children
+    for(unsigned int i = 0; i < node->mNumChildren; i++) {
+        process_node(node->mChildren[i], scene, path);
+    }
+} 
+
+Mesh Model_ass::process_mesh(aiMesh *mesh, const aiScene *scene, const std::string& path) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+
+    for(unsigned int i = 0; i < mesh->mNumVertices; i++) {
+        Vertex vertex;
+        // process vertex positions, normals and texture coordinates
+        vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+        vertex.Normal   = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+
+        if(mesh->mTextureCoords[0]) {
+            glm::vec2 vec;
+            vec.x = mesh->mTextureCoords[0][i].x; 
+            vec.y = mesh->mTextureCoords[0][i].y;
+            vertex.TexCoords = vec;
+
+            const aiVector3D& pTangent = mesh->mTangents[i];
+            vertex.Tangent = glm::vec3(pTangent.x, pTangent.y, pTangent.z);
+
+            const aiVector3D& pBitangent = mesh->mBitangents[i];
+            vertex.Bitangent = glm::vec3(pBitangent.x, pBitangent.y, pBitangent.z);
+        }
+        else {
+            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            vertex.Tangent = glm::vec3(0.0f);
+            vertex.Bitangent = glm::vec3(0.0f);
+        }
+
+        vertices.push_back(vertex);
+    }
+    // process indices
+    for(unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        aiFace face = mesh->mFaces[i];
+        for(unsigned int j = 0; j < face.mNumIndices; j++)
+            indices.push_back(face.mIndices[j]);
+    }
+
+    // process material, the files are only loaded in upload
+    texture_paths textures;
+    if(mesh->mMaterialIndex >= 0) {
+        aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+
+        if (material->GetTextureCount(aiTextureType_BASE_COLOR)) {
+            aiString str;
+            material->GetTexture(aiTextureType_BASE_COLOR, 0, &str);
+            textures.albedo = path.substr(0, path.size() - 10) + str.C_Str();
+        }        
+        
+        if (material->GetTextureCount(aiTextureType_NORMALS)) {
+            aiString str;
+            material->GetTexture(aiTextureType_NORMALS, 0, &str);
+            textures.normal = path.substr(0, path.size() - 10) + str.C_Str();
+        }
+
+        if (material->GetTextureCount(aiTextureType_UNKNOWN)) {
+            // Try to find metallic-roughness texture by name patterns
+            for (unsigned int i = 0; i < material->GetTextureCount(aiTextureType_UNKNOWN); i++) {
+                aiString str;
+                material->GetTexture(aiTextureType_UNKNOWN, i, &str);
+                std::string texName = str.C_Str();
+                // Common naming patterns for metallic-roughness maps
+                if (texName.find("metallic") != std::string::npos ||
+                    texName.find("roughness") != std::string::npos ||
+                    texName.find("orm") != std::string::npos) { // ORM = Occlusion/Roughness/Metallic
+                    textures.metallic_roughness = path.substr(0, path.size() - 10) + str.C_Str();
+                    break;
+                }
+            }
+        }
+   
+    }
+
+    mesh_textures.push_back(textures);
+
+    return Mesh(vertices, indices, Material());
+}  
+
+void Model_ass::normalize_model(float scale) {
+    aabb_min = glm::vec3(FLT_MAX);
+    aabb_max = glm::vec3(-FLT_MAX);
+
+    for (auto &m : meshes) {
+        for (auto &v : m.vertices) {
+            aabb_min.x = std::min(aabb_min.x, v.Position.x);
+            aabb_min.y = std::min(aabb_min.y, v.Position.y);
+            aabb_min.z = std::min(aabb_min.z, v.Position.z);
+
+            aabb_max.x = std::max(aabb_max.x, v.Position.x);
+            aabb_max.y = std::max(aabb_max.y, v.Position.y);
+            aabb_max.z = std::max(aabb_max.z, v.Position.z);
+        }
+    }
+
+    //printf("starting aabb max %f %f %f\n", aabb_max.x, aabb_max.y, aabb_max.z);
+    //printf("starting aabb min %f %f %f\n", aabb_min.x, aabb_min.y, aabb_min.z);
+
+    glm::vec3 center = 0.5f * (aabb_min + aabb_max);
+    // authored occluders have to stay where the meshes they stand in for go
+    for (glm::vec3& p : occluder.positions)
+        p -= center;
+    glm::vec3 diff   = aabb_max - aabb_min;
+    float maxDim     = std::max(diff.x, std::max(diff.y, diff.z));
+    if (maxDim < 1e-8f) {
+        maxDim = 1.0f;
+    }
+    //float scale_f = scale / maxDim;  // so the largest dimension goes from -1 to +1
+    float scale_f = 1.0f; // dont scale, just center
+
+    for (auto& m : meshes) {
+        for (auto& v : m.vertices) {
+            // Center around origin
+            v.Position = (v.Position - center) * scale_f;
+            // Then shift Y so bottom is at y=0
+            //v.Position.y += (center.y - aabb_min.y) * scale_f; // why ?>?????? todo figure out bruh
+        }
+    }
+
+    // centering moves every vertex by the same amount, so the box just moves along
+    aabb_min = (aabb_min - center) * scale_f;
+    aabb_max = (aabb_max - center) * scale_f;
+
+    //printf("after aabb max %f %f %f\n", aabb_max.x, aabb_max.y, aabb_max.z);
+    //printf("after aabb min %f %f %f\n", aabb_min.x, aabb_min.y, aabb_min.z);
+
+    //printf("after aabb max %f %f %f\n", aabb_max.x, aabb_max.y, aabb_max.z);
+    //printf("after aabb min %f %f %f\n", aabb_min.x, aabb_min.y, aabb_min.z);
+}
+
+void Model_ass::build_bvh() {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+
+    for (auto& m : meshes) {
+        unsigned int base = (unsigned int)positions.size();
+        for (auto& v : m.vertices)
+            positions.push_back(v.Position);
+        for (unsigned int i : m.indices)
+            indices.push_back(base + i);
+    }
+
+    bvh.build(positions, indices);
+}
+
+void Model_ass::add_authored_occluder(const aiMesh* mesh) {
+    uint32_t base = (uint32_t)occluder.positions.size();
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        occluder.positions.push_back(glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z));
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        if (mesh->mFaces[i].mNumIndices == 3)
+            for (unsigned int j = 0; j < 3; j++)
+                occluder.indices.push_back(base + mesh->mFaces[i].mIndices[j]);
+    occluder.authored = true;
+}
+
+// without an authored one the biggest triangles stand in, a subset of the surface can only hide less than the model
+void Model_ass::build_occluder() {
+    const size_t OCCLUDER_TRIANGLE_BUDGET = 256;
+    if (occluder.authored)
+        return;
+
+    struct candidate {
+        const Mesh* mesh;
+        unsigned int first;
+        float area;
+    };
+    std::vector<candidate> candidates;
+    for (const Mesh& m : meshes) {
+        for (size_t i = 0; i + 2 < m.indices.size(); i += 3) {
+            glm::vec3 a = m.vertices[m.indices[i]].Position;
+            glm::vec3 b = m.vertices[m.indices[i + 1]].Position;
+            glm::vec3 c = m.vertices[m.indices[i + 2]].Position;
+            candidates.push_back({ &m, (unsigned int)i, glm::length(glm::cross(b - a, c - a)) });
+        }
+    }
+    size_t count = std::min(candidates.size(), OCCLUDER_TRIANGLE_BUDGET);
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+        [](const candidate& x, const candidate& y) { return x.area > y.area; });
+
+    occluder.positions.clear();
+    occluder.indices.clear();
+    for (size_t t = 0; t < count; t++) {
+        for (unsigned int j = 0; j < 3; j++) {
+            occluder.indices.push_back((uint32_t)occluder.positions.size());
+            occluder.positions.push_back(candidates[t].mesh->vertices[candidates[t].mesh->indices[candidates[t].first + j]].Position);
+        }
+    }
+}
+
+// the whole model switches together, so a level is only as good as its worst mesh
+void Model_ass::gather_lod_errors() {
+    lod_count = 1;
+    for (const Mesh& m : meshes)
+        lod_count = std::max(lod_count, m.lod_count());
+    for (int l = 0; l < lod_count; l++) {
+        lod_errors[l] = 0.0f;
+        lod_triangles[l] = 0;
+        for (const Mesh& m : meshes) {
+            int ml = std::min(l, m.lod_count() - 1);
+            lod_errors[l] = std::max(lod_errors[l], m.lods[ml].error);
+            lod_triangles[l] += m.index_count(ml) / 3;
+        }
+    }
+}
@@ -1,5 +1,7 @@
 #include <vector>
+#include <deque>
 #include <string>
+#include <memory>
 #include <cassert>
 
 #include <glad/glad.h>
@@ -7,77 +9,137 @@
 
 #include "model_manager.h"
 #include "model_ass.h"
+#include "streaming.h"
+#include "asset_registry.h"
 
 namespace Model_manager {
 
-    static std::vector<Model_ass> models;
+    enum model_state : uint8_t { LOADING, READY, FAILED, EVICTED };
+
+    static std::deque<Model_ass> models; // deque so scene bvh can hold pointers to model bvhs
     static std::vector<std::string> names;
+    static std::vector<uint8_t> states;
+    static uint32_t epoch = 0;
     static std::string base_path;
 
-    static bool loaded_already(const std::string& new_model_name, size_t& existing_idx) {
-        for (size_t i = 0; i < names.size(); i++) {
-            if (new_model_name == names[i]) {
-                existing_idx = i;
-                return true;
+    // the cube stands in for anything not loaded
+    static size_t resolve(model_handle model_id) {
+        return states[model_id] == READY ? model_id : 0;
+    }
+
+    static std::string full_path(const std::string& model_name, int gltf) {
+        return gltf ? base_path + model_name + "/scene.gltf" : base_path + model_name;
+    }
+
+    static void evict(uint32_t slot) {
+        models[slot].release();
+        models[slot] = Model_ass();
+        states[slot] = EVICTED;
+    }
+
+    static void stream(size_t slot, const std::string& path) {
+        printf("[MODEL] Loading: %s\n", path.c_str());
+        states[slot] = LOADING;
+        Streaming::submit([slot, path] {
+            auto model = std::make_shared<Model_ass>();
+            if (model->import(path)) {
+                Streaming::stage(0, [slot] {
+                    states[slot] = FAILED;
+                    printf("[MODEL] Failed: %s, keeping the cube\n", names[slot].c_str());
+                });
+                return;
             }
-        }
-        return false;
+            Streaming::stage(model->upload_bytes(), [slot, model] {
+                size_t gpu_bytes = model->upload_bytes();
+                model->upload();
+                models[slot] = std::move(*model);
+                states[slot] = READY;
+                Asset_registry::set_resident(Asset_registry::MODEL, (uint32_t)slot, models[slot].cpu_bytes(), gpu_bytes);
+                epoch++;
+                printf("[MODEL] Ready: %s\n", names[slot].c_str());
+            });
+        });
     }
 
     void init(std::string path) {
         base_path = path;
-        model_handle mh = load_model("cube.obj", 0);
+        Asset_registry::set_evictor(Asset_registry::MODEL, evict);
+        // the placeholder itself cant stream, and is never evicted
+        std::string cube_path = full_path("cube.obj", 0);
+        models.emplace_back();
+        names.push_back("cube.obj");
+        Asset_registry::add(Asset_registry::MODEL, cube_path, 0);
+        Asset_registry::acquire(Asset_registry::MODEL, 0);
+        size_t gpu_bytes = 0;
+        int fail = models[0].import(cube_path);
+        if (!fail) {
+            gpu_bytes = models[0].upload_bytes();
+            models[0].upload();
+        }
+        states.push_back(fail ? FAILED : READY);
+        assert(states[0] == READY);
+        Asset_registry::set_resident(Asset_registry::MODEL, 0, models[0].cpu_bytes(), gpu_bytes);
     }
 
     void cleanup() {
-        // need to free resources that model_ass owns, prob implement in destructor
-        //models.clear();
-        //names.clear();
+        for (size_t i = 0; i < models.size(); i++)
+            if (states[i] == READY)
+                models[i].release();
+        models.clear();
+        names.clear();
+        states.clear();
     }
 
     model_handle load_model(const std::string& model_name, int gltf) {
-        size_t existing_idx;
-        if (loaded_already(model_name, existing_idx)) {
-            printf("[MODEL] Already loaded: %s\n", model_name.c_str());
+        std::string path = full_path(model_name, gltf);
+        uint32_t existing_idx;
+        if (Asset_registry::find(Asset_registry::MODEL, path, existing_idx)) {
+            // evicted since, same slot so handles out there stay good
+            if (states[existing_idx] == EVICTED)
+                stream(existing_idx, path);
             return existing_idx;
         }
 
-        std::string full_path;
-        if (gltf)
-            full_path = base_path + model_name + "/scene.gltf";
-        else
-            full_path = base_path + model_name;
-        
-        printf("[MODEL] Loading: %s\n", full_path.c_str());
-
-        Model_ass model;
-        int fail = model.load_model(full_path);
-        if (fail)
-            return 0; // default model
-
         size_t new_idx = models.size();
-        models.push_back(std::move(model));
+        models.emplace_back();
         names.push_back(model_name);
-
+        states.push_back(LOADING);
+        Asset_registry::add(Asset_registry::MODEL, path, (uint32_t)new_idx);
+        stream(new_idx, path);
         return new_idx;
     }
 
+    void acquire(const model_handle model_id) {
+        Asset_registry::acquire(Asset_registry::MODEL, (uint32_t)model_id);
+    }
+
+    void release(const model_handle model_id) {
+        Asset_registry::release(Asset_registry::MODEL, (uint32_t)model_id);
+    }
+
+    bool ready(const model_handle model_id) {
+        return states[model_id] == READY;
+    }
+
+    uint32_t ready_epoch() {
+        return epoch;
+    }
+
     Model_ass& get_model_by_name(const std::string& model_name) {
-        for (size_t i = 0; i < names.size(); i++) {
-            if (model_name == names[i]) {
-                return models[i];
-            }
-        }
+        uint32_t slot;
+        if (Asset_registry::find(Asset_registry::MODEL, full_path(model_name, 1), slot) || Asset_registry::find(Asset_registry::MODEL, full_path(model_name, 0), slot))
+            return models[resolve(slot)];
 
         assert(false);
+        return models[0];
     }
 
     Model_ass& get_model(const model_handle model_id) {
-        return models[model_id];
+        return models[resolve(model_id)];
     }
 
     void draw(const Shader* shader, const model_handle model_id, bool shadow_pass) {
-        models[model_id].draw(shader, shadow_pass);
+        models[resolve(model_id)].draw(shader, shadow_pass);
     }
 
 
@@ -98,7 +160,16 @@ namespace Model_manager {
     }
 
     Util::aabb get_aabb(const model_handle& model_id) {
-        Util::aabb aabb{ models[model_id].aabb_min, models[model_id].aabb_max };
+        const Model_ass& model = models[resolve(model_id)];
+        Util::aabb aabb{ model.aabb_min, model.aabb_max };
         return aabb;
     }
+
+    const Bvh_mesh& get_bvh(const model_handle& model_id) {
+        return models[resolve(model_id)].bvh;
+    }
+
+    const occluder_mesh& get_occluder(const model_handle& model_id) {
+        return models[resolve(model_id)].occluder;
+    }
 }
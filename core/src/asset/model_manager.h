@@ -9,11 +9,22 @@
 
 typedef size_t model_handle;
 
+// handle 0 is the default cube, loaded by init
+// load_model returns a handle right away and imports on a loader thread, the geometry is uploaded through Streaming
+// every lookup goes to the cube until then (and for good if the import failed)
+// paths are looked up through Asset_registry, an evicted model is the cube again until something loads it
 namespace Model_manager {
     void init(std::string path);
     void cleanup();
 
+    // finds or starts loading, doesnt add a reference
     model_handle load_model(const std::string& model_name, int gltf = 1);
+    // whoever keeps a handle (entity stores, weapons) holds a reference, unreferenced models can be evicted
+    void acquire(const model_handle model_id);
+    void release(const model_handle model_id);
+    bool ready(const model_handle model_id);
+    // bumped whenever a model swaps in, whatever was taken from the placeholder (bounds, bvh pointers) is stale
+    uint32_t ready_epoch();
     Model_ass& get_model_by_name(const std::string& model_name);
     Model_ass& get_model(const model_handle model_id);
 
@@ -23,5 +34,7 @@ namespace Model_manager {
     size_t get_model_count();
     std::string get_name(const model_handle& model_id);
     Util::aabb get_aabb(const model_handle& model_id);
+    const Bvh_mesh& get_bvh(const model_handle& model_id);
+    const occluder_mesh& get_occluder(const model_handle& model_id);
 }
 #endif
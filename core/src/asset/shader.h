@@ -5,10 +5,13 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+#include "vertex_format.h"
+
 class Shader {
 public:
     unsigned int ID;
@@ -40,6 +43,8 @@ public:
         catch (std::ifstream::failure& e) {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
+        vertexCode = preprocess(vertexCode, vertexPath);
+        fragmentCode = preprocess(fragmentCode, fragmentPath);
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -64,51 +69,118 @@ public:
         glDeleteShader(vertex);
         glDeleteShader(fragment);
 
+        cache_uniform_locations();
         return true;
     }
+
+    // -1 (ignored by glUniform*) for names the program doesnt use
+    int location(const std::string &name) const {
+        auto it = uniform_locations.find(name);
+        return it != uniform_locations.end() ? it->second : -1;
+    }
     // activate the shader
     void use() const {
         glUseProgram(ID); 
     }
     // utility uniform functions
     void setBool(const std::string &name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(location(name), (int)value); 
     }
     void setInt(const std::string &name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(location(name), value); 
     }
     void setFloat(const std::string &name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(location(name), value); 
     }
     void setVec2(const std::string &name, const glm::vec2 &value) const {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(location(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(location(name), x, y); 
     }
     void setVec3(const std::string &name, const glm::vec3 &value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(location(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(location(name), x, y, z); 
     }
     void setVec4(const std::string &name, const glm::vec4 &value) const {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(location(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) const {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(location(name), x, y, z, w); 
     }
     void setMat2(const std::string &name, const glm::mat2 &mat) const {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     void setMat3(const std::string &name, const glm::mat3 &mat) const {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     void setMat4(const std::string &name, const glm::mat4 &mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    std::unordered_map<std::string, int> uniform_locations;
+
+    // glsl has no includes, so #include "file" lines are pasted in from the shader's directory (one level deep)
+    // and the vertex format's VERTEX_*_LOCATION defines go right after #version
+    // #line keeps error messages pointing at the shader's own lines
+    static std::string preprocess(const std::string& source, const std::string& path) {
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        std::istringstream in(source);
+        std::string out, line;
+        int number = 0;
+        while (std::getline(in, line)) {
+            number++;
+            if (line.compare(0, 8, "#version") == 0) {
+                out += line + "\n" + Vertex_format::glsl_defines() + "#line " + std::to_string(number + 1) + "\n";
+                continue;
+            }
+            if (line.compare(0, 8, "#include") != 0) {
+                out += line + "\n";
+                continue;
+            }
+            size_t open = line.find('"'), close = line.rfind('"');
+            std::ifstream file;
+            if (open != close)
+                file.open(directory + line.substr(open + 1, close - open - 1));
+            if (!file.is_open()) {
+                std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << line << " in " << path << std::endl;
+                continue;
+            }
+            std::stringstream included;
+            included << file.rdbuf();
+            out += included.str() + "\n#line " + std::to_string(number + 1) + "\n";
+        }
+        return out;
+    }
+
+    // every active uniform once at link time instead of a glGetUniformLocation per set call
+    void cache_uniform_locations() {
+        uniform_locations.clear();
+        GLint count = 0, max_length = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+        std::string name(max_length > 0 ? max_length : 1, '\0');
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, max_length, &length, &size, &type, &name[0]);
+            std::string uniform(name.c_str(), length);
+            GLint loc = glGetUniformLocation(ID, uniform.c_str());
+            if (loc < 0)
+                continue; // block members
+            uniform_locations[uniform] = loc;
+            // arrays are reported as "name[0]", also answer to "name"
+            size_t bracket = uniform.find("[0]");
+            if (bracket != std::string::npos)
+                uniform_locations[uniform.substr(0, bracket)] = loc;
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     void checkCompileErrors(GLuint shader, std::string type) {
         GLint success;
@@ -1,12 +1,19 @@
 #include "shader_manager.h"
+#include "asset_registry.h"
 #include <iostream>
 #include <cassert>
 
 namespace Shader_manager {
 
     static std::vector<ShaderData> shaders;
+    static std::unordered_map<Asset_registry::asset_key, shader_handle> by_name;
     static std::string base_path;
 
+    // registry key, a program is its pair of files
+    static std::string program_path(const std::string& vertex_name, const std::string& fragment_name) {
+        return vertex_name + "+" + fragment_name;
+    }
+
     void init(const std::string path) {
         std::cout << "[SHADER] Shader manager initialized" << std::endl;
         base_path = path;
@@ -20,6 +27,7 @@ namespace Shader_manager {
             }
         }
         shaders.clear();
+        by_name.clear();
     }
 
     shader_handle load_from_paths(const std::string& name, const std::string& vertex_name, const std::string& fragment_name) {
@@ -43,6 +51,9 @@ namespace Shader_manager {
         if (success) {
             shader_handle handle = shaders.size();
             shaders.push_back(shader_data);
+            // shaders are small and always bound by someone, registered for lookup only, never evicted
+            Asset_registry::add(Asset_registry::SHADER, program_path(vertex_name, fragment_name), (uint32_t)handle);
+            by_name.emplace(Asset_registry::hash(name), handle);
 
             std::cout << "[SHADER] Loaded: " << vertex_path << " + " << fragment_path << std::endl;
             return handle;
@@ -68,11 +79,11 @@ namespace Shader_manager {
     }
 
     Shader* get_shader_by_name(const std::string& name) {
-        for (size_t i = 0; i < shaders.size(); i++) {
-            if (shaders[i].name == name)
-                return &shaders[i].shader;
-        }
+        auto it = by_name.find(Asset_registry::hash(name));
+        if (it != by_name.end() && shaders[it->second].name == name)
+            return &shaders[it->second].shader;
         assert(false);
+        return nullptr;
     }
 
     bool reload(shader_handle handle) {
@@ -136,13 +147,11 @@ namespace Shader_manager {
     }
 
     bool loaded_already(const std::string& vertex_name, const std::string& fragment_name, shader_handle& existing_handle) {
-        for (size_t i = 0; i < shaders.size(); i++) {
-            if (vertex_name == shaders[i].vertex_name && fragment_name == shaders[i].fragment_name) {
-                existing_handle = i;
-                return true;
-            }
-        }
-        return false;
+        uint32_t slot;
+        if (!Asset_registry::find(Asset_registry::SHADER, program_path(vertex_name, fragment_name), slot))
+            return false;
+        existing_handle = slot;
+        return true;
     }
 
     fs::file_time_type get_file_time(const std::string& name) {
@@ -0,0 +1,133 @@
+#include "streaming.h"
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+
+namespace Streaming {
+    size_t frame_budget = 8 * 1024 * 1024;
+
+    struct staged_upload {
+        size_t bytes;
+        std::function<void()> upload;
+    };
+
+    struct stream_state {
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<std::function<void()>> loads;
+        std::deque<staged_upload> uploads;
+        uint32_t loading = 0; // queued or running, under mutex
+        bool quit = false;
+        stream_stats stats;
+    };
+
+    static stream_state g_stream;
+
+    static void loader_main() {
+        std::unique_lock<std::mutex> lock(g_stream.mutex);
+        while (true) {
+            g_stream.wake.wait(lock, [] { return g_stream.quit || !g_stream.loads.empty(); });
+            if (g_stream.quit)
+                return;
+            std::function<void()> load = std::move(g_stream.loads.front());
+            g_stream.loads.pop_front();
+            lock.unlock();
+            load();
+            lock.lock();
+            g_stream.loading--;
+        }
+    }
+
+    void init(int threads) {
+        g_stream.quit = false;
+        for (int i = 0; i < threads; i++)
+            g_stream.threads.emplace_back(loader_main);
+        printf("[STREAMING] %d loader threads, %zu KB per frame\n", threads, frame_budget / 1024);
+    }
+
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(g_stream.mutex);
+            g_stream.quit = true;
+        }
+        g_stream.wake.notify_all();
+        for (std::thread& t : g_stream.threads)
+            t.join();
+        g_stream.threads.clear();
+        g_stream.loads.clear();
+        g_stream.uploads.clear();
+        g_stream.loading = 0;
+    }
+
+    void submit(std::function<void()> load) {
+        if (g_stream.threads.empty()) {
+            load();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(g_stream.mutex);
+            g_stream.loads.push_back(std::move(load));
+            g_stream.loading++;
+        }
+        g_stream.wake.notify_one();
+    }
+
+    void stage(size_t bytes, std::function<void()> upload) {
+        std::lock_guard<std::mutex> lock(g_stream.mutex);
+        g_stream.uploads.push_back({ bytes, std::move(upload) });
+    }
+
+    // pops one upload if it fits in what is left of budget, the first one always fits
+    static bool pop_upload(size_t spent, size_t budget, staged_upload& out) {
+        std::lock_guard<std::mutex> lock(g_stream.mutex);
+        if (g_stream.uploads.empty())
+            return false;
+        if (spent > 0 && spent + g_stream.uploads.front().bytes > budget)
+            return false;
+        out = std::move(g_stream.uploads.front());
+        g_stream.uploads.pop_front();
+        return true;
+    }
+
+    static void run_uploads(size_t budget) {
+        stream_stats& s = g_stream.stats;
+        s.uploads = 0;
+        s.uploaded_bytes = 0;
+        staged_upload u;
+        while (pop_upload((size_t)s.uploaded_bytes, budget, u)) {
+            u.upload();
+            s.uploads++;
+            s.uploaded_bytes += u.bytes;
+        }
+    }
+
+    void update() {
+        run_uploads(frame_budget);
+    }
+
+    void finish() {
+        while (true) {
+            run_uploads(SIZE_MAX);
+            {
+                std::lock_guard<std::mutex> lock(g_stream.mutex);
+                if (g_stream.loading == 0 && g_stream.uploads.empty())
+                    return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    stream_stats get_stats() {
+        std::lock_guard<std::mutex> lock(g_stream.mutex);
+        stream_stats s = g_stream.stats;
+        s.loading = g_stream.loading;
+        s.staged = (uint32_t)g_stream.uploads.size();
+        return s;
+    }
+}
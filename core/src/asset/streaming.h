@@ -0,0 +1,40 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// background asset loading
+//   loads (file reads, assimp imports, image decodes) run on a few loader threads of their own, not the job system,
+//   a job waiting on the main thread would happily pick up a 300 ms import and stall the frame
+//   a load hands its gl work back with stage(), update() runs staged uploads on the main thread
+//   until frame_budget bytes went up, at least one per frame so a big asset cant starve
+// managers give out handles right away and point them at a placeholder until their upload ran
+namespace Streaming {
+    struct stream_stats {
+        uint32_t loading = 0;        // submitted loads not finished yet
+        uint32_t staged = 0;         // uploads waiting for the main thread
+        uint32_t uploads = 0;        // run by the last update
+        uint64_t uploaded_bytes = 0; // by the last update
+    };
+
+    extern size_t frame_budget;
+
+    void init(int threads = 2);
+    // drops whatever is still queued, joins the loaders
+    void shutdown();
+
+    // load runs on a loader thread, or right here before init / after shutdown
+    void submit(std::function<void()> load);
+    // from a load, upload runs on the main thread, bytes is roughly what it sends to the gpu
+    void stage(size_t bytes, std::function<void()> upload);
+
+    // main thread, once a frame
+    void update();
+    // main thread, blocks until everything submitted so far (and what its uploads submit) is in
+    void finish();
+
+    stream_stats get_stats();
+}
+#endif
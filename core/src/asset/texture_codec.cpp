@@ -0,0 +1,591 @@
+#include "texture_codec.h"
+
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+namespace Texture_codec {
+    // weight of color0 for each bc1 index
+    static const float BC1_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    // weight of endpoint 1 out of 64 for each 4 bit bc7 index
+    static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    format choose_format(usage u, bool alpha, bool high_quality) {
+        switch (u) {
+        case NORMAL:
+        case METALLIC_ROUGHNESS:
+            return BC5;
+        case SINGLE_CHANNEL:
+            return BC4;
+        default:
+            return high_quality ? BC7 : alpha ? BC3 : BC1;
+        }
+    }
+
+    bool has_alpha(const image& img) {
+        for (size_t i = 3; i < img.rgba.size(); i += 4)
+            if (img.rgba[i] != 255)
+                return true;
+        return false;
+    }
+
+    // mips
+
+    static float srgb_to_linear(float c) {
+        return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    static float linear_to_srgb(float c) {
+        return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+    }
+
+    // alpha is never srgb
+    static void to_float(const image& img, bool srgb, std::vector<float>& out) {
+        float table[256];
+        for (int i = 0; i < 256; i++)
+            table[i] = srgb ? srgb_to_linear(i / 255.0f) : i / 255.0f;
+        out.resize(img.rgba.size());
+        for (size_t i = 0; i < img.rgba.size(); i++)
+            out[i] = (i & 3) == 3 ? img.rgba[i] / 255.0f : table[img.rgba[i]];
+    }
+
+    static void to_rgba8(const std::vector<float>& pixels, uint32_t width, uint32_t height, bool srgb, image& out) {
+        out.width = width;
+        out.height = height;
+        out.rgba.resize(pixels.size());
+        for (size_t i = 0; i < pixels.size(); i++) {
+            float v = std::min(std::max(pixels[i], 0.0f), 1.0f);
+            if (srgb && (i & 3) != 3)
+                v = linear_to_srgb(v);
+            out.rgba[i] = (uint8_t)(v * 255.0f + 0.5f);
+        }
+    }
+
+    // 2x2 box, odd sizes drop their last row / column, 1 pixel wide levels clamp
+    static void downsample(const float* src, uint32_t w, uint32_t h, float* dst, uint32_t dw, uint32_t dh) {
+        for (uint32_t y = 0; y < dh; y++) {
+            const float* r0 = src + (size_t)std::min(2 * y, h - 1) * w * 4;
+            const float* r1 = src + (size_t)std::min(2 * y + 1, h - 1) * w * 4;
+            float* out = dst + (size_t)y * dw * 4;
+            uint32_t x = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+            // a = source pixels 2x, 2x+1 of both rows, b = 2x+2, 2x+3, so the halves sum into outputs x and x+1
+            const __m256 quarter = _mm256_set1_ps(0.25f);
+            for (; x + 1 < dw && 2 * x + 3 < w; x += 2) {
+                __m256 a = _mm256_add_ps(_mm256_loadu_ps(r0 + 8 * x), _mm256_loadu_ps(r1 + 8 * x));
+                __m256 b = _mm256_add_ps(_mm256_loadu_ps(r0 + 8 * x + 8), _mm256_loadu_ps(r1 + 8 * x + 8));
+                __m256 lo = _mm256_permute2f128_ps(a, b, 0x20);
+                __m256 hi = _mm256_permute2f128_ps(a, b, 0x31);
+                _mm256_storeu_ps(out + 4 * x, _mm256_mul_ps(_mm256_add_ps(lo, hi), quarter));
+            }
+#endif
+            for (; x < dw; x++) {
+                uint32_t x0 = std::min(2 * x, w - 1);
+                uint32_t x1 = std::min(2 * x + 1, w - 1);
+                for (int c = 0; c < 4; c++)
+                    out[4 * x + c] = 0.25f * ((r0[4 * x0 + c] + r1[4 * x0 + c]) + (r0[4 * x1 + c] + r1[4 * x1 + c]));
+            }
+        }
+    }
+
+    // averaged unit vectors come out short, a coarse level would read flatter than the surface is
+    static void renormalize(std::vector<float>& pixels) {
+        for (size_t i = 0; i < pixels.size(); i += 4) {
+            float n[3];
+            for (int c = 0; c < 3; c++)
+                n[c] = pixels[i + c] * 2.0f - 1.0f;
+            float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (len < 1e-6f)
+                continue;
+            for (int c = 0; c < 3; c++)
+                pixels[i + c] = n[c] / len * 0.5f + 0.5f;
+        }
+    }
+
+    void build_mips(const image& img, usage u, std::vector<image>& levels) {
+        bool srgb = u == ALBEDO;
+        levels.assign(1, img);
+        uint32_t w = img.width, h = img.height;
+        std::vector<float> current, next;
+        to_float(img, srgb, current);
+        while (w > 1 || h > 1) {
+            uint32_t dw = std::max(1u, w / 2);
+            uint32_t dh = std::max(1u, h / 2);
+            next.resize((size_t)dw * dh * 4);
+            downsample(current.data(), w, h, next.data(), dw, dh);
+            if (u == NORMAL)
+                renormalize(next);
+            levels.emplace_back();
+            to_rgba8(next, dw, dh, srgb, levels.back());
+            current.swap(next);
+            w = dw;
+            h = dh;
+        }
+    }
+
+    // endpoint fitting, shared by bc1 and bc7
+
+    // mean and principal axis of the texels' first channels, power iteration on the covariance
+    static void fit_axis(const uint8_t* texels, int channels, float* mean, float* axis) {
+        float cov[4][4] = {};
+        for (int c = 0; c < channels; c++) {
+            mean[c] = 0.0f;
+            for (int i = 0; i < BLOCK_TEXELS; i++)
+                mean[c] += texels[i * 4 + c];
+            mean[c] /= BLOCK_TEXELS;
+        }
+        for (int i = 0; i < BLOCK_TEXELS; i++)
+            for (int a = 0; a < channels; a++)
+                for (int b = 0; b < channels; b++)
+                    cov[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+
+        // start from the row of the channel that spreads most
+        int widest = 0;
+        for (int c = 1; c < channels; c++)
+            if (cov[c][c] > cov[widest][widest])
+                widest = c;
+        for (int c = 0; c < channels; c++)
+            axis[c] = cov[widest][c];
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float v[4] = {};
+            float largest = 0.0f;
+            for (int a = 0; a < channels; a++) {
+                for (int b = 0; b < channels; b++)
+                    v[a] += cov[a][b] * axis[b];
+                largest = std::max(largest, fabsf(v[a]));
+            }
+            if (largest == 0.0f)
+                break;
+            for (int c = 0; c < channels; c++)
+                axis[c] = v[c] / largest;
+        }
+        float len = 0.0f;
+        for (int c = 0; c < channels; c++)
+            len += axis[c] * axis[c];
+        len = sqrtf(len);
+        for (int c = 0; c < channels; c++)
+            axis[c] = len > 0.0f ? axis[c] / len : 0.0f;
+    }
+
+    // the texels' extremes along axis, a flat block gets its mean twice
+    static void axis_endpoints(const uint8_t* texels, int channels, const float* mean, const float* axis, float* e0, float* e1) {
+        float t_min = FLT_MAX, t_max = -FLT_MAX;
+        for (int i = 0; i < BLOCK_TEXELS; i++) {
+            float t = 0.0f;
+            for (int c = 0; c < channels; c++)
+                t += (texels[i * 4 + c] - mean[c]) * axis[c];
+            t_min = std::min(t_min, t);
+            t_max = std::max(t_max, t);
+        }
+        for (int c = 0; c < channels; c++) {
+            e0[c] = std::min(std::max(mean[c] + axis[c] * t_max, 0.0f), 255.0f);
+            e1[c] = std::min(std::max(mean[c] + axis[c] * t_min, 0.0f), 255.0f);
+        }
+    }
+
+    // endpoints that best reproduce the texels with these weights of e0 (e1 gets the rest), false if degenerate
+    static bool least_squares(const uint8_t* texels, int channels, const float* weights, float* e0, float* e1) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+        for (int i = 0; i < BLOCK_TEXELS; i++) {
+            float a = weights[i], b = 1.0f - weights[i];
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < channels; c++) {
+                ax[c] += a * texels[i * 4 + c];
+                bx[c] += b * texels[i * 4 + c];
+            }
+        }
+        float det = aa * bb - ab * ab;
+        if (fabsf(det) < 1e-6f)
+            return false;
+        for (int c = 0; c < channels; c++) {
+            e0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / det, 0.0f), 255.0f);
+            e1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / det, 0.0f), 255.0f);
+        }
+        return true;
+    }
+
+    // bc1
+
+    static uint16_t pack_565(const float* c) {
+        int r = (int)(c[0] * 31.0f / 255.0f + 0.5f);
+        int g = (int)(c[1] * 63.0f / 255.0f + 0.5f);
+        int b = (int)(c[2] * 31.0f / 255.0f + 0.5f);
+        return (uint16_t)(r << 11 | g << 5 | b);
+    }
+
+    static void unpack_565(uint16_t v, int* c) {
+        int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+        c[0] = r << 3 | r >> 2;
+        c[1] = g << 2 | g >> 4;
+        c[2] = b << 3 | b >> 2;
+    }
+
+    // orders the endpoints for 4 color mode and picks indices, returns the squared error
+    // equal endpoints would mean 3 color mode, there everything takes index 0 which reads the same in both
+    static int bc1_pack(const uint8_t* texels, uint16_t& c0, uint16_t& c1, uint32_t& indices) {
+        if (c0 < c1)
+            std::swap(c0, c1);
+        int palette[4][3];
+        unpack_565(c0, palette[0]);
+        unpack_565(c1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        int entries = c0 == c1 ? 1 : 4;
+        int error = 0;
+        indices = 0;
+        for (int i = 0; i < BLOCK_TEXELS; i++) {
+            int best = 0, best_error = INT32_MAX;
+            for (int p = 0; p < entries; p++) {
+                int e = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = texels[i * 4 + c] - palette[p][c];
+                    e += d * d;
+                }
+                if (e < best_error) {
+                    best_error = e;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+            error += best_error;
+        }
+        return error;
+    }
+
+    void encode_bc1(const uint8_t* texels, uint8_t* block) {
+        float mean[4], axis[4], e0[4], e1[4];
+        fit_axis(texels, 3, mean, axis);
+        axis_endpoints(texels, 3, mean, axis, e0, e1);
+        uint16_t c0 = pack_565(e0), c1 = pack_565(e1);
+        uint32_t indices;
+        int error = bc1_pack(texels, c0, c1, indices);
+
+        // once more with endpoints fitted to what the indices picked
+        float weights[BLOCK_TEXELS];
+        for (int i = 0; i < BLOCK_TEXELS; i++)
+            weights[i] = BC1_WEIGHTS[(indices >> (2 * i)) & 3];
+        if (error > 0 && least_squares(texels, 3, weights, e0, e1)) {
+            uint16_t r0 = pack_565(e0), r1 = pack_565(e1);
+            uint32_t refined;
+            if (bc1_pack(texels, r0, r1, refined) < error) {
+                c0 = r0;
+                c1 = r1;
+                indices = refined;
+            }
+        }
+
+        block[0] = (uint8_t)c0;
+        block[1] = (uint8_t)(c0 >> 8);
+        block[2] = (uint8_t)c1;
+        block[3] = (uint8_t)(c1 >> 8);
+        for (int b = 0; b < 4; b++)
+            block[4 + b] = (uint8_t)(indices >> (8 * b));
+    }
+
+    // bc4 / bc5 / bc3 alpha
+
+    void encode_bc4(const uint8_t* texels, int channel, uint8_t* block) {
+        int lo = 255, hi = 0;
+        for (int i = 0; i < BLOCK_TEXELS; i++) {
+            lo = std::min(lo, (int)texels[i * 4 + channel]);
+            hi = std::max(hi, (int)texels[i * 4 + channel]);
+        }
+        // hi > lo is the 8 value mode, a flat block is all index 0 which is hi either way
+        block[0] = (uint8_t)hi;
+        block[1] = (uint8_t)lo;
+        int palette[8] = { hi, lo };
+        for (int p = 2; p < 8; p++)
+            palette[p] = ((8 - p) * hi + (p - 1) * lo) / 7;
+        uint64_t bits = 0;
+        if (hi > lo) {
+            for (int i = 0; i < BLOCK_TEXELS; i++) {
+                int v = texels[i * 4 + channel];
+                int best = 0, best_error = INT32_MAX;
+                for (int p = 0; p < 8; p++) {
+                    int e = abs(v - palette[p]);
+                    if (e < best_error) {
+                        best_error = e;
+                        best = p;
+                    }
+                }
+                bits |= (uint64_t)best << (3 * i);
+            }
+        }
+        for (int b = 0; b < 6; b++)
+            block[2 + b] = (uint8_t)(bits >> (8 * b));
+    }
+
+    void encode_bc5(const uint8_t* texels, uint8_t* block) {
+        encode_bc4(texels, 0, block);
+        encode_bc4(texels, 1, block + 8);
+    }
+
+    void encode_bc3(const uint8_t* texels, uint8_t* block) {
+        encode_bc4(texels, 3, block);
+        encode_bc1(texels, block + 8);
+    }
+
+    // bc7 mode 6
+
+    // 7 bits per channel plus one p bit shared by the endpoint's four channels, keeps the p bit that lands closer
+    // opaque stays 255, only reachable with p = 1
+    static void bc7_quantize(const float* e, int* q, int& p) {
+        float best_error = FLT_MAX;
+        for (int pbit = e[3] > 254.5f ? 1 : 0; pbit < 2; pbit++) {
+            int candidate[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                candidate[c] = std::min(std::max((int)((e[c] - pbit) * 0.5f + 0.5f), 0), 127);
+                float d = (float)(candidate[c] * 2 + pbit) - e[c];
+                error += d * d;
+            }
+            if (error < best_error) {
+                best_error = error;
+                p = pbit;
+                memcpy(q, candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    static int bc7_indices(const uint8_t* texels, const int* q0, int p0, const int* q1, int p1, uint8_t* indices) {
+        int palette[16][4];
+        for (int c = 0; c < 4; c++) {
+            int a = q0[c] * 2 + p0, b = q1[c] * 2 + p1;
+            for (int w = 0; w < 16; w++)
+                palette[w][c] = ((64 - BC7_WEIGHTS[w]) * a + BC7_WEIGHTS[w] * b + 32) >> 6;
+        }
+        int error = 0;
+        for (int i = 0; i < BLOCK_TEXELS; i++) {
+            int best = 0, best_error = INT32_MAX;
+            for (int w = 0; w < 16; w++) {
+                int e = 0;
+                for (int c = 0; c < 4; c++) {
+                    int d = texels[i * 4 + c] - palette[w][c];
+                    e += d * d;
+                }
+                if (e < best_error) {
+                    best_error = e;
+                    best = w;
+                }
+            }
+            indices[i] = (uint8_t)best;
+            error += best_error;
+        }
+        return error;
+    }
+
+    static void put_bits(uint8_t* block, int& pos, uint32_t value, int count) {
+        for (int i = 0; i < count; i++, pos++)
+            if (value >> i & 1)
+                block[pos >> 3] |= (uint8_t)(1 << (pos & 7));
+    }
+
+    static uint32_t get_bits(const uint8_t* block, int& pos, int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++, pos++)
+            value |= (uint32_t)(block[pos >> 3] >> (pos & 7) & 1) << i;
+        return value;
+    }
+
+    void encode_bc7(const uint8_t* texels, uint8_t* block) {
+        float mean[4], axis[4], e0[4], e1[4];
+        fit_axis(texels, 4, mean, axis);
+        axis_endpoints(texels, 4, mean, axis, e0, e1);
+        int q0[4], q1[4], p0 = 0, p1 = 0;
+        bc7_quantize(e0, q0, p0);
+        bc7_quantize(e1, q1, p1);
+        uint8_t indices[BLOCK_TEXELS];
+        int error = bc7_indices(texels, q0, p0, q1, p1, indices);
+
+        float weights[BLOCK_TEXELS];
+        for (int i = 0; i < BLOCK_TEXELS; i++)
+            weights[i] = 1.0f - BC7_WEIGHTS[indices[i]] / 64.0f;
+        if (error > 0 && least_squares(texels, 4, weights, e0, e1)) {
+            int r0[4], r1[4], rp0 = 0, rp1 = 0;
+            uint8_t refined[BLOCK_TEXELS];
+            bc7_quantize(e0, r0, rp0);
+            bc7_quantize(e1, r1, rp1);
+            if (bc7_indices(texels, r0, rp0, r1, rp1, refined) < error) {
+                memcpy(q0, r0, sizeof(q0));
+                memcpy(q1, r1, sizeof(q1));
+                p0 = rp0;
+                p1 = rp1;
+                memcpy(indices, refined, sizeof(indices));
+            }
+        }
+
+        // the first index only has 3 bits, its top bit is implied 0, so flip the endpoints when it would be 1
+        if (indices[0] & 8) {
+            for (int c = 0; c < 4; c++)
+                std::swap(q0[c], q1[c]);
+            std::swap(p0, p1);
+            for (int i = 0; i < BLOCK_TEXELS; i++)
+                indices[i] = (uint8_t)(15 - indices[i]);
+        }
+
+        memset(block, 0, 16);
+        int pos = 0;
+        put_bits(block, pos, 1 << 6, 7); // mode 6
+        for (int c = 0; c < 4; c++) {
+            put_bits(block, pos, q0[c], 7);
+            put_bits(block, pos, q1[c], 7);
+        }
+        put_bits(block, pos, p0, 1);
+        put_bits(block, pos, p1, 1);
+        put_bits(block, pos, indices[0], 3);
+        for (int i = 1; i < BLOCK_TEXELS; i++)
+            put_bits(block, pos, indices[i], 4);
+    }
+
+    // whole levels
+
+    static void fetch_block(const image& img, uint32_t bx, uint32_t by, uint8_t* texels) {
+        for (uint32_t y = 0; y < 4; y++) {
+            uint32_t sy = std::min(by * 4 + y, img.height - 1);
+            for (uint32_t x = 0; x < 4; x++) {
+                uint32_t sx = std::min(bx * 4 + x, img.width - 1);
+                memcpy(texels + (y * 4 + x) * 4, &img.rgba[((size_t)sy * img.width + sx) * 4], 4);
+            }
+        }
+    }
+
+    void encode(const image& img, format f, std::vector<uint8_t>& blocks) {
+        blocks.resize(level_bytes(f, img.width, img.height));
+        size_t size = block_bytes(f);
+        uint8_t* out = blocks.data();
+        uint8_t texels[BLOCK_TEXELS * 4];
+        for (uint32_t by = 0; by < (img.height + 3) / 4; by++) {
+            for (uint32_t bx = 0; bx < (img.width + 3) / 4; bx++, out += size) {
+                fetch_block(img, bx, by, texels);
+                switch (f) {
+                case BC1: encode_bc1(texels, out); break;
+                case BC3: encode_bc3(texels, out); break;
+                case BC4: encode_bc4(texels, 0, out); break;
+                case BC5: encode_bc5(texels, out); break;
+                case BC7: encode_bc7(texels, out); break;
+                default: break;
+                }
+            }
+        }
+    }
+
+    void cook(const image& img, usage u, bool high_quality, cooked_texture& out) {
+        image source = img;
+        if (u == METALLIC_ROUGHNESS) {
+            // roughness (g) and metallic (b) into the two channels bc5 keeps
+            for (size_t i = 0; i < source.rgba.size(); i += 4) {
+                source.rgba[i] = source.rgba[i + 1];
+                source.rgba[i + 1] = source.rgba[i + 2];
+            }
+        }
+        out.block_format = choose_format(u, has_alpha(source), high_quality);
+        out.use = u;
+        out.srgb = u == ALBEDO;
+        out.width = img.width;
+        out.height = img.height;
+        std::vector<image> mips;
+        build_mips(source, u, mips);
+        out.levels.resize(mips.size());
+        for (size_t l = 0; l < mips.size(); l++)
+            encode(mips[l], out.block_format, out.levels[l]);
+    }
+
+    // decoding, for checking the encoders
+
+    static void decode_bc1(const uint8_t* block, uint8_t* texels, bool four_color) {
+        uint16_t c0 = (uint16_t)(block[0] | block[1] << 8);
+        uint16_t c1 = (uint16_t)(block[2] | block[3] << 8);
+        int palette[4][4];
+        unpack_565(c0, palette[0]);
+        unpack_565(c1, palette[1]);
+        palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+        for (int c = 0; c < 3; c++) {
+            if (four_color || c0 > c1) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            else {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+        if (!four_color && c0 <= c1)
+            palette[3][3] = 0;
+        uint32_t indices = (uint32_t)(block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24);
+        for (int i = 0; i < BLOCK_TEXELS; i++)
+            for (int c = 0; c < 4; c++)
+                texels[i * 4 + c] = (uint8_t)palette[(indices >> (2 * i)) & 3][c];
+    }
+
+    static void decode_bc4(const uint8_t* block, uint8_t* texels, int channel) {
+        int r0 = block[0], r1 = block[1];
+        int palette[8] = { r0, r1 };
+        if (r0 > r1) {
+            for (int p = 2; p < 8; p++)
+                palette[p] = ((8 - p) * r0 + (p - 1) * r1) / 7;
+        }
+        else {
+            for (int p = 2; p < 6; p++)
+                palette[p] = ((6 - p) * r0 + (p - 1) * r1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+        uint64_t bits = 0;
+        for (int b = 0; b < 6; b++)
+            bits |= (uint64_t)block[2 + b] << (8 * b);
+        for (int i = 0; i < BLOCK_TEXELS; i++)
+            texels[i * 4 + channel] = (uint8_t)palette[(bits >> (3 * i)) & 7];
+    }
+
+    static void decode_bc7(const uint8_t* block, uint8_t* texels) {
+        int pos = 0;
+        if (get_bits(block, pos, 7) != 1 << 6)
+            return; // not mode 6, left as it was
+        int e[2][4];
+        for (int c = 0; c < 4; c++) {
+            e[0][c] = (int)get_bits(block, pos, 7) << 1;
+            e[1][c] = (int)get_bits(block, pos, 7) << 1;
+        }
+        int p0 = (int)get_bits(block, pos, 1), p1 = (int)get_bits(block, pos, 1);
+        for (int c = 0; c < 4; c++) {
+            e[0][c] |= p0;
+            e[1][c] |= p1;
+        }
+        for (int i = 0; i < BLOCK_TEXELS; i++) {
+            int w = BC7_WEIGHTS[get_bits(block, pos, i == 0 ? 3 : 4)];
+            for (int c = 0; c < 4; c++)
+                texels[i * 4 + c] = (uint8_t)(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+        }
+    }
+
+    void decode_block(format f, const uint8_t* block, uint8_t* texels) {
+        for (int i = 0; i < BLOCK_TEXELS; i++) {
+            texels[i * 4 + 0] = texels[i * 4 + 1] = texels[i * 4 + 2] = 0;
+            texels[i * 4 + 3] = 255;
+        }
+        switch (f) {
+        case BC1: decode_bc1(block, texels, false); break;
+        case BC3:
+            decode_bc1(block + 8, texels, true);
+            decode_bc4(block, texels, 3);
+            break;
+        case BC4: decode_bc4(block, texels, 0); break;
+        case BC5:
+            decode_bc4(block, texels, 0);
+            decode_bc4(block + 8, texels, 1);
+            break;
+        case BC7: decode_bc7(block, texels); break;
+        default: break;
+        }
+    }
+}
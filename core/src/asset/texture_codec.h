@@ -0,0 +1,82 @@
+#ifndef TEXTURE_CODEC_H
+#define TEXTURE_CODEC_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// cpu side of the texture cooker, no gl and no files, everything works on rgba8 pixels in memory
+//   mips are box filtered in linear light: albedo is decoded from srgb first and encoded again per level,
+//   normal maps are renormalized per level. the 2x2 filter does two output pixels per step with avx2
+//   blocks are 4x4 texels, blocks hanging over the edge repeat the last row / column
+//   endpoints come from the block's principal axis, refined once by least squares,
+//   then every texel takes the nearest palette entry. bc7 only writes mode 6 (one subset, rgba, 4 bit indices)
+// what each usage becomes, see choose_format
+//   albedo                bc1, bc3 with alpha, bc7 for both when high quality
+//   normal                bc5 (x, y), shaders rebuild z
+//   metallic roughness    bc5 of (g, b), the loader swizzles them back where the shaders look
+//   single channel source bc4
+namespace Texture_codec {
+    enum format : uint8_t { BC1, BC3, BC4, BC5, BC7, FORMAT_COUNT };
+    enum usage : uint8_t { ALBEDO, NORMAL, METALLIC_ROUGHNESS, SINGLE_CHANNEL, USAGE_COUNT };
+
+    const int BLOCK_TEXELS = 16;
+
+    // always 4 bytes a pixel
+    struct image {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> rgba;
+    };
+
+    struct cooked_texture {
+        format block_format = BC1;
+        usage use = ALBEDO;
+        bool srgb = false;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<std::vector<uint8_t>> levels; // level 0 first, down to 1x1
+    };
+
+    // sizes and names inline, the engine reads cooked files with these and doesnt link the encoder
+    inline size_t block_bytes(format f) {
+        return f == BC1 || f == BC4 ? 8 : 16;
+    }
+
+    inline size_t level_bytes(format f, uint32_t width, uint32_t height) {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * block_bytes(f);
+    }
+
+    inline const char* format_name(format f) {
+        static const char* NAMES[FORMAT_COUNT] = { "bc1", "bc3", "bc4", "bc5", "bc7" };
+        return f < FORMAT_COUNT ? NAMES[f] : "?";
+    }
+
+    inline const char* usage_name(usage u) {
+        static const char* NAMES[USAGE_COUNT] = { "albedo", "normal", "metallic_roughness", "single_channel" };
+        return u < USAGE_COUNT ? NAMES[u] : "?";
+    }
+
+    format choose_format(usage u, bool has_alpha, bool high_quality);
+    // any alpha under 255
+    bool has_alpha(const image& img);
+
+    // levels[0] is img, each next one half the size down to 1x1
+    void build_mips(const image& img, usage u, std::vector<image>& levels);
+    // one level into blocks, row by row
+    void encode(const image& img, format f, std::vector<uint8_t>& blocks);
+    // the whole pipeline: channel moves for the usage, mips, encode
+    void cook(const image& img, usage u, bool high_quality, cooked_texture& out);
+
+    // single blocks, texels are 16 rgba8 in row order
+    void encode_bc1(const uint8_t* texels, uint8_t* block);
+    void encode_bc3(const uint8_t* texels, uint8_t* block);
+    // one channel of the texels
+    void encode_bc4(const uint8_t* texels, int channel, uint8_t* block);
+    // channels 0 and 1
+    void encode_bc5(const uint8_t* texels, uint8_t* block);
+    void encode_bc7(const uint8_t* texels, uint8_t* block);
+    // back to 16 rgba8 texels, channels the format doesnt have come out 0 (alpha 255), bc7 mode 6 only
+    void decode_block(format f, const uint8_t* block, uint8_t* texels);
+}
+#endif
@@ -1,82 +1,262 @@
 #include <vector>
 #include <string>
+#include <memory>
+#include <unordered_map>
 #include <iostream>
 #include <cassert>
+#include <algorithm>
 
 #include <glad/glad.h>
 #include <stb_image.h>
 
 #include "texture_manager.h"
+#include "asset_registry.h"
+#include "streaming.h"
+#include "ktx2.h"
+#include "util/mapped_file.h"
+
+// s3tc is an extension glad wasnt generated with, every desktop driver has it
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
 
 namespace Texture_manager {
 
-    static std::vector<unsigned int> textures;
-    static std::vector<std::string> paths;
+    enum texture_state : uint8_t { LOADING, READY, FAILED, EVICTED };
+
+    static std::vector<unsigned int> textures; // missing.png's texture until the slot's own is uploaded
+    static std::vector<uint8_t> states;
+    static std::vector<Asset_registry::asset_key> contents; // pixel hash of ready textures
+    static std::vector<texture_handle> alias_of;            // slot whose gl texture this one shares, itself if none
+    static std::unordered_map<Asset_registry::asset_key, texture_handle> content_owners;
+    static const char* MISSING_PATH = "../resources/textures/missing.png";
     //static std::vector<texture_data> texture_data;
 
-    bool loaded_already(const std::string& new_path, size_t& existing_idx) {
-        for (size_t i = 0; i < paths.size(); i++) {
-            if (new_path == paths[i]) {
-                existing_idx = i;
-                return true;
-            }
+    struct decoded_image {
+        unsigned char* data = nullptr;
+        int width = 0, height = 0, components = 0;
+        // a cooked .ktx2 instead, its levels are uploaded straight from the mapping
+        std::unique_ptr<Util::mapped_file> file;
+        Ktx2::texture cooked;
+        Asset_registry::asset_key content = 0;
+        ~decoded_image() { stbi_image_free(data); }
+
+        bool ok() const { return data || file; }
+        size_t gpu_bytes() const {
+            if (!file)
+                return (size_t)width * height * components * 4 / 3; // mips add about a third
+            size_t bytes = 0;
+            for (const Ktx2::level_view& l : cooked.levels)
+                bytes += l.size;
+            return bytes;
+        }
+    };
+
+    // the srgb formats would convert albedo to linear on sampling, the shaders take it as stored like the png path does
+    static GLenum compressed_format(Texture_codec::format f) {
+        switch (f) {
+        case Texture_codec::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case Texture_codec::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case Texture_codec::BC4: return GL_COMPRESSED_RED_RGTC1;
+        case Texture_codec::BC5: return GL_COMPRESSED_RG_RGTC2;
+        default: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        }
+    }
+
+    static void upload_cooked(const Ktx2::texture& cooked) {
+        GLenum format = compressed_format(cooked.block_format);
+        for (size_t l = 0; l < cooked.levels.size(); l++) {
+            GLsizei w = std::max(1u, cooked.width >> l), h = std::max(1u, cooked.height >> l);
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)l, format, w, h, 0, (GLsizei)cooked.levels[l].size, cooked.levels[l].data);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)cooked.levels.size() - 1);
+        if (cooked.use == Texture_codec::METALLIC_ROUGHNESS) {
+            // cooked as (roughness, metallic), the shaders read g and b
+            GLint swizzle[4] = { GL_ZERO, GL_RED, GL_GREEN, GL_ONE };
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+    }
+
+    static void upload(texture_handle slot, const decoded_image& image) {
+        const char* path = Asset_registry::name(Asset_registry::TEXTURE, slot);
+        auto owner = content_owners.find(image.content);
+        if (owner != content_owners.end() && owner->second != slot) {
+            // same pixels under another name, share its texture and keep it alive while we do
+            texture_handle o = owner->second;
+            textures[slot] = textures[o];
+            alias_of[slot] = o;
+            states[slot] = READY;
+            Asset_registry::acquire(Asset_registry::TEXTURE, (uint32_t)o);
+            Asset_registry::set_resident(Asset_registry::TEXTURE, (uint32_t)slot, 0, 0);
+            std::cout << "[TEXTURE] Loaded: " << path << " (same pixels as " << Asset_registry::name(Asset_registry::TEXTURE, (uint32_t)o) << ")" << std::endl;
+            return;
+        }
+
+        unsigned int texture_id = 0;
+        glGenTextures(1, &texture_id);
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        if (image.file) {
+            upload_cooked(image.cooked);
+        }
+        else {
+            GLenum format = 0;
+            if (image.components == 1) format = GL_RED;
+            else if (image.components == 3) format = GL_RGB;
+            else if (image.components == 4) format = GL_RGBA;
+
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+            glGenerateMipmap(GL_TEXTURE_2D);
         }
-        return false;
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        textures[slot] = texture_id;
+        states[slot] = READY;
+        contents[slot] = image.content;
+        content_owners[image.content] = slot;
+        Asset_registry::set_resident(Asset_registry::TEXTURE, (uint32_t)slot, 0, image.gpu_bytes());
+        if (image.file)
+            std::cout << "[TEXTURE] Loaded: " << path << " (cooked " << Texture_codec::format_name(image.cooked.block_format) << ")" << std::endl;
+        else
+            std::cout << "[TEXTURE] Loaded: " << path << std::endl;
+    }
+
+    static void fail(texture_handle slot) {
+        states[slot] = FAILED;
+        std::cout << "Texture failed to load: " << Asset_registry::name(Asset_registry::TEXTURE, (uint32_t)slot) << std::endl;
+    }
+
+    // a fresh .ktx2 next to the file is mapped and checked, no decode at all
+    static bool map_cooked(const std::string& file_path, decoded_image& image) {
+        if (!Ktx2::fresh(file_path))
+            return false;
+        std::string path = Ktx2::cooked_path(file_path);
+        auto file = std::make_unique<Util::mapped_file>();
+        if (!file->open(path) || !Ktx2::parse(file->data(), file->size(), image.cooked)) {
+            std::cout << "[TEXTURE] " << path << " is stale or broken, decoding the source" << std::endl;
+            return false;
+        }
+        // the upload reads the mapping on the main thread
+        file->prefetch();
+        const Ktx2::level_view& top = image.cooked.levels[0];
+        uint32_t header[3] = { image.cooked.width, image.cooked.height, image.cooked.block_format };
+        image.content = Asset_registry::hash_bytes(header, sizeof(header));
+        image.content = Asset_registry::hash_bytes(top.data, top.size, image.content);
+        image.width = (int)image.cooked.width;
+        image.height = (int)image.cooked.height;
+        image.file = std::move(file);
+        return true;
+    }
+
+    // any thread
+    static void decode(const std::string& file_path, decoded_image& image) {
+        if (map_cooked(file_path, image))
+            return;
+        image.data = stbi_load(file_path.c_str(), &image.width, &image.height, &image.components, 0);
+        if (!image.data)
+            return;
+        int header[3] = { image.width, image.height, image.components };
+        image.content = Asset_registry::hash_bytes(header, sizeof(header));
+        image.content = Asset_registry::hash_bytes(image.data, (size_t)image.width * image.height * image.components, image.content);
+    }
+
+    static void evict(uint32_t slot) {
+        if (alias_of[slot] != slot) {
+            Asset_registry::release(Asset_registry::TEXTURE, (uint32_t)alias_of[slot]);
+            alias_of[slot] = slot;
+        }
+        else {
+            glDeleteTextures(1, &textures[slot]);
+            auto owner = content_owners.find(contents[slot]);
+            if (owner != content_owners.end() && owner->second == slot)
+                content_owners.erase(owner);
+        }
+        textures[slot] = textures[0];
+        states[slot] = EVICTED;
+    }
+
+    static void stream(texture_handle slot, const std::string& file_path) {
+        states[slot] = LOADING;
+        Streaming::submit([slot, file_path] {
+            auto image = std::make_shared<decoded_image>();
+            decode(file_path, *image);
+            if (!image->ok()) {
+                Streaming::stage(0, [slot] { fail(slot); });
+                return;
+            }
+            Streaming::stage(image->gpu_bytes(), [slot, image] { upload(slot, *image); });
+        });
+    }
+
+    static texture_handle add_slot(const std::string& file_path) {
+        texture_handle slot = textures.size();
+        textures.push_back(textures.empty() ? 0 : textures[0]);
+        states.push_back(LOADING);
+        contents.push_back(0);
+        alias_of.push_back(slot);
+        Asset_registry::add(Asset_registry::TEXTURE, file_path, (uint32_t)slot);
+        return slot;
     }
 
     void init() {
         //stbi_set_flip_vertically_on_load(true);
-        texture_handle zero = load_from_path("../resources/textures/missing.png");
+        if (!textures.empty())
+            return;
+        Asset_registry::set_evictor(Asset_registry::TEXTURE, evict);
+        // the placeholder itself cant stream, and is never evicted
+        add_slot(MISSING_PATH);
+        Asset_registry::acquire(Asset_registry::TEXTURE, 0);
+        decoded_image image;
+        decode(MISSING_PATH, image);
+        if (image.ok())
+            upload(0, image);
+        else
+            fail(0);
         assert(!textures.empty());
     }
 
     void cleanup() {
-        for (unsigned int texture : textures) {
-            if (texture != 0) {
-                glDeleteTextures(1, &texture);
+        for (size_t i = 0; i < textures.size(); i++) {
+            // placeholders and aliases share someone else's
+            if (states[i] == READY && alias_of[i] == i) {
+                glDeleteTextures(1, &textures[i]);
             }
         }
         textures.clear();
-        paths.clear();
+        states.clear();
+        contents.clear();
+        alias_of.clear();
+        content_owners.clear();
     }
 
     texture_handle load_from_path(const std::string& file_path) {
-        size_t existing_texture_index;
-        if (loaded_already(file_path, existing_texture_index)) {
+        if (textures.empty())
+            init();
+
+        uint32_t existing_texture_index;
+        if (Asset_registry::find(Asset_registry::TEXTURE, file_path, existing_texture_index)) {
+            if (states[existing_texture_index] == EVICTED)
+                stream(existing_texture_index, file_path);
             return existing_texture_index;
         }
 
-        unsigned int texture_id = 0;
-        glGenTextures(1, &texture_id);
-        int width, height, nrComponents;
-        unsigned char* data = stbi_load(file_path.c_str(), &width, &height, &nrComponents, 0);
-
-        if (data) {
-            GLenum format = 0;
-            if (nrComponents == 1) format = GL_RED;
-            else if (nrComponents == 3) format = GL_RGB;
-            else if (nrComponents == 4) format = GL_RGBA;
-
-            glBindTexture(GL_TEXTURE_2D, texture_id);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
+        texture_handle slot = add_slot(file_path);
+        stream(slot, file_path);
+        return slot;
+    }
 
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    void acquire(texture_handle texture_id) {
+        Asset_registry::acquire(Asset_registry::TEXTURE, (uint32_t)texture_id);
+    }
 
-            stbi_image_free(data);
-            textures.push_back(texture_id);
-            paths.push_back(file_path);
-            std::cout << "[TEXTURE] Loaded: " << file_path << std::endl;
-            return textures.size() - 1;
-        }
-        else {
-            std::cout << "Texture failed to load: " << file_path << std::endl;
-            stbi_image_free(data);
-            return 0;
-        }
+    void release(texture_handle texture_id) {
+        Asset_registry::release(Asset_registry::TEXTURE, (uint32_t)texture_id);
     }
 
     void bind(texture_handle texture_id, unsigned int texture_unit) {
@@ -84,11 +264,15 @@ namespace Texture_manager {
         glBindTexture(GL_TEXTURE_2D, textures[texture_id]);
     }
 
+    bool ready(texture_handle texture_id) {
+        return states[texture_id] == READY;
+    }
+
     size_t get_texture_count() {
         return textures.size();
     }
 
     std::string get_name(texture_handle texture_id) {
-        return paths[texture_id];
+        return Asset_registry::name(Asset_registry::TEXTURE, (uint32_t)texture_id);
     }
 }
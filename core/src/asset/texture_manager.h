@@ -5,11 +5,21 @@
 
 typedef size_t texture_handle;
 
+// handle 0 is missing.png, loaded by init (or the first load)
+// loads return right away, the image is decoded on a loader thread and uploaded through Streaming,
+// until then the handle binds missing.png. failed loads keep it
+// a fresh cooked .ktx2 next to the file (see ktx2.h) is mapped and uploaded block compressed with its own mips instead
+// paths are looked up through Asset_registry, owners acquire / release handles and unreferenced textures
+// can be evicted (back to missing.png until loaded again). two files with the same pixels share one gl texture
 namespace Texture_manager {
     void init();
     void cleanup();
     texture_handle load_from_path(const std::string& file_path);
+    void acquire(texture_handle texture_id);
+    void release(texture_handle texture_id);
     void bind(texture_handle texture_id, unsigned int texture_unit = 0);
+    // false while the placeholder stands in, normal / metallic roughness maps are skipped until then
+    bool ready(texture_handle texture_id);
     size_t get_texture_count();
     std::string get_name(texture_handle texture_id);
 }
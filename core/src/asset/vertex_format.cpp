@@ -0,0 +1,103 @@
+#include "vertex_format.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "mesh.h"
+
+namespace Vertex_format {
+    // smallest w that survives snorm16, so a right handed frame never reads back as w = -0
+    static const float MIN_W = 1.0f / 32767.0f;
+
+    static int16_t snorm16(float v) {
+        return (int16_t)std::lround(glm::clamp(v, -1.0f, 1.0f) * 32767.0f);
+    }
+
+    quantization measure(const Vertex* vertices, uint32_t count) {
+        quantization q;
+#ifndef GLOW_FLOAT_POSITIONS
+        if (count == 0)
+            return q;
+        glm::vec3 lo = vertices[0].Position, hi = vertices[0].Position;
+        for (uint32_t i = 1; i < count; i++) {
+            lo = glm::min(lo, vertices[i].Position);
+            hi = glm::max(hi, vertices[i].Position);
+        }
+        q.offset = lo;
+        q.scale = hi - lo;
+#endif
+        return q;
+    }
+
+    void encode_frame(const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& bitangent, int16_t out[4]) {
+        float length = glm::length(normal);
+        glm::vec3 n = length > 1e-12f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        glm::vec3 t = tangent - n * glm::dot(n, tangent);
+        length = glm::length(t);
+        if (length > 1e-6f)
+            t /= length;
+        else
+            t = glm::normalize(glm::cross(n, std::abs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f)));
+        glm::vec3 b = glm::cross(n, t);
+        bool mirrored = glm::dot(b, bitangent) < 0.0f;
+
+        glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(t, b, n)));
+        // q and -q are the same rotation, keep w positive so its sign is free for the handedness
+        if (q.w < 0.0f)
+            q = -q;
+        if (q.w < MIN_W) {
+            float rest = std::sqrt(1.0f - MIN_W * MIN_W) / std::max(glm::length(glm::vec3(q.x, q.y, q.z)), 1e-12f);
+            q = glm::quat(MIN_W, q.x * rest, q.y * rest, q.z * rest);
+        }
+        if (mirrored)
+            q = -q;
+        out[0] = snorm16(q.x);
+        out[1] = snorm16(q.y);
+        out[2] = snorm16(q.z);
+        out[3] = snorm16(q.w);
+    }
+
+    void decode_frame(const int16_t frame[4], glm::vec3& normal, glm::vec3& tangent, float& handedness) {
+        glm::vec4 q = glm::normalize(glm::max(glm::vec4(frame[0], frame[1], frame[2], frame[3]) / 32767.0f, glm::vec4(-1.0f)));
+        handedness = q.w < 0.0f ? -1.0f : 1.0f;
+        tangent = glm::vec3(1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y + q.w * q.z), 2.0f * (q.x * q.z - q.w * q.y));
+        normal = glm::vec3(2.0f * (q.x * q.z + q.w * q.y), 2.0f * (q.y * q.z - q.w * q.x), 1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+    }
+
+    void pack(const Vertex* vertices, uint32_t count, const quantization& q, packed_position* positions, packed_surface* surfaces) {
+#ifndef GLOW_FLOAT_POSITIONS
+        // flat axes (a floor plane) pack to 0 and come back as the offset
+        glm::vec3 inverse_scale;
+        for (int a = 0; a < 3; a++)
+            inverse_scale[a] = q.scale[a] > 0.0f ? 1.0f / q.scale[a] : 0.0f;
+#endif
+        for (uint32_t i = 0; i < count; i++) {
+            const Vertex& v = vertices[i];
+#ifdef GLOW_FLOAT_POSITIONS
+            positions[i] = packed_position{ v.Position.x, v.Position.y, v.Position.z };
+#else
+            glm::vec3 unit = glm::clamp((v.Position - q.offset) * inverse_scale, 0.0f, 1.0f);
+            positions[i] = packed_position{
+                (uint16_t)std::lround(unit.x * 65535.0f),
+                (uint16_t)std::lround(unit.y * 65535.0f),
+                (uint16_t)std::lround(unit.z * 65535.0f),
+                0 };
+#endif
+            encode_frame(v.Normal, v.Tangent, v.Bitangent, surfaces[i].frame);
+            surfaces[i].uv[0] = glm::packHalf1x16(v.TexCoords.x);
+            surfaces[i].uv[1] = glm::packHalf1x16(v.TexCoords.y);
+        }
+    }
+
+    glm::mat4 dequantize(const glm::mat4& model, const quantization& q) {
+        glm::mat4 m;
+        m[0] = model[0] * q.scale.x;
+        m[1] = model[1] * q.scale.y;
+        m[2] = model[2] * q.scale.z;
+        m[3] = model * glm::vec4(q.offset, 1.0f);
+        return m;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <string>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+struct Vertex;
+
+// what a Vertex turns into in the geometry pool, Vertex stays the import / lod / bvh form on the cpu
+// two streams, so depth only passes fetch 8 bytes a vertex and nothing else
+//   position  unorm16 x y z against the mesh's aabb (w is padding), 8 bytes
+//             GLOW_FLOAT_POSITIONS keeps plain floats instead, 12 bytes
+//   surface   tangent frame as a snorm16 quaternion, the bitangent's handedness is the sign of w, 8 bytes
+//             uv as two halfs, 4 bytes
+// 20 bytes a vertex (24 with float positions) down from 56
+// the attribute table in vertex_format_gpu.cpp is the only description: Geometry_pool sets the vaos up from it
+// and Shader::init puts its locations in front of every shader, resources/shaders/vertex_format.glsl does the decoding
+// shaders get positions in the unit box, the render queue folds the mesh's dequantize into each instance's model matrix
+namespace Vertex_format {
+    enum stream : uint32_t { POSITION_STREAM, SURFACE_STREAM, STREAM_COUNT };
+
+#ifdef GLOW_FLOAT_POSITIONS
+    struct packed_position {
+        float x, y, z;
+    };
+#else
+    struct packed_position {
+        uint16_t x, y, z, pad;
+    };
+#endif
+
+    struct packed_surface {
+        int16_t frame[4]; // quaternion x y z w
+        uint16_t uv[2];   // half floats
+    };
+
+    // model space position = offset + packed position (0..1 per axis) * scale
+    struct quantization {
+        glm::vec3 offset = glm::vec3(0.0f);
+        glm::vec3 scale = glm::vec3(1.0f);
+    };
+
+    const uint32_t STREAM_STRIDES[STREAM_COUNT] = { sizeof(packed_position), sizeof(packed_surface) };
+    const uint32_t VERTEX_BYTES = sizeof(packed_position) + sizeof(packed_surface);
+
+    // the mesh's aabb, identity with float positions
+    quantization measure(const Vertex* vertices, uint32_t count);
+    void pack(const Vertex* vertices, uint32_t count, const quantization& q, packed_position* positions, packed_surface* surfaces);
+    // the frame goes through Gram-Schmidt first, degenerate tangents get any perpendicular
+    void encode_frame(const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& bitangent, int16_t out[4]);
+    // what the shader rebuilds, bitangent = cross(normal, tangent) * handedness
+    void decode_frame(const int16_t frame[4], glm::vec3& normal, glm::vec3& tangent, float& handedness);
+    // model * quantization, for the instance buffer
+    glm::mat4 dequantize(const glm::mat4& model, const quantization& q);
+
+    // needs a gl context, formats every attribute of the streams into the bound vao
+    // stream s reads from vertex buffer binding s, position_only leaves the surface attributes disabled
+    void setup_attributes(bool position_only);
+    // "#define VERTEX_<NAME>_LOCATION n" per attribute
+    std::string glsl_defines();
+}
+#endif
@@ -0,0 +1,44 @@
+#include "vertex_format.h"
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+namespace Vertex_format {
+    struct attribute {
+        const char* name; // VERTEX_<name>_LOCATION in the shaders
+        GLuint location;
+        stream source;
+        GLint components;
+        GLenum type;
+        GLboolean normalized;
+        GLuint offset;
+    };
+
+    static const attribute ATTRIBUTES[] = {
+#ifdef GLOW_FLOAT_POSITIONS
+        { "POSITION", 0, POSITION_STREAM, 3, GL_FLOAT, GL_FALSE, 0 },
+#else
+        { "POSITION", 0, POSITION_STREAM, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0 },
+#endif
+        { "FRAME", 1, SURFACE_STREAM, 4, GL_SHORT, GL_TRUE, offsetof(packed_surface, frame) },
+        { "UV", 2, SURFACE_STREAM, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(packed_surface, uv) },
+    };
+
+    void setup_attributes(bool position_only) {
+        for (const attribute& a : ATTRIBUTES) {
+            if (position_only && a.source != POSITION_STREAM)
+                continue;
+            glEnableVertexAttribArray(a.location);
+            glVertexAttribFormat(a.location, a.components, a.type, a.normalized, a.offset);
+            glVertexAttribBinding(a.location, a.source);
+        }
+    }
+
+    std::string glsl_defines() {
+        std::string defines;
+        for (const attribute& a : ATTRIBUTES)
+            defines += "#define VERTEX_" + std::string(a.name) + "_LOCATION " + std::to_string(a.location) + "\n";
+        return defines;
+    }
+}
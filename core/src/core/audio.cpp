@@ -149,4 +149,11 @@ namespace Audio {
         }
     }
 
+    int playing_channels() {
+        int channels = 0;
+        if (g_system)
+            g_system->getChannelsPlaying(&channels, nullptr);
+        return channels;
+    }
+
 }
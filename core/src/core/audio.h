@@ -26,4 +26,6 @@ namespace Audio {
     void loop_audio_if_not_playing(const std::string& filename, float volume);
     void play_audio(const std::string& filename, float volume, float frequency = 1.0f);
     void set_audio_volume(const std::string& filename, float volume);
+    // channels fmod is playing right now, 0 when audio was never initialized
+    int playing_channels();
 }
@@ -0,0 +1,716 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cassert>
+#include <cstring>
+
+#include <immintrin.h>
+
+namespace {
+    constexpr int BIN_COUNT = 12;
+    constexpr uint32_t MESH_MAX_LEAF = 4;
+    constexpr uint32_t SCENE_MAX_LEAF = 2;
+    constexpr int MAX_DEPTH = 60; // traversal stacks are 64 deep
+    constexpr float TRI_EPSILON = 1e-12f;
+    constexpr float HIT_EPSILON = 1e-6f;
+
+    struct build_prim {
+        Util::aabb bounds;
+        glm::vec3 centroid;
+    };
+
+    inline void grow(Util::aabb& b, const Util::aabb& o) {
+        b.min = glm::min(b.min, o.min);
+        b.max = glm::max(b.max, o.max);
+    }
+
+    inline Util::aabb empty_aabb() {
+        return Util::aabb{ glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+    }
+
+    inline float half_area(const Util::aabb& b) {
+        glm::vec3 e = b.max - b.min;
+        if (e.x < 0.0f) return 0.0f;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    // binned sah, children are always pushed after their parent so a reverse walk refits bottom up
+    void build_nodes(std::vector<bvh_node>& nodes, std::vector<uint32_t>& order, const std::vector<build_prim>& prims, uint32_t max_leaf) {
+        nodes.clear();
+        order.resize(prims.size());
+        std::iota(order.begin(), order.end(), 0u);
+        if (prims.empty())
+            return;
+
+        nodes.reserve(prims.size() * 2);
+
+        auto make_node = [&](uint32_t first, uint32_t count) {
+            Util::aabb b = empty_aabb();
+            for (uint32_t i = first; i < first + count; i++)
+                grow(b, prims[order[i]].bounds);
+            nodes.push_back(bvh_node{ b.min, first, b.max, count });
+            return (uint32_t)nodes.size() - 1;
+        };
+
+        struct build_item { uint32_t node; int depth; };
+        std::vector<build_item> stack;
+        stack.push_back({ make_node(0, (uint32_t)prims.size()), 0 });
+
+        while (!stack.empty()) {
+            build_item item = stack.back();
+            stack.pop_back();
+
+            uint32_t first = nodes[item.node].left_first;
+            uint32_t count = nodes[item.node].count;
+            if (count <= 1 || item.depth >= MAX_DEPTH)
+                continue;
+
+            Util::aabb centroid_bounds = empty_aabb();
+            for (uint32_t i = first; i < first + count; i++) {
+                centroid_bounds.min = glm::min(centroid_bounds.min, prims[order[i]].centroid);
+                centroid_bounds.max = glm::max(centroid_bounds.max, prims[order[i]].centroid);
+            }
+
+            int best_axis = -1;
+            int best_split = 0;
+            float best_cost = FLT_MAX;
+
+            for (int axis = 0; axis < 3; axis++) {
+                float lo = centroid_bounds.min[axis];
+                float extent = centroid_bounds.max[axis] - lo;
+                if (extent <= 0.0f)
+                    continue;
+
+                Util::aabb bin_bounds[BIN_COUNT];
+                uint32_t bin_count[BIN_COUNT] = { 0 };
+                for (int b = 0; b < BIN_COUNT; b++)
+                    bin_bounds[b] = empty_aabb();
+
+                float scale = BIN_COUNT / extent;
+                for (uint32_t i = first; i < first + count; i++) {
+                    const build_prim& p = prims[order[i]];
+                    int b = std::min(BIN_COUNT - 1, (int)((p.centroid[axis] - lo) * scale));
+                    bin_count[b]++;
+                    grow(bin_bounds[b], p.bounds);
+                }
+
+                // sweep from both sides
+                float left_area[BIN_COUNT - 1], right_area[BIN_COUNT - 1];
+                uint32_t left_count[BIN_COUNT - 1], right_count[BIN_COUNT - 1];
+                Util::aabb left_box = empty_aabb(), right_box = empty_aabb();
+                uint32_t left_sum = 0, right_sum = 0;
+                for (int b = 0; b < BIN_COUNT - 1; b++) {
+                    left_sum += bin_count[b];
+                    grow(left_box, bin_bounds[b]);
+                    left_count[b] = left_sum;
+                    left_area[b] = half_area(left_box);
+
+                    right_sum += bin_count[BIN_COUNT - 1 - b];
+                    grow(right_box, bin_bounds[BIN_COUNT - 1 - b]);
+                    right_count[BIN_COUNT - 2 - b] = right_sum;
+                    right_area[BIN_COUNT - 2 - b] = half_area(right_box);
+                }
+
+                for (int b = 0; b < BIN_COUNT - 1; b++) {
+                    if (!left_count[b] || !right_count[b])
+                        continue;
+                    float cost = left_count[b] * left_area[b] + right_count[b] * right_area[b];
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_split = b;
+                    }
+                }
+            }
+
+            const bvh_node& node = nodes[item.node];
+            float leaf_cost = count * half_area(Util::aabb{ node.min, node.max });
+            // traversal cost relative to one primitive test
+            float split_cost = half_area(Util::aabb{ node.min, node.max }) + best_cost;
+
+            uint32_t mid;
+            if (best_axis == -1) {
+                // every centroid in the same spot, fall back to an even split
+                if (count <= max_leaf)
+                    continue;
+                mid = first + count / 2;
+            }
+            else {
+                if (count <= max_leaf && split_cost >= leaf_cost)
+                    continue;
+
+                float lo = centroid_bounds.min[best_axis];
+                float scale = BIN_COUNT / (centroid_bounds.max[best_axis] - lo);
+                auto it = std::partition(order.begin() + first, order.begin() + first + count, [&](uint32_t idx) {
+                    int b = std::min(BIN_COUNT - 1, (int)((prims[idx].centroid[best_axis] - lo) * scale));
+                    return b <= best_split;
+                });
+                mid = (uint32_t)(it - order.begin());
+                if (mid == first || mid == first + count)
+                    mid = first + count / 2;
+            }
+
+            uint32_t left = make_node(first, mid - first);
+            uint32_t right = make_node(mid, first + count - mid);
+            (void)right;
+            nodes[item.node].left_first = left;
+            nodes[item.node].count = 0;
+
+            stack.push_back({ left + 1, item.depth + 1 });
+            stack.push_back({ left, item.depth + 1 });
+        }
+    }
+
+    // returns entry distance or FLT_MAX on a miss
+    inline float slab(const bvh_node& n, __m128 origin, __m128 inv_dir, float t_max) {
+        // lane 3 holds left_first / count and is never read back
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&n.min.x), origin), inv_dir);
+        __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&n.max.x), origin), inv_dir);
+        __m128 vmin = _mm_min_ps(t1, t2);
+        __m128 vmax = _mm_max_ps(t1, t2);
+        __m128 tmin = _mm_max_ss(vmin, _mm_max_ss(_mm_shuffle_ps(vmin, vmin, 1), _mm_shuffle_ps(vmin, vmin, 2)));
+        __m128 tmax = _mm_min_ss(vmax, _mm_min_ss(_mm_shuffle_ps(vmax, vmax, 1), _mm_shuffle_ps(vmax, vmax, 2)));
+        float near = _mm_cvtss_f32(tmin);
+        float far = _mm_cvtss_f32(tmax);
+        if (near > far || far < 0.0f || near >= t_max)
+            return FLT_MAX;
+        return near;
+    }
+
+    inline __m128 load_vec3(const glm::vec3& v) {
+        return _mm_setr_ps(v.x, v.y, v.z, 0.0f);
+    }
+
+    inline glm::vec3 safe_inverse(const glm::vec3& d) {
+        return glm::vec3(
+            d.x != 0.0f ? 1.0f / d.x : FLT_MAX,
+            d.y != 0.0f ? 1.0f / d.y : FLT_MAX,
+            d.z != 0.0f ? 1.0f / d.z : FLT_MAX);
+    }
+
+    inline Bvh_ray transform_ray(const Bvh_ray& ray, const glm::mat4& m) {
+        // direction is left unnormalized so t means the same thing in both spaces
+        Bvh_ray local;
+        local.origin = glm::vec3(m * glm::vec4(ray.origin, 1.0f));
+        local.dir = glm::vec3(m * glm::vec4(ray.dir, 0.0f));
+        local.t_max = ray.t_max;
+        return local;
+    }
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+// 8 rays in soa form
+struct bvh_packet {
+    __m256 ox, oy, oz;
+    __m256 dx, dy, dz;
+    __m256 idx, idy, idz;    // 1 / dir
+    __m256 oidx, oidy, oidz; // origin / dir
+    __m256 t;
+    __m256i tri;
+    __m256i instance;
+    __m256 active;
+
+    void finish_setup() {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 big = _mm256_set1_ps(FLT_MAX);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        idx = _mm256_blendv_ps(_mm256_div_ps(one, dx), big, _mm256_cmp_ps(dx, zero, _CMP_EQ_OQ));
+        idy = _mm256_blendv_ps(_mm256_div_ps(one, dy), big, _mm256_cmp_ps(dy, zero, _CMP_EQ_OQ));
+        idz = _mm256_blendv_ps(_mm256_div_ps(one, dz), big, _mm256_cmp_ps(dz, zero, _CMP_EQ_OQ));
+        oidx = _mm256_mul_ps(ox, idx);
+        oidy = _mm256_mul_ps(oy, idy);
+        oidz = _mm256_mul_ps(oz, idz);
+    }
+};
+
+namespace {
+    inline __m256 slab8(const bvh_node& n, const bvh_packet& p, __m256& t_near) {
+        __m256 tx1 = _mm256_fmsub_ps(_mm256_set1_ps(n.min.x), p.idx, p.oidx);
+        __m256 tx2 = _mm256_fmsub_ps(_mm256_set1_ps(n.max.x), p.idx, p.oidx);
+        __m256 ty1 = _mm256_fmsub_ps(_mm256_set1_ps(n.min.y), p.idy, p.oidy);
+        __m256 ty2 = _mm256_fmsub_ps(_mm256_set1_ps(n.max.y), p.idy, p.oidy);
+        __m256 tz1 = _mm256_fmsub_ps(_mm256_set1_ps(n.min.z), p.idz, p.oidz);
+        __m256 tz2 = _mm256_fmsub_ps(_mm256_set1_ps(n.max.z), p.idz, p.oidz);
+
+        __m256 tmin = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx1, tx2), _mm256_min_ps(ty1, ty2)),
+                                    _mm256_max_ps(_mm256_min_ps(tz1, tz2), _mm256_setzero_ps()));
+        __m256 tmax = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx1, tx2), _mm256_max_ps(ty1, ty2)),
+                                    _mm256_min_ps(_mm256_max_ps(tz1, tz2), p.t));
+        t_near = tmin;
+        return _mm256_and_ps(_mm256_cmp_ps(tmin, tmax, _CMP_LE_OQ), p.active);
+    }
+
+    // smallest entry distance over the lanes that hit
+    inline float nearest_lane(__m256 t_near, __m256 mask) {
+        __m256 t = _mm256_blendv_ps(_mm256_set1_ps(FLT_MAX), t_near, mask);
+        __m128 m = _mm_min_ps(_mm256_castps256_ps128(t), _mm256_extractf128_ps(t, 1));
+        m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+        m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+        return _mm_cvtss_f32(m);
+    }
+
+    bvh_packet load_packet(const Bvh_ray* rays, int count) {
+        alignas(32) float o[3][8], d[3][8], t[8], active[8];
+        for (int i = 0; i < BVH_PACKET_SIZE; i++) {
+            bool live = i < count;
+            const Bvh_ray& r = rays[live ? i : 0];
+            for (int a = 0; a < 3; a++) {
+                o[a][i] = r.origin[a];
+                d[a][i] = r.dir[a];
+            }
+            t[i] = live ? r.t_max : 0.0f;
+            active[i] = live ? -1.0f : 0.0f; // sign bit drives blendv / and
+        }
+
+        bvh_packet p;
+        p.ox = _mm256_load_ps(o[0]); p.oy = _mm256_load_ps(o[1]); p.oz = _mm256_load_ps(o[2]);
+        p.dx = _mm256_load_ps(d[0]); p.dy = _mm256_load_ps(d[1]); p.dz = _mm256_load_ps(d[2]);
+        p.t = _mm256_load_ps(t);
+        p.active = _mm256_cmp_ps(_mm256_load_ps(active), _mm256_setzero_ps(), _CMP_LT_OQ);
+        p.tri = _mm256_set1_epi32(-1);
+        p.instance = _mm256_set1_epi32(-1);
+        p.finish_setup();
+        return p;
+    }
+}
+#else
+struct bvh_packet {};
+#endif
+
+// ----------------------------------------------------------------------------------------------
+// bottom level
+
+void Bvh_mesh::build(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices) {
+    clear();
+
+    size_t tri_count = indices.size() / 3;
+    std::vector<build_prim> prims(tri_count);
+    for (size_t i = 0; i < tri_count; i++) {
+        const glm::vec3& a = positions[indices[i * 3 + 0]];
+        const glm::vec3& b = positions[indices[i * 3 + 1]];
+        const glm::vec3& c = positions[indices[i * 3 + 2]];
+        prims[i].bounds.min = glm::min(a, glm::min(b, c));
+        prims[i].bounds.max = glm::max(a, glm::max(b, c));
+        prims[i].centroid = (a + b + c) * (1.0f / 3.0f);
+    }
+
+    build_nodes(nodes, tri_ids, prims, MESH_MAX_LEAF);
+
+    tris.resize(tri_count);
+    for (size_t i = 0; i < tri_count; i++) {
+        uint32_t id = tri_ids[i];
+        const glm::vec3& a = positions[indices[id * 3 + 0]];
+        const glm::vec3& b = positions[indices[id * 3 + 1]];
+        const glm::vec3& c = positions[indices[id * 3 + 2]];
+        tris[i] = tri{ a, b - a, c - a };
+    }
+}
+
+void Bvh_mesh::assign(const bvh_node* src_nodes, size_t node_count, const float* src_tris, const uint32_t* src_tri_ids, size_t tri_count) {
+    static_assert(sizeof(tri) == TRI_FLOATS * sizeof(float), "cooked triangles are packed floats");
+    nodes.assign(src_nodes, src_nodes + node_count);
+    tris.resize(tri_count);
+    memcpy(tris.data(), src_tris, tri_count * sizeof(tri));
+    tri_ids.assign(src_tri_ids, src_tri_ids + tri_count);
+}
+
+void Bvh_mesh::clear() {
+    nodes.clear();
+    tris.clear();
+    tri_ids.clear();
+}
+
+Util::aabb Bvh_mesh::bounds() const {
+    if (nodes.empty())
+        return Util::aabb{ glm::vec3(0.0f), glm::vec3(0.0f) };
+    return Util::aabb{ nodes[0].min, nodes[0].max };
+}
+
+bool Bvh_mesh::intersect(const Bvh_ray& ray, Bvh_hit& hit) const {
+    if (nodes.empty())
+        return false;
+
+    float t_best = std::min(ray.t_max, hit.t);
+    uint32_t best = BVH_INVALID;
+
+    __m128 origin = load_vec3(ray.origin);
+    __m128 inv_dir = load_vec3(safe_inverse(ray.dir));
+
+    struct entry { uint32_t node; float dist; };
+    entry stack[64];
+    int sp = 0;
+
+    float d = slab(nodes[0], origin, inv_dir, t_best);
+    if (d == FLT_MAX)
+        return false;
+    stack[sp++] = { 0, d };
+
+    while (sp) {
+        entry e = stack[--sp];
+        if (e.dist >= t_best)
+            continue;
+
+        const bvh_node& n = nodes[e.node];
+        if (n.count) {
+            for (uint32_t i = n.left_first; i < n.left_first + n.count; i++) {
+                const tri& t = tris[i];
+                glm::vec3 h = glm::cross(ray.dir, t.e2);
+                float a = glm::dot(t.e1, h);
+                if (std::fabs(a) < TRI_EPSILON)
+                    continue;
+                float f = 1.0f / a;
+                glm::vec3 s = ray.origin - t.v0;
+                float u = f * glm::dot(s, h);
+                if (u < 0.0f || u > 1.0f)
+                    continue;
+                glm::vec3 q = glm::cross(s, t.e1);
+                float v = f * glm::dot(ray.dir, q);
+                if (v < 0.0f || u + v > 1.0f)
+                    continue;
+                float dist = f * glm::dot(t.e2, q);
+                if (dist > HIT_EPSILON && dist < t_best) {
+                    t_best = dist;
+                    best = i;
+                }
+            }
+            continue;
+        }
+
+        uint32_t c0 = n.left_first, c1 = n.left_first + 1;
+        float d0 = slab(nodes[c0], origin, inv_dir, t_best);
+        float d1 = slab(nodes[c1], origin, inv_dir, t_best);
+        if (d0 > d1) {
+            std::swap(d0, d1);
+            std::swap(c0, c1);
+        }
+        // far child first so the near one is popped next
+        if (d1 != FLT_MAX)
+            stack[sp++] = { c1, d1 };
+        if (d0 != FLT_MAX)
+            stack[sp++] = { c0, d0 };
+    }
+
+    if (best == BVH_INVALID)
+        return false;
+
+    hit.t = t_best;
+    hit.tri = tri_ids[best];
+    return true;
+}
+
+void Bvh_mesh::intersect_packet(const Bvh_ray* rays, Bvh_hit* hits, int count) const {
+#if defined(__AVX2__) && defined(__FMA__)
+    if (nodes.empty())
+        return;
+
+    bvh_packet p = load_packet(rays, count);
+    alignas(32) float t_in[8];
+    for (int i = 0; i < BVH_PACKET_SIZE; i++)
+        t_in[i] = i < count ? std::min(rays[i].t_max, hits[i].t) : 0.0f;
+    p.t = _mm256_load_ps(t_in);
+
+    trace_packet(p);
+
+    alignas(32) float t_out[8];
+    alignas(32) int32_t tri_out[8];
+    _mm256_store_ps(t_out, p.t);
+    _mm256_store_si256((__m256i*)tri_out, p.tri);
+    for (int i = 0; i < count; i++) {
+        if (tri_out[i] != -1) {
+            hits[i].t = t_out[i];
+            hits[i].tri = (uint32_t)tri_out[i];
+        }
+    }
+#else
+    for (int i = 0; i < count; i++)
+        intersect(rays[i], hits[i]);
+#endif
+}
+
+void Bvh_mesh::trace_packet(bvh_packet& p) const {
+#if defined(__AVX2__) && defined(__FMA__)
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 eps = _mm256_set1_ps(TRI_EPSILON);
+    const __m256 hit_eps = _mm256_set1_ps(HIT_EPSILON);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+
+    uint32_t stack[64];
+    int sp = 0;
+
+    __m256 t_near;
+    if (!_mm256_movemask_ps(slab8(nodes[0], p, t_near)))
+        return;
+    stack[sp++] = 0;
+
+    while (sp) {
+        const bvh_node& n = nodes[stack[--sp]];
+
+        if (n.count) {
+            for (uint32_t i = n.left_first; i < n.left_first + n.count; i++) {
+                const tri& t = tris[i];
+                __m256 e1x = _mm256_set1_ps(t.e1.x), e1y = _mm256_set1_ps(t.e1.y), e1z = _mm256_set1_ps(t.e1.z);
+                __m256 e2x = _mm256_set1_ps(t.e2.x), e2y = _mm256_set1_ps(t.e2.y), e2z = _mm256_set1_ps(t.e2.z);
+
+                // h = dir x e2
+                __m256 hx = _mm256_fmsub_ps(p.dy, e2z, _mm256_mul_ps(p.dz, e2y));
+                __m256 hy = _mm256_fmsub_ps(p.dz, e2x, _mm256_mul_ps(p.dx, e2z));
+                __m256 hz = _mm256_fmsub_ps(p.dx, e2y, _mm256_mul_ps(p.dy, e2x));
+                __m256 a = _mm256_fmadd_ps(e1x, hx, _mm256_fmadd_ps(e1y, hy, _mm256_mul_ps(e1z, hz)));
+                __m256 valid = _mm256_cmp_ps(_mm256_andnot_ps(sign, a), eps, _CMP_GT_OQ);
+                __m256 f = _mm256_div_ps(one, a);
+
+                __m256 sx = _mm256_sub_ps(p.ox, _mm256_set1_ps(t.v0.x));
+                __m256 sy = _mm256_sub_ps(p.oy, _mm256_set1_ps(t.v0.y));
+                __m256 sz = _mm256_sub_ps(p.oz, _mm256_set1_ps(t.v0.z));
+                __m256 u = _mm256_mul_ps(f, _mm256_fmadd_ps(sx, hx, _mm256_fmadd_ps(sy, hy, _mm256_mul_ps(sz, hz))));
+
+                // q = s x e1
+                __m256 qx = _mm256_fmsub_ps(sy, e1z, _mm256_mul_ps(sz, e1y));
+                __m256 qy = _mm256_fmsub_ps(sz, e1x, _mm256_mul_ps(sx, e1z));
+                __m256 qz = _mm256_fmsub_ps(sx, e1y, _mm256_mul_ps(sy, e1x));
+                __m256 v = _mm256_mul_ps(f, _mm256_fmadd_ps(p.dx, qx, _mm256_fmadd_ps(p.dy, qy, _mm256_mul_ps(p.dz, qz))));
+                __m256 dist = _mm256_mul_ps(f, _mm256_fmadd_ps(e2x, qx, _mm256_fmadd_ps(e2y, qy, _mm256_mul_ps(e2z, qz))));
+
+                valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+                valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+                valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+                valid = _mm256_and_ps(valid, _mm256_cmp_ps(dist, hit_eps, _CMP_GT_OQ));
+                valid = _mm256_and_ps(valid, _mm256_cmp_ps(dist, p.t, _CMP_LT_OQ));
+                valid = _mm256_and_ps(valid, p.active);
+
+                p.t = _mm256_blendv_ps(p.t, dist, valid);
+                p.tri = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(p.tri),
+                    _mm256_castsi256_ps(_mm256_set1_epi32((int)tri_ids[i])), valid));
+            }
+            continue;
+        }
+
+        uint32_t c0 = n.left_first, c1 = n.left_first + 1;
+        __m256 n0, n1;
+        __m256 m0 = slab8(nodes[c0], p, n0);
+        __m256 m1 = slab8(nodes[c1], p, n1);
+        bool h0 = _mm256_movemask_ps(m0) != 0;
+        bool h1 = _mm256_movemask_ps(m1) != 0;
+
+        if (h0 && h1) {
+            if (nearest_lane(n0, m0) > nearest_lane(n1, m1))
+                std::swap(c0, c1);
+            stack[sp++] = c1;
+            stack[sp++] = c0;
+        }
+        else if (h0) {
+            stack[sp++] = c0;
+        }
+        else if (h1) {
+            stack[sp++] = c1;
+        }
+    }
+#endif
+}
+
+// ----------------------------------------------------------------------------------------------
+// top level
+
+void Bvh_scene::build(const std::vector<Util::aabb>& bounds, const std::vector<glm::mat4>& world_to_local, const std::vector<const Bvh_mesh*>& meshes) {
+    assert(bounds.size() == world_to_local.size() && bounds.size() == meshes.size());
+
+    std::vector<build_prim> prims(bounds.size());
+    for (size_t i = 0; i < bounds.size(); i++) {
+        prims[i].bounds = bounds[i];
+        prims[i].centroid = 0.5f * (bounds[i].min + bounds[i].max);
+    }
+
+    build_nodes(nodes, order, prims, SCENE_MAX_LEAF);
+    instance_world_to_local = world_to_local;
+    instance_meshes = meshes;
+}
+
+void Bvh_scene::refit(const std::vector<Util::aabb>& bounds, const std::vector<glm::mat4>& world_to_local) {
+    assert(bounds.size() == instance_meshes.size());
+    instance_world_to_local = world_to_local;
+
+    for (size_t i = nodes.size(); i-- > 0;) {
+        bvh_node& n = nodes[i];
+        Util::aabb b = empty_aabb();
+        if (n.count) {
+            for (uint32_t j = n.left_first; j < n.left_first + n.count; j++)
+                grow(b, bounds[order[j]]);
+        }
+        else {
+            const bvh_node& l = nodes[n.left_first];
+            const bvh_node& r = nodes[n.left_first + 1];
+            b.min = glm::min(l.min, r.min);
+            b.max = glm::max(l.max, r.max);
+        }
+        n.min = b.min;
+        n.max = b.max;
+    }
+}
+
+void Bvh_scene::clear() {
+    nodes.clear();
+    order.clear();
+    instance_world_to_local.clear();
+    instance_meshes.clear();
+}
+
+bool Bvh_scene::intersect(const Bvh_ray& ray, Bvh_hit& hit) const {
+    if (nodes.empty())
+        return false;
+
+    __m128 origin = load_vec3(ray.origin);
+    __m128 inv_dir = load_vec3(safe_inverse(ray.dir));
+    float t_best = std::min(ray.t_max, hit.t);
+    bool found = false;
+
+    struct entry { uint32_t node; float dist; };
+    entry stack[64];
+    int sp = 0;
+
+    float d = slab(nodes[0], origin, inv_dir, t_best);
+    if (d == FLT_MAX)
+        return false;
+    stack[sp++] = { 0, d };
+
+    while (sp) {
+        entry e = stack[--sp];
+        if (e.dist >= t_best)
+            continue;
+
+        const bvh_node& n = nodes[e.node];
+        if (n.count) {
+            for (uint32_t i = n.left_first; i < n.left_first + n.count; i++) {
+                uint32_t instance = order[i];
+                const Bvh_mesh* mesh = instance_meshes[instance];
+                if (!mesh || mesh->empty())
+                    continue;
+
+                Bvh_ray local = transform_ray(ray, instance_world_to_local[instance]);
+                local.t_max = t_best;
+                Bvh_hit local_hit;
+                if (mesh->intersect(local, local_hit)) {
+                    t_best = local_hit.t;
+                    hit.t = local_hit.t;
+                    hit.tri = local_hit.tri;
+                    hit.instance = instance;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        uint32_t c0 = n.left_first, c1 = n.left_first + 1;
+        float d0 = slab(nodes[c0], origin, inv_dir, t_best);
+        float d1 = slab(nodes[c1], origin, inv_dir, t_best);
+        if (d0 > d1) {
+            std::swap(d0, d1);
+            std::swap(c0, c1);
+        }
+        if (d1 != FLT_MAX)
+            stack[sp++] = { c1, d1 };
+        if (d0 != FLT_MAX)
+            stack[sp++] = { c0, d0 };
+    }
+
+    return found;
+}
+
+void Bvh_scene::intersect(const Bvh_ray* rays, Bvh_hit* hits, size_t count) const {
+    for (size_t i = 0; i < count; i += BVH_PACKET_SIZE) {
+        int n = (int)std::min<size_t>(BVH_PACKET_SIZE, count - i);
+        intersect_packet(rays + i, hits + i, n);
+    }
+}
+
+void Bvh_scene::intersect_packet(const Bvh_ray* rays, Bvh_hit* hits, int count) const {
+#if defined(__AVX2__) && defined(__FMA__)
+    if (nodes.empty())
+        return;
+
+    bvh_packet p = load_packet(rays, count);
+    alignas(32) float t_in[8];
+    for (int i = 0; i < BVH_PACKET_SIZE; i++)
+        t_in[i] = i < count ? std::min(rays[i].t_max, hits[i].t) : 0.0f;
+    p.t = _mm256_load_ps(t_in);
+
+    uint32_t stack[64];
+    int sp = 0;
+
+    __m256 t_near;
+    if (_mm256_movemask_ps(slab8(nodes[0], p, t_near)))
+        stack[sp++] = 0;
+
+    while (sp) {
+        const bvh_node& n = nodes[stack[--sp]];
+
+        if (n.count) {
+            for (uint32_t i = n.left_first; i < n.left_first + n.count; i++) {
+                uint32_t instance = order[i];
+                const Bvh_mesh* mesh = instance_meshes[instance];
+                if (!mesh || mesh->empty())
+                    continue;
+
+                // move the whole packet into model space
+                const glm::mat4& m = instance_world_to_local[instance];
+                bvh_packet local = p;
+                local.ox = _mm256_fmadd_ps(_mm256_set1_ps(m[0][0]), p.ox, _mm256_fmadd_ps(_mm256_set1_ps(m[1][0]), p.oy, _mm256_fmadd_ps(_mm256_set1_ps(m[2][0]), p.oz, _mm256_set1_ps(m[3][0]))));
+                local.oy = _mm256_fmadd_ps(_mm256_set1_ps(m[0][1]), p.ox, _mm256_fmadd_ps(_mm256_set1_ps(m[1][1]), p.oy, _mm256_fmadd_ps(_mm256_set1_ps(m[2][1]), p.oz, _mm256_set1_ps(m[3][1]))));
+                local.oz = _mm256_fmadd_ps(_mm256_set1_ps(m[0][2]), p.ox, _mm256_fmadd_ps(_mm256_set1_ps(m[1][2]), p.oy, _mm256_fmadd_ps(_mm256_set1_ps(m[2][2]), p.oz, _mm256_set1_ps(m[3][2]))));
+                local.dx = _mm256_fmadd_ps(_mm256_set1_ps(m[0][0]), p.dx, _mm256_fmadd_ps(_mm256_set1_ps(m[1][0]), p.dy, _mm256_mul_ps(_mm256_set1_ps(m[2][0]), p.dz)));
+                local.dy = _mm256_fmadd_ps(_mm256_set1_ps(m[0][1]), p.dx, _mm256_fmadd_ps(_mm256_set1_ps(m[1][1]), p.dy, _mm256_mul_ps(_mm256_set1_ps(m[2][1]), p.dz)));
+                local.dz = _mm256_fmadd_ps(_mm256_set1_ps(m[0][2]), p.dx, _mm256_fmadd_ps(_mm256_set1_ps(m[1][2]), p.dy, _mm256_mul_ps(_mm256_set1_ps(m[2][2]), p.dz)));
+                local.finish_setup();
+                local.tri = _mm256_set1_epi32(-1);
+
+                mesh->trace_packet(local);
+
+                __m256 found = _mm256_castsi256_ps(_mm256_cmpgt_epi32(local.tri, _mm256_set1_epi32(-1)));
+                p.t = _mm256_blendv_ps(p.t, local.t, found);
+                p.tri = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(p.tri), _mm256_castsi256_ps(local.tri), found));
+                p.instance = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(p.instance),
+                    _mm256_castsi256_ps(_mm256_set1_epi32((int)instance)), found));
+            }
+            continue;
+        }
+
+        uint32_t c0 = n.left_first, c1 = n.left_first + 1;
+        __m256 n0, n1;
+        __m256 m0 = slab8(nodes[c0], p, n0);
+        __m256 m1 = slab8(nodes[c1], p, n1);
+        bool h0 = _mm256_movemask_ps(m0) != 0;
+        bool h1 = _mm256_movemask_ps(m1) != 0;
+
+        if (h0 && h1) {
+            if (nearest_lane(n0, m0) > nearest_lane(n1, m1))
+                std::swap(c0, c1);
+            stack[sp++] = c1;
+            stack[sp++] = c0;
+        }
+        else if (h0) {
+            stack[sp++] = c0;
+        }
+        else if (h1) {
+            stack[sp++] = c1;
+        }
+    }
+
+    alignas(32) float t_out[8];
+    alignas(32) int32_t tri_out[8], instance_out[8];
+    _mm256_store_ps(t_out, p.t);
+    _mm256_store_si256((__m256i*)tri_out, p.tri);
+    _mm256_store_si256((__m256i*)instance_out, p.instance);
+    for (int i = 0; i < count; i++) {
+        if (instance_out[i] != -1) {
+            hits[i].t = t_out[i];
+            hits[i].tri = (uint32_t)tri_out[i];
+            hits[i].instance = (uint32_t)instance_out[i];
+        }
+    }
+#else
+    for (int i = 0; i < count; i++)
+        intersect(rays[i], hits[i]);
+#endif
+}
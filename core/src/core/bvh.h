@@ -0,0 +1,105 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <cstdint>
+#include <cfloat>
+
+#include <glm/glm.hpp>
+
+#include "util/aabb.h"
+
+// two level acceleration structure for ray queries
+//   Bvh_mesh  - bottom level, triangles of one model, built once at load and shared by every instance
+//   Bvh_scene - top level, entity world aabbs, rebuilt when entities are added and refit when they move
+// batched queries trace packets of 8 rays at a time (avx2), single rays use sse slab tests
+
+constexpr uint32_t BVH_INVALID = 0xFFFFFFFF;
+constexpr int BVH_PACKET_SIZE = 8;
+
+struct bvh_packet; // simd ray packet, only defined in bvh.cpp
+
+struct Bvh_ray {
+    glm::vec3 origin;
+    glm::vec3 dir;
+    float t_max = FLT_MAX;
+};
+
+struct Bvh_hit {
+    float t = FLT_MAX;
+    uint32_t tri = BVH_INVALID;      // triangle index in the model (original order)
+    uint32_t instance = BVH_INVALID; // instance index in the scene
+
+    bool hit() const { return tri != BVH_INVALID; }
+};
+
+// 32 bytes, two per cache line
+struct bvh_node {
+    glm::vec3 min;
+    uint32_t left_first; // interior: index of left child (right is left + 1), leaf: first primitive
+    glm::vec3 max;
+    uint32_t count;      // 0 for interior nodes
+};
+
+class Bvh_mesh {
+public:
+    // positions / indices of every mesh in a model, indices are already offset into positions
+    void build(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices);
+    void clear();
+
+    bool empty() const { return nodes.empty(); }
+    Util::aabb bounds() const;
+
+    // ray is in model space, hit.t is only overwritten when a closer hit is found
+    bool intersect(const Bvh_ray& ray, Bvh_hit& hit) const;
+    // up to BVH_PACKET_SIZE rays, lanes past count are ignored
+    void intersect_packet(const Bvh_ray* rays, Bvh_hit* hits, int count) const;
+
+    size_t triangle_count() const { return tri_ids.size(); }
+    size_t node_count() const { return nodes.size(); }
+    size_t memory_bytes() const { return nodes.size() * sizeof(bvh_node) + tris.size() * sizeof(tri) + tri_ids.size() * sizeof(uint32_t); }
+
+    // flat arrays for cooked models (asset/cooked_mesh.h), a triangle is TRI_FLOATS floats: v0, e1, e2
+    static const size_t TRI_FLOATS = 9;
+    const std::vector<bvh_node>& get_nodes() const { return nodes; }
+    const float* tri_data() const { return (const float*)tris.data(); }
+    const std::vector<uint32_t>& get_tri_ids() const { return tri_ids; }
+    void assign(const bvh_node* src_nodes, size_t node_count, const float* src_tris, const uint32_t* src_tri_ids, size_t tri_count);
+
+private:
+    friend class Bvh_scene;
+    void trace_packet(bvh_packet& p) const;
+
+    // triangles stored in leaf order with precomputed edges for moller trumbore
+    struct tri {
+        glm::vec3 v0, e1, e2;
+    };
+
+    std::vector<bvh_node> nodes;
+    std::vector<tri> tris;
+    std::vector<uint32_t> tri_ids; // leaf order -> original triangle index
+};
+
+class Bvh_scene {
+public:
+    // world aabbs, world to local matrices and bottom level bvh per instance, arrays are parallel
+    void build(const std::vector<Util::aabb>& bounds, const std::vector<glm::mat4>& world_to_local, const std::vector<const Bvh_mesh*>& meshes);
+    // same instances, new transforms, keeps the tree topology
+    void refit(const std::vector<Util::aabb>& bounds, const std::vector<glm::mat4>& world_to_local);
+    void clear();
+
+    size_t instance_count() const { return instance_meshes.size(); }
+
+    bool intersect(const Bvh_ray& ray, Bvh_hit& hit) const;
+    // any number of rays, traced in packets of BVH_PACKET_SIZE
+    void intersect(const Bvh_ray* rays, Bvh_hit* hits, size_t count) const;
+
+private:
+    void intersect_packet(const Bvh_ray* rays, Bvh_hit* hits, int count) const;
+
+    std::vector<bvh_node> nodes;
+    std::vector<uint32_t> order; // leaf order -> instance index
+    std::vector<glm::mat4> instance_world_to_local;
+    std::vector<const Bvh_mesh*> instance_meshes;
+};
+#endif
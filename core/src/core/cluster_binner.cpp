@@ -0,0 +1,121 @@
+#include "cluster_binner.h"
+
+#include <atomic>
+#include <cmath>
+
+#include <immintrin.h>
+
+#include "jobs.h"
+
+static_assert(sizeof(cluster_bounds) == 32, "cluster_bounds has to match the std430 layout");
+static_assert(sizeof(point_light) == 48, "point_light has to match the std430 layout");
+
+// far enough that the squared distance overflows to inf, so padding lanes never pass the radius test
+static const float PAD_POSITION = 1e30f;
+static const size_t BIN_BATCH = 64; // clusters per job
+
+void Cluster_binner::build_bounds(const glm::mat4& projection, float near_plane, float far_plane, int width, int height, std::vector<cluster_bounds>& bounds) {
+    glm::mat4 inverse_projection = glm::inverse(projection);
+    glm::vec2 screen((float)width, (float)height);
+    glm::vec2 tile_size = screen / glm::vec2(CLUSTER_X, CLUSTER_Y);
+
+    auto screen_to_view = [&](glm::vec2 p) {
+        glm::vec4 v = inverse_projection * glm::vec4(p / screen * 2.0f - 1.0f, -1.0f, 1.0f);
+        return glm::vec3(v) / v.w;
+    };
+    // ray from the eye through p, hit with the plane z = -depth
+    auto at_depth = [](glm::vec3 p, float depth) { return p * (depth / -p.z); };
+
+    bounds.resize(CLUSTER_COUNT);
+    for (unsigned int z = 0; z < CLUSTER_Z; z++) {
+        float plane_near = near_plane * std::pow(far_plane / near_plane, z / (float)CLUSTER_Z);
+        float plane_far = near_plane * std::pow(far_plane / near_plane, (z + 1) / (float)CLUSTER_Z);
+        for (unsigned int y = 0; y < CLUSTER_Y; y++) {
+            for (unsigned int x = 0; x < CLUSTER_X; x++) {
+                glm::vec3 tile_min = screen_to_view(glm::vec2(x, y) * tile_size);
+                glm::vec3 tile_max = screen_to_view(glm::vec2(x + 1, y + 1) * tile_size);
+
+                glm::vec3 min_near = at_depth(tile_min, plane_near), min_far = at_depth(tile_min, plane_far);
+                glm::vec3 max_near = at_depth(tile_max, plane_near), max_far = at_depth(tile_max, plane_far);
+
+                cluster_bounds& b = bounds[x + y * CLUSTER_X + z * CLUSTER_X * CLUSTER_Y];
+                b.min = glm::vec4(glm::min(glm::min(min_near, min_far), glm::min(max_near, max_far)), 0.0f);
+                b.max = glm::vec4(glm::max(glm::max(min_near, min_far), glm::max(max_near, max_far)), 0.0f);
+            }
+        }
+    }
+}
+
+uint32_t Cluster_binner::bin(const std::vector<cluster_bounds>& bounds, const std::vector<point_light>& lights, const glm::mat4& view) {
+    counts.assign(CLUSTER_COUNT, 0);
+    indices.resize(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER);
+
+    // view space spheres, the padded tail sits at infinity
+    size_t count = lights.size();
+    size_t padded = (count + 7) & ~size_t(7);
+    light_x.assign(padded, PAD_POSITION);
+    light_y.assign(padded, PAD_POSITION);
+    light_z.assign(padded, PAD_POSITION);
+    light_r.assign(padded, 0.0f);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 p = glm::vec3(view * glm::vec4(glm::vec3(lights[i].position_radius), 1.0f));
+        light_x[i] = p.x;
+        light_y[i] = p.y;
+        light_z[i] = p.z;
+        light_r[i] = lights[i].position_radius.w;
+    }
+
+    std::atomic<uint32_t> overflowed{ 0 };
+    Jobs::parallel_for(CLUSTER_COUNT, BIN_BATCH, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            const cluster_bounds& b = bounds[c];
+            uint32_t* out = &indices[c * MAX_LIGHTS_PER_CLUSTER];
+            uint32_t n = 0;
+            bool full = false;
+
+            size_t i = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+            const __m256 min_x = _mm256_set1_ps(b.min.x), max_x = _mm256_set1_ps(b.max.x);
+            const __m256 min_y = _mm256_set1_ps(b.min.y), max_y = _mm256_set1_ps(b.max.y);
+            const __m256 min_z = _mm256_set1_ps(b.min.z), max_z = _mm256_set1_ps(b.max.z);
+            for (; i < padded && !full; i += 8) {
+                // distance from the center to the closest point of the box
+                __m256 x = _mm256_loadu_ps(&light_x[i]);
+                __m256 y = _mm256_loadu_ps(&light_y[i]);
+                __m256 z = _mm256_loadu_ps(&light_z[i]);
+                __m256 dx = _mm256_sub_ps(x, _mm256_min_ps(_mm256_max_ps(x, min_x), max_x));
+                __m256 dy = _mm256_sub_ps(y, _mm256_min_ps(_mm256_max_ps(y, min_y), max_y));
+                __m256 dz = _mm256_sub_ps(z, _mm256_min_ps(_mm256_max_ps(z, min_z), max_z));
+                __m256 d2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+                __m256 r = _mm256_loadu_ps(&light_r[i]);
+                int hit = _mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(r, r), _CMP_LE_OQ));
+
+                for (int lane = 0; hit; lane++, hit >>= 1) {
+                    if (!(hit & 1))
+                        continue;
+                    if (n == MAX_LIGHTS_PER_CLUSTER) {
+                        full = true;
+                        break;
+                    }
+                    out[n++] = (uint32_t)(i + lane);
+                }
+            }
+#endif
+            for (; i < count && !full; i++) {
+                glm::vec3 p(light_x[i], light_y[i], light_z[i]);
+                glm::vec3 d = p - glm::clamp(p, glm::vec3(b.min), glm::vec3(b.max));
+                if (glm::dot(d, d) > light_r[i] * light_r[i])
+                    continue;
+                if (n == MAX_LIGHTS_PER_CLUSTER)
+                    full = true;
+                else
+                    out[n++] = (uint32_t)i;
+            }
+
+            counts[c] = n;
+            if (full)
+                overflowed++;
+        }
+    });
+    return overflowed;
+}
@@ -0,0 +1,46 @@
+#ifndef CLUSTER_BINNER_H
+#define CLUSTER_BINNER_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// the cluster grid and the cpu side of light binning, no gl so it runs without a context
+// Clustered_lights uploads what it makes, the compute shaders build the same thing on the gpu
+
+const unsigned int CLUSTER_X = 16;
+const unsigned int CLUSTER_Y = 9;
+const unsigned int CLUSTER_Z = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+const unsigned int MAX_LIGHTS_PER_CLUSTER = 128; // cluster_cull.comp has the same define
+
+// std430 layouts
+struct cluster_bounds {
+    glm::vec4 min;
+    glm::vec4 max;
+};
+
+struct point_light {
+    glm::vec4 position_radius;  // world space
+    glm::vec4 color_intensity;
+    glm::ivec4 shadow;          // x first shadow atlas record, -1 unshadowed
+};
+
+// 8 lights per cluster test with avx2, clusters split over the job system
+class Cluster_binner {
+public:
+    // view space boxes of the grid, same as compute/cluster.comp
+    static void build_bounds(const glm::mat4& projection, float near_plane, float far_plane, int width, int height, std::vector<cluster_bounds>& bounds);
+    // fills counts (one per cluster) and indices (MAX_LIGHTS_PER_CLUSTER slots per cluster, into lights)
+    // bounds has CLUSTER_COUNT boxes, returns how many clusters were full and dropped lights
+    uint32_t bin(const std::vector<cluster_bounds>& bounds, const std::vector<point_light>& lights, const glm::mat4& view);
+
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> indices;
+
+private:
+    // view space spheres, padded to a multiple of 8 with spheres at infinity so the tail never hits
+    std::vector<float> light_x, light_y, light_z, light_r;
+};
+#endif
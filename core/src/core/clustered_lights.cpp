@@ -0,0 +1,149 @@
+#include "clustered_lights.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "light.h"
+
+static unsigned int make_ssbo(size_t size) {
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    return buffer;
+}
+
+void Clustered_lights::init() {
+    bounds_buffer = make_ssbo(CLUSTER_COUNT * sizeof(cluster_bounds));
+    grid_buffer = make_ssbo(CLUSTER_COUNT * sizeof(uint32_t));
+    index_buffer = make_ssbo(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t));
+    light_capacity = 64;
+    light_buffer = make_ssbo(light_capacity * sizeof(point_light));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    compute_ok = GLAD_GL_VERSION_4_3 &&
+        build_shader.init("../resources/shaders/compute/cluster.comp") &&
+        cull_shader.init("../resources/shaders/compute/cluster_cull.comp");
+    if (!compute_ok) {
+        printf("[CLUSTER] no compute, binning lights on the cpu\n");
+        use_compute = false;
+    }
+}
+
+void Clustered_lights::shutdown() {
+    glDeleteBuffers(1, &bounds_buffer);
+    glDeleteBuffers(1, &light_buffer);
+    glDeleteBuffers(1, &grid_buffer);
+    glDeleteBuffers(1, &index_buffer);
+    bounds_buffer = light_buffer = grid_buffer = index_buffer = 0;
+    if (build_shader.ID) glDeleteProgram(build_shader.ID);
+    if (cull_shader.ID) glDeleteProgram(cull_shader.ID);
+}
+
+void Clustered_lights::set_projection(const glm::mat4& proj, float near_p, float far_p, int w, int h) {
+    if (w <= 0 || h <= 0)
+        return; // minimized
+    if (proj == projection && near_p == near_plane && far_p == far_plane && w == width && h == height)
+        return;
+    projection = proj;
+    near_plane = near_p;
+    far_plane = far_p;
+    width = w;
+    height = h;
+    bounds_dirty = cpu_bounds_dirty = true;
+}
+
+void Clustered_lights::fill_block(light_block& block) const {
+    // slice = log(z) * scale - bias, the inverse of near * (far / near)^(slice / CLUSTER_Z)
+    float log_ratio = std::log(far_plane / near_plane);
+    block.cluster_grid = glm::uvec4(CLUSTER_X, CLUSTER_Y, CLUSTER_Z, MAX_LIGHTS_PER_CLUSTER);
+    block.cluster_params = glm::vec4((float)width / CLUSTER_X, (float)height / CLUSTER_Y,
+                                     CLUSTER_Z / log_ratio, CLUSTER_Z * std::log(near_plane) / log_ratio);
+}
+
+void Clustered_lights::update(const std::vector<Light>& lights, const glm::mat4& view) {
+    auto start = std::chrono::steady_clock::now();
+
+    gpu_lights.clear();
+    for (const Light& l : lights)
+        if (l.type == POINT)
+            gpu_lights.push_back({ glm::vec4(l.position, l.radius), glm::vec4(l.color, l.intensity), glm::ivec4(l.shadow_record, 0, 0, 0) });
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, light_buffer);
+    if (gpu_lights.size() > light_capacity) {
+        while (light_capacity < gpu_lights.size())
+            light_capacity *= 2;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, light_capacity * sizeof(point_light), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpu_lights.size() * sizeof(point_light), gpu_lights.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BOUNDS_BINDING, bounds_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_BINDING, light_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_GRID_BINDING, grid_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_BINDING, index_buffer);
+
+    stats = cluster_stats();
+    stats.lights = (uint32_t)gpu_lights.size();
+
+    if (use_compute && compute_ok)
+        bin_compute(view);
+    else
+        bin_cpu(view);
+
+    stats.bin_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Clustered_lights::bin_compute(const glm::mat4& view) {
+    if (bounds_dirty) {
+        build_shader.use();
+        build_shader.setFloat("near_plane", near_plane);
+        build_shader.setFloat("far_plane", far_plane);
+        build_shader.setMat4("inverse_projection", glm::inverse(projection));
+        build_shader.setUvec3("grid_size", glm::uvec3(CLUSTER_X, CLUSTER_Y, CLUSTER_Z));
+        build_shader.setVec2("screen_size", glm::vec2(width, height));
+        build_shader.dispatch(CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+        build_shader.memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        bounds_dirty = false;
+    }
+
+    // one invocation per cluster, 128 per group (cluster_cull.comp LOCAL_SIZE)
+    cull_shader.use();
+    cull_shader.setMat4("view", view);
+    cull_shader.setUint("light_count", stats.lights);
+    cull_shader.setUint("cluster_count", CLUSTER_COUNT);
+    cull_shader.dispatch((CLUSTER_COUNT + 127) / 128, 1, 1);
+    cull_shader.memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void Clustered_lights::bin_cpu(const glm::mat4& view) {
+    if (cpu_bounds_dirty) {
+        Cluster_binner::build_bounds(projection, near_plane, far_plane, width, height, bounds);
+        cpu_bounds_dirty = false;
+    }
+    stats.overflowed = binner.bin(bounds, gpu_lights, view);
+
+    const std::vector<uint32_t>& counts = binner.counts;
+    uint32_t total = 0;
+    for (uint32_t n : counts) {
+        total += n;
+        stats.max_per_cluster = std::max(stats.max_per_cluster, n);
+    }
+    stats.average_per_cluster = (float)total / CLUSTER_COUNT;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, grid_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, counts.size() * sizeof(uint32_t), counts.data());
+    // nothing past the last lit cluster needs to go up
+    if (total) {
+        size_t last = CLUSTER_COUNT;
+        while (last && !counts[last - 1])
+            last--;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, index_buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, ((last - 1) * MAX_LIGHTS_PER_CLUSTER + counts[last - 1]) * sizeof(uint32_t), binner.indices.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
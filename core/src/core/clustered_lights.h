@@ -0,0 +1,87 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "frame_uniforms.h"
+#include "cluster_binner.h"
+#include "util/shader_compute.h"
+
+class Light;
+
+// clustered forward point lights
+//   the camera frustum is split into a CLUSTER_X * CLUSTER_Y screen tile grid with CLUSTER_Z exponential depth slices,
+//   every cluster keeps a list of the lights whose sphere touches its view space box
+//   the pbr shader finds its cluster from gl_FragCoord and view depth and only loops that list,
+//   so per pixel cost is bounded by MAX_LIGHTS_PER_CLUSTER no matter how many lights the scene has
+//
+// binning runs in the compute shaders (compute/cluster.comp builds the boxes, compute/cluster_cull.comp the lists)
+// or on the cpu (Cluster_binner, no gl), both fill the same buffers
+//
+// ssbo bindings (1 is the instance buffer)
+//   2: cluster boxes, 3: lights, 4: light count per cluster, 5: light indices, MAX_LIGHTS_PER_CLUSTER slots per cluster
+
+const unsigned int CLUSTER_BOUNDS_BINDING = 2;
+const unsigned int POINT_LIGHT_BINDING = 3;
+const unsigned int LIGHT_GRID_BINDING = 4;
+const unsigned int LIGHT_INDEX_BINDING = 5;
+
+struct cluster_stats {
+    uint32_t lights = 0;
+    // only known on the cpu path, the compute path never reads the grid back
+    uint32_t max_per_cluster = 0;
+    uint32_t overflowed = 0;   // clusters that hit MAX_LIGHTS_PER_CLUSTER and dropped lights
+    float average_per_cluster = 0.0f;
+    float bin_ms = 0.0f;       // cpu time, just the dispatch on the compute path
+};
+
+class Clustered_lights {
+public:
+    // needs a gl context, falls back to the cpu binner when compute shaders are missing or dont build
+    void init();
+    void shutdown();
+
+    // camera projection and viewport, cluster boxes are rebuilt when any of them changes
+    void set_projection(const glm::mat4& projection, float near_plane, float far_plane, int width, int height);
+    // grid size and the depth slice constants the fragment shader needs
+    void fill_block(light_block& block) const;
+    // bins the POINT lights for this camera view, leaves every buffer bound
+    void update(const std::vector<Light>& lights, const glm::mat4& view);
+
+    bool has_compute() const { return compute_ok; }
+    const cluster_stats& get_stats() const { return stats; }
+
+    bool use_compute = true;
+
+private:
+    // runs the binner and uploads its lists
+    void bin_cpu(const glm::mat4& view);
+    void bin_compute(const glm::mat4& view);
+
+    Shader_compute build_shader;
+    Shader_compute cull_shader;
+    bool compute_ok = false;
+
+    glm::mat4 projection = glm::mat4(1.0f);
+    float near_plane = 0.1f;
+    float far_plane = 1.0f;
+    int width = 1, height = 1;
+    bool bounds_dirty = true;     // gpu boxes
+    bool cpu_bounds_dirty = true; // cpu copy, only rebuilt when the cpu binner runs
+
+    std::vector<cluster_bounds> bounds;
+    std::vector<point_light> gpu_lights;
+    Cluster_binner binner;
+
+    unsigned int bounds_buffer = 0;
+    unsigned int light_buffer = 0;
+    unsigned int grid_buffer = 0;
+    unsigned int index_buffer = 0;
+    uint32_t light_capacity = 0;
+
+    cluster_stats stats;
+};
+#endif
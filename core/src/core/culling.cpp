@@ -0,0 +1,67 @@
+#include "culling.h"
+
+#include <immintrin.h>
+
+namespace Culling {
+
+    void bounds_soa::resize(size_t count) {
+        min_x.resize(count); min_y.resize(count); min_z.resize(count);
+        max_x.resize(count); max_y.resize(count); max_z.resize(count);
+    }
+
+    void bounds_soa::set(size_t i, const Util::aabb& box) {
+        min_x[i] = box.min.x; min_y[i] = box.min.y; min_z[i] = box.min.z;
+        max_x[i] = box.max.x; max_y[i] = box.max.y; max_z[i] = box.max.z;
+    }
+
+    size_t cull(const Util::frustum& f, const bounds_soa& bounds, size_t begin, size_t end, std::vector<uint32_t>& visible) {
+        size_t before = visible.size();
+
+        // the corner furthest along a plane normal only depends on the normal's signs,
+        // so pick the min or max array per axis once per plane instead of per box
+        const float* xs[Util::PLANE_COUNT];
+        const float* ys[Util::PLANE_COUNT];
+        const float* zs[Util::PLANE_COUNT];
+        for (int p = 0; p < Util::PLANE_COUNT; p++) {
+            xs[p] = f.planes[p].x >= 0.0f ? bounds.max_x.data() : bounds.min_x.data();
+            ys[p] = f.planes[p].y >= 0.0f ? bounds.max_y.data() : bounds.min_y.data();
+            zs[p] = f.planes[p].z >= 0.0f ? bounds.max_z.data() : bounds.min_z.data();
+        }
+
+        size_t i = begin;
+#if defined(__AVX2__) && defined(__FMA__)
+        __m256 nx[Util::PLANE_COUNT], ny[Util::PLANE_COUNT], nz[Util::PLANE_COUNT], nd[Util::PLANE_COUNT];
+        for (int p = 0; p < Util::PLANE_COUNT; p++) {
+            nx[p] = _mm256_set1_ps(f.planes[p].x);
+            ny[p] = _mm256_set1_ps(f.planes[p].y);
+            nz[p] = _mm256_set1_ps(f.planes[p].z);
+            nd[p] = _mm256_set1_ps(f.planes[p].w);
+        }
+        const __m256 zero = _mm256_setzero_ps();
+
+        for (; i + 8 <= end; i += 8) {
+            int inside = 0xFF;
+            for (int p = 0; p < Util::PLANE_COUNT && inside; p++) {
+                __m256 d = _mm256_fmadd_ps(nx[p], _mm256_loadu_ps(xs[p] + i), nd[p]);
+                d = _mm256_fmadd_ps(ny[p], _mm256_loadu_ps(ys[p] + i), d);
+                d = _mm256_fmadd_ps(nz[p], _mm256_loadu_ps(zs[p] + i), d);
+                inside &= _mm256_movemask_ps(_mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+            }
+            // compact the surviving lanes
+            for (int lane = 0; inside; lane++, inside >>= 1)
+                if (inside & 1)
+                    visible.push_back((uint32_t)(i + lane));
+        }
+#endif
+        for (; i < end; i++) {
+            bool inside = true;
+            for (int p = 0; p < Util::PLANE_COUNT && inside; p++) {
+                const glm::vec4& pl = f.planes[p];
+                inside = pl.x * xs[p][i] + pl.y * ys[p][i] + pl.z * zs[p][i] + pl.w >= 0.0f;
+            }
+            if (inside)
+                visible.push_back((uint32_t)i);
+        }
+        return visible.size() - before;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <vector>
+#include <cstdint>
+
+#include "util/aabb.h"
+#include "util/frustum.h"
+
+// world space bounds kept as separate min / max arrays so 8 boxes test against a plane in a handful of instructions
+// the scene owns one (refreshed for whatever moved in Scene::update), each view culls into its own index list
+namespace Culling {
+    struct bounds_soa {
+        std::vector<float> min_x, min_y, min_z;
+        std::vector<float> max_x, max_y, max_z;
+
+        void resize(size_t count);
+        void set(size_t i, const Util::aabb& box);
+        size_t size() const { return min_x.size(); }
+    };
+
+    struct stats {
+        uint32_t tested = 0;
+        uint32_t visible = 0;
+    };
+
+    // appends the indices in [begin, end) whose box touches the frustum, returns how many were appended
+    size_t cull(const Util::frustum& f, const bounds_soa& bounds, size_t begin, size_t end, std::vector<uint32_t>& visible);
+}
+#endif
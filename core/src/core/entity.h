@@ -8,14 +8,13 @@
 
 #include "asset/model_ass.h"
 #include "asset/model_manager.h"
-#include "asset/shader.h"
 #include "util/aabb.h"
-#include "physics.h"
 
 //struct entity_creation {
 //    
 //};
 
+// spawn description, scene.include copies it into the packed entity store
 class Entity {
 public:
     //Entity(
@@ -54,29 +53,17 @@ public:
         float ttl = 0.0f,
         float max_ttl = 0.0f
     );
-    
-    virtual ~Entity();
 
-    glm::mat4 get_model_matrix() const;
-
-    void draw(const Shader* shader, bool shadow_pass = false);
-    bool collides(const glm::vec3& pos, const glm::vec3& dir, glm::vec3& hit_pos);
-    glm::vec3 get_physics_position();
-    Util::aabb get_aabb();
-
-// private:
-    Model_ass* model;
     model_handle model_id;
     glm::vec3 position;
     bool physics_enabled;
     glm::vec3 scale;
+    float mass;
+    glm::quat rotation;
     bool fade;
     float ttl;
     float max_ttl;
-    glm::quat rotation;
 
     Util::aabb aabb;
-    JPH::BodyID physics_id;
-
 };
 #endif
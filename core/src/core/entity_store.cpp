@@ -0,0 +1,358 @@
+#include "entity_store.h"
+
+#include <algorithm>
+#include <immintrin.h>
+
+// body user data layout: bit 63 marks an entity body, 62..56 archetype, 55..32 generation, 31..0 handle index
+static constexpr uint64_t ENTITY_BODY_BIT = 1ull << 63;
+static constexpr uint32_t GENERATION_MASK = 0xFFFFFF;
+
+uint64_t Entity_store::body_user_data(entity_handle h) const {
+    return ENTITY_BODY_BIT | ((uint64_t)(archetype & 0x7F) << 56) | ((uint64_t)(h.generation & GENERATION_MASK) << 32) | h.index;
+}
+
+entity_handle Entity_store::add(const Entity& desc) {
+    uint32_t slot;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+    else {
+        slot = (uint32_t)sparse.size();
+        sparse.push_back(0);
+        generations.push_back(0);
+    }
+
+    entity_handle h{ slot, generations[slot] };
+    sparse[slot] = (uint32_t)handles.size();
+
+    positions.push_back(desc.position);
+    rotations.push_back(desc.rotation);
+    prev_positions.push_back(desc.position);
+    prev_rotations.push_back(desc.rotation);
+    scales.push_back(desc.scale);
+    models.push_back(desc.model_id);
+    Model_manager::acquire(desc.model_id);
+    aabbs.push_back(desc.aabb);
+    physics_enabled.push_back(desc.physics_enabled);
+    physics_ids.push_back(desc.physics_enabled
+        ? Physics::addBox(desc.position, (desc.aabb.max - desc.aabb.min) * desc.scale, false, body_user_data(h))
+        : JPH::BodyID());
+    ttls.push_back(desc.ttl);
+    max_ttls.push_back(desc.max_ttl);
+    handles.push_back(h);
+    model_matrices.emplace_back(1.0f);
+    normal_matrices.emplace_back(1.0f);
+    lods.push_back(0);
+    dirty_flags.push_back(0);
+    moving_flags.push_back(0);
+    // static entities get their matrices composed once here and never again
+    mark_dirty(handles.size() - 1);
+
+    return h;
+}
+
+void Entity_store::remove(entity_handle h) {
+    int dense = dense_index(h);
+    if (dense == -1)
+        return;
+    remove_at((size_t)dense);
+}
+
+void Entity_store::remove_at(size_t dense) {
+    if (physics_enabled[dense])
+        Physics::removeBody(physics_ids[dense]);
+    Model_manager::release(models[dense]);
+
+    size_t last = handles.size() - 1;
+    entity_handle removed = handles[dense];
+
+    // the moving list stays exact, the removed entry leaves and the last one follows its move
+    if (moving_flags[dense]) {
+        auto it = std::find(moving_list.begin(), moving_list.end(), (uint32_t)dense);
+        if (it != moving_list.end()) {
+            *it = moving_list.back();
+            moving_list.pop_back();
+        }
+    }
+    if (dense != last && moving_flags[last]) {
+        auto it = std::find(moving_list.begin(), moving_list.end(), (uint32_t)last);
+        if (it != moving_list.end())
+            *it = (uint32_t)dense;
+    }
+
+    if (dense != last) {
+        positions[dense] = positions[last];
+        rotations[dense] = rotations[last];
+        prev_positions[dense] = prev_positions[last];
+        prev_rotations[dense] = prev_rotations[last];
+        scales[dense] = scales[last];
+        models[dense] = models[last];
+        aabbs[dense] = aabbs[last];
+        physics_ids[dense] = physics_ids[last];
+        physics_enabled[dense] = physics_enabled[last];
+        ttls[dense] = ttls[last];
+        max_ttls[dense] = max_ttls[last];
+        handles[dense] = handles[last];
+        model_matrices[dense] = model_matrices[last];
+        normal_matrices[dense] = normal_matrices[last];
+        lods[dense] = lods[last];
+        sparse[handles[dense].index] = (uint32_t)dense;
+        // dirty list keeps the old index, compose skips it since it is past the end
+        dirty_flags[dense] = 0;
+        if (dirty_flags[last])
+            mark_dirty(dense);
+        moving_flags[dense] = moving_flags[last];
+    }
+
+    positions.pop_back();
+    rotations.pop_back();
+    prev_positions.pop_back();
+    prev_rotations.pop_back();
+    scales.pop_back();
+    models.pop_back();
+    aabbs.pop_back();
+    physics_ids.pop_back();
+    physics_enabled.pop_back();
+    ttls.pop_back();
+    max_ttls.pop_back();
+    handles.pop_back();
+    model_matrices.pop_back();
+    normal_matrices.pop_back();
+    lods.pop_back();
+    dirty_flags.pop_back();
+    moving_flags.pop_back();
+
+    rest_changes++;
+    // bump so old handles to this slot go stale
+    generations[removed.index]++;
+    free_slots.push_back(removed.index);
+}
+
+size_t Entity_store::refresh_bounds() {
+    size_t changed = 0;
+    for (size_t i = 0; i < handles.size(); i++) {
+        Util::aabb b = Model_manager::get_aabb(models[i]);
+        if (b.min == aabbs[i].min && b.max == aabbs[i].max)
+            continue;
+        aabbs[i] = b;
+        if (physics_enabled[i]) {
+            glm::vec3 velocity = Physics::getBodyVelocity(physics_ids[i]);
+            Physics::removeBody(physics_ids[i]);
+            physics_ids[i] = Physics::addBox(positions[i], (b.max - b.min) * scales[i], false, body_user_data(handles[i]));
+            Physics::setBodyRotation(physics_ids[i], rotations[i]);
+            Physics::setBodyVelocity(physics_ids[i], velocity);
+        }
+        mark_dirty(i);
+        changed++;
+    }
+    if (changed)
+        rest_changes++;
+    return changed;
+}
+
+void Entity_store::clear() {
+    while (!handles.empty())
+        remove_at(handles.size() - 1);
+}
+
+bool Entity_store::alive(entity_handle h) const {
+    return h.index < generations.size() && generations[h.index] == h.generation && sparse[h.index] < handles.size()
+        && handles[sparse[h.index]] == h;
+}
+
+int Entity_store::dense_index(entity_handle h) const {
+    if (!alive(h))
+        return -1;
+    return (int)sparse[h.index];
+}
+
+void Entity_store::mark_dirty(size_t dense) {
+    if (dirty_flags[dense])
+        return;
+    dirty_flags[dense] = 1;
+    dirty_list.push_back((uint32_t)dense);
+}
+
+void Entity_store::set_transform(size_t dense, const glm::vec3& position, const glm::quat& rotation) {
+    positions[dense] = prev_positions[dense] = position;
+    rotations[dense] = prev_rotations[dense] = rotation;
+    mark_dirty(dense);
+}
+
+int Entity_store::resolve_body(uint64_t user_data) const {
+    if (!(user_data & ENTITY_BODY_BIT) || ((user_data >> 56) & 0x7F) != (archetype & 0x7F))
+        return -1;
+
+    uint32_t index = (uint32_t)user_data;
+    uint32_t generation = (uint32_t)(user_data >> 32) & GENERATION_MASK;
+    if (index >= sparse.size() || (generations[index] & GENERATION_MASK) != generation)
+        return -1;
+
+    uint32_t dense = sparse[index];
+    if (dense >= handles.size() || handles[dense].index != index)
+        return -1;
+    return (int)dense;
+}
+
+void Entity_store::apply_transforms(const Physics::transform_sync& sync) {
+    if (sync.ticked) {
+        // whatever was moving settles on its latest transform, the new movers are added back below
+        // 2 marks was moving until we know whether it still is
+        settling_list.clear();
+        for (uint32_t dense : moving_list) {
+            if (dense >= handles.size() || moving_flags[dense] != 1)
+                continue;
+            moving_flags[dense] = 2;
+            settling_list.push_back(dense);
+            prev_positions[dense] = positions[dense];
+            prev_rotations[dense] = rotations[dense];
+            mark_dirty(dense);
+        }
+        moving_list.clear();
+
+        for (const Physics::body_transform& t : sync.current) {
+            int dense = resolve_body(t.user_data);
+            if (dense == -1)
+                continue;
+
+            prev_positions[dense] = positions[dense];
+            prev_rotations[dense] = rotations[dense];
+            positions[dense] = t.position;
+            rotations[dense] = t.rotation;
+            if (moving_flags[dense] != 1) {
+                // woke up, it leaves the resting set
+                if (moving_flags[dense] == 0)
+                    rest_changes++;
+                moving_flags[dense] = 1;
+                moving_list.push_back((uint32_t)dense);
+            }
+        }
+
+        // fell asleep, compose below bumps rest_changes when it lands in the resting set
+        for (uint32_t dense : settling_list)
+            if (moving_flags[dense] == 2)
+                moving_flags[dense] = 0;
+
+        // exact pre tick state when several ticks ran this frame
+        for (const Physics::body_transform& t : sync.previous) {
+            int dense = resolve_body(t.user_data);
+            if (dense == -1 || !moving_flags[dense])
+                continue;
+            prev_positions[dense] = t.position;
+            prev_rotations[dense] = t.rotation;
+        }
+    }
+
+    // alpha changes every frame, so anything between two ticks is recomposed even without a new tick
+    for (uint32_t dense : moving_list)
+        if (dense < handles.size() && moving_flags[dense])
+            mark_dirty(dense);
+
+    compose_matrices(sync.alpha);
+}
+
+static glm::quat nlerp(const glm::quat& a, const glm::quat& b, float t) {
+    glm::quat b2 = glm::dot(a, b) < 0.0f ? -b : b;
+    return glm::normalize(glm::quat(
+        a.w + (b2.w - a.w) * t,
+        a.x + (b2.x - a.x) * t,
+        a.y + (b2.y - a.y) * t,
+        a.z + (b2.z - a.z) * t));
+}
+
+// model = T * R * S, normal = R * S^-1
+static void compose_one(const glm::vec3& p, const glm::quat& q, const glm::vec3& s, glm::mat4& model, glm::mat3& normal) {
+    glm::mat3 r = glm::mat3_cast(q);
+    for (int c = 0; c < 3; c++) {
+        model[c] = glm::vec4(r[c] * s[c], 0.0f);
+        normal[c] = r[c] / s[c];
+    }
+    model[3] = glm::vec4(p, 1.0f);
+}
+
+void Entity_store::compose_matrices(float alpha) {
+    changed_list.clear();
+    for (uint32_t dense : dirty_list) {
+        if (dense < handles.size() && dirty_flags[dense]) {
+            dirty_flags[dense] = 0;
+            changed_list.push_back(dense);
+            if (!moving_flags[dense])
+                rest_changes++;
+        }
+    }
+    dirty_list.clear();
+
+    size_t i = 0;
+#ifdef __AVX2__
+    // 8 entities per iteration, gather into soa, compose, scatter back
+    for (; i + 8 <= changed_list.size(); i += 8) {
+        alignas(32) float in[10][8];
+        for (int l = 0; l < 8; l++) {
+            uint32_t d = changed_list[i + l];
+            glm::vec3 p = glm::mix(prev_positions[d], positions[d], alpha);
+            glm::quat q = nlerp(prev_rotations[d], rotations[d], alpha);
+            in[0][l] = p.x; in[1][l] = p.y; in[2][l] = p.z;
+            in[3][l] = q.x; in[4][l] = q.y; in[5][l] = q.z; in[6][l] = q.w;
+            in[7][l] = scales[d].x; in[8][l] = scales[d].y; in[9][l] = scales[d].z;
+        }
+
+        __m256 qx = _mm256_load_ps(in[3]), qy = _mm256_load_ps(in[4]), qz = _mm256_load_ps(in[5]), qw = _mm256_load_ps(in[6]);
+        __m256 two = _mm256_set1_ps(2.0f), one = _mm256_set1_ps(1.0f);
+        __m256 xx = _mm256_mul_ps(qx, qx), yy = _mm256_mul_ps(qy, qy), zz = _mm256_mul_ps(qz, qz);
+        __m256 xy = _mm256_mul_ps(qx, qy), xz = _mm256_mul_ps(qx, qz), yz = _mm256_mul_ps(qy, qz);
+        __m256 wx = _mm256_mul_ps(qw, qx), wy = _mm256_mul_ps(qw, qy), wz = _mm256_mul_ps(qw, qz);
+
+        // rotation columns, same layout as glm::mat3_cast
+        __m256 r[3][3];
+        r[0][0] = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz)));
+        r[0][1] = _mm256_mul_ps(two, _mm256_add_ps(xy, wz));
+        r[0][2] = _mm256_mul_ps(two, _mm256_sub_ps(xz, wy));
+        r[1][0] = _mm256_mul_ps(two, _mm256_sub_ps(xy, wz));
+        r[1][1] = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz)));
+        r[1][2] = _mm256_mul_ps(two, _mm256_add_ps(yz, wx));
+        r[2][0] = _mm256_mul_ps(two, _mm256_add_ps(xz, wy));
+        r[2][1] = _mm256_mul_ps(two, _mm256_sub_ps(yz, wx));
+        r[2][2] = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)));
+
+        alignas(32) float m_out[3][3][8], n_out[3][3][8];
+        for (int c = 0; c < 3; c++) {
+            __m256 sc = _mm256_load_ps(in[7 + c]);
+            __m256 inv = _mm256_div_ps(one, sc);
+            for (int row = 0; row < 3; row++) {
+                _mm256_store_ps(m_out[c][row], _mm256_mul_ps(r[c][row], sc));
+                _mm256_store_ps(n_out[c][row], _mm256_mul_ps(r[c][row], inv));
+            }
+        }
+
+        for (int l = 0; l < 8; l++) {
+            uint32_t d = changed_list[i + l];
+            glm::mat4& m = model_matrices[d];
+            glm::mat3& n = normal_matrices[d];
+            for (int c = 0; c < 3; c++) {
+                m[c] = glm::vec4(m_out[c][0][l], m_out[c][1][l], m_out[c][2][l], 0.0f);
+                n[c] = glm::vec3(n_out[c][0][l], n_out[c][1][l], n_out[c][2][l]);
+            }
+            m[3] = glm::vec4(in[0][l], in[1][l], in[2][l], 1.0f);
+        }
+    }
+#endif
+    for (; i < changed_list.size(); i++) {
+        uint32_t d = changed_list[i];
+        compose_one(glm::mix(prev_positions[d], positions[d], alpha), nlerp(prev_rotations[d], rotations[d], alpha),
+            scales[d], model_matrices[d], normal_matrices[d]);
+    }
+}
+
+size_t Entity_store::tick_ttl(float dt) {
+    size_t removed = 0;
+    // walk backwards so the swapped in entity was already ticked
+    for (size_t i = handles.size(); i-- > 0;) {
+        ttls[i] -= dt;
+        if (ttls[i] <= 0.0f) {
+            remove_at(i);
+            removed++;
+        }
+    }
+    return removed;
+}
@@ -0,0 +1,106 @@
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "core/entity.h"
+#include "asset/model_manager.h"
+#include "util/aabb.h"
+#include "physics.h"
+
+// soa entity storage, one store per archetype (scene keeps static and timed entities apart)
+// every component array is indexed by the same dense index, removal swaps the last entity into the hole
+// handles stay valid across removals, a stale handle fails the generation check
+// model / normal matrices are only recomposed for entities that moved (physics sync or mark_dirty)
+// physics entities keep the transform before and after the last tick, matrices blend between them
+
+struct entity_handle {
+    uint32_t index = 0xFFFFFFFF; // slot in the sparse table, not the dense index
+    uint32_t generation = 0;
+
+    bool valid() const { return index != 0xFFFFFFFF; }
+    bool operator==(const entity_handle& o) const { return index == o.index && generation == o.generation; }
+    bool operator!=(const entity_handle& o) const { return !(*this == o); }
+};
+
+class Entity_store {
+public:
+    // archetype id is packed into the physics body user data so synced transforms find their store
+    Entity_store(uint32_t archetype = 0) : archetype(archetype) {}
+
+    // creates the physics body if the description asks for one, holds a reference on the model
+    entity_handle add(const Entity& desc);
+    // destroys the physics body and drops the model reference, O(1)
+    void remove(entity_handle h);
+    void remove_at(size_t dense);
+    void clear();
+
+    bool alive(entity_handle h) const;
+    // -1 if the handle is stale
+    int dense_index(entity_handle h) const;
+    size_t size() const { return handles.size(); }
+
+    const glm::mat4& model_matrix(size_t dense) const { return model_matrices[dense]; }
+    const glm::mat3& normal_matrix(size_t dense) const { return normal_matrices[dense]; }
+
+    // copies the synced body transforms that belong to this store, then recomposes everything dirty
+    // and everything still moving at the sync's interpolation alpha
+    void apply_transforms(const Physics::transform_sync& sync);
+    // teleport, no blending from the old transform
+    void set_transform(size_t dense, const glm::vec3& position, const glm::quat& rotation);
+    // transform was edited outside of physics, recomposed on the next apply
+    void mark_dirty(size_t dense);
+    // dense indices recomposed by the last apply_transforms
+    const std::vector<uint32_t>& changed() const { return changed_list; }
+    // body awake in jolt (moved during the last ticks), everything else is at rest
+    bool moving(size_t dense) const { return moving_flags[dense] != 0; }
+    // dense indices moving() is true for
+    const std::vector<uint32_t>& moving_entities() const { return moving_list; }
+    // bumped whenever the set of resting entities or one of their transforms changes,
+    // anything cached from resting entities only (static shadow layers) is stale once it moves
+    uint32_t rest_version() const { return rest_changes; }
+    // counts ttl down, removes whatever expired, returns the number removed
+    size_t tick_ttl(float dt);
+    // entities added while their model streamed in were sized from the placeholder, takes the real bounds
+    // and rebuilds their bodies. returns the number changed
+    size_t refresh_bounds();
+
+    // packed components
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> prev_positions; // before the last physics tick
+    std::vector<glm::quat> prev_rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<model_handle> models;
+    std::vector<Util::aabb> aabbs; // model space
+    std::vector<JPH::BodyID> physics_ids;
+    std::vector<uint8_t> physics_enabled;
+    std::vector<float> ttls;
+    std::vector<float> max_ttls;
+    std::vector<entity_handle> handles; // dense -> handle
+    std::vector<glm::mat4> model_matrices;
+    std::vector<glm::mat3> normal_matrices; // R * S^-1, no inverse needed
+    std::vector<uint8_t> lods; // camera lod picked last frame, the renderer keeps it for hysteresis
+
+private:
+    uint64_t body_user_data(entity_handle h) const;
+    int resolve_body(uint64_t user_data) const;
+    void compose_matrices(float alpha);
+
+    uint32_t archetype;
+    std::vector<uint32_t> dirty_list;
+    std::vector<uint8_t> dirty_flags;
+    std::vector<uint32_t> changed_list;
+    std::vector<uint32_t> moving_list; // moved during the last ticks, recomposed every frame
+    std::vector<uint32_t> settling_list;
+    std::vector<uint8_t> moving_flags;
+    uint32_t rest_changes = 0;
+    std::vector<uint32_t> sparse;      // handle index -> dense index
+    std::vector<uint32_t> generations; // handle index -> current generation
+    std::vector<uint32_t> free_slots;
+};
+#endif
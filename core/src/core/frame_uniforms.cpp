@@ -0,0 +1,50 @@
+#include "frame_uniforms.h"
+
+#include <cstring>
+
+#include <glad/glad.h>
+
+static_assert(sizeof(view_block) == 144, "view_block has to match the std140 layout");
+static_assert(sizeof(light_block) == 512, "light_block has to match the std140 layout");
+
+void Frame_uniforms::init(int view_count) {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    view_stride = (sizeof(view_block) + alignment - 1) / alignment * alignment;
+
+    views.assign(view_count, view_block());
+    staging.assign(view_stride * view_count, 0);
+
+    glGenBuffers(1, &view_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, view_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, staging.size(), nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &light_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, light_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(light_block), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Frame_uniforms::shutdown() {
+    glDeleteBuffers(1, &view_buffer);
+    glDeleteBuffers(1, &light_buffer);
+    view_buffer = light_buffer = 0;
+}
+
+void Frame_uniforms::upload() {
+    for (size_t i = 0; i < views.size(); i++)
+        memcpy(&staging[i * view_stride], &views[i], sizeof(view_block));
+
+    glBindBuffer(GL_UNIFORM_BUFFER, view_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, staging.size(), staging.data(), GL_DYNAMIC_DRAW);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, light_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(light_block), &lights, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, light_buffer);
+}
+
+void Frame_uniforms::bind_view(int i) const {
+    glBindBufferRange(GL_UNIFORM_BUFFER, VIEW_BLOCK_BINDING, view_buffer, i * view_stride, sizeof(view_block));
+}
@@ -0,0 +1,67 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "shadow_cascades.h"
+
+// per frame std140 uniform blocks shared by every scene shader
+//   view block (binding 0): one slot per view (camera, light views, editor views), all uploaded once per frame,
+//     a pass just binds its slot's range
+//   light block (binding 1): lights and the shadow matrices the pbr pass samples with
+// the structs mirror the glsl blocks, vec3s are followed by a float so they fill one 16 byte std140 slot
+
+const unsigned int VIEW_BLOCK_BINDING = 0;
+const unsigned int LIGHT_BLOCK_BINDING = 1;
+
+struct view_block {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 view_position;
+    float pad;
+};
+
+struct light_block {
+    glm::mat4 light_view;
+    glm::mat4 light_projection;
+    glm::mat4 cascade_matrices[CASCADE_COUNT]; // projection * view
+    glm::vec3 spot_light_position;
+    float spot_light_intensity;
+    glm::vec3 spot_light_direction;
+    float spot_light_inner_cone;
+    glm::vec3 spot_light_color;
+    float spot_light_outer_cone;
+    glm::vec3 directional_light_direction;
+    float directional_light_intensity;
+    glm::vec3 directional_light_color;
+    float pad;
+    glm::uvec4 cluster_grid;   // clusters x, y, z, max lights per cluster
+    glm::vec4 cluster_params;  // tile size in pixels, depth slice scale, depth slice bias
+    glm::vec4 cascade_splits;  // view space depth where each cascade ends
+};
+
+class Frame_uniforms {
+public:
+    // needs a gl context
+    void init(int view_count);
+    void shutdown();
+
+    view_block& view(int i) { return views[i]; }
+    light_block lights;
+
+    // one upload for every view and the lights, binds the light block
+    void upload();
+    // binds view i's range to VIEW_BLOCK_BINDING
+    void bind_view(int i) const;
+
+private:
+    std::vector<view_block> views;
+    std::vector<uint8_t> staging;
+    size_t view_stride = 0; // sizeof(view_block) rounded up to the ubo offset alignment
+    unsigned int view_buffer = 0;
+    unsigned int light_buffer = 0;
+};
+#endif
@@ -0,0 +1,41 @@
+#include "gbuffer.h"
+
+#include <glad/glad.h>
+
+void G_buffer::init() {
+    glGenVertexArrays(1, &empty_vao);
+}
+
+void G_buffer::shutdown() {
+    glDeleteVertexArrays(1, &empty_vao);
+    empty_vao = 0;
+}
+
+G_buffer::targets G_buffer::declare(Render_graph::builder& b, int width, int height) const {
+    targets t;
+    t.albedo_metallic = b.write_color(b.create("albedo_metallic", { width, height, GL_RGBA8 }), 0);
+    t.normal_roughness = b.write_color(b.create("normal_roughness", { width, height, GL_RGB10_A2 }), 1);
+    t.depth = b.write_depth(b.create("gbuffer_depth", { width, height, GL_DEPTH_COMPONENT32F }));
+    return t;
+}
+
+void G_buffer::read(Render_graph::builder& b, const targets& t) const {
+    b.read(t.albedo_metallic);
+    b.read(t.normal_roughness);
+    b.read(t.depth);
+}
+
+void G_buffer::bind_read(const Render_graph& graph, const targets& t, unsigned int first) const {
+    glActiveTexture(GL_TEXTURE0 + first);
+    glBindTexture(GL_TEXTURE_2D, graph.texture(t.albedo_metallic));
+    glActiveTexture(GL_TEXTURE0 + first + 1);
+    glBindTexture(GL_TEXTURE_2D, graph.texture(t.normal_roughness));
+    glActiveTexture(GL_TEXTURE0 + first + 2);
+    glBindTexture(GL_TEXTURE_2D, graph.texture(t.depth));
+}
+
+void G_buffer::draw_fullscreen() const {
+    glBindVertexArray(empty_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+}
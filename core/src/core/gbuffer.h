@@ -0,0 +1,46 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <cstdint>
+
+#include "render_graph.h"
+
+// packed g-buffer for the deferred path, 12 bytes a pixel against the old 24
+//   0: RGBA8     albedo, metallic
+//   1: RGB10_A2  octahedral normal (xy), roughness, a unused
+//   depth: 32F, sampled by the lighting pass to rebuild the world position so there is no position target
+//
+// the targets are render graph transients, they only hold memory between the geometry and lighting passes
+// and go back to the graph's pool after, the fbo comes from the graph too
+//
+// the lighting pass (deferred_light_f.glsl) is one fullscreen triangle that walks the same cluster light lists
+// as forward, so the cluster compute shaders double as the tiled light culling
+class G_buffer {
+public:
+    struct targets {
+        Render_graph::resource albedo_metallic;
+        Render_graph::resource normal_roughness;
+        Render_graph::resource depth;
+    };
+
+    // needs a gl context
+    void init();
+    void shutdown();
+
+    // creates the targets in the geometry pass and writes them as its attachments
+    targets declare(Render_graph::builder& b, int width, int height) const;
+    void read(Render_graph::builder& b, const targets& t) const;
+    // albedo_metallic, normal_roughness, depth on units first, first + 1, first + 2
+    void bind_read(const Render_graph& graph, const targets& t, unsigned int first) const;
+    // no vertex buffer, the vertex shader builds the triangle from gl_VertexID
+    void draw_fullscreen() const;
+
+    // color targets and depth
+    static const uint32_t BYTES_PER_PIXEL = 4 + 4 + 4;
+    // explicit position (RGBA16F), normal (RGBA16F), albedo/spec (RGBA8) and depth, the layout this replaced
+    static const uint32_t UNPACKED_BYTES_PER_PIXEL = 8 + 8 + 4 + 4;
+
+private:
+    unsigned int empty_vao = 0;
+};
+#endif
@@ -0,0 +1,341 @@
+#include "headless.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#ifdef GLOW_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace Headless {
+    static void print_usage() {
+        printf("[HEADLESS] usage: --headless [--frames n] [--warmup n] [--size wxh] [--step seconds] [--deferred]\n"
+               "           [--camera path.txt] [--timings out.csv] [--capture dir] [--capture-every n]\n"
+               "           [--golden dir] [--tolerance 0-255] [--max-changed fraction] [--trace out.json]\n");
+    }
+
+    bool parse_args(int argc, char** argv, options& out) {
+        for (int i = 1; i < argc; i++) {
+            const char* a = argv[i];
+            bool has_value = i + 1 < argc;
+            if (!strcmp(a, "--headless"))
+                out.enabled = true;
+            else if (!strcmp(a, "--deferred"))
+                out.deferred = true;
+            else if (!strcmp(a, "--frames") && has_value)
+                out.frames = atoi(argv[++i]);
+            else if (!strcmp(a, "--warmup") && has_value)
+                out.warmup = atoi(argv[++i]);
+            else if (!strcmp(a, "--size") && has_value) {
+                if (sscanf(argv[++i], "%dx%d", &out.width, &out.height) != 2) {
+                    print_usage();
+                    return false;
+                }
+            }
+            else if (!strcmp(a, "--step") && has_value)
+                out.time_step = (float)atof(argv[++i]);
+            else if (!strcmp(a, "--camera") && has_value)
+                out.camera_path = argv[++i];
+            else if (!strcmp(a, "--timings") && has_value)
+                out.timings = argv[++i];
+            else if (!strcmp(a, "--capture") && has_value)
+                out.capture_dir = argv[++i];
+            else if (!strcmp(a, "--capture-every") && has_value)
+                out.capture_every = atoi(argv[++i]);
+            else if (!strcmp(a, "--golden") && has_value)
+                out.golden_dir = argv[++i];
+            else if (!strcmp(a, "--tolerance") && has_value)
+                out.tolerance = atoi(argv[++i]);
+            else if (!strcmp(a, "--max-changed") && has_value)
+                out.max_changed = (float)atof(argv[++i]);
+            else if (!strcmp(a, "--trace") && has_value)
+                out.trace = argv[++i];
+            else {
+                printf("[HEADLESS] unknown argument %s\n", a);
+                print_usage();
+                return false;
+            }
+        }
+        if (out.frames <= 0 || out.width <= 0 || out.height <= 0 || out.time_step <= 0.0f) {
+            print_usage();
+            return false;
+        }
+        out.warmup = std::min(std::max(out.warmup, 0), out.frames - 1);
+        return true;
+    }
+
+#ifdef GLOW_EGL
+    static EGLDisplay display = EGL_NO_DISPLAY;
+    static EGLContext context = EGL_NO_CONTEXT;
+    static EGLSurface surface = EGL_NO_SURFACE;
+
+    static bool has_extension(const char* list, const char* name) {
+        if (!list)
+            return false;
+        size_t length = strlen(name);
+        for (const char* p = strstr(list, name); p; p = strstr(p + length, name)) {
+            if ((p == list || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+                return true;
+        }
+        return false;
+    }
+
+    // mesa's surfaceless platform first (no display server or drm master, llvmpipe when there is no gpu),
+    // then the egl devices for drivers without it
+    static EGLDisplay open_display() {
+        const char* client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (!get_platform_display)
+            return EGL_NO_DISPLAY;
+
+        if (has_extension(client, "EGL_MESA_platform_surfaceless")) {
+            EGLDisplay d = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (d != EGL_NO_DISPLAY && eglInitialize(d, NULL, NULL))
+                return d;
+        }
+
+        PFNEGLQUERYDEVICESEXTPROC query_devices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+        if (has_extension(client, "EGL_EXT_platform_device") && query_devices) {
+            EGLDeviceEXT devices[8];
+            EGLint count = 0;
+            query_devices(8, devices, &count);
+            for (EGLint i = 0; i < count; i++) {
+                EGLDisplay d = get_platform_display(EGL_PLATFORM_DEVICE_EXT, devices[i], NULL);
+                if (d != EGL_NO_DISPLAY && eglInitialize(d, NULL, NULL))
+                    return d;
+            }
+        }
+        return EGL_NO_DISPLAY;
+    }
+
+    bool create_context() {
+        display = open_display();
+        if (display == EGL_NO_DISPLAY) {
+            printf("[HEADLESS] no egl display, need EGL_MESA_platform_surfaceless or EGL_EXT_platform_device\n");
+            return false;
+        }
+
+        // the frames go to an offscreen fbo, the pbuffer bit only matters when surfaceless contexts arent there
+        const EGLint config_attribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+            EGL_DEPTH_SIZE, 24,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configs = 0;
+        if (!eglChooseConfig(display, config_attribs, &config, 1, &configs) || configs == 0) {
+            printf("[HEADLESS] no egl config with a pbuffer and desktop gl\n");
+            destroy_context();
+            return false;
+        }
+
+        // 4.3 for the instance ssbo
+        const EGLint context_attribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        eglBindAPI(EGL_OPENGL_API);
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+        if (context == EGL_NO_CONTEXT) {
+            printf("[HEADLESS] cant create a 4.3 core context (egl error 0x%x)\n", eglGetError());
+            destroy_context();
+            return false;
+        }
+
+        if (!has_extension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+            const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+            surface = eglCreatePbufferSurface(display, config, pbuffer_attribs);
+        }
+        if (!eglMakeCurrent(display, surface, surface, context)) {
+            printf("[HEADLESS] eglMakeCurrent failed (egl error 0x%x)\n", eglGetError());
+            destroy_context();
+            return false;
+        }
+        printf("[HEADLESS] egl %s, %s\n", eglQueryString(display, EGL_VERSION), surface == EGL_NO_SURFACE ? "surfaceless" : "1x1 pbuffer");
+        return true;
+    }
+
+    void destroy_context() {
+        if (display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (surface != EGL_NO_SURFACE)
+            eglDestroySurface(display, surface);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+        surface = EGL_NO_SURFACE;
+    }
+
+    void* proc_address(const char* name) {
+        return (void*)eglGetProcAddress(name);
+    }
+#else
+    bool create_context() {
+        printf("[HEADLESS] built without egl\n");
+        return false;
+    }
+
+    void destroy_context() {}
+
+    void* proc_address(const char*) {
+        return nullptr;
+    }
+#endif
+
+    bool Camera_path::load(const std::string& path) {
+        std::ifstream file(path);
+        if (!file) {
+            printf("[HEADLESS] cant open camera path %s\n", path.c_str());
+            return false;
+        }
+        keys.clear();
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream in(line);
+            key k;
+            if (in >> k.time >> k.position.x >> k.position.y >> k.position.z >> k.target.x >> k.target.y >> k.target.z)
+                keys.push_back(k);
+        }
+        std::sort(keys.begin(), keys.end(), [](const key& a, const key& b) { return a.time < b.time; });
+        if (keys.empty())
+            printf("[HEADLESS] no keys in %s\n", path.c_str());
+        return !keys.empty();
+    }
+
+    void Camera_path::orbit(float radius, float height, float duration) {
+        const int KEYS = 16;
+        keys.clear();
+        for (int i = 0; i <= KEYS; i++) {
+            float angle = 6.2831853f * i / KEYS;
+            keys.push_back({ duration * i / KEYS, glm::vec3(std::cos(angle) * radius, height, std::sin(angle) * radius), glm::vec3(0.0f) });
+        }
+    }
+
+    static glm::vec3 catmull_rom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) {
+        float t2 = t * t, t3 = t2 * t;
+        return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+
+    void Camera_path::sample(float time, glm::vec3& position, glm::vec3& target) const {
+        if (keys.empty()) {
+            position = glm::vec3(0.0f, 2.0f, 10.0f);
+            target = glm::vec3(0.0f);
+            return;
+        }
+        if (time <= keys.front().time || keys.size() == 1) {
+            position = keys.front().position;
+            target = keys.front().target;
+            return;
+        }
+        if (time >= keys.back().time) {
+            position = keys.back().position;
+            target = keys.back().target;
+            return;
+        }
+        size_t i = 0;
+        while (keys[i + 1].time < time)
+            i++;
+        const key& k0 = keys[i == 0 ? 0 : i - 1];
+        const key& k1 = keys[i];
+        const key& k2 = keys[i + 1];
+        const key& k3 = keys[std::min(i + 2, keys.size() - 1)];
+        float t = (time - k1.time) / std::max(k2.time - k1.time, 1e-6f);
+        position = catmull_rom(k0.position, k1.position, k2.position, k3.position, t);
+        target = catmull_rom(k0.target, k1.target, k2.target, k3.target, t);
+    }
+
+    bool Frame_log::write_csv(const std::string& path) const {
+        FILE* f = fopen(path.c_str(), "w");
+        if (!f) {
+            printf("[HEADLESS] cant write %s\n", path.c_str());
+            return false;
+        }
+        fprintf(f, "frame,frame_ms,cpu_ms,gpu_ms,draw_calls,triangles\n");
+        for (size_t i = 0; i < samples.size(); i++) {
+            const frame_sample& s = samples[i];
+            fprintf(f, "%zu,%.4f,%.4f,%.4f,%u,%llu\n", i, s.frame_ms, s.cpu_ms, s.gpu_ms, s.draw_calls, (unsigned long long)s.triangles);
+        }
+        fclose(f);
+        return true;
+    }
+
+    void Frame_log::print_summary(int warmup) const {
+        std::vector<float> times;
+        for (size_t i = (size_t)warmup; i < samples.size(); i++)
+            times.push_back(samples[i].frame_ms);
+        if (times.empty())
+            return;
+        double total = 0.0;
+        for (float t : times)
+            total += t;
+        std::sort(times.begin(), times.end());
+        auto percentile = [&](float p) { return times[std::min(times.size() - 1, (size_t)(p * times.size()))]; };
+        printf("[HEADLESS] %zu frames  mean %.3f ms  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+            times.size(), total / times.size(), percentile(0.5f), percentile(0.95f), percentile(0.99f), times.back());
+    }
+
+    bool write_png(const std::string& path, int width, int height, const std::vector<uint8_t>& rgba) {
+        stbi_flip_vertically_on_write(1);
+        int ok = stbi_write_png(path.c_str(), width, height, 4, rgba.data(), width * 4);
+        stbi_flip_vertically_on_write(0);
+        if (!ok)
+            printf("[HEADLESS] cant write %s\n", path.c_str());
+        return ok != 0;
+    }
+
+    bool compare_golden(const std::string& golden_path, int width, int height, const std::vector<uint8_t>& rgba, const options& opts) {
+        int w, h, channels;
+        // goldens are written top down by write_png, so load them the same way
+        // per thread, texture loaders may be decoding at the same time
+        stbi_set_flip_vertically_on_load_thread(1);
+        uint8_t* golden = stbi_load(golden_path.c_str(), &w, &h, &channels, 4);
+        stbi_set_flip_vertically_on_load_thread(0);
+        if (!golden) {
+            printf("[HEADLESS] no golden %s\n", golden_path.c_str());
+            return false;
+        }
+        if (w != width || h != height) {
+            printf("[HEADLESS] golden %s is %dx%d, frame is %dx%d\n", golden_path.c_str(), w, h, width, height);
+            stbi_image_free(golden);
+            return false;
+        }
+
+        size_t pixels = (size_t)width * height;
+        size_t changed = 0;
+        int max_diff = 0;
+        for (size_t p = 0; p < pixels; p++) {
+            int diff = 0;
+            // alpha isnt meaningful in the output
+            for (int c = 0; c < 3; c++)
+                diff = std::max(diff, std::abs((int)rgba[p * 4 + c] - (int)golden[p * 4 + c]));
+            max_diff = std::max(max_diff, diff);
+            if (diff > opts.tolerance)
+                changed++;
+        }
+        stbi_image_free(golden);
+
+        float fraction = (float)changed / (float)pixels;
+        bool pass = fraction <= opts.max_changed;
+        printf("[HEADLESS] %s %s: %zu pixels over tolerance (%.4f%%), max difference %d\n",
+            pass ? "match" : "MISMATCH", golden_path.c_str(), changed, fraction * 100.0f, max_diff);
+        return pass;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// scripted runs with no display for the build farm and perf tracking
+//   there is no glfw window, the renderer makes an egl context with no surface (a 1x1 pbuffer where
+//   EGL_KHR_surfaceless_context is missing) on mesa's surfaceless platform or the first egl device,
+//   so it works on llvmpipe, and draws into an offscreen target instead of a back buffer
+//   a fixed number of frames at a fixed time step, the camera follows a path, no input, audio or imgui
+//   frame times go to a csv plus a summary line, pngs of chosen frames are written and / or checked
+//   against golden images of the same name
+namespace Headless {
+    struct options {
+        bool enabled = false;
+        int width = 1280;
+        int height = 720;
+        int frames = 300;
+        int warmup = 30;            // run but left out of the summary, shader compiles and first uploads land here
+        float time_step = 1.0f / 60.0f;
+        bool deferred = false;
+        std::string camera_path;    // lines of "time px py pz tx ty tz", empty orbits the origin
+        std::string timings = "frame_times.csv";
+        std::string capture_dir;    // empty writes no pngs
+        int capture_every = 0;      // 0 is only the last frame
+        std::string golden_dir;     // captures are compared against the pngs of the same name in here
+        int tolerance = 8;          // per channel difference a pixel may have before it counts as changed
+        float max_changed = 0.001f; // fraction of changed pixels a capture may have
+        std::string trace;          // chrome trace of the run from the profiler, empty writes none
+    };
+
+    // picks the headless flags out of argv, false (after printing usage) on anything it doesnt know
+    bool parse_args(int argc, char** argv, options& out);
+
+    // 4.3 core context current on this thread, false when no egl display could be brought up
+    bool create_context();
+    void destroy_context();
+    // for gladLoadGLLoader
+    void* proc_address(const char* name);
+
+    // catmull rom through the keys, clamped at both ends
+    class Camera_path {
+    public:
+        struct key {
+            float time;
+            glm::vec3 position;
+            glm::vec3 target;
+        };
+
+        bool load(const std::string& path);
+        // one turn around the origin over duration seconds
+        void orbit(float radius, float height, float duration);
+        void sample(float time, glm::vec3& position, glm::vec3& target) const;
+
+    private:
+        std::vector<key> keys;
+    };
+
+    struct frame_sample {
+        float frame_ms; // wall time of the whole frame, waits for the gpu at the end
+        float cpu_ms;   // until the last gl call was issued
+        float gpu_ms;   // forward or geometry + lighting, from queries a few frames old
+        uint32_t draw_calls;
+        uint64_t triangles;
+    };
+
+    class Frame_log {
+    public:
+        void add(const frame_sample& s) { samples.push_back(s); }
+        bool write_csv(const std::string& path) const;
+        // mean / percentiles of frame_ms past the warmup frames
+        void print_summary(int warmup) const;
+
+    private:
+        std::vector<frame_sample> samples;
+    };
+
+    // rgba rows bottom up as read from gl
+    bool write_png(const std::string& path, int width, int height, const std::vector<uint8_t>& rgba);
+    // true when the image is within tolerance of the golden png, a missing or differently sized golden fails
+    bool compare_golden(const std::string& golden_path, int width, int height, const std::vector<uint8_t>& rgba, const options& opts);
+}
+#endif
@@ -0,0 +1,344 @@
+#include "jobs.h"
+
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <condition_variable>
+#include <cstdio>
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/JobSystemWithBarrier.h>
+#include <Jolt/Core/FixedSizeFreeList.h>
+#include <Jolt/Physics/PhysicsSettings.h>
+
+#include "profiler.h"
+
+namespace Jobs {
+
+    struct task {
+        job_fn fn;
+        counter* done;
+    };
+
+    // one per thread, padded so the hot stats of neighbours dont share a line
+    struct alignas(64) worker {
+        std::mutex mutex;
+        std::deque<task> tasks;
+
+        std::atomic<uint64_t> busy_ns{ 0 };
+        std::atomic<uint64_t> jobs{ 0 };
+        std::atomic<uint64_t> steals{ 0 };
+        uint64_t last_busy_ns = 0;
+        uint64_t last_jobs = 0;
+        uint64_t last_steals = 0;
+    };
+
+    class Jolt_job_system;
+
+    struct job_state {
+        std::vector<std::unique_ptr<worker>> workers; // 0 is the main thread
+        std::vector<std::thread> threads;
+        std::atomic<int> pending{ 0 };                // queued, not yet taken
+        std::atomic<bool> quit{ false };
+        std::mutex sleep_mutex;
+        std::condition_variable sleep_cv;
+        std::chrono::steady_clock::time_point last_collect;
+        std::unique_ptr<Jolt_job_system> jolt;
+    };
+
+    static job_state g_jobs;
+    static thread_local int t_index = -1;
+
+    static uint64_t now_ns() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void finish(counter* c);
+
+    static void push(task t) {
+        // threads we dont own drop their work on the main thread's deque, workers steal it from there
+        int index = t_index >= 0 ? t_index : 0;
+        worker& w = *g_jobs.workers[index];
+        {
+            std::lock_guard<std::mutex> lock(w.mutex);
+            w.tasks.push_back(std::move(t));
+        }
+        g_jobs.pending.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(g_jobs.sleep_mutex);
+        }
+        g_jobs.sleep_cv.notify_one();
+    }
+
+    // own deque from the back (lifo, warm cache), everyone else from the front
+    static bool take(int index, task& out) {
+        if (g_jobs.pending.load(std::memory_order_acquire) <= 0)
+            return false;
+
+        worker& self = *g_jobs.workers[index];
+        {
+            std::lock_guard<std::mutex> lock(self.mutex);
+            if (!self.tasks.empty()) {
+                out = std::move(self.tasks.back());
+                self.tasks.pop_back();
+                g_jobs.pending.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        size_t count = g_jobs.workers.size();
+        for (size_t i = 1; i < count; i++) {
+            worker& victim = *g_jobs.workers[(index + i) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                out = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                g_jobs.pending.fetch_sub(1, std::memory_order_relaxed);
+                self.steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void execute(int index, task& t) {
+        uint64_t start = now_ns();
+        {
+            PROFILE_SCOPE("job");
+            t.fn();
+        }
+        worker& w = *g_jobs.workers[index];
+        w.busy_ns.fetch_add(now_ns() - start, std::memory_order_relaxed);
+        w.jobs.fetch_add(1, std::memory_order_relaxed);
+        finish(t.done);
+    }
+
+    static void finish(counter* c) {
+        if (!c || c->value.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        std::vector<std::pair<job_fn, counter*>> ready;
+        {
+            std::lock_guard<std::mutex> lock(c->mutex);
+            ready.swap(c->continuations);
+        }
+        // done counters were already incremented in run_after
+        for (auto& r : ready)
+            push(task{ std::move(r.first), r.second });
+    }
+
+    static void worker_main(int index) {
+        t_index = index;
+        task t;
+        while (!g_jobs.quit.load(std::memory_order_acquire)) {
+            if (take(index, t)) {
+                execute(index, t);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(g_jobs.sleep_mutex);
+            g_jobs.sleep_cv.wait(lock, [] {
+                return g_jobs.quit.load(std::memory_order_acquire) || g_jobs.pending.load(std::memory_order_acquire) > 0;
+            });
+        }
+    }
+
+    // jolt's JobSystemWithBarrier on top of our workers, modelled on JobSystemThreadPool
+    class Jolt_job_system final : public JPH::JobSystemWithBarrier {
+    public:
+        Jolt_job_system(JPH::uint max_jobs, JPH::uint max_barriers) {
+            JobSystemWithBarrier::Init(max_barriers);
+            jolt_jobs.Init(max_jobs, max_jobs);
+        }
+
+        virtual int GetMaxConcurrency() const override {
+            return thread_count();
+        }
+
+        virtual JPH::JobHandle CreateJob(const char* name, JPH::ColorArg color, const JobFunction& function, JPH::uint32 num_dependencies = 0) override {
+            JPH::uint32 index;
+            for (;;) {
+                index = jolt_jobs.ConstructObject(name, color, this, function, num_dependencies);
+                if (index != Free_list::cInvalidObjectIndex)
+                    break;
+                // out of jobs, finished ones are still queued waiting for their release, help drain them
+                int thread = t_index >= 0 ? t_index : 0;
+                task t;
+                if (take(thread, t))
+                    execute(thread, t);
+                else
+                    std::this_thread::yield();
+            }
+            Job* job = &jolt_jobs.Get(index);
+
+            JPH::JobHandle handle(job);
+            if (num_dependencies == 0)
+                QueueJob(job);
+            return handle;
+        }
+
+    protected:
+        virtual void QueueJob(Job* job) override {
+            job->AddRef();
+            // a barrier wait may have executed it already, Execute is a no op then
+            run([job] {
+                job->Execute();
+                job->Release();
+            });
+        }
+
+        virtual void QueueJobs(Job** jobs, JPH::uint num_jobs) override {
+            for (JPH::uint i = 0; i < num_jobs; i++)
+                QueueJob(jobs[i]);
+        }
+
+        virtual void FreeJob(Job* job) override {
+            jolt_jobs.DestructObject(job);
+        }
+
+    private:
+        typedef JPH::FixedSizeFreeList<Job> Free_list;
+        Free_list jolt_jobs;
+    };
+
+    void init(int worker_count) {
+        if (worker_count < 0)
+            worker_count = (int)std::thread::hardware_concurrency() - 1;
+        if (worker_count < 0)
+            worker_count = 0;
+
+        t_index = 0;
+        g_jobs.quit = false;
+        g_jobs.pending = 0;
+        g_jobs.workers.clear();
+        for (int i = 0; i < worker_count + 1; i++)
+            g_jobs.workers.push_back(std::make_unique<worker>());
+
+        for (int i = 1; i <= worker_count; i++)
+            g_jobs.threads.emplace_back(worker_main, i);
+
+        g_jobs.last_collect = std::chrono::steady_clock::now();
+        // runs before Physics::init, the barriers are allocated through jolt's hooks
+        JPH::RegisterDefaultAllocator();
+        g_jobs.jolt = std::make_unique<Jolt_job_system>(JPH::cMaxPhysicsJobs, JPH::cMaxPhysicsBarriers);
+
+        printf("[JOBS] %d workers + main thread\n", worker_count);
+    }
+
+    void shutdown() {
+        // drain whatever is left on this thread before the workers go away
+        task t;
+        while (take(0, t))
+            execute(0, t);
+
+        g_jobs.quit = true;
+        {
+            std::lock_guard<std::mutex> lock(g_jobs.sleep_mutex);
+        }
+        g_jobs.sleep_cv.notify_all();
+        for (std::thread& th : g_jobs.threads)
+            th.join();
+        g_jobs.threads.clear();
+
+        g_jobs.jolt.reset();
+        g_jobs.workers.clear();
+    }
+
+    int thread_count() {
+        return (int)g_jobs.workers.size();
+    }
+
+    int thread_index() {
+        return t_index;
+    }
+
+    void run(job_fn fn, counter* done) {
+        if (done)
+            done->value.fetch_add(1, std::memory_order_relaxed);
+
+        // no workers (or not initialized yet), just run it here
+        if (g_jobs.workers.size() <= 1) {
+            fn();
+            finish(done);
+            return;
+        }
+        push(task{ std::move(fn), done });
+    }
+
+    void run_after(counter& dependency, job_fn fn, counter* done) {
+        if (done)
+            done->value.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock(dependency.mutex);
+            if (dependency.value.load(std::memory_order_acquire) > 0) {
+                dependency.continuations.emplace_back(std::move(fn), done);
+                return;
+            }
+        }
+
+        if (g_jobs.workers.size() <= 1) {
+            fn();
+            finish(done);
+            return;
+        }
+        push(task{ std::move(fn), done });
+    }
+
+    void wait(counter& c) {
+        int index = t_index >= 0 ? t_index : 0;
+        task t;
+        while (c.value.load(std::memory_order_acquire) > 0) {
+            if (take(index, t))
+                execute(index, t);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void parallel_for(size_t count, size_t batch_size, const std::function<void(size_t begin, size_t end)>& fn) {
+        if (batch_size == 0)
+            batch_size = 1;
+        if (count <= batch_size || g_jobs.workers.size() <= 1) {
+            if (count)
+                fn(0, count);
+            return;
+        }
+
+        counter c;
+        // keep the first range for this thread
+        for (size_t begin = batch_size; begin < count; begin += batch_size) {
+            size_t end = begin + batch_size < count ? begin + batch_size : count;
+            run([&fn, begin, end] { fn(begin, end); }, &c);
+        }
+        fn(0, batch_size);
+        wait(c);
+    }
+
+    void collect_stats(std::vector<worker_stats>& out) {
+        auto now = std::chrono::steady_clock::now();
+        double wall_ms = std::chrono::duration<double, std::milli>(now - g_jobs.last_collect).count();
+        g_jobs.last_collect = now;
+
+        out.resize(g_jobs.workers.size());
+        for (size_t i = 0; i < g_jobs.workers.size(); i++) {
+            worker& w = *g_jobs.workers[i];
+            uint64_t busy = w.busy_ns.load(std::memory_order_relaxed);
+            uint64_t jobs = w.jobs.load(std::memory_order_relaxed);
+            uint64_t steals = w.steals.load(std::memory_order_relaxed);
+
+            out[i].busy_ms = (busy - w.last_busy_ns) / 1e6;
+            out[i].idle_ms = wall_ms > out[i].busy_ms ? wall_ms - out[i].busy_ms : 0.0;
+            out[i].jobs = jobs - w.last_jobs;
+            out[i].steals = steals - w.last_steals;
+
+            w.last_busy_ns = busy;
+            w.last_jobs = jobs;
+            w.last_steals = steals;
+        }
+    }
+
+    JPH::JobSystem* get_jolt_job_system() {
+        return g_jobs.jolt.get();
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+namespace JPH {
+    class JobSystem;
+}
+
+// engine wide work stealing job system
+//   every worker (and the main thread, index 0) owns a deque, owners push / pop the back, idle workers steal the front
+//   counters track outstanding jobs, waiting on one runs other jobs instead of blocking
+//   jolt runs its physics jobs on the same workers through get_jolt_job_system
+namespace Jobs {
+    typedef std::function<void()> job_fn;
+
+    struct counter {
+        std::atomic<int> value{ 0 };
+
+        // jobs queued by run_after, released when value hits zero
+        std::mutex mutex;
+        std::vector<std::pair<job_fn, counter*>> continuations;
+    };
+
+    struct worker_stats {
+        double busy_ms = 0.0;
+        double idle_ms = 0.0;
+        uint64_t jobs = 0;
+        uint64_t steals = 0;
+    };
+
+    // worker_count < 0 uses hardware_concurrency - 1, call from the main thread before anything queues jobs
+    void init(int worker_count = -1);
+    void shutdown();
+    // workers plus the main thread
+    int thread_count();
+    // 0 on the main thread, 1..n on workers, -1 anywhere else
+    int thread_index();
+
+    // done (if any) is incremented now and decremented when fn returns
+    void run(job_fn fn, counter* done = nullptr);
+    // fn is queued once dependency reaches zero
+    void run_after(counter& dependency, job_fn fn, counter* done = nullptr);
+    // runs queued jobs until c reaches zero
+    void wait(counter& c);
+    // splits [0, count) into ranges of at most batch_size and waits for all of them, the caller helps
+    void parallel_for(size_t count, size_t batch_size, const std::function<void(size_t begin, size_t end)>& fn);
+
+    // per thread utilization since the previous call, index matches thread_index
+    void collect_stats(std::vector<worker_stats>& out);
+
+    JPH::JobSystem* get_jolt_job_system();
+}
+#endif
@@ -17,6 +17,9 @@ public:
     float intensity;
     float inner_fov;
     float outer_fov;
+    float radius; // point lights, nothing past it is lit
+    bool casts_shadows = false; // point lights, six tiles in the renderers shadow atlas
+    int shadow_record = -1;     // first atlas record this frame, -1 unshadowed
 
     unsigned int width, height;
     unsigned int fbo, shadow_map;
@@ -29,11 +32,11 @@ public:
         generate_fbo(w, h);
     }    
     */
-    Light(light_type lt, glm::vec3 pos, glm::vec3 dir, glm::vec3 col, float intens, unsigned int w, unsigned int h, float fov_in = 25.0f, float fov_out = 45.0f) : position(pos), direction(dir), color(col), intensity(intens), inner_fov(fov_in), outer_fov(fov_out), width(w), height(h)
+    Light(light_type lt, glm::vec3 pos, glm::vec3 dir, glm::vec3 col, float intens, unsigned int w, unsigned int h, float fov_in = 25.0f, float fov_out = 45.0f, float r = 0.0f) : type(lt), position(pos), direction(dir), color(col), intensity(intens), inner_fov(fov_in), outer_fov(fov_out), radius(r), width(w), height(h), fbo(0), shadow_map(0)
     {
-        if (lt == POINT)
-            generate_cubemap();
-        else
+        // point lights go through the clustered path, their shadows (if any) are atlas tiles
+        // directional shadows are the renderers cascades
+        if (lt == SPOT)
             generate_fbo(w, h);
     }
 
@@ -42,9 +45,10 @@ public:
         return Light(DIRECTIONAL, glm::vec3(0.0f), dir, col, intens, w, h);
     }
 
-    static Light create_point(glm::vec3 pos, glm::vec3 col, float intens,
-        unsigned int w = 1024, unsigned int h = 1024) {
-        return Light(POINT, pos, glm::vec3(0.0f, -1.0f, 0.0f), col, intens, w, h);
+    static Light create_point(glm::vec3 pos, glm::vec3 col, float intens, float radius = 10.0f, bool shadows = false) {
+        Light l(POINT, pos, glm::vec3(0.0f, -1.0f, 0.0f), col, intens, 0, 0, 0.0f, 0.0f, radius);
+        l.casts_shadows = shadows;
+        return l;
     }
 
     static Light create_spot(glm::vec3 pos, glm::vec3 dir, glm::vec3 col, float intens,
@@ -60,7 +64,7 @@ public:
         // depth buffer texture
         glGenTextures(1, &shadow_map);
         glBindTexture(GL_TEXTURE_2D, shadow_map);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL); // sized so the shadow cache can copy into it
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -86,9 +90,6 @@ public:
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 
-    void generate_cubemap() {
-    }
-
     void bind_fbo_write() {
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
         glViewport(0, 0, width, height);
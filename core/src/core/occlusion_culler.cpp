@@ -0,0 +1,305 @@
+#include "occlusion_culler.h"
+
+#include <chrono>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+#include <immintrin.h>
+
+#include "jobs.h"
+
+static const int BAND_TILES = 2;        // rows of tiles per band job
+static const size_t SETUP_BATCH = 4;    // occluders per job
+static const size_t TEST_BATCH = 64;    // boxes per job
+
+void Occlusion_culler::init(int w, int h) {
+    assert(w % 8 == 0 && h % (TILE_SIZE * BAND_TILES) == 0);
+    width = w;
+    height = h;
+    tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y = height / TILE_SIZE;
+    band_rows = TILE_SIZE * BAND_TILES;
+    bands = height / band_rows;
+    depth.assign((size_t)width * height, 1.0f);
+    tile_max.assign((size_t)tiles_x * tiles_y, 1.0f);
+}
+
+void Occlusion_culler::begin(const glm::mat4& vp) {
+    view_projection = vp;
+    occluders.clear();
+    stats = occlusion_stats();
+}
+
+void Occlusion_culler::add_occluder(const occluder_mesh& mesh, const glm::mat4& model) {
+    if (!mesh.indices.empty())
+        occluders.push_back({ &mesh, model });
+}
+
+// clip space in, pixels out; keeps the triangle only if its bounds reach the screen
+void Occlusion_culler::setup_triangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2, std::vector<raster_tri>& out) const {
+    glm::vec3 v[3];
+    const glm::vec4* c[3] = { &c0, &c1, &c2 };
+    for (int i = 0; i < 3; i++) {
+        float inv_w = 1.0f / c[i]->w;
+        v[i] = glm::vec3((c[i]->x * inv_w * 0.5f + 0.5f) * width, (c[i]->y * inv_w * 0.5f + 0.5f) * height, c[i]->z * inv_w);
+    }
+
+    // twice the signed area, flipped to counter clockwise so inside is positive for either winding
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+    if (std::abs(area) < 1e-6f)
+        return;
+    if (area < 0.0f) {
+        std::swap(v[1], v[2]);
+        area = -area;
+    }
+
+    raster_tri t;
+    float min_x = std::min(v[0].x, std::min(v[1].x, v[2].x));
+    float max_x = std::max(v[0].x, std::max(v[1].x, v[2].x));
+    float min_y = std::min(v[0].y, std::min(v[1].y, v[2].y));
+    float max_y = std::max(v[0].y, std::max(v[1].y, v[2].y));
+    t.min_x = std::max((int)std::floor(min_x), 0);
+    t.max_x = std::min((int)std::ceil(max_x) - 1, width - 1);
+    t.min_y = std::max((int)std::floor(min_y), 0);
+    t.max_y = std::min((int)std::ceil(max_y) - 1, height - 1);
+    if (t.min_x > t.max_x || t.min_y > t.max_y)
+        return;
+
+    // edge i runs from v[i] to v[i + 1], evaluated at pixel centers
+    // the pixel's worst corner is the center minus half a pixel along both gradients
+    float inv_area = 1.0f / area;
+    float z_a = 0.0f, z_b = 0.0f, z_c = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        const glm::vec3& p = v[i];
+        const glm::vec3& q = v[(i + 1) % 3];
+        float a = p.y - q.y;
+        float b = q.x - p.x;
+        float c = -(a * p.x + b * p.y);
+        t.a[i] = a;
+        t.b[i] = b;
+        t.c[i] = c + 0.5f * (a + b) - 0.5f * (std::abs(a) + std::abs(b));
+
+        // the edge's function over the area is the barycentric of the vertex across from it
+        float z = v[(i + 2) % 3].z * inv_area;
+        z_a += a * z;
+        z_b += b * z;
+        z_c += c * z;
+    }
+    // same half pixel shift to the farthest depth in the pixel
+    t.z_c = z_c + 0.5f * (z_a + z_b) + 0.5f * (std::abs(z_a) + std::abs(z_b));
+    t.z_a = z_a;
+    t.z_b = z_b;
+    out.push_back(t);
+}
+
+static void clip_near(const glm::vec4* in, int in_count, glm::vec4* out, int& out_count) {
+    // gl clip space, inside the near plane is z >= -w
+    out_count = 0;
+    for (int i = 0; i < in_count; i++) {
+        const glm::vec4& p = in[i];
+        const glm::vec4& q = in[(i + 1) % in_count];
+        float dp = p.z + p.w;
+        float dq = q.z + q.w;
+        if (dp >= 0.0f)
+            out[out_count++] = p;
+        if ((dp >= 0.0f) != (dq >= 0.0f))
+            out[out_count++] = p + (q - p) * (dp / (dp - dq));
+    }
+}
+
+void Occlusion_culler::rasterize() {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // transform, clip and set up on every thread, each appends to its own list
+    thread_tris.resize(Jobs::thread_count());
+    for (std::vector<raster_tri>& list : thread_tris)
+        list.clear();
+    Jobs::parallel_for(occluders.size(), SETUP_BATCH, [&](size_t begin, size_t end) {
+        std::vector<raster_tri>& out = thread_tris[Jobs::thread_index()];
+        std::vector<glm::vec4> clip;
+        for (size_t o = begin; o < end; o++) {
+            const occluder_mesh& mesh = *occluders[o].mesh;
+            glm::mat4 mvp = view_projection * occluders[o].model;
+            clip.resize(mesh.positions.size());
+            for (size_t i = 0; i < mesh.positions.size(); i++)
+                clip[i] = mvp * glm::vec4(mesh.positions[i], 1.0f);
+
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                glm::vec4 tri[3] = { clip[mesh.indices[i]], clip[mesh.indices[i + 1]], clip[mesh.indices[i + 2]] };
+                if (tri[0].z >= -tri[0].w && tri[1].z >= -tri[1].w && tri[2].z >= -tri[2].w) {
+                    setup_triangle(tri[0], tri[1], tri[2], out);
+                    continue;
+                }
+                glm::vec4 poly[4];
+                int count;
+                clip_near(tri, 3, poly, count);
+                for (int k = 1; k + 1 < count; k++)
+                    setup_triangle(poly[0], poly[k], poly[k + 1], out);
+            }
+        }
+    });
+    tris.clear();
+    for (const std::vector<raster_tri>& list : thread_tris)
+        tris.insert(tris.end(), list.begin(), list.end());
+
+    Jobs::parallel_for(bands, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; b++)
+            rasterize_band((int)b);
+    });
+
+    stats.occluders = (uint32_t)occluders.size();
+    stats.triangles = (uint32_t)tris.size();
+    stats.raster_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Occlusion_culler::rasterize_band(int band) {
+    int y0 = band * band_rows;
+    int y1 = y0 + band_rows - 1;
+    std::fill(depth.begin() + (size_t)y0 * width, depth.begin() + (size_t)(y1 + 1) * width, 1.0f);
+
+    for (const raster_tri& t : tris) {
+        if (t.max_y < y0 || t.min_y > y1)
+            continue;
+        int row_begin = std::max(t.min_y, y0);
+        int row_end = std::min(t.max_y, y1);
+        int x_begin = t.min_x & ~7;
+
+        for (int y = row_begin; y <= row_end; y++) {
+            float* row = depth.data() + (size_t)y * width;
+            float fy = (float)y;
+            int x = x_begin;
+#if defined(__AVX2__) && defined(__FMA__)
+            const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+            const __m256 zero = _mm256_setzero_ps();
+            __m256 e_row[3], e_step[3];
+            for (int i = 0; i < 3; i++) {
+                e_row[i] = _mm256_set1_ps(t.b[i] * fy + t.c[i]);
+                e_step[i] = _mm256_set1_ps(t.a[i]);
+            }
+            __m256 z_row = _mm256_set1_ps(t.z_b * fy + t.z_c);
+            __m256 z_step = _mm256_set1_ps(t.z_a);
+            __m256 one = _mm256_set1_ps(1.0f);
+            for (; x <= t.max_x; x += 8) {
+                __m256 xs = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+                __m256 e0 = _mm256_fmadd_ps(e_step[0], xs, e_row[0]);
+                __m256 e1 = _mm256_fmadd_ps(e_step[1], xs, e_row[1]);
+                __m256 e2 = _mm256_fmadd_ps(e_step[2], xs, e_row[2]);
+                // sign bits of all three edges together, lanes left of min_x are outside at least one edge anyway
+                __m256 inside = _mm256_cmp_ps(_mm256_min_ps(e0, _mm256_min_ps(e1, e2)), zero, _CMP_GE_OQ);
+                if (_mm256_movemask_ps(inside) == 0)
+                    continue;
+                __m256 z = _mm256_min_ps(_mm256_fmadd_ps(z_step, xs, z_row), one);
+                __m256 old = _mm256_loadu_ps(row + x);
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, _mm256_min_ps(old, z), inside));
+            }
+#endif
+            for (; x <= t.max_x; x++) {
+                float fx = (float)x;
+                if (t.a[0] * fx + t.b[0] * fy + t.c[0] < 0.0f ||
+                    t.a[1] * fx + t.b[1] * fy + t.c[1] < 0.0f ||
+                    t.a[2] * fx + t.b[2] * fy + t.c[2] < 0.0f)
+                    continue;
+                float z = std::min(t.z_a * fx + t.z_b * fy + t.z_c, 1.0f);
+                row[x] = std::min(row[x], z);
+            }
+        }
+    }
+
+    // farthest depth per tile for the coarse test
+    for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ty++) {
+        for (int tx = 0; tx < tiles_x; tx++) {
+            float m = 0.0f;
+            int x_end = std::min((tx + 1) * TILE_SIZE, width);
+            for (int y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; y++) {
+                const float* row = depth.data() + (size_t)y * width;
+                for (int x = tx * TILE_SIZE; x < x_end; x++)
+                    m = std::max(m, row[x]);
+            }
+            tile_max[(size_t)ty * tiles_x + tx] = m;
+        }
+    }
+}
+
+// every pixel in the inclusive rect has something nearer than depth
+bool Occlusion_culler::rect_hidden(int x0, int y0, int x1, int y1, float box_depth) const {
+    for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ty++) {
+        for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; tx++) {
+            if (tile_max[(size_t)ty * tiles_x + tx] < box_depth)
+                continue;
+            // the tile has something as far as the box, check just the pixels the rect covers
+            int py0 = std::max(y0, ty * TILE_SIZE), py1 = std::min(y1, ty * TILE_SIZE + TILE_SIZE - 1);
+            int px0 = std::max(x0, tx * TILE_SIZE), px1 = std::min(x1, tx * TILE_SIZE + TILE_SIZE - 1);
+            for (int y = py0; y <= py1; y++) {
+                const float* row = depth.data() + (size_t)y * width;
+                for (int x = px0; x <= px1; x++)
+                    if (row[x] >= box_depth)
+                        return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool Occlusion_culler::is_occluded(const Util::aabb& box) const {
+    float min_x = 1e30f, min_y = 1e30f, max_x = -1e30f, max_y = -1e30f;
+    float nearest = 1.0f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+        glm::vec4 c = view_projection * glm::vec4(corner, 1.0f);
+        // reaches the near plane, the camera might be inside it
+        if (c.z < -c.w || c.w <= 0.0f)
+            return false;
+        float inv_w = 1.0f / c.w;
+        float x = (c.x * inv_w * 0.5f + 0.5f) * width;
+        float y = (c.y * inv_w * 0.5f + 0.5f) * height;
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        nearest = std::min(nearest, c.z * inv_w);
+    }
+
+    // every pixel the rect touches, even partly
+    int x0 = std::max((int)std::floor(min_x), 0);
+    int y0 = std::max((int)std::floor(min_y), 0);
+    int x1 = std::min((int)std::ceil(max_x) - 1, width - 1);
+    int y1 = std::min((int)std::ceil(max_y) - 1, height - 1);
+    if (x0 > x1 || y0 > y1)
+        return false; // off screen, the frustum test deals with it
+    return rect_hidden(x0, y0, x1, y1, nearest);
+}
+
+void Occlusion_culler::cull(const Culling::bounds_soa& bounds, std::vector<uint32_t>& visible) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    hidden.assign(visible.size(), 0);
+    if (!tris.empty()) {
+        Jobs::parallel_for(visible.size(), TEST_BATCH, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                uint32_t v = visible[i];
+                Util::aabb box;
+                box.min = glm::vec3(bounds.min_x[v], bounds.min_y[v], bounds.min_z[v]);
+                box.max = glm::vec3(bounds.max_x[v], bounds.max_y[v], bounds.max_z[v]);
+                hidden[i] = is_occluded(box);
+            }
+        });
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < visible.size(); i++)
+        if (!hidden[i])
+            visible[kept++] = visible[i];
+    stats.tested = (uint32_t)visible.size();
+    stats.occluded = (uint32_t)(visible.size() - kept);
+    visible.resize(kept);
+
+    stats.test_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void Occlusion_culler::debug_image(std::vector<uint8_t>& out) const {
+    out.resize(depth.size());
+    // ndc depth crowds next to 1, a high power spreads the near range out
+    for (size_t i = 0; i < depth.size(); i++)
+        out[i] = (uint8_t)(std::pow(std::max(depth[i], 0.0f), 32.0f) * 255.0f);
+}
@@ -0,0 +1,94 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+
+// low poly stand in for a model, model space, triangles lie on or inside the real surface
+// so anything they hide is really hidden
+struct occluder_mesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    bool authored = false; // came from "occluder" meshes in the model file, not picked from its triangles
+};
+
+// cpu occlusion culling against a low res depth buffer, no gl anywhere in here
+//   occluders are rasterized conservatively: a pixel is only written when the triangle covers all of it,
+//   with the farthest depth the triangle has inside it, so gaps stay open and nothing is hidden that shouldnt be
+//   rows are split into bands that rasterize on the job system, 8 pixels per step with avx2,
+//   then every band keeps the farthest depth of each 8x8 tile as a coarse level
+//   a box is hidden when its nearest point is behind every pixel its screen rect touches,
+//   whole tiles are rejected from the coarse level and only tiles that cant decide go to the pixels
+class Occlusion_culler {
+public:
+    struct occlusion_stats {
+        uint32_t occluders = 0;
+        uint32_t triangles = 0;     // after near clipping, before the screen bounds
+        uint32_t tested = 0;
+        uint32_t occluded = 0;
+        float raster_ms = 0.0f;
+        float test_ms = 0.0f;
+    };
+
+    // width a multiple of 8, height a multiple of TILE_SIZE * the band height
+    void init(int width = 320, int height = 192);
+
+    // clears the occluder list for a new camera
+    void begin(const glm::mat4& view_projection);
+    // only queued, the mesh has to stay alive until rasterize
+    void add_occluder(const occluder_mesh& mesh, const glm::mat4& model);
+    // transforms, clips and rasterizes everything queued since begin
+    void rasterize();
+    // drops the indices whose box is hidden, bounds is indexed by the values in visible
+    void cull(const Culling::bounds_soa& bounds, std::vector<uint32_t>& visible);
+    bool is_occluded(const Util::aabb& box) const;
+
+    // 0 near .. 255 empty, row 0 is the bottom one like a gl texture
+    void debug_image(std::vector<uint8_t>& out) const;
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+    const occlusion_stats& get_stats() const { return stats; }
+
+    bool enabled = true;
+    int max_occluders = 32;           // largest on screen first
+    float min_occluder_size = 0.05f;  // bounding radius over distance, smaller entities never occlude
+
+    static const int TILE_SIZE = 8;
+
+private:
+    struct queued {
+        const occluder_mesh* mesh;
+        glm::mat4 model;
+    };
+
+    // edge functions biased so >= 0 means the whole pixel is inside, depth plane is the farthest depth in a pixel
+    struct raster_tri {
+        float a[3], b[3], c[3];
+        float z_a, z_b, z_c;
+        int min_x, max_x, min_y, max_y;
+    };
+
+    void setup_triangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2, std::vector<raster_tri>& out) const;
+    void rasterize_band(int band);
+    bool rect_hidden(int x0, int y0, int x1, int y1, float depth) const;
+
+    int width = 0, height = 0;
+    int tiles_x = 0, tiles_y = 0;
+    int band_rows = 0;
+    int bands = 0;
+    glm::mat4 view_projection = glm::mat4(1.0f);
+
+    std::vector<queued> occluders;
+    std::vector<std::vector<raster_tri>> thread_tris; // per job system thread, merged into tris
+    std::vector<raster_tri> tris;
+    std::vector<float> depth;     // ndc z, 1 where nothing was drawn
+    std::vector<float> tile_max;  // farthest depth per tile
+    std::vector<uint8_t> hidden;  // scratch, one per tested index
+
+    occlusion_stats stats;
+};
+#endif
@@ -0,0 +1,49 @@
+#include "offscreen_target.h"
+
+#include <cstdio>
+#include <cassert>
+
+#include <glad/glad.h>
+
+void Offscreen_target::init(int w, int h) {
+    width = w;
+    height = h;
+
+    // renderbuffers, nothing samples these
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depth_stencil);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_stencil);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_stencil);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("[OFFSCREEN] FB error: 0x%x\n", status);
+        assert(false);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Offscreen_target::shutdown() {
+    glDeleteFramebuffers(1, &fbo);
+    unsigned int buffers[2] = { color, depth_stencil };
+    glDeleteRenderbuffers(2, buffers);
+    fbo = color = depth_stencil = 0;
+}
+
+void Offscreen_target::read_pixels(std::vector<uint8_t>& rgba) const {
+    rgba.resize((size_t)width * height * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
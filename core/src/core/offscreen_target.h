@@ -0,0 +1,28 @@
+#ifndef OFFSCREEN_TARGET_H
+#define OFFSCREEN_TARGET_H
+
+#include <vector>
+#include <cstdint>
+
+// stands in for the window's framebuffer when there is no window (headless runs),
+// RGBA8 color and 24/8 depth stencil like the default one so every pass draws the same
+class Offscreen_target {
+public:
+    // needs a gl context
+    void init(int width, int height);
+    void shutdown();
+
+    unsigned int get_fbo() const { return fbo; }
+    int get_width() const { return width; }
+    int get_height() const { return height; }
+
+    // waits for the gpu, rows bottom up like gl
+    void read_pixels(std::vector<uint8_t>& rgba) const;
+
+private:
+    int width = 0, height = 0;
+    unsigned int fbo = 0;
+    unsigned int color = 0;
+    unsigned int depth_stencil = 0;
+};
+#endif
@@ -1,13 +1,15 @@
 #include "physics.h"
+#include "jobs.h"
 #include <iostream>
 #include <cstdarg>
 #include <thread>
+#include <mutex>
+#include <atomic>
 
 #include <Jolt/Jolt.h>
 #include <Jolt/RegisterTypes.h>
 #include <Jolt/Core/Factory.h>
 #include <Jolt/Core/TempAllocator.h>
-#include <Jolt/Core/JobSystemThreadPool.h>
 #include <Jolt/Physics/PhysicsSettings.h>
 #include <Jolt/Physics/PhysicsSystem.h>
 #include <Jolt/Physics/Collision/Shape/BoxShape.h>
@@ -15,6 +17,7 @@
 #include <Jolt/Physics/Collision/Shape/CylinderShape.h>
 #include <Jolt/Physics/Body/BodyCreationSettings.h>
 #include <Jolt/Physics/Body/BodyActivationListener.h>
+#include <Jolt/Physics/Body/BodyLockInterface.h>
 #include <Jolt/Physics/Collision/RayCast.h>
 //#include <Jolt/Physics/Collision/CollisionCollectorImpl.h>
 #include <Jolt/Physics/Collision/CastResult.h>
@@ -32,13 +35,20 @@ namespace Physics {
 
     struct PhysicsState {
         std::unique_ptr<TempAllocatorImpl> tempAllocator;
-        std::unique_ptr<JobSystemThreadPool> jobSystem;
+        JobSystem* jobSystem = nullptr; // owned by Jobs, shared with the rest of the engine
         std::unique_ptr<PhysicsSystem> physicsSystem;
         std::unique_ptr<BPLayerInterfaceImpl> broadPhaseLayerInterface;
         std::unique_ptr<ObjectVsBroadPhaseLayerFilterImpl> objectVsBroadphaseLayerFilter;
         std::unique_ptr<ObjectLayerPairFilterImpl> objectVsObjectLayerFilter;
         std::unique_ptr<MyBodyActivationListener> bodyActivationListener;
         std::unique_ptr<MyContactListener> contactListener;
+
+        // fixed timestep
+        float tick_rate = 60.0f;
+        int max_steps = 4;
+        float accumulator = 0.0f;
+        bool ticked = false;
+        std::vector<body_transform> previous;
     };
 
     static PhysicsState g_state;
@@ -154,15 +164,22 @@ namespace Physics {
         }
     };
 
+    // called from jobs, keeps the bodies that fell asleep so their resting transform is synced once
     class MyBodyActivationListener : public BodyActivationListener {
     public:
         virtual void OnBodyActivated(const BodyID& inBodyID, uint64 inBodyUserData) override {
-            std::cout << "A body got activated" << std::endl;
+            epoch.fetch_add(1, std::memory_order_relaxed);
         }
 
         virtual void OnBodyDeactivated(const BodyID& inBodyID, uint64 inBodyUserData) override {
-            std::cout << "A body went to sleep" << std::endl;
+            epoch.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(mutex);
+            deactivated.push_back(inBodyID);
         }
+
+        std::atomic<uint32_t> epoch{ 0 };
+        std::mutex mutex;
+        std::vector<BodyID> deactivated;
     };
 
     // Public API Implementation
@@ -191,10 +208,8 @@ namespace Physics {
         // malloc / free.
         g_state.tempAllocator = std::make_unique<TempAllocatorImpl>(10 * 1024 * 1024);
 
-        // We need a job system that will execute physics jobs on multiple threads. Typically
-        // you would implement the JobSystem interface yourself and let Jolt Physics run on top
-        // of your own job scheduler. JobSystemThreadPool is an example implementation.
-        g_state.jobSystem = std::make_unique<JobSystemThreadPool>(cMaxPhysicsJobs, cMaxPhysicsBarriers, std::thread::hardware_concurrency() - 1);
+        // physics jobs run on the engine workers, Jobs::init has to come first
+        g_state.jobSystem = Jobs::get_jolt_job_system();
 
         // This is the max amount of rigid bodies that you can add to the physics system. If you try to add more you'll get an error.
         // Note: This value is low because this is a simple test. For a real project use something in the order of 65536.
@@ -262,7 +277,7 @@ namespace Physics {
         g_state.objectVsObjectLayerFilter.reset();
         g_state.objectVsBroadphaseLayerFilter.reset();
         g_state.broadPhaseLayerInterface.reset();
-        g_state.jobSystem.reset();
+        g_state.jobSystem = nullptr;
         g_state.tempAllocator.reset();
 
         delete Factory::sInstance;
@@ -271,14 +286,114 @@ namespace Physics {
 
     void update(float deltaTime) {
         const int cCollisionSteps = 1;
-        g_state.physicsSystem->Update(deltaTime, cCollisionSteps, g_state.tempAllocator.get(), g_state.jobSystem.get());
+        g_state.physicsSystem->Update(deltaTime, cCollisionSteps, g_state.tempAllocator.get(), g_state.jobSystem);
+        g_state.ticked = true;
+    }
+
+    static void append_active_transforms(std::vector<body_transform>& out);
+
+    int step(float frame_dt) {
+        float tick = 1.0f / g_state.tick_rate;
+        g_state.accumulator += frame_dt;
+
+        int steps = (int)(g_state.accumulator / tick);
+        if (steps > g_state.max_steps) {
+            // behind, drop the rest instead of trying to catch up
+            steps = g_state.max_steps;
+            g_state.accumulator = tick * steps;
+        }
+
+        for (int i = 0; i < steps; i++) {
+            // snapshot right before the last tick so rendering can blend between the last two
+            if (i == steps - 1) {
+                g_state.previous.clear();
+                append_active_transforms(g_state.previous);
+            }
+            update(tick);
+            g_state.accumulator -= tick;
+        }
+
+        return steps;
+    }
+
+    void set_tick_rate(float hz) {
+        g_state.tick_rate = hz > 1.0f ? hz : 1.0f;
+    }
+
+    void set_max_steps(int steps) {
+        g_state.max_steps = steps > 1 ? steps : 1;
+    }
+
+    float get_tick_rate() {
+        return g_state.tick_rate;
+    }
+
+    float interpolation_alpha() {
+        float alpha = g_state.accumulator * g_state.tick_rate;
+        return alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+    }
+
+    static void append_transform(const Body& body, std::vector<body_transform>& out) {
+        RVec3 pos = body.GetPosition();
+        Quat rot = body.GetRotation();
+        out.push_back(body_transform{
+            body.GetUserData(),
+            glm::vec3(static_cast<float>(pos.GetX()), static_cast<float>(pos.GetY()), static_cast<float>(pos.GetZ())),
+            glm::quat(rot.GetW(), rot.GetX(), rot.GetY(), rot.GetZ())
+        });
+    }
+
+    static void append_active_transforms(std::vector<body_transform>& out) {
+        const BodyLockInterfaceNoLock& lock_interface = g_state.physicsSystem->GetBodyLockInterfaceNoLock();
+
+        // safe, nothing is simulating between updates
+        uint32 active_count = g_state.physicsSystem->GetNumActiveBodies(EBodyType::RigidBody);
+        const BodyID* active = g_state.physicsSystem->GetActiveBodiesUnsafe(EBodyType::RigidBody);
+        out.reserve(out.size() + active_count);
+        for (uint32 i = 0; i < active_count; i++) {
+            const Body* body = lock_interface.TryGetBody(active[i]);
+            if (body)
+                append_transform(*body, out);
+        }
+    }
+
+    void sync_transforms(transform_sync& out) {
+        out.current.clear();
+        out.previous.clear();
+        out.alpha = interpolation_alpha();
+        out.ticked = g_state.ticked;
+        if (!g_state.ticked)
+            return;
+        g_state.ticked = false;
+
+        append_active_transforms(out.current);
+        out.previous.swap(g_state.previous);
+
+        // last step of bodies that went to sleep, may already be destroyed
+        const BodyLockInterfaceNoLock& lock_interface = g_state.physicsSystem->GetBodyLockInterfaceNoLock();
+        MyBodyActivationListener& listener = *g_state.bodyActivationListener;
+        std::lock_guard<std::mutex> lock(listener.mutex);
+        for (const BodyID& id : listener.deactivated) {
+            const Body* body = lock_interface.TryGetBody(id);
+            if (body && !body->IsActive())
+                append_transform(*body, out.current);
+        }
+        listener.deactivated.clear();
+    }
+
+    uint32_t activation_epoch() {
+        return g_state.bodyActivationListener->epoch.load(std::memory_order_relaxed);
+    }
+
+    uint32_t active_body_count() {
+        return g_state.physicsSystem->GetNumActiveBodies(EBodyType::RigidBody);
     }
 
     void optimize_broad_phase() {
         g_state.physicsSystem->OptimizeBroadPhase();
     }
 
-    JPH::BodyID addBox(const glm::vec3& pos, const glm::vec3& size, bool isStatic) {
+    JPH::BodyID addBox(const glm::vec3& pos, const glm::vec3& size, bool isStatic, uint64_t user_data) {
         // Create box shape
         RefConst<Shape> box_shape = new BoxShape(Vec3(size.x * 0.5f, size.y * 0.5f, size.z * 0.5f));
 
@@ -291,6 +406,7 @@ namespace Physics {
             isStatic ? Layers::NON_MOVING : Layers::MOVING);
 
         body_settings.mRestitution = 0.2f;
+        body_settings.mUserData = user_data;
 
         // Create body
         BodyInterface& body_interface = g_state.physicsSystem->GetBodyInterface();
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <vector>
+#include <cstdint>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
@@ -15,7 +18,6 @@ namespace JPH {
     class BodyInterface;
     class PhysicsSystem;
     class TempAllocatorImpl;
-    class JobSystemThreadPool;
     class Body;
     class Shape;
     using BodyID = class BodyID;
@@ -27,13 +29,43 @@ namespace Physics {
     bool init();
     void shutdown();
     void update(float deltaTime = 1.0f / 60.0f);
+    // fixed timestep, accumulates frame time and runs as many ticks as fit, at most max_steps per call
+    // leftover time past max_steps is dropped so a slow frame cant spiral. returns the ticks run
+    int step(float frame_dt);
+    void set_tick_rate(float hz);
+    void set_max_steps(int steps);
+    float get_tick_rate();
+    // how far the frame is between the last two ticks, 0..1
+    float interpolation_alpha();
     void optimize_broad_phase();
     // todo add call to somewhere OptimizeBroadPhase();
     // Optional step: Before starting the physics simulation you can optimize the broad phase. This improves collision detection performance (it's pointless here because we only have 2 bodies).
     // You should definitely not call this every frame or when e.g. streaming in a new level section as it is an expensive operation.
     // Instead insert all new objects in batches instead of 1 at a time to keep the broad phase efficient.
 
-    JPH::BodyID addBox(const glm::vec3& pos, const glm::vec3& size, bool isStatic = false);
+    // transform of a body that moved, user_data is whatever the body was created with
+    struct body_transform {
+        uint64_t user_data;
+        glm::vec3 position;
+        glm::quat rotation;
+    };
+
+    struct transform_sync {
+        bool ticked = false;                  // at least one tick ran since the last sync
+        float alpha = 1.0f;                   // interpolation_alpha at sync time
+        std::vector<body_transform> current;  // after the last tick
+        std::vector<body_transform> previous; // active bodies right before the last tick
+    };
+
+    // active bodies plus the ones that fell asleep since the last call, through the no lock interface
+    // current / previous are only filled when a tick ran. main thread only and never while update runs
+    void sync_transforms(transform_sync& out);
+    // bumped every time a body falls asleep or wakes up
+    uint32_t activation_epoch();
+    // awake rigid bodies, main thread between updates
+    uint32_t active_body_count();
+
+    JPH::BodyID addBox(const glm::vec3& pos, const glm::vec3& size, bool isStatic = false, uint64_t user_data = 0);
     JPH::BodyID addSphere(const glm::vec3& pos, float radius, bool isStatic = false);
     void removeBody(JPH::BodyID id);
 
@@ -0,0 +1,344 @@
+#include "profiler.h"
+
+#ifdef GLOW_PROFILE
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <glad/glad.h>
+
+#include "jobs.h"
+
+namespace Profiler {
+    bool enabled = true;
+
+    struct event {
+        const char* name;
+        uint64_t start;
+        uint32_t duration; // ns
+        uint32_t depth;
+    };
+
+    static const uint64_t RING_SIZE = 1 << 15; // events per thread, oldest get overwritten
+    static const int GPU_TID = 1000;          // trace lanes that arent job threads
+    static const int FRAME_TID = 1001;
+
+    // only its own thread writes, readers take head with acquire and read behind it
+    struct alignas(64) thread_ring {
+        std::unique_ptr<event[]> events{ new event[RING_SIZE] };
+        std::atomic<uint64_t> head{ 0 };
+    };
+
+    struct frame_record {
+        uint64_t start;
+        uint64_t end;
+        int64_t counters[MAX_COUNTERS];
+    };
+
+    // queries of one frame, reused LATENCY frames later
+    struct gpu_frame {
+        unsigned int queries[MAX_GPU_SCOPES * 2]; // begin, end per scope
+        const char* names[MAX_GPU_SCOPES];
+        uint8_t depths[MAX_GPU_SCOPES];
+        uint64_t cpu_start[MAX_GPU_SCOPES];
+        float cpu_ms[MAX_GPU_SCOPES];
+        int count;
+        unsigned int last_query;                  // timestamps finish in order, this one being ready means all are
+        int64_t gpu_to_cpu;                       // offset from gl time to now_ns, taken at the start of the frame
+        bool pending;
+    };
+
+    struct profiler_state {
+        bool ready = false;
+        uint64_t epoch = 0;                       // trace time zero
+        std::vector<std::unique_ptr<thread_ring>> rings; // by Jobs::thread_index
+        thread_ring gpu_ring;                     // collected gpu scopes, on the cpu clock
+
+        gpu_frame gpu[LATENCY];
+        int gpu_current = 0;
+        int gpu_depth = 0;
+        std::vector<pass_timing> passes;
+
+        const char* counter_names[MAX_COUNTERS];
+        int64_t counter_values[MAX_COUNTERS];
+        int counter_count = 0;
+
+        std::vector<frame_record> frames;         // ring of FRAME_HISTORY
+        uint64_t frame_count = 0;                 // frames closed so far
+        uint64_t frame_start = 0;                 // 0 while no frame is open
+
+        std::string trace_path;
+        bool trace_requested = false;
+    };
+
+    static profiler_state g_profiler;
+    static thread_local uint32_t t_depth = 0;
+
+    static uint64_t now_ns() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void push(thread_ring& r, const char* name, uint64_t start, uint64_t end, uint32_t depth) {
+        uint64_t h = r.head.load(std::memory_order_relaxed);
+        r.events[h & (RING_SIZE - 1)] = event{ name, start, (uint32_t)std::min<uint64_t>(end - start, UINT32_MAX), depth };
+        r.head.store(h + 1, std::memory_order_release);
+    }
+
+    void init() {
+        profiler_state& p = g_profiler;
+        p.epoch = now_ns();
+        int threads = std::max(Jobs::thread_count(), 1);
+        for (int i = 0; i < threads; i++)
+            p.rings.push_back(std::make_unique<thread_ring>());
+        for (gpu_frame& f : p.gpu) {
+            glGenQueries(MAX_GPU_SCOPES * 2, f.queries);
+            f.count = 0;
+            f.pending = false;
+        }
+        p.frames.resize(FRAME_HISTORY);
+        p.ready = true;
+        printf("[PROFILER] %d threads, %llu events each\n", threads, (unsigned long long)RING_SIZE);
+    }
+
+    void shutdown() {
+        profiler_state& p = g_profiler;
+        if (!p.ready)
+            return;
+        for (gpu_frame& f : p.gpu)
+            glDeleteQueries(MAX_GPU_SCOPES * 2, f.queries);
+        p.rings.clear();
+        p.ready = false;
+    }
+
+    uint64_t scope_begin() {
+        t_depth++;
+        return now_ns();
+    }
+
+    void scope_end(const char* name, uint64_t start) {
+        uint64_t end = now_ns();
+        t_depth--;
+        int thread = Jobs::thread_index();
+        // threads the job system doesnt know about have no ring
+        if (thread < 0 || thread >= (int)g_profiler.rings.size())
+            return;
+        push(*g_profiler.rings[thread], name, start, end, t_depth);
+    }
+
+    int gpu_begin(const char* name) {
+        profiler_state& p = g_profiler;
+        if (!p.ready)
+            return -1;
+        gpu_frame& f = p.gpu[p.gpu_current];
+        if (f.count >= MAX_GPU_SCOPES)
+            return -1;
+        int i = f.count++;
+        glQueryCounter(f.queries[i * 2], GL_TIMESTAMP);
+        f.names[i] = name;
+        f.depths[i] = (uint8_t)p.gpu_depth++;
+        f.cpu_start[i] = now_ns();
+        return i;
+    }
+
+    void gpu_end(int scope) {
+        profiler_state& p = g_profiler;
+        gpu_frame& f = p.gpu[p.gpu_current];
+        f.last_query = f.queries[scope * 2 + 1];
+        glQueryCounter(f.last_query, GL_TIMESTAMP);
+        f.cpu_ms[scope] = (now_ns() - f.cpu_start[scope]) / 1000000.0f;
+        p.gpu_depth--;
+    }
+
+    void counter(const char* name, int64_t value) {
+        profiler_state& p = g_profiler;
+        int i = 0;
+        while (i < p.counter_count && p.counter_names[i] != name && strcmp(p.counter_names[i], name))
+            i++;
+        if (i == p.counter_count) {
+            if (i == MAX_COUNTERS)
+                return;
+            p.counter_names[i] = name;
+            p.counter_count++;
+        }
+        p.counter_values[i] = value;
+    }
+
+    // results that arent ready yet are dropped, passes keeps the last frame that was
+    static void collect(gpu_frame& f) {
+        if (!f.pending)
+            return;
+        f.pending = false;
+        if (f.count == 0)
+            return;
+        GLint ready = 0;
+        glGetQueryObjectiv(f.last_query, GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready)
+            return;
+
+        profiler_state& p = g_profiler;
+        p.passes.clear();
+        for (int i = 0; i < f.count; i++) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(f.queries[i * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(f.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+            p.passes.push_back({ f.names[i], f.depths[i], f.cpu_ms[i], (end - begin) / 1000000.0f });
+            push(p.gpu_ring, f.names[i], (uint64_t)((int64_t)begin + f.gpu_to_cpu), (uint64_t)((int64_t)end + f.gpu_to_cpu), f.depths[i]);
+        }
+    }
+
+    void begin_frame() {
+        profiler_state& p = g_profiler;
+        if (!p.ready)
+            return;
+        uint64_t now = now_ns();
+        if (p.frame_start) {
+            frame_record& r = p.frames[p.frame_count % FRAME_HISTORY];
+            r.start = p.frame_start;
+            r.end = now;
+            std::copy(p.counter_values, p.counter_values + MAX_COUNTERS, r.counters);
+            p.frame_count++;
+        }
+        // between frames the workers are idle, so the rings hold still while this reads them
+        if (p.trace_requested) {
+            write_trace(p.trace_path);
+            p.trace_requested = false;
+        }
+        if (!enabled) {
+            p.frame_start = 0;
+            return;
+        }
+        p.frame_start = now;
+
+        p.gpu_current = (p.gpu_current + 1) % LATENCY;
+        gpu_frame& f = p.gpu[p.gpu_current];
+        collect(f);
+        f.count = 0;
+        GLint64 gpu_now = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+        f.gpu_to_cpu = (int64_t)now_ns() - gpu_now;
+        f.pending = true;
+    }
+
+    void request_trace(const std::string& path) {
+        g_profiler.trace_path = path.empty() ? "trace_" + std::to_string(g_profiler.frame_count) + ".json" : path;
+        g_profiler.trace_requested = true;
+    }
+
+    static void write_string(FILE* f, const char* s) {
+        fputc('"', f);
+        for (; *s; s++) {
+            if (*s == '"' || *s == '\\')
+                fputc('\\', f);
+            fputc(*s, f);
+        }
+        fputc('"', f);
+    }
+
+    static double trace_us(uint64_t ns) {
+        return (double)(int64_t)(ns - g_profiler.epoch) / 1000.0;
+    }
+
+    static void write_events(FILE* f, const thread_ring& r, int tid, bool& first) {
+        uint64_t head = r.head.load(std::memory_order_acquire);
+        uint64_t count = std::min(head, RING_SIZE);
+        for (uint64_t i = head - count; i < head; i++) {
+            const event& e = r.events[i & (RING_SIZE - 1)];
+            fputs(first ? "" : ",\n", f);
+            first = false;
+            fputs("{\"name\":", f);
+            write_string(f, e.name);
+            fprintf(f, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}", trace_us(e.start), e.duration / 1000.0, tid);
+        }
+    }
+
+    static void write_thread_name(FILE* f, int tid, const char* name, bool& first) {
+        fputs(first ? "" : ",\n", f);
+        first = false;
+        fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", tid, name);
+    }
+
+    bool write_trace(const std::string& path) {
+        profiler_state& p = g_profiler;
+        FILE* f = fopen(path.c_str(), "w");
+        if (!f) {
+            printf("[PROFILER] cant write %s\n", path.c_str());
+            return false;
+        }
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+        bool first = true;
+
+        char name[32];
+        for (int t = 0; t < (int)p.rings.size(); t++) {
+            snprintf(name, sizeof(name), t == 0 ? "main" : "worker %d", t);
+            write_thread_name(f, t, name, first);
+            write_events(f, *p.rings[t], t, first);
+        }
+        write_thread_name(f, GPU_TID, "gpu", first);
+        write_events(f, p.gpu_ring, GPU_TID, first);
+
+        write_thread_name(f, FRAME_TID, "frames", first);
+        uint64_t kept = std::min<uint64_t>(p.frame_count, FRAME_HISTORY);
+        for (uint64_t i = p.frame_count - kept; i < p.frame_count; i++) {
+            const frame_record& r = p.frames[i % FRAME_HISTORY];
+            fprintf(f, ",\n{\"name\":\"frame %llu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                (unsigned long long)i, trace_us(r.start), (r.end - r.start) / 1000.0, FRAME_TID);
+            for (int c = 0; c < p.counter_count; c++) {
+                fputs(",\n{\"name\":", f);
+                write_string(f, p.counter_names[c]);
+                fprintf(f, ",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"value\":%lld}}", trace_us(r.start), (long long)r.counters[c]);
+            }
+        }
+        fputs("\n]}\n", f);
+        fclose(f);
+        printf("[PROFILER] wrote %s, %llu frames\n", path.c_str(), (unsigned long long)kept);
+        return true;
+    }
+
+    const std::vector<pass_timing>& passes() {
+        return g_profiler.passes;
+    }
+
+    frame_stats get_frame_stats() {
+        frame_stats s;
+        std::vector<float> times;
+        frame_history(times);
+        if (times.empty())
+            return s;
+        double total = 0.0;
+        for (float t : times)
+            total += t;
+        std::sort(times.begin(), times.end());
+        auto percentile = [&](float q) { return times[std::min(times.size() - 1, (size_t)(q * times.size()))]; };
+        s.frames = (uint32_t)times.size();
+        s.mean_ms = (float)(total / times.size());
+        s.p50_ms = percentile(0.5f);
+        s.p95_ms = percentile(0.95f);
+        s.p99_ms = percentile(0.99f);
+        s.max_ms = times.back();
+        return s;
+    }
+
+    void frame_history(std::vector<float>& out_ms) {
+        const profiler_state& p = g_profiler;
+        out_ms.clear();
+        uint64_t kept = std::min<uint64_t>(p.frame_count, FRAME_HISTORY);
+        for (uint64_t i = p.frame_count - kept; i < p.frame_count; i++) {
+            const frame_record& r = p.frames[i % FRAME_HISTORY];
+            out_ms.push_back((r.end - r.start) / 1000000.0f);
+        }
+    }
+
+    void counters(std::vector<counter_value>& out) {
+        const profiler_state& p = g_profiler;
+        out.clear();
+        if (!p.frame_count)
+            return;
+        const frame_record& r = p.frames[(p.frame_count - 1) % FRAME_HISTORY];
+        for (int c = 0; c < p.counter_count; c++)
+            out.push_back({ p.counter_names[c], r.counters[c] });
+    }
+}
+#endif
@@ -0,0 +1,100 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// frame profiler
+//   cpu scopes go into a ring per job thread (Jobs::thread_index), nothing is shared or locked on the way in
+//   gpu scopes put a GL_TIMESTAMP query on each side, results are read LATENCY frames later and only if ready
+//   counters are plain values set once a frame, kept per frame next to the frame time
+//   begin_frame closes the previous frame, collects the gpu results and writes a requested trace
+//   write_trace dumps what the rings still hold as chrome trace json (chrome://tracing, ui.perfetto.dev)
+// everything goes through the PROFILE_ macros, without GLOW_PROFILE they compile to nothing
+// and profiler.cpp is empty. enabled turns recording off at runtime
+namespace Profiler {
+    static const int LATENCY = 3;           // frames a gpu result is given before its queries are reused
+    static const int MAX_GPU_SCOPES = 32;   // per frame
+    static const int MAX_COUNTERS = 16;
+    static const int FRAME_HISTORY = 1024;  // frames kept for percentiles, counters and the trace
+
+    struct pass_timing {
+        const char* name;
+        int depth;
+        float cpu_ms;
+        float gpu_ms;
+    };
+
+    struct frame_stats {
+        uint32_t frames = 0;
+        float mean_ms = 0.0f;
+        float p50_ms = 0.0f;
+        float p95_ms = 0.0f;
+        float p99_ms = 0.0f;
+        float max_ms = 0.0f;
+    };
+
+    struct counter_value {
+        const char* name;
+        int64_t value;
+    };
+
+    extern bool enabled;
+
+    // after Jobs::init and with the gl context current
+    void init();
+    void shutdown();
+
+    void begin_frame();
+    // written at the next begin_frame, empty path picks trace_<frame>.json
+    void request_trace(const std::string& path = "");
+    bool write_trace(const std::string& path);
+
+    // name has to outlive the profiler, string literals
+    uint64_t scope_begin();
+    void scope_end(const char* name, uint64_t start);
+    // -1 when nothing was recorded (disabled, out of queries)
+    int gpu_begin(const char* name);
+    void gpu_end(int scope);
+    void counter(const char* name, int64_t value);
+
+    // newest gpu results, LATENCY frames behind
+    const std::vector<pass_timing>& passes();
+    // over the kept history
+    frame_stats get_frame_stats();
+    // oldest first, for a plot
+    void frame_history(std::vector<float>& out_ms);
+    // values set during the last finished frame
+    void counters(std::vector<counter_value>& out);
+
+    struct scope {
+        const char* name;
+        uint64_t start;
+        explicit scope(const char* n) : name(enabled ? n : nullptr), start(enabled ? scope_begin() : 0) {}
+        ~scope() { if (name) scope_end(name, start); }
+    };
+
+    struct gpu_scope {
+        int index;
+        explicit gpu_scope(const char* name) : index(enabled ? gpu_begin(name) : -1) {}
+        ~gpu_scope() { if (index >= 0) gpu_end(index); }
+    };
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef GLOW_PROFILE
+#define PROFILE_SCOPE(name) Profiler::scope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+// cpu and gpu time of a pass, only on the thread that owns the gl context
+#define PROFILE_GPU_SCOPE(name) PROFILE_SCOPE(name); Profiler::gpu_scope PROFILE_CONCAT(profile_gpu_scope_, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) Profiler::counter(name, (int64_t)(value))
+#define PROFILE_FRAME() Profiler::begin_frame()
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_GPU_SCOPE(name) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
+#endif
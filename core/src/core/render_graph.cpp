@@ -0,0 +1,425 @@
+#include "render_graph.h"
+
+#include <cstdio>
+#include <cassert>
+#include <queue>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "profiler.h"
+
+namespace {
+    uint32_t bytes_per_pixel(unsigned int format) {
+        switch (format) {
+        case GL_R8: return 1;
+        case GL_RG8: case GL_DEPTH_COMPONENT16: case GL_R16F: return 2;
+        case GL_RGBA16F: case GL_RG32F: return 8;
+        case GL_RGBA32F: return 16;
+        case GL_DEPTH32F_STENCIL8: return 8;
+        default: return 4; // RGBA8, RGB10_A2, R11F_G11F_B10F, 32F and 24/8 depth
+        }
+    }
+
+    bool is_depth(unsigned int format) {
+        return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F
+            || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    bool has_stencil(unsigned int format) {
+        return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+}
+
+// builder
+
+Render_graph::resource Render_graph::builder::create(const char* name, const texture_desc& desc) {
+    resource r = (resource)graph.nodes.size();
+    graph.physicals.push_back(physical{ name, desc, false, 0, 0, false, r, -1, -1 });
+    graph.nodes.push_back(node{ (uint32_t)graph.physicals.size() - 1, NONE, NONE, 0 });
+    return r;
+}
+
+Render_graph::resource Render_graph::builder::read(resource r) {
+    assert(r < graph.nodes.size());
+    graph.passes[pass].reads.push_back(r);
+    return r;
+}
+
+Render_graph::resource Render_graph::builder::write(resource r) {
+    resource written = graph.new_version(r, pass);
+    graph.passes[pass].writes.push_back(written);
+    return written;
+}
+
+Render_graph::resource Render_graph::builder::write_color(resource r, int slot) {
+    assert(slot >= 0 && slot < MAX_COLOR_ATTACHMENTS);
+    resource written = write(r);
+    graph.passes[pass].colors[slot] = written;
+    return written;
+}
+
+Render_graph::resource Render_graph::builder::write_depth(resource r) {
+    resource written = write(r);
+    graph.passes[pass].depth = written;
+    return written;
+}
+
+void Render_graph::builder::side_effect() {
+    graph.passes[pass].side_effect = true;
+}
+
+// graph
+
+Render_graph::resource Render_graph::new_version(resource r, uint32_t writer) {
+    assert(r < nodes.size());
+    physical& p = physicals[nodes[r].physical];
+    // writing an old version would fork the resource
+    assert(p.latest == r);
+    resource v = (resource)nodes.size();
+    nodes.push_back(node{ nodes[r].physical, writer, r, 0 });
+    p.latest = v;
+    return v;
+}
+
+void Render_graph::reset() {
+    physicals.clear();
+    nodes.clear();
+    passes.clear();
+    presented.clear();
+    order.clear();
+    stats = graph_stats();
+}
+
+Render_graph::resource Render_graph::import_texture(const char* name, unsigned int texture) {
+    resource r = (resource)nodes.size();
+    // never an attachment, so the size doesnt matter
+    physicals.push_back(physical{ name, texture_desc{ 0, 0, 0 }, true, texture, 0, false, r, -1, -1 });
+    nodes.push_back(node{ (uint32_t)physicals.size() - 1, NONE, NONE, 0 });
+    return r;
+}
+
+Render_graph::resource Render_graph::import_framebuffer(const char* name, unsigned int fbo, int width, int height) {
+    resource r = (resource)nodes.size();
+    physicals.push_back(physical{ name, texture_desc{ width, height, 0 }, true, 0, fbo, true, r, -1, -1 });
+    nodes.push_back(node{ (uint32_t)physicals.size() - 1, NONE, NONE, 0 });
+    return r;
+}
+
+void Render_graph::add_pass(const char* name, const std::function<void(builder&)>& setup, std::function<void()> execute) {
+    pass p;
+    p.name = name;
+    for (resource& c : p.colors)
+        c = NONE;
+    p.depth = NONE;
+    p.side_effect = false;
+    p.culled = false;
+    p.refs = 0;
+    p.execute = std::move(execute);
+    passes.push_back(std::move(p));
+
+    builder b(*this, (uint32_t)passes.size() - 1);
+    setup(b);
+}
+
+void Render_graph::present(resource r) {
+    assert(r < nodes.size());
+    presented.push_back(r);
+}
+
+void Render_graph::compile() {
+    // culling, a pass lives while any of its writes is read, nodes nobody reads drop their writer
+    for (node& n : nodes)
+        n.refs = 0;
+    for (pass& p : passes) {
+        p.refs = (uint32_t)p.writes.size();
+        p.culled = false;
+        for (resource r : p.reads)
+            nodes[r].refs++;
+    }
+    for (resource r : presented)
+        nodes[r].refs++;
+
+    std::vector<resource> unused;
+    for (resource r = 0; r < nodes.size(); r++)
+        if (nodes[r].refs == 0)
+            unused.push_back(r);
+    while (!unused.empty()) {
+        resource r = unused.back();
+        unused.pop_back();
+        uint32_t writer = nodes[r].writer;
+        if (writer == NONE || passes[writer].side_effect)
+            continue;
+        pass& p = passes[writer];
+        if (--p.refs > 0)
+            continue;
+        p.culled = true;
+        for (resource read : p.reads)
+            if (--nodes[read].refs == 0)
+                unused.push_back(read);
+    }
+    // a pass that writes nothing at all is only there for its side effects
+    for (pass& p : passes)
+        if (p.writes.empty() && !p.side_effect)
+            p.culled = true;
+
+    // edges: writer of what a pass reads, and for each write the writer and readers of the version it replaces
+    uint32_t count = (uint32_t)passes.size();
+    std::vector<std::vector<uint32_t>> readers(nodes.size());
+    for (uint32_t i = 0; i < count; i++)
+        for (resource r : passes[i].reads)
+            readers[r].push_back(i);
+
+    std::vector<std::vector<uint32_t>> edges(count);
+    std::vector<uint32_t> incoming(count, 0);
+    auto edge = [&](uint32_t from, uint32_t to) {
+        if (from == NONE || from == to || passes[from].culled || passes[to].culled)
+            return;
+        edges[from].push_back(to);
+        incoming[to]++;
+    };
+    for (uint32_t i = 0; i < count; i++) {
+        for (resource r : passes[i].reads)
+            edge(nodes[r].writer, i);
+        for (resource w : passes[i].writes) {
+            resource previous = nodes[w].previous;
+            edge(nodes[previous].writer, i);
+            for (uint32_t reader : readers[previous])
+                edge(reader, i);
+        }
+    }
+
+    // kahn, lowest index first so independent passes keep the order they were added in
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+    for (uint32_t i = 0; i < count; i++)
+        if (!passes[i].culled && incoming[i] == 0)
+            ready.push(i);
+    order.clear();
+    while (!ready.empty()) {
+        uint32_t i = ready.top();
+        ready.pop();
+        order.push_back(i);
+        for (uint32_t to : edges[i])
+            if (--incoming[to] == 0)
+                ready.push(to);
+    }
+
+    stats.passes = count;
+    stats.culled = 0;
+    for (const pass& p : passes)
+        stats.culled += p.culled ? 1 : 0;
+    if (order.size() + stats.culled != count)
+        printf("[GRAPH] cycle, %zu of %u passes ordered\n", order.size(), count - stats.culled);
+
+    // lifetimes in order positions
+    for (int i = 0; i < (int)order.size(); i++) {
+        const pass& p = passes[order[i]];
+        for (const std::vector<resource>* list : { &p.reads, &p.writes })
+            for (resource r : *list) {
+                physical& ph = physicals[nodes[r].physical];
+                if (ph.first < 0)
+                    ph.first = i;
+                ph.last = i;
+            }
+    }
+    for (const physical& ph : physicals)
+        if (!ph.imported && ph.first >= 0) {
+            stats.transients++;
+            stats.transient_bytes += (uint64_t)ph.desc.width * ph.desc.height * bytes_per_pixel(ph.desc.format);
+        }
+}
+
+unsigned int Render_graph::acquire(const texture_desc& desc) {
+    for (pooled& p : pool)
+        if (!p.in_use && p.desc == desc) {
+            if (p.unused_frames >= 0)
+                stats.aliased_bytes += (uint64_t)desc.width * desc.height * bytes_per_pixel(desc.format);
+            p.in_use = true;
+            p.unused_frames = -1;
+            return p.texture;
+        }
+
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, desc.format, desc.width, desc.height);
+    // attachments get read with texelFetch, never filtered
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    pool.push_back(pooled{ desc, texture, true, -1 });
+    stats.aliased_bytes += (uint64_t)desc.width * desc.height * bytes_per_pixel(desc.format);
+    return texture;
+}
+
+void Render_graph::release(unsigned int texture) {
+    for (pooled& p : pool)
+        if (p.texture == texture) {
+            p.in_use = false;
+            return;
+        }
+}
+
+unsigned int Render_graph::framebuffer_for(const pass& p, int& width, int& height) {
+    // an imported framebuffer stands alone
+    resource first = p.colors[0] != NONE ? p.colors[0] : p.depth;
+    const physical& target = physicals[nodes[first].physical];
+    width = target.desc.width;
+    height = target.desc.height;
+    if (target.is_framebuffer)
+        return target.fbo;
+
+    unsigned int key[MAX_COLOR_ATTACHMENTS + 1] = {};
+    for (int c = 0; c < MAX_COLOR_ATTACHMENTS; c++)
+        if (p.colors[c] != NONE)
+            key[c] = physicals[nodes[p.colors[c]].physical].texture;
+    if (p.depth != NONE)
+        key[MAX_COLOR_ATTACHMENTS] = physicals[nodes[p.depth].physical].texture;
+
+    for (cached_fbo& f : fbos)
+        if (std::equal(key, key + MAX_COLOR_ATTACHMENTS + 1, f.attachments)) {
+            f.unused_frames = -1;
+            return f.fbo;
+        }
+
+    cached_fbo f;
+    std::copy(key, key + MAX_COLOR_ATTACHMENTS + 1, f.attachments);
+    f.unused_frames = -1;
+    glGenFramebuffers(1, &f.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, f.fbo);
+    unsigned int draw_buffers[MAX_COLOR_ATTACHMENTS];
+    int draw_count = 0;
+    for (int c = 0; c < MAX_COLOR_ATTACHMENTS; c++) {
+        if (!key[c])
+            continue;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + c, GL_TEXTURE_2D, key[c], 0);
+        draw_buffers[draw_count++] = GL_COLOR_ATTACHMENT0 + c;
+    }
+    if (key[MAX_COLOR_ATTACHMENTS]) {
+        unsigned int format = physicals[nodes[p.depth].physical].desc.format;
+        assert(is_depth(format));
+        glFramebufferTexture2D(GL_FRAMEBUFFER, has_stencil(format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, key[MAX_COLOR_ATTACHMENTS], 0);
+    }
+    if (draw_count)
+        glDrawBuffers(draw_count, draw_buffers);
+    else
+        glDrawBuffer(GL_NONE);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("[GRAPH] FB error in %s: 0x%x\n", p.name, status);
+        assert(false);
+    }
+    fbos.push_back(f);
+    // execute does the real bind and counts it
+    bound_fbo = ~0u;
+    return f.fbo;
+}
+
+void Render_graph::execute() {
+    // anything could have been bound since last frame
+    bound_fbo = ~0u;
+
+    for (int i = 0; i < (int)order.size(); i++) {
+        pass& p = passes[order[i]];
+        for (physical& ph : physicals)
+            if (!ph.imported && ph.first == i)
+                ph.texture = acquire(ph.desc);
+
+        bool targets = p.depth != NONE;
+        for (resource c : p.colors)
+            targets |= c != NONE;
+        if (targets) {
+            int width, height;
+            unsigned int fbo = framebuffer_for(p, width, height);
+            if (fbo != bound_fbo) {
+                glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+                bound_fbo = fbo;
+                stats.fbo_binds++;
+            }
+            else {
+                stats.fbo_binds_skipped++;
+            }
+            glViewport(0, 0, width, height);
+        }
+
+        {
+            PROFILE_GPU_SCOPE(p.name);
+            p.execute();
+        }
+        // passes without attachments bind whatever they like
+        if (!targets)
+            bound_fbo = ~0u;
+
+        for (physical& ph : physicals)
+            if (!ph.imported && ph.last == i) {
+                release(ph.texture);
+                ph.texture = 0;
+            }
+    }
+    trim();
+
+    stats.pooled_textures = (uint32_t)pool.size();
+    stats.pool_bytes = 0;
+    for (const pooled& p : pool)
+        stats.pool_bytes += (uint64_t)p.desc.width * p.desc.height * bytes_per_pixel(p.desc.format);
+}
+
+// textures and fbos nothing used for pool_frames frames go, fbos with a deleted attachment go with them
+void Render_graph::trim() {
+    for (size_t i = 0; i < pool.size();) {
+        pooled& p = pool[i];
+        if (++p.unused_frames <= pool_frames) {
+            i++;
+            continue;
+        }
+        for (cached_fbo& f : fbos)
+            if (std::find(f.attachments, f.attachments + MAX_COLOR_ATTACHMENTS + 1, p.texture) != f.attachments + MAX_COLOR_ATTACHMENTS + 1)
+                f.unused_frames = pool_frames + 1;
+        glDeleteTextures(1, &p.texture);
+        pool[i] = pool.back();
+        pool.pop_back();
+    }
+    for (size_t i = 0; i < fbos.size();) {
+        cached_fbo& f = fbos[i];
+        if (++f.unused_frames <= pool_frames) {
+            i++;
+            continue;
+        }
+        if (bound_fbo == f.fbo)
+            bound_fbo = ~0u;
+        glDeleteFramebuffers(1, &f.fbo);
+        fbos[i] = fbos.back();
+        fbos.pop_back();
+    }
+}
+
+void Render_graph::shutdown() {
+    for (const pooled& p : pool)
+        glDeleteTextures(1, &p.texture);
+    for (const cached_fbo& f : fbos)
+        glDeleteFramebuffers(1, &f.fbo);
+    pool.clear();
+    fbos.clear();
+    reset();
+}
+
+unsigned int Render_graph::texture(resource r) const {
+    assert(r < nodes.size());
+    return physicals[nodes[r].physical].texture;
+}
+
+void Render_graph::describe(std::vector<const char*>& names, std::vector<uint8_t>& culled) const {
+    names.clear();
+    culled.clear();
+    for (uint32_t i : order) {
+        names.push_back(passes[i].name);
+        culled.push_back(0);
+    }
+    for (const pass& p : passes)
+        if (p.culled) {
+            names.push_back(p.name);
+            culled.push_back(1);
+        }
+}
@@ -0,0 +1,150 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+// per frame graph of render passes, rebuilt every frame
+//   passes declare what they create, read and write in setup, the graph then
+//   - culls passes nothing needed reads from (walking back from present and side effects)
+//   - orders what is left by its dependencies (read after write and write after read on each resource),
+//     ties keep the order passes were added in
+//   - gives transient textures a pooled gl texture only from their first to their last use,
+//     so resources whose lifetimes dont overlap share memory, and textures nobody asked for in a while are freed
+//   - binds the framebuffer of a pass's attachments before running it, fbos are cached per attachment set
+//     and a bind is skipped when that fbo is already bound
+// every write makes a new version of the resource, so a handle always means "the contents after that write"
+// imported resources (shadow maps, the window) belong to someone else and are never pooled or freed
+class Render_graph {
+public:
+    typedef uint32_t resource;
+    static const resource NONE = ~0u;
+    static const int MAX_COLOR_ATTACHMENTS = 4;
+
+    struct texture_desc {
+        int width;
+        int height;
+        unsigned int format; // sized gl internal format
+        bool operator==(const texture_desc& o) const { return width == o.width && height == o.height && format == o.format; }
+    };
+
+    struct graph_stats {
+        uint32_t passes = 0;
+        uint32_t culled = 0;
+        uint32_t transients = 0;       // transient resources declared
+        uint32_t pooled_textures = 0;  // gl textures in the pool after the frame
+        uint64_t transient_bytes = 0;  // what the transients would take if each had its own texture
+        uint64_t aliased_bytes = 0;    // what they actually used from the pool
+        uint64_t pool_bytes = 0;       // everything the pool holds
+        uint32_t fbo_binds = 0;
+        uint32_t fbo_binds_skipped = 0;
+    };
+
+    class builder {
+    public:
+        resource create(const char* name, const texture_desc& desc);
+        resource read(resource r);
+        // written some other way than as an attachment (the pass binds it itself, storage, copies)
+        resource write(resource r);
+        resource write_color(resource r, int slot = 0);
+        resource write_depth(resource r);
+        // the pass is kept even when nothing reads what it writes (queries, readbacks)
+        void side_effect();
+
+    private:
+        friend class Render_graph;
+        builder(Render_graph& g, uint32_t p) : graph(g), pass(p) {}
+        Render_graph& graph;
+        uint32_t pass;
+    };
+
+    // needs a gl context for execute / shutdown
+    void shutdown();
+
+    // drops last frame's passes and resources, the pool and fbo cache stay
+    void reset();
+    resource import_texture(const char* name, unsigned int texture);
+    // an existing framebuffer as a single attachment target, 0 is the window
+    resource import_framebuffer(const char* name, unsigned int fbo, int width, int height);
+
+    // setup runs right away, execute during execute() if the pass survives compile()
+    void add_pass(const char* name, const std::function<void(builder&)>& setup, std::function<void()> execute);
+    // r is a final output, its writers and everything they need survive culling
+    void present(resource r);
+
+    void compile();
+    void execute();
+
+    // the gl texture behind a resource, transients only have one while their passes run
+    unsigned int texture(resource r) const;
+    // what execute left bound, ~0u when a pass bound something itself
+    unsigned int bound_framebuffer() const { return bound_fbo; }
+
+    const graph_stats& get_stats() const { return stats; }
+    // pass names in execution order, culled ones marked, for the debug ui
+    void describe(std::vector<const char*>& names, std::vector<uint8_t>& culled) const;
+
+    int pool_frames = 60; // frames a pooled texture can go unused before it is deleted
+
+private:
+    struct physical {
+        const char* name;
+        texture_desc desc;
+        bool imported;
+        unsigned int texture;    // transients: assigned from the pool while alive
+        unsigned int fbo;        // imported framebuffers, else 0
+        bool is_framebuffer;
+        resource latest;         // only the newest version can be written
+        int first, last;         // positions in order, -1 when no surviving pass uses it
+    };
+
+    struct node {
+        uint32_t physical;
+        uint32_t writer;         // pass, NONE for the first version
+        resource previous;       // version this one was written over
+        uint32_t refs;
+    };
+
+    struct pass {
+        const char* name;
+        std::vector<resource> reads;
+        std::vector<resource> writes;
+        resource colors[MAX_COLOR_ATTACHMENTS];
+        resource depth;
+        bool side_effect;
+        bool culled;
+        uint32_t refs;
+        std::function<void()> execute;
+    };
+
+    struct pooled {
+        texture_desc desc;
+        unsigned int texture;
+        bool in_use;
+        int unused_frames;
+    };
+
+    struct cached_fbo {
+        unsigned int attachments[MAX_COLOR_ATTACHMENTS + 1]; // colors then depth, 0 when empty
+        unsigned int fbo;
+        int unused_frames;
+    };
+
+    resource new_version(resource r, uint32_t writer);
+    unsigned int acquire(const texture_desc& desc);
+    void release(unsigned int texture);
+    unsigned int framebuffer_for(const pass& p, int& width, int& height);
+    void trim();
+
+    std::vector<physical> physicals;
+    std::vector<node> nodes;
+    std::vector<pass> passes;
+    std::vector<resource> presented;
+    std::vector<uint32_t> order;
+    std::vector<pooled> pool;
+    std::vector<cached_fbo> fbos;
+    unsigned int bound_fbo = ~0u;
+    graph_stats stats;
+};
+#endif
@@ -0,0 +1,260 @@
+#include "render_queue.h"
+
+#include <chrono>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "asset/texture_manager.h"
+#include "asset/geometry_pool.h"
+
+namespace {
+    constexpr int PASS_SHIFT = 60;
+    constexpr int SHADER_SHIFT = 52;
+    constexpr int MATERIAL_SHIFT = 32;
+    constexpr int MESH_SHIFT = 16;
+    constexpr int LOD_SHIFT = 14;
+    constexpr uint64_t SHADER_MASK = 0xFF;
+    constexpr uint64_t MATERIAL_MASK = 0xFFFFF;
+    constexpr uint64_t MESH_MASK = 0xFFFF;
+    constexpr uint64_t LOD_MASK = 0x3;
+    constexpr uint64_t DEPTH_MASK = 0x3FFF;
+
+    enum texture_unit {
+        UNIT_ALBEDO = 0,
+        UNIT_NORMAL,
+        UNIT_METALLIC_ROUGHNESS,
+        UNIT_COUNT
+    };
+}
+
+uint32_t Render_queue::material_id(const Material& m) {
+    // texture handles are indices into the texture manager, 21 bits each is plenty
+    uint64_t packed = ((uint64_t)m.albedo_map << 42) | ((uint64_t)m.normal_map << 21) | (uint64_t)m.metallic_roughness_map;
+    auto it = material_ids.find(packed);
+    if (it != material_ids.end())
+        return it->second;
+
+    uint32_t id = (uint32_t)(material_ids.size() + 1) & MATERIAL_MASK;
+    material_ids.emplace(packed, id);
+    return id;
+}
+
+void Render_queue::add_model(render_pass pass, shader_handle shader, model_handle model, const glm::mat4& model_matrix, const glm::mat3* normal_matrix, const glm::vec3& eye, float far_plane, int lod) {
+    float distance = glm::length(glm::vec3(model_matrix[3]) - eye) / far_plane;
+    uint64_t depth = (uint64_t)(glm::clamp(distance, 0.0f, 1.0f) * DEPTH_MASK);
+
+    for (const Mesh& mesh : Model_manager::get_model(model).get_meshes()) {
+        // depth only passes dont bind materials, so dont split runs on them
+        uint64_t material = normal_matrix ? material_id(mesh.material) : 0;
+        int mesh_lod = std::min(lod, mesh.lod_count() - 1);
+
+        draw_packet p;
+        p.key = ((uint64_t)pass << PASS_SHIFT)
+            | (((uint64_t)shader & SHADER_MASK) << SHADER_SHIFT)
+            | (material << MATERIAL_SHIFT)
+            | (((uint64_t)mesh.geometry_id() & MESH_MASK) << MESH_SHIFT)
+            | (((uint64_t)mesh_lod & LOD_MASK) << LOD_SHIFT)
+            | depth;
+        p.mesh = &mesh;
+        p.model = &model_matrix;
+        p.normal = normal_matrix;
+        p.shader = shader;
+        p.lod = (uint8_t)mesh_lod;
+        packets.push_back(p);
+    }
+}
+
+// lsd radix sort on bytes, bytes every key shares are skipped (usually pass and shader)
+void Render_queue::sort() {
+    size_t count = packets.size();
+    if (count < 2)
+        return;
+    scratch.resize(count);
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        uint32_t histogram[256] = {};
+        for (const draw_packet& p : packets)
+            histogram[(p.key >> shift) & 0xFF]++;
+        if (histogram[(packets[0].key >> shift) & 0xFF] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (uint32_t& h : histogram) {
+            uint32_t c = h;
+            h = offset;
+            offset += c;
+        }
+        for (const draw_packet& p : packets)
+            scratch[histogram[(p.key >> shift) & 0xFF]++] = p;
+        packets.swap(scratch);
+    }
+}
+
+void Render_queue::init() {
+    instance_capacity = 1024;
+    glGenBuffers(1, &instance_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instance_capacity * sizeof(instance_data), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glGenBuffers(1, &command_buffer);
+}
+
+void Render_queue::shutdown() {
+    glDeleteBuffers(1, &instance_buffer);
+    glDeleteBuffers(1, &command_buffer);
+    instance_buffer = command_buffer = 0;
+}
+
+void Render_queue::begin_frame() {
+    stats = render_stats();
+    instance_offset = 0;
+    // orphan last frames storage so the driver doesnt wait on draws still reading it
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instance_capacity * sizeof(instance_data), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+uint32_t Render_queue::upload_instances(const std::vector<instance_data>& data) {
+    uint32_t count = (uint32_t)data.size();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance_buffer);
+    if (instance_offset + count > instance_capacity) {
+        // sized for the whole frame so far, draws already issued keep the old storage so this one starts over at 0
+        while (instance_capacity < instance_offset + count)
+            instance_capacity *= 2;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, instance_capacity * sizeof(instance_data), nullptr, GL_STREAM_DRAW);
+        instance_offset = 0;
+    }
+    uint32_t base = instance_offset;
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, base * sizeof(instance_data), count * sizeof(instance_data), data.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    instance_offset += count;
+    Geometry_pool::reserve_instance_ids(instance_capacity);
+    return base;
+}
+
+void Render_queue::submit(shader_handle bound) {
+    if (packets.empty())
+        return;
+    auto start = std::chrono::steady_clock::now();
+
+    // group runs of the same mesh and lod, everything above the depth bits matches inside a run
+    batches.clear();
+    instances.clear();
+    for (uint32_t i = 0; i < packets.size(); i++) {
+        const draw_packet& p = packets[i];
+        if (batches.empty() || (packets[batches.back().first].key >> LOD_SHIFT) != (p.key >> LOD_SHIFT) || packets[batches.back().first].mesh != p.mesh)
+            batches.push_back(batch{ i, 0, (uint32_t)instances.size() });
+        batches.back().count++;
+
+        // pool positions are in the mesh's unit box, the instance matrix takes them back to model space first
+        instance_data d;
+        d.model = Vertex_format::dequantize(*p.model, p.mesh->quantization);
+        if (p.normal) {
+            d.normal[0] = glm::vec4((*p.normal)[0], 0.0f);
+            d.normal[1] = glm::vec4((*p.normal)[1], 0.0f);
+            d.normal[2] = glm::vec4((*p.normal)[2], 0.0f);
+        }
+        instances.push_back(d);
+    }
+    uint32_t base = upload_instances(instances);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BUFFER_BINDING, instance_buffer);
+
+    commands.clear();
+    for (const batch& b : batches) {
+        const draw_packet& p = packets[b.first];
+        commands.push_back(draw_command{ p.mesh->index_count(p.lod), b.count, p.mesh->first_index(p.lod), (int32_t)p.mesh->base_vertex(), base + b.base });
+    }
+    if (use_indirect) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(draw_command), commands.data(), GL_STREAM_DRAW);
+    }
+
+    shader_handle current = bound;
+    const Shader* shader = Shader_manager::get_shader(bound);
+    bool samplers_set = false;
+    // material uniforms are set per bucket, their locations only change with the program
+    struct material_locations { int diffuse, normal, metallic_roughness, has_normal, has_metallic_roughness; };
+    auto look_up = [](const Shader* s) {
+        return material_locations{ s->location("diffuse"), s->location("normal"), s->location("metallic_roughness"),
+                                   s->location("has_normal"), s->location("has_metallic_roughness") };
+    };
+    material_locations locations = look_up(shader);
+    // other draws (skybox, text, debug) bind textures between passes, so the cache only lives for one submit
+    texture_handle units[UNIT_COUNT] = { ~(texture_handle)0, ~(texture_handle)0, ~(texture_handle)0 };
+
+    auto bind = [&](texture_handle t, texture_unit unit) {
+        if (units[unit] == t)
+            return;
+        Texture_manager::bind(t, unit);
+        units[unit] = t;
+        stats.texture_binds++;
+    };
+
+    // every mesh lives in the pool, one vao for the whole submit
+    // depth only passes (no normal matrix) get the one that fetches nothing but positions
+    glBindVertexArray(packets[0].normal ? Geometry_pool::get_vao() : Geometry_pool::get_position_vao());
+    stats.vao_binds++;
+
+    // buckets of batches sharing pass, shader and material
+    for (size_t first = 0; first < batches.size();) {
+        const draw_packet& p = packets[batches[first].first];
+        size_t last = first + 1;
+        while (last < batches.size() && (packets[batches[last].first].key >> MATERIAL_SHIFT) == (p.key >> MATERIAL_SHIFT))
+            last++;
+
+        if (p.shader != current) {
+            shader = Shader_manager::get_shader(p.shader);
+            shader->use();
+            locations = look_up(shader);
+            current = p.shader;
+            samplers_set = false;
+            stats.program_switches++;
+        }
+
+        if (p.normal) {
+            if (!samplers_set) {
+                glUniform1i(locations.diffuse, UNIT_ALBEDO);
+                glUniform1i(locations.normal, UNIT_NORMAL);
+                glUniform1i(locations.metallic_roughness, UNIT_METALLIC_ROUGHNESS);
+                samplers_set = true;
+            }
+
+            // buckets are split on material, so every bucket sets it
+            const Material& m = p.mesh->material;
+            bind(m.albedo_map, UNIT_ALBEDO);
+            // maps still streaming in would bind missing.png, go without them until then
+            bool has_normal = m.has_normal && Texture_manager::ready(m.normal_map);
+            glUniform1i(locations.has_normal, (int)has_normal);
+            if (has_normal)
+                bind(m.normal_map, UNIT_NORMAL);
+            bool has_metallic_roughness = m.metallic_roughness_map != 0 && Texture_manager::ready(m.metallic_roughness_map);
+            glUniform1i(locations.has_metallic_roughness, (int)has_metallic_roughness);
+            if (has_metallic_roughness)
+                bind(m.metallic_roughness_map, UNIT_METALLIC_ROUGHNESS);
+        }
+
+        if (use_indirect) {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(first * sizeof(draw_command)), (GLsizei)(last - first), 0);
+            stats.draw_calls++;
+        }
+        else {
+            for (size_t c = first; c < last; c++) {
+                const draw_command& cmd = commands[c];
+                glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, cmd.count, GL_UNSIGNED_INT, (void*)((size_t)cmd.first_index * sizeof(unsigned int)), cmd.instance_count, cmd.base_vertex, cmd.base_instance);
+                stats.draw_calls++;
+            }
+        }
+        for (size_t c = first; c < last; c++) {
+            stats.instances += commands[c].instance_count;
+            stats.triangles += commands[c].count / 3 * commands[c].instance_count;
+        }
+        stats.commands += (uint32_t)(last - first);
+        first = last;
+    }
+
+    glBindVertexArray(0);
+    if (use_indirect)
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    stats.submit_ms += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
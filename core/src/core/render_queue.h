@@ -0,0 +1,118 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "asset/mesh.h"
+#include "asset/shader_manager.h"
+#include "asset/model_manager.h"
+
+// per pass list of draw packets, radix sorted by a 64 bit key and submitted in order
+// so runs of the same shader / material skip the rebinds
+//
+// key, most significant first:
+//   pass 4 | shader 8 | material 20 | mesh 16 | lod 2 | depth 14
+// depth sits under mesh and lod, so it only orders packets front to back inside one mesh+lod run,
+// those become the instances of one draw and still help early z there, across meshes the order is by mesh id
+//
+// packets of the same mesh and lod end up next to each other after the sort (same key above the depth bits),
+// each run is one indirect command whose instances read their matrices from an ssbo,
+// the index comes in through the geometry pool's instance id attribute (base instance + gl_InstanceID)
+// every material bucket (same key above the mesh bits) is then one glMultiDrawElementsIndirect
+
+// ssbo binding the instance shaders read from
+const unsigned int INSTANCE_BUFFER_BINDING = 1;
+
+enum render_pass {
+    PASS_SHADOW = 0,
+    PASS_OPAQUE,
+    PASS_EDITOR,
+    PASS_COUNT
+};
+
+struct draw_packet {
+    uint64_t key;
+    const Mesh* mesh;
+    const glm::mat4* model;
+    const glm::mat3* normal; // null in depth only passes
+    shader_handle shader;
+    uint8_t lod;
+};
+
+// std430 layout of struct instance { mat4 model; mat3 normal_matrix; }, mat3 columns are padded to vec4
+// model includes the mesh's position dequantize, normal_matrix is the entity's own
+struct instance_data {
+    glm::mat4 model;
+    glm::vec4 normal[3];
+};
+
+// glMultiDrawElementsIndirect command layout
+struct draw_command {
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t base_vertex;
+    uint32_t base_instance;
+};
+
+struct render_stats {
+    uint32_t draw_calls = 0; // gl calls, one per material bucket with indirect on
+    uint32_t commands = 0;   // meshes drawn
+    uint32_t instances = 0;
+    uint32_t triangles = 0;
+    uint32_t texture_binds = 0;
+    uint32_t program_switches = 0;
+    uint32_t vao_binds = 0;
+    float submit_ms = 0.0f;  // cpu time spent in submit
+};
+
+class Render_queue {
+public:
+    // needs a gl context
+    void init();
+    void shutdown();
+
+    void clear() { packets.clear(); }
+    // one packet per mesh of the model, eye / far give the depth bits
+    // meshes with a shorter lod chain than the model draw their last level
+    void add_model(render_pass pass, shader_handle shader, model_handle model, const glm::mat4& model_matrix, const glm::mat3* normal_matrix, const glm::vec3& eye, float far_plane, int lod = 0);
+    void sort();
+    // bound is the shader the caller already bound and set pass uniforms on
+    void submit(shader_handle bound);
+
+    // counters are summed over every submit until the next begin_frame, instance writes restart at the front of the buffer
+    void begin_frame();
+    const render_stats& get_stats() const { return stats; }
+    size_t size() const { return packets.size(); }
+
+    // off issues one glDrawElementsInstancedBaseVertexBaseInstance per command, for comparing cpu cost
+    bool use_indirect = true;
+
+private:
+    struct batch {
+        uint32_t first; // packet index
+        uint32_t count;
+        uint32_t base;  // instance index in the buffer
+    };
+
+    uint32_t material_id(const Material& m);
+    // reserves count instances this frame, returns the first index
+    uint32_t upload_instances(const std::vector<instance_data>& data);
+
+    std::vector<draw_packet> packets;
+    std::vector<draw_packet> scratch;
+    std::vector<batch> batches;
+    std::vector<instance_data> instances;
+    std::vector<draw_command> commands;
+    unsigned int command_buffer = 0;
+    unsigned int instance_buffer = 0;
+    uint32_t instance_capacity = 0;
+    uint32_t instance_offset = 0;
+    std::unordered_map<uint64_t, uint32_t> material_ids; // packed texture handles -> dense id, ids never change, 0 is no material
+    render_stats stats;
+};
+#endif
@@ -13,14 +13,29 @@
 
 #include "renderer_debug.h"
 #include "scene.h"
+#include "render_queue.h"
+#include "frame_uniforms.h"
+#include "clustered_lights.h"
+#include "shadow_cascades.h"
+#include "shadow_cache.h"
+#include "shadow_atlas.h"
+#include "render_graph.h"
+#include "gbuffer.h"
+#include "occlusion_culler.h"
+#include "offscreen_target.h"
+#include "headless.h"
+#include "profiler.h"
 #include "light.h"
 #include "asset/shader.h"
 #include "asset/model_ass.h"
 #include "asset/crosshair.h"
 #include "asset/shader_manager.h"
+#include "asset/geometry_pool.h"
 #include "asset/text.h"
 #include "player/player.h"
 #include "util/decompose.h"
+#include "util/frustum.h"
+#include "util/gpu_query.h"
 
 const float FAR_PLANE = 500.0f;
 
@@ -39,6 +54,23 @@ enum gizmo_modes {
 };
 std::string gize_mode_strs[]{"none", "translate", "rotate", "scale"};
 
+// every pass has its own view block slot and culls into its own visible list
+enum render_view {
+    VIEW_CAMERA = 0,
+    VIEW_SPOTLIGHT,
+    VIEW_CASCADE_0, // directional light, one per cascade
+    VIEW_CASCADE_1,
+    VIEW_CASCADE_2,
+    VIEW_CASCADE_3,
+    VIEW_TOP,   // editor ortho views, same order as ortho_view
+    VIEW_FRONT,
+    VIEW_SIDE,
+    VIEW_ATLAS_0,   // shadow atlas faces redrawn this frame, ATLAS_VIEW_COUNT of them
+    VIEW_COUNT = VIEW_ATLAS_0 + ATLAS_VIEW_COUNT
+};
+// named views, up to and including the first atlas slot
+const char* render_view_strs[]{"camera", "spotlight", "cascade 0", "cascade 1", "cascade 2", "cascade 3", "top", "front", "side", "atlas 0"};
+
 struct ortho_view_data {
     ortho_view type;
 
@@ -222,38 +254,74 @@ public:
     float get_time() { return static_cast<float>(glfwGetTime()); }
     bool open() { return !glfwWindowShouldClose(window); }
 
-    bool init(int width, int height, const char* title, bool edit_mode) {
+    // headless has no display at all: no glfw window, Headless::create_context makes an egl context straight
+    // on mesa's surfaceless platform (or an egl device), and frames go to an offscreen target instead of a back buffer
+    bool init(int width, int height, const char* title, bool edit_mode, bool headless_mode = false) {
         editor_mode = edit_mode;
+        headless = headless_mode;
         scr_width = width;
         scr_height = height;
 
-        glfwInit();
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-        window = glfwCreateWindow(width, height, title, NULL, NULL);
-        if (window == NULL) {
-            std::cout << "Failed to create GLFW window" << std::endl;
-            glfwTerminate();
-            return false;
-        } else {
-            std::cout << "GLFW window created successfully" << std::endl;
+        if (headless) {
+            if (!Headless::create_context())
+                return false;
+            if (!gladLoadGLLoader((GLADloadproc)Headless::proc_address)) {
+                std::cout << "Failed to initialize GLAD" << std::endl;
+                return false;
+            }
         }
+        else {
+            if (!glfwInit()) {
+                std::cout << "Failed to initialize GLFW" << std::endl;
+                return false;
+            }
+            // 4.3 for the instance ssbo
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+            window = glfwCreateWindow(width, height, title, NULL, NULL);
+            if (window == NULL) {
+                std::cout << "Failed to create GLFW window" << std::endl;
+                glfwTerminate();
+                return false;
+            } else {
+                std::cout << "GLFW window created successfully" << std::endl;
+            }
+
+            glfwMakeContextCurrent(window); // idk
+            glfwSetWindowUserPointer(window, this); // same as below
+            glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); // todo maybe move kinda weird
 
-        glfwMakeContextCurrent(window); // idk
-        glfwSetWindowUserPointer(window, this); // same as below
-        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); // todo maybe move kinda weird
+            // tell GLFW to capture our mouse
+            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+            // glad: load all OpenGL function pointers
+            if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+                std::cout << "Failed to initialize GLAD" << std::endl;
+                return false;
+            }
+        }
 
-        // tell GLFW to capture our mouse
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-        // glad: load all OpenGL function pointers
-        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-            std::cout << "Failed to initialize GLAD" << std::endl;
-            return false;
+        if (headless) {
+            offscreen.init(scr_width, scr_height);
+            output_fbo = offscreen.get_fbo();
+            printf("[HEADLESS] %s, %s\n", (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
         }
 
         Texture_manager::init();
+        Geometry_pool::init();
+        render_queue.init();
+        frame_uniforms.init(VIEW_COUNT);
+        clustered_lights.init();
+        shadow_cascades.init();
+        shadow_cache.init();
+        shadow_atlas.init();
+        g_buffer.init();
+        occlusion.init();
+        for (Util::gpu_query* q : { &forward_time, &geometry_time, &lighting_time })
+            q->init(GL_TIME_ELAPSED);
+        for (Util::gpu_query* q : { &forward_samples, &geometry_samples, &lighting_samples })
+            q->init(GL_SAMPLES_PASSED);
 
         // TODO MOVE TO TO WINDOW CLASS MAYBE EDITOR WINDOW TOO
         // make viewports
@@ -270,6 +338,7 @@ public:
         // makes opengl calls
         spotlight = Light::create_spot(glm::vec3(0.0f, 5.0f, -5.0f), glm::vec3(0.0f, -1.0f, -0.5f), glm::vec3(1.0f), 15.0f, 25.0f, 45.0f, 1024, 1024);
         directional_light = Light::create_directional(glm::vec3(0.0f, -0.25f, 0.25f), glm::vec3(1.0f), 0.1f);
+        spot_cache_slot = shadow_cache.add_slot(spotlight.width);
 
         // SHADERS
         Shader_manager::init("../resources/shaders/");
@@ -280,11 +349,10 @@ public:
         editor_shader = Shader_manager::load_from_name("editor");
         shadow_map_shader = Shader_manager::load_from_name("shadow_map");
         //debug_shader.init("../resources/shaders/debug_v.glsl", "../resources/shaders/debug_f.glsl");
-        
-        //setup_buffers(); // defferd g buffer setup
-        //deferred_shader.init("../resources/shaders/deferred_v.glsl", "../resources/shaders/deferred_f.glsl");
-        //deferred_lighting_shader.init("../resources/shaders/deferred_light_v.glsl", "../resources/shaders/deferred_light_f.glsl");
-        //debug_gbuffer_shader.init("../resources/shaders/deferred_light_v.glsl", "../resources/shaders/deferred_lighting_debug_f.glsl");
+
+        deferred_shader = Shader_manager::load_from_name("deferred");
+        deferred_lighting_shader = Shader_manager::load_from_name("deferred_light");
+        debug_gbuffer_shader = Shader_manager::load_from_paths("deferred_debug", "deferred_light_v.glsl", "deferred_lighting_debug_f.glsl");
 
         crosshair_shader = Shader_manager::load_from_name("crosshair");
 
@@ -298,6 +366,8 @@ public:
 
     void sync_callbacks(Player& player) {
         current_player = &player; // Store pointer to the active Player instance
+        if (headless)
+            return;
 
         //glfwSetWindowUserPointer(window, &player);
         glfwSetCursorPosCallback(window, Renderer::static_mouse_callback);
@@ -307,83 +377,6 @@ public:
         glfwSetCharCallback(window, Renderer::static_char_callback);
     }
 
-    bool setup_buffers() {
-        // Create and bind G-buffer framebuffer
-        glGenFramebuffers(1, &g_buffer);
-        glBindFramebuffer(GL_FRAMEBUFFER, g_buffer);
-    
-        // 1. Position buffer
-        glGenTextures(1, &g_position);
-        glBindTexture(GL_TEXTURE_2D, g_position);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, scr_width, scr_height, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g_position, 0);
-        
-        // 2. Normal buffer
-        glGenTextures(1, &g_normal);
-        glBindTexture(GL_TEXTURE_2D, g_normal);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, scr_width, scr_height, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, g_normal, 0);
-        
-        // 3. Color + specular buffer
-        glGenTextures(1, &g_albedo_specular);
-        glBindTexture(GL_TEXTURE_2D, g_albedo_specular);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, scr_width, scr_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, g_albedo_specular, 0);
-        
-        // Tell OpenGL which color attachments we'll use for rendering
-        unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-        glDrawBuffers(3, attachments);
-        
-        // Create and attach depth buffer
-        unsigned int rboDepth;
-        glGenRenderbuffers(1, &rboDepth);
-        glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, scr_width, scr_height);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-        
-        // Check if framebuffer is complete
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-            std::cout << "Framebuffer not complete!" << std::endl;
-            return false;
-        }
-        
-        // Unbind framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
-        unsigned int quadVBO;
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        
-        float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-        
-        // Print debug info
-        printf("Quad VAO created: %u\n", quadVAO);
-        
-        return true;
-    }
-
     //void draw_player_model(Player& player, Model_ass& player_model) {
     //    Shader* shader = Shader_manager::get_shader(pbr_shader);
     //    shader->use();
@@ -406,185 +399,518 @@ public:
     //    player_model.draw(shader);
     //}
 
+    // every view and the lights for this frame, one ubo upload
+    void update_frame_uniforms(Player& player, Scene& scene) {
+        PROFILE_SCOPE("frame uniforms");
+        view_block& spot = frame_uniforms.view(VIEW_SPOTLIGHT);
+        spot.projection = glm::perspective(glm::radians(spotlight.outer_fov * 2.0f), (float)spotlight.width / (float)spotlight.height, 0.1f, 50.0f);
+        spot.view = glm::lookAt(spotlight.position, spotlight.position + spotlight.direction, glm::vec3(0.0f, 1.0f, 0.0f));
+        spot.view_position = spotlight.position;
+
+        view_block& camera = frame_uniforms.view(VIEW_CAMERA);
+        camera.projection = glm::perspective(glm::radians(player.camera.zoom), (float)scr_width / (float)scr_height, 0.1f, FAR_PLANE);
+        camera.view = player.camera.get_view_matrix();
+        camera.view_position = player.camera.position;
+        clustered_lights.set_projection(camera.projection, 0.1f, FAR_PLANE, scr_width, scr_height);
+
+        // dir light, cascades fitted to the camera, the ones not due this frame keep their old matrices
+        cascades_due = shadow_cascades.update(camera.view, glm::radians(player.camera.zoom), (float)scr_width / (float)scr_height, 0.1f, directional_light.direction);
+        for (int i = 0; i < CASCADE_COUNT; i++) {
+            view_block& cascade = frame_uniforms.view(VIEW_CASCADE_0 + i);
+            cascade.view = shadow_cascades.view(i);
+            cascade.projection = shadow_cascades.projection(i);
+            cascade.view_position = shadow_cascades.eye(i);
+        }
+
+        if (editor_mode) {
+            int half_width = scr_width / 2;
+            int half_height = scr_height / 2;
+            float aspect_ratio = (float)half_width / (float)half_height;
+
+            for (const ortho_view_data* view_data : { &editor_viewports.top, &editor_viewports.front, &editor_viewports.side }) {
+                float ortho_size = view_data->get_ortho_size();
+                glm::vec3 target_pos = view_data->get_target_position();
+
+                view_block& ortho = frame_uniforms.view(VIEW_TOP + view_data->type);
+                ortho.projection = glm::ortho(
+                    -ortho_size * aspect_ratio, ortho_size * aspect_ratio,  // left, right
+                    -ortho_size, ortho_size,                                // bottom, top
+                    0.1f, FAR_PLANE                                         // near, far
+                );
+                ortho.view_position = target_pos + view_data->get_camera_position();
+                ortho.view = glm::lookAt(ortho.view_position, target_pos, view_data->get_up_vector());
+            }
+        }
+
+        light_block& lights = frame_uniforms.lights;
+        lights.light_view = spot.view;
+        lights.light_projection = spot.projection;
+        for (int i = 0; i < CASCADE_COUNT; i++) {
+            lights.cascade_matrices[i] = shadow_cascades.projection(i) * shadow_cascades.view(i);
+            lights.cascade_splits[i] = shadow_cascades.split(i);
+        }
+        lights.spot_light_position = spotlight.position;
+        lights.spot_light_direction = spotlight.direction;
+        lights.spot_light_color = spotlight.color;
+        lights.spot_light_intensity = spotlight.intensity;
+        lights.spot_light_inner_cone = glm::cos(glm::radians(spotlight.inner_fov));
+        lights.spot_light_outer_cone = glm::cos(glm::radians(spotlight.outer_fov));
+        lights.directional_light_direction = directional_light.direction;
+        lights.directional_light_color = directional_light.color;
+        lights.directional_light_intensity = directional_light.intensity;
+        clustered_lights.fill_block(lights);
+        plan_shadow_atlas(scene, camera.view_position);
+
+        frame_uniforms.upload();
+        clustered_lights.update(point_lights, camera.view);
+    }
+
+    // shadowed point lights ask for tiles sized by how much of the screen they can cover,
+    // then the dirty ones (new tile, light moved, resting scene changed, awake body in range) get their
+    // six faces queued for shadow_pass, highest priority first until ATLAS_VIEW_COUNT faces are used
+    void plan_shadow_atlas(Scene& scene, const glm::vec3& eye) {
+        atlas_draws.clear();
+        for (Light& l : point_lights)
+            l.shadow_record = -1;
+        if (editor_mode)
+            return; // no shadow pass
+
+        atlas_requests.clear();
+        for (uint32_t i = 0; i < point_lights.size(); i++) {
+            const Light& l = point_lights[i];
+            if (l.type != POINT || !l.casts_shadows)
+                continue;
+            // 1 when the camera is inside the light, falls off with distance like its projected size
+            float coverage = l.radius / std::max(glm::length(l.position - eye), l.radius);
+            unsigned int size = shadow_atlas.min_tile_size();
+            while (size * 2 <= coverage * shadow_atlas.max_tile_size())
+                size *= 2;
+            atlas_requests.push_back({ i, 6, size, coverage * l.intensity });
+        }
+        shadow_atlas.allocate(atlas_requests);
+
+        const Entity_store& entities = scene.entities;
+        awake_bounds.clear();
+        for (uint32_t i : entities.moving_entities())
+            awake_bounds.push_back(Util::transform_aabb(Model_manager::get_bvh(entities.models[i]).bounds(), entities.model_matrix(i)));
+
+        std::vector<Shadow_atlas::entry>& entries = shadow_atlas.get_entries();
+        atlas_order.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); i++)
+            atlas_order[i] = (uint32_t)i;
+        std::sort(atlas_order.begin(), atlas_order.end(), [&](uint32_t a, uint32_t b) { return entries[a].priority > entries[b].priority; });
+
+        static const glm::vec3 face_dirs[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+        static const glm::vec3 face_ups[6] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 } };
+        uint32_t version = entities.rest_version();
+        for (uint32_t index : atlas_order) {
+            Shadow_atlas::entry& e = entries[index];
+            const Light& l = point_lights[e.owner];
+            glm::vec4 key(l.position, l.radius);
+
+            bool dirty = !e.drawn || e.key != key || e.version != version;
+            for (size_t b = 0; b < awake_bounds.size() && !dirty; b++) {
+                glm::vec3 d = l.position - glm::clamp(l.position, awake_bounds[b].min, awake_bounds[b].max);
+                dirty = glm::dot(d, d) <= l.radius * l.radius;
+            }
+            // over budget waits for a later frame, the tile keeps the map it has
+            if (!dirty || atlas_draws.size() + e.faces > ATLAS_VIEW_COUNT)
+                continue;
+
+            glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, l.radius);
+            for (uint32_t f = 0; f < e.faces; f++) {
+                view_block& face = frame_uniforms.view(VIEW_ATLAS_0 + (int)atlas_draws.size());
+                face.view = glm::lookAt(l.position, l.position + face_dirs[f], face_ups[f]);
+                face.projection = projection;
+                face.view_position = l.position;
+                e.view_projection[f] = projection * face.view;
+                atlas_draws.push_back({ e.tiles[f], l.radius });
+            }
+            e.drawn = true;
+            e.key = key;
+            e.version = version;
+        }
+        shadow_atlas.get_stats().redrawn = (uint32_t)atlas_draws.size();
+
+        shadow_atlas.upload();
+        for (const Shadow_atlas::entry& e : entries)
+            point_lights[e.owner].shadow_record = e.record;
+    }
+
+    // culls the entities against view v into visible[v] and binds its view block
+    void cull_view(Scene& scene, render_view v) {
+        PROFILE_SCOPE("cull");
+        const view_block& vb = frame_uniforms.view(v);
+        frame_uniforms.bind_view(v);
+        scene.cull(Util::frustum_from_matrix(vb.projection * vb.view), visible[v], cull_stats[v]);
+        if (v == VIEW_CAMERA && occlusion.enabled)
+            cull_occluded(scene);
+    }
+
+    // the camera's biggest visible entities on screen are rasterized as occluders on the cpu,
+    // then every visible box is tested against them before anything is queued
+    void cull_occluded(Scene& scene) {
+        PROFILE_SCOPE("occlusion");
+        const view_block& camera = frame_uniforms.view(VIEW_CAMERA);
+        const Culling::bounds_soa& bounds = scene.bounds();
+        const Entity_store& entities = scene.entities;
+
+        occluder_candidates.clear();
+        for (uint32_t i : visible[VIEW_CAMERA]) {
+            if (Model_manager::get_occluder(entities.models[i]).indices.empty())
+                continue;
+            glm::vec3 min(bounds.min_x[i], bounds.min_y[i], bounds.min_z[i]);
+            glm::vec3 max(bounds.max_x[i], bounds.max_y[i], bounds.max_z[i]);
+            float radius = 0.5f * glm::length(max - min);
+            float size = radius / std::max(glm::length(0.5f * (min + max) - camera.view_position), radius);
+            if (size >= occlusion.min_occluder_size)
+                occluder_candidates.push_back({ size, i });
+        }
+        size_t count = std::min(occluder_candidates.size(), (size_t)std::max(occlusion.max_occluders, 0));
+        std::partial_sort(occluder_candidates.begin(), occluder_candidates.begin() + count, occluder_candidates.end(),
+            [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.first > b.first; });
+
+        occlusion.begin(camera.projection * camera.view);
+        for (size_t k = 0; k < count; k++) {
+            uint32_t i = occluder_candidates[k].second;
+            occlusion.add_occluder(Model_manager::get_occluder(entities.models[i]), entities.model_matrix(i));
+        }
+        occlusion.rasterize();
+        occlusion.cull(bounds, visible[VIEW_CAMERA]);
+    }
+
+    // grayscale copy of the occlusion depth for the debug window
+    void update_occlusion_debug() {
+        occlusion.debug_image(occlusion_pixels);
+        if (!occlusion_texture) {
+            glGenTextures(1, &occlusion_texture);
+            glBindTexture(GL_TEXTURE_2D, occlusion_texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            GLint gray[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, gray);
+        }
+        glBindTexture(GL_TEXTURE_2D, occlusion_texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, occlusion.get_width(), occlusion.get_height(), 0, GL_RED, GL_UNSIGNED_BYTE, occlusion_pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // pixels across the height of a view, lod errors are measured against it
+    float view_pixels(render_view v) const {
+        if (v == VIEW_CAMERA)
+            return (float)scr_height;
+        if (v == VIEW_SPOTLIGHT)
+            return (float)spotlight.height;
+        if (v >= VIEW_CASCADE_0 && v < VIEW_CASCADE_0 + CASCADE_COUNT)
+            return (float)shadow_cascades.size();
+        if (v >= VIEW_ATLAS_0)
+            return (float)atlas_draws[v - VIEW_ATLAS_0].tile.size;
+        return scr_height * 0.5f; // editor quarters
+    }
+
+    // coarsest level whose error projects under threshold pixels, from the nearest the bounds can get
+    // the camera keeps last frame's pick in the entity so levels dont flicker at the boundary
+    int pick_lod(Entity_store& entities, uint32_t i, const Model_ass& model, const view_block& vb, float pixels, float threshold, bool camera) {
+        if (!lods_enabled || model.lod_count < 2)
+            return 0;
+        const glm::vec3& s = entities.scales[i];
+        float scale = std::max(s.x, std::max(s.y, s.z));
+        // world units to pixels, perspective falls off with distance, ortho doesnt
+        float pixels_per_unit = vb.projection[1][1] * 0.5f * pixels * scale;
+        if (vb.projection[3][3] == 0.0f) {
+            float radius = glm::length(entities.aabbs[i].max - entities.aabbs[i].min) * 0.5f * scale;
+            float distance = glm::length(glm::vec3(entities.model_matrix(i)[3]) - vb.view_position) - radius;
+            pixels_per_unit /= std::max(distance, 0.1f);
+        }
+        int lod = Mesh_lod::select(model.lod_errors, model.lod_count, pixels_per_unit, threshold, camera ? entities.lods[i] : -1, lod_hysteresis);
+        if (camera)
+            entities.lods[i] = (uint8_t)lod;
+        return lod;
+    }
+
+    // queues the given dense indices and submits them, the caller binds the program first
+    void draw_entities(Scene& scene, const std::vector<uint32_t>& indices, render_view v, render_pass pass, shader_handle shader, bool depth_only, float far_plane) {
+        const view_block& vb = frame_uniforms.view(v);
+        Entity_store& entities = scene.entities;
+        bool shadow = pass == PASS_SHADOW;
+        float pixels = view_pixels(v);
+        // shadow maps are blurred by the filter anyway and nobody looks at them up close
+        float threshold = lod_threshold * std::exp2(lod_bias + (shadow ? shadow_lod_bias : 0.0f));
+        render_queue.clear();
+        for (uint32_t i : indices) {
+            const Model_ass& model = Model_manager::get_model(entities.models[i]);
+            int lod = pick_lod(entities, i, model, vb, pixels, threshold, v == VIEW_CAMERA);
+            render_queue.add_model(pass, shader, entities.models[i], entities.model_matrix(i), depth_only ? nullptr : &entities.normal_matrix(i), vb.view_position, far_plane, lod);
+
+            lod_stats.entities[lod]++;
+            (shadow ? lod_stats.shadow_triangles : lod_stats.triangles) += model.lod_triangles[lod];
+            (shadow ? lod_stats.shadow_full_triangles : lod_stats.full_triangles) += model.lod_triangles[0];
+        }
+        render_queue.sort();
+        render_queue.submit(shader);
+    }
+
+    // culls the entities against view and queues what survives, the caller binds the program first
+    void draw_view(Scene& scene, render_view v, render_pass pass, shader_handle shader, bool depth_only, float far_plane) {
+        cull_view(scene, v);
+        draw_entities(scene, visible[v], v, pass, shader, depth_only, far_plane);
+    }
+
+    void bind_shadow_target(render_view v) {
+        if (v == VIEW_SPOTLIGHT)
+            spotlight.bind_fbo_write();
+        else
+            shadow_cascades.bind_write(v - VIEW_CASCADE_0);
+    }
+
+    // resting casters come from the cache slot (redrawn only when it went stale), just the awake bodies are drawn every frame
+    // cache_slot -1 draws everything, cascades are refit around the camera so a slot keyed on their matrix never survives a move
+    void draw_shadow_view(Scene& scene, render_view v, int cache_slot, float far_plane) {
+        cull_view(scene, v);
+
+        if (cache_slot < 0 || !shadow_cache.enabled) {
+            bind_shadow_target(v);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            draw_entities(scene, visible[v], v, PASS_SHADOW, shadow_map_shader, true, far_plane);
+            return;
+        }
+
+        const Entity_store& entities = scene.entities;
+        resting_casters.clear();
+        awake_casters.clear();
+        for (uint32_t i : visible[v])
+            (entities.moving(i) ? awake_casters : resting_casters).push_back(i);
+
+        const view_block& vb = frame_uniforms.view(v);
+        glm::mat4 view_projection = vb.projection * vb.view;
+        if (shadow_cache.stale(cache_slot, view_projection, entities.rest_version())) {
+            shadow_cache.begin_static(cache_slot, view_projection, entities.rest_version());
+            glClear(GL_DEPTH_BUFFER_BIT);
+            draw_entities(scene, resting_casters, v, PASS_SHADOW, shadow_map_shader, true, far_plane);
+        }
+
+        shadow_cache.restore(cache_slot, spotlight.shadow_map, GL_TEXTURE_2D, 0);
+        bind_shadow_target(v);
+        draw_entities(scene, awake_casters, v, PASS_SHADOW, shadow_map_shader, true, far_plane);
+    }
+
     void shadow_pass(Scene& scene) {
-        spotlight.bind_fbo_write();
         glEnable(GL_DEPTH_TEST);
-        glClear(GL_DEPTH_BUFFER_BIT);
 
         // use shadow shader
-        Shader* shader = Shader_manager::get_shader(shadow_map_shader);
-        shader->use();
-        glm::mat4 projection = glm::perspective(glm::radians(spotlight.outer_fov * 2.0f), (float)spotlight.width / (float)spotlight.height, 0.1f, 50.0f);
-        shader->setMat4("projection", projection);
-        glm::mat4 view = glm::lookAt(spotlight.position, spotlight.position + spotlight.direction, glm::vec3(0.0f, 1.0f, 0.0f));
-        shader->setMat4("view", view);
-        
-        // frusutm cull objects + check move?
-        for (Entity& entity : scene.entities) {
-            glm::mat4 model = entity.get_model_matrix();
-            shader->setMat4("model", model);
+        Shader_manager::get_shader(shadow_map_shader)->use();
+        draw_shadow_view(scene, VIEW_SPOTLIGHT, spot_cache_slot, 50.0f);
 
-            bool shadow_pass = true;
-            entity.draw(shader, shadow_pass);
+        // each cascade culls its casters against its own ortho box, far ones only redraw every few frames
+        for (int i = 0; i < CASCADE_COUNT; i++) {
+            if (cascades_due & (1u << i))
+                draw_shadow_view(scene, (render_view)(VIEW_CASCADE_0 + i), -1, shadow_cascades.depth_range(i));
         }
 
-        // dir light, maybe scene BB
-        directional_light.bind_fbo_write();
-        glEnable(GL_DEPTH_TEST);
-        glClear(GL_DEPTH_BUFFER_BIT);
-
-        float scene_size = 25.0f;
-        float light_distance = 50.0f;
-        glm::vec3 scene_center = glm::vec3(0.0f, 0.0f, 0.0f);
-        glm::vec3 light_pos = scene_center - directional_light.direction * light_distance;
-        glm::mat4 dir_projection = glm::ortho(-scene_size, scene_size, -scene_size, scene_size, 0.1f, 60.0f);
-        shader->setMat4("projection", dir_projection);
-        glm::mat4 dir_view = glm::lookAt(light_pos, light_pos + directional_light.direction, glm::vec3(0.0f, 1.0f, 0.0f));
-        shader->setMat4("view", dir_view);
-
-        // frusutm cull objects + check move?
-        for (Entity& entity : scene.entities) {
-            glm::mat4 model = entity.get_model_matrix();
-            shader->setMat4("model", model);
-
-            bool shadow_pass = true;
-            entity.draw(shader, shadow_pass);
+        // point light faces planned in update_frame_uniforms, one fbo for all of them
+        // tiles keep their maps until the light or a caster in its range moves (entry.drawn), that is their cache
+        for (size_t k = 0; k < atlas_draws.size(); k++) {
+            shadow_atlas.bind_write(atlas_draws[k].tile);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            draw_view(scene, (render_view)(VIEW_ATLAS_0 + k), PASS_SHADOW, shadow_map_shader, true, atlas_draws[k].far_plane);
         }
+        shadow_atlas.end_write();
 
-        // point light shadow mapping
-        // frustum culling stuff
     }
 
     void render(Player& player, Scene& scene, float delta_time) {
+        render_queue.begin_frame();
+        lod_stats = lod_frame_stats();
+        shadow_cache.begin_frame();
+        update_frame_uniforms(player, scene);
 
+        graph.reset();
+        Render_graph::resource output = graph.import_framebuffer("output", output_fbo, scr_width, scr_height);
         if (editor_mode) {
-            render_scene_editor(player, scene, delta_time);
+            graph.add_pass("editor", [&](Render_graph::builder& b) {
+                output = b.write_color(output);
+            }, [&]() { render_scene_editor(player, scene, delta_time); });
         }
         else {
-            shadow_pass(scene);
-            render_scene(player, scene, delta_time);
+            Render_graph::resource spot_map = graph.import_texture("spot_shadow", spotlight.shadow_map);
+            Render_graph::resource cascade_maps = graph.import_texture("cascade_shadows", shadow_cascades.texture());
+            Render_graph::resource atlas = graph.import_texture("shadow_atlas", shadow_atlas.texture());
+            // binds each map and tile itself
+            graph.add_pass("shadows", [&](Render_graph::builder& b) {
+                spot_map = b.write(spot_map);
+                cascade_maps = b.write(cascade_maps);
+                atlas = b.write(atlas);
+            }, [&]() { shadow_pass(scene); });
+
+            auto read_shadows = [&](Render_graph::builder& b) {
+                b.read(spot_map);
+                b.read(cascade_maps);
+                b.read(atlas);
+            };
+            // keep is for the path drawn only for its timings, nothing reads what it writes
+            auto add_forward = [&](bool keep) {
+                graph.add_pass("forward", [&](Render_graph::builder& b) {
+                    read_shadows(b);
+                    output = b.write_color(output);
+                    if (keep)
+                        b.side_effect();
+                }, [&]() { render_scene(player, scene, delta_time); });
+            };
+            auto add_deferred = [&](bool keep) {
+                graph.add_pass("gbuffer", [&](Render_graph::builder& b) {
+                    gbuffer_targets = g_buffer.declare(b, scr_width, scr_height);
+                }, [&]() { render_gbuffer(scene); });
+                // the channel views dont light anything, the shadow pass gets culled with them
+                graph.add_pass("deferred_lighting", [&](Render_graph::builder& b) {
+                    g_buffer.read(b, gbuffer_targets);
+                    if (gbuffer_view < 0)
+                        read_shadows(b);
+                    output = b.write_color(output);
+                    if (keep)
+                        b.side_effect();
+                }, [&]() { render_deferred_lighting(scene); });
+            };
+
+            // the path not shown goes first and gets overwritten, same views, lights and shadow maps
+            if (compare_paths) {
+                if (deferred)
+                    add_forward(true);
+                else
+                    add_deferred(true);
+            }
+            if (deferred)
+                add_deferred(false);
+            else
+                add_forward(false);
+        }
+        graph.present(output);
+        graph.compile();
+        graph.execute();
+        // overlays after this (debug lines, hud, imgui) draw on whatever is bound
+        if (graph.bound_framebuffer() != output_fbo)
+            bind_output();
+
+        queue_scene_debug(scene);
+    }
+
+    void queue_scene_debug(Scene& scene) {
+        debug_renderer.add_sphere(spotlight.position, 0.1f, spotlight.color);
+        debug_renderer.add_line(spotlight.position, spotlight.position + spotlight.direction, spotlight.color);
+        debug_renderer.add_line(glm::vec3(0.0f, 10.f, 0.0f), glm::vec3(0.0f, 10.f, 0.0f) + directional_light.direction, spotlight.color);
+
+        const Entity_store& entities = scene.entities;
+        for (uint32_t i : visible[VIEW_CAMERA]) {
+            /////////////////////////////////////////////////////////////////////////////////////////////////
+            //debug_renderer.add_axes(entity.get_physics_position(), entity.rotation);
+            if (entities.physics_enabled[i]) {
+                Util::OBB collision_box = Physics::getShapeOBB(entities.physics_ids[i]);
+                debug_renderer.add_obb(collision_box, glm::vec3(0.0f, 1.0f, 0.0f)); // Green for physics collision box
+            }
         }
     }
 
     void render_scene(Player& player, Scene& scene, float delta_time) {
         //Shader used_shader = toon;
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glViewport(0, 0, scr_width, scr_height);
+        forward_time.begin();
+        forward_samples.begin();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         Shader* shader = Shader_manager::get_shader(pbr_shader);
         shader->use();
 
-        // spotlight
+        // lights and shadow matrices come from the light block, only the maps are bound here
         spotlight.bind_fbo_read(3);
         shader->setInt("shadow_map", 3);
-        glm::mat4 lprojection = glm::perspective(glm::radians(spotlight.outer_fov * 2.0f), (float)spotlight.width / (float)spotlight.height, 0.1f, 50.0f);
-        shader->setMat4("light_projection", lprojection);
-        glm::mat4 lview = glm::lookAt(spotlight.position, spotlight.position + spotlight.direction, glm::vec3(0.0f, 1.0f, 0.0f));
-        shader->setMat4("light_view", lview);
-
-        // dir light
-        float scene_size = 25.0f;
-        float light_distance = 50.0f;
-        glm::vec3 scene_center = glm::vec3(0.0f, 0.0f, 0.0f);
-        glm::vec3 light_pos = scene_center - directional_light.direction * light_distance;
-        glm::mat4 dir_projection = glm::ortho(-scene_size, scene_size, -scene_size, scene_size, 0.1f, 60.0f);
-        shader->setMat4("dir_light_projection", dir_projection);
-        glm::mat4 dir_view = glm::lookAt(light_pos, light_pos + directional_light.direction, glm::vec3(0.0f, 1.0f, 0.0f));
-        shader->setMat4("dir_light_view", dir_view);
-        directional_light.bind_fbo_read(4);
+        shadow_cascades.bind_read(4);
         shader->setInt("directional_shadow_map", 4);
-        ///////////
-
-        shader->setVec3("spot_light_position", spotlight.position);
-        shader->setVec3("spot_light_direction", spotlight.direction);
-        shader->setVec3("spot_light_color", spotlight.color);
-        shader->setFloat("spot_light_intensity", spotlight.intensity);
-        shader->setFloat("spot_light_inner_cone", glm::cos(glm::radians(spotlight.inner_fov)));
-        shader->setFloat("spot_light_outer_cone", glm::cos(glm::radians(spotlight.outer_fov)));
-        debug_renderer.add_sphere(spotlight.position, 0.1f, spotlight.color);
-        debug_renderer.add_line(spotlight.position, spotlight.position + spotlight.direction, spotlight.color);
+        shadow_atlas.bind_read(5);
+        shader->setInt("shadow_atlas", 5);
 
-        shader->setVec3("directional_light_direction", directional_light.direction);
-        shader->setVec3("directional_light_color", directional_light.color);
-        shader->setFloat("directional_light_intensity", directional_light.intensity);
-        debug_renderer.add_line(glm::vec3(0.0f, 10.f, 0.0f), glm::vec3(0.0f, 10.f, 0.0f) + directional_light.direction, spotlight.color);
-
-        // Setup camera matrices
-        glm::mat4 projection = glm::perspective(glm::radians(player.camera.zoom), (float)scr_width / (float)scr_height, 0.1f, FAR_PLANE);
-        shader->setMat4("projection", projection);
-        
-        glm::mat4 view = player.camera.get_view_matrix();
-        shader->setMat4("view", view);
-        shader->setVec3("view_position", player.camera.position);
-        
-        for (Entity& entity : scene.entities) {
-            // Calculate and set transformation matrices
-            glm::mat4 model = entity.get_model_matrix();
-            shader->setMat4("model", model);
-            
-            // Calculate normal matrix (inverse transpose of the model matrix)
-            glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(model)));
-            shader->setMat3("normal_matrix", normal_matrix);
-            
-            // Draw the entity
-            entity.draw(shader);
-            
-            /////////////////////////////////////////////////////////////////////////////////////////////////
-            //debug_renderer.add_axes(entity.get_physics_position(), entity.rotation);
-            if (entity.physics_enabled) {
-                Util::OBB collision_box = Physics::getShapeOBB(entity.physics_id);
-                debug_renderer.add_obb(collision_box, glm::vec3(0.0f, 1.0f, 0.0f)); // Green for physics collision box
-            }
-        }
+        // normal matrix is composed with the model matrix in the transform sync
+        draw_view(scene, VIEW_CAMERA, PASS_OPAQUE, pbr_shader, false, FAR_PLANE);
+        forward_samples.end();
+        forward_time.end();
         
-        render_skybox(scene.skybox, view, projection);
+        render_skybox(scene.skybox);
 
         // flush(); !!
     }
 
-    void render_scene_ortho(Player& player, Scene& scene, float deltaTime, const ortho_view_data& view_data) {
-        Shader* shader = Shader_manager::get_shader(editor_shader);
-        shader->use();
-
-        int half_width = scr_width / 2;
-        int half_height = scr_height / 2;
-
-        float aspect_ratio = (float)half_width / (float)half_height;
-        float ortho_size = view_data.get_ortho_size();
-
-        glm::mat4 projection = glm::ortho(
-            -ortho_size * aspect_ratio, ortho_size * aspect_ratio,  // left, right
-            -ortho_size, ortho_size,                                // bottom, top
-            0.1f, FAR_PLANE                                         // near, far
-        );
-
-        shader->setMat4("projection", projection);
+    // same frame as render_scene through the packed g-buffer, lighting is one fullscreen triangle
+    // that walks the cluster lists, so every pixel is shaded once whatever the overdraw was
+    // the graph binds the g-buffer targets for the first and the output for the second
+    void render_gbuffer(Scene& scene) {
+        geometry_time.begin();
+        geometry_samples.begin();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        Shader_manager::get_shader(deferred_shader)->use();
+        draw_view(scene, VIEW_CAMERA, PASS_OPAQUE, deferred_shader, false, FAR_PLANE);
+        geometry_samples.end();
+        geometry_time.end();
+    }
 
-        glm::vec3 target_pos = view_data.get_target_position();
-        glm::vec3 view_camera_pos = target_pos + view_data.get_camera_position();
-        glm::vec3 up_vector = view_data.get_up_vector();
+    void render_deferred_lighting(Scene& scene) {
+        lighting_time.begin();
+        lighting_samples.begin();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glm::mat4 view = glm::lookAt(view_camera_pos, target_pos, up_vector);
+        Shader* shader = Shader_manager::get_shader(gbuffer_view < 0 ? deferred_lighting_shader : debug_gbuffer_shader);
+        shader->use();
+        g_buffer.bind_read(graph, gbuffer_targets, 0);
+        shader->setInt("g_albedo_metallic", 0);
+        shader->setInt("g_normal_roughness", 1);
+        shader->setInt("g_depth", 2);
+        if (gbuffer_view < 0) {
+            const view_block& camera = frame_uniforms.view(VIEW_CAMERA);
+            shader->setMat4("inverse_view_projection", glm::inverse(camera.projection * camera.view));
+            spotlight.bind_fbo_read(3);
+            shader->setInt("shadow_map", 3);
+            shadow_cascades.bind_read(4);
+            shader->setInt("directional_shadow_map", 4);
+            shadow_atlas.bind_read(5);
+            shader->setInt("shadow_atlas", 5);
+        }
+        else
+            shader->setInt("debug_mode", gbuffer_view);
 
-        shader->setMat4("view", view);
-        //used_shader.setVec3("view_position", view_camera_pos);
-        
-        for (Entity& entity : scene.entities) {
-            glm::mat4 model = entity.get_model_matrix();
-            shader->setMat4("model", model);
+        // the lighting shader copies the g-buffer depth out so the skybox and debug lines still test against the scene
+        glDepthFunc(GL_ALWAYS);
+        g_buffer.draw_fullscreen();
+        glDepthFunc(GL_LESS);
+        lighting_samples.end();
+        lighting_time.end();
 
-            glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(model)));
-            shader->setMat3("normal_matrix", normal_matrix);
+        if (gbuffer_view < 0)
+            render_skybox(scene.skybox);
+    }
 
-            entity.draw(shader);
+    struct path_stats {
+        float forward_ms, geometry_ms, lighting_ms;
+        // framebuffer traffic from the samples that passed, no compression or cache effects
+        float forward_mb, deferred_mb, unpacked_mb;
+    };
+
+    // gpu numbers trail a few frames, a path only updates while its drawn (see compare_paths)
+    path_stats get_path_stats() const {
+        path_stats s;
+        s.forward_ms = forward_time.ms();
+        s.geometry_ms = geometry_time.ms();
+        s.lighting_ms = lighting_time.ms();
+        const float mb = 1.0f / (1024.0f * 1024.0f);
+        // forward writes color + depth per passing sample
+        s.forward_mb = forward_samples.value * (4.0f + 4.0f) * mb;
+        // deferred writes the targets per passing sample, then reads them back and writes color + depth once per lit pixel
+        float lit = (float)lighting_samples.value;
+        s.deferred_mb = (geometry_samples.value * (float)G_buffer::BYTES_PER_PIXEL + lit * (G_buffer::BYTES_PER_PIXEL + 4.0f + 4.0f)) * mb;
+        s.unpacked_mb = (geometry_samples.value * (float)G_buffer::UNPACKED_BYTES_PER_PIXEL + lit * (G_buffer::UNPACKED_BYTES_PER_PIXEL + 4.0f + 4.0f)) * mb;
+        return s;
+    }
 
- /*           if (entity.physics_enabled) {
-                Util::OBB collision_box = Physics::getShapeOBB(entity.physics_id);
-                debug_renderer.add_obb(collision_box, glm::vec3(0.0f, 1.0f, 0.0f));
-            }*/
-        }
+    void render_scene_ortho(Player& player, Scene& scene, float deltaTime, const ortho_view_data& view_data) {
+        Shader_manager::get_shader(editor_shader)->use();
+        draw_view(scene, (render_view)(VIEW_TOP + view_data.type), PASS_EDITOR, editor_shader, false, FAR_PLANE);
         
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         render_hud_text(view_data.view_text);
@@ -618,8 +944,29 @@ public:
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
 
-    void render_gizmo(const Scene& scene, const Player& player) {
-        if (editor_viewports.scene.gizmo_mode != gizmo_modes::NONE && target_entity != -1) {
+    void render_gizmo(Scene& scene, const Player& player) {
+        // resolve a click in the scene viewport, unless it landed on the gizmo itself
+        if (pick_pending) {
+            pick_pending = false;
+            if (!ImGuizmo::IsOver() && !ImGuizmo::IsUsing()) {
+                float w = scr_width / 2.0f;
+                float h = scr_height / 2.0f;
+                glm::vec2 ndc(pick_mouse.x / w * 2.0f - 1.0f, 1.0f - pick_mouse.y / h * 2.0f);
+
+                glm::mat4 projection = glm::perspective(glm::radians(player.camera.zoom), (float)scr_width / (float)scr_height, 0.1f, FAR_PLANE);
+                glm::mat4 inv_view_proj = glm::inverse(projection * player.camera.get_view_matrix());
+                glm::vec4 near_point = inv_view_proj * glm::vec4(ndc, -1.0f, 1.0f);
+                glm::vec4 far_point = inv_view_proj * glm::vec4(ndc, 1.0f, 1.0f);
+                glm::vec3 origin = glm::vec3(near_point) / near_point.w;
+                glm::vec3 dir = glm::normalize(glm::vec3(far_point) / far_point.w - origin);
+
+                glm::vec3 hit_pos;
+                target_entity = scene.pick(origin, dir, hit_pos);
+            }
+        }
+
+        int target = scene.entities.dense_index(target_entity);
+        if (editor_viewports.scene.gizmo_mode != gizmo_modes::NONE && target != -1) {
             float w = scr_width / 2;
             float h = scr_height / 2;
 
@@ -642,7 +989,7 @@ public:
 
             glm::mat4 projection = glm::perspective(glm::radians(player.camera.zoom), (float)scr_width / (float)scr_height, 0.1f, FAR_PLANE);
             glm::mat4 view = player.camera.get_view_matrix();
-            glm::mat4 model = scene.entities[target_entity].get_model_matrix();
+            glm::mat4 model = scene.entities.model_matrix(target);
 
             ImGuizmo::OPERATION guizmo_op;
             if (editor_viewports.scene.gizmo_mode == gizmo_modes::TRANSLATE)
@@ -667,8 +1014,11 @@ public:
                 glm::vec3 position, scale, rotation;
                 Util::decompose(model, position, scale, rotation);
 
-                Physics::setBodyPosition(scene.entities[target_entity].physics_id, position);
-                Physics::setBodyRotation(scene.entities[target_entity].physics_id, glm::quat(rotation));
+                if (scene.entities.physics_enabled[target]) {
+                    Physics::setBodyPosition(scene.entities.physics_ids[target], position);
+                    Physics::setBodyRotation(scene.entities.physics_ids[target], glm::quat(rotation));
+                }
+                scene.entities.set_transform(target, position, glm::quat(rotation));
             }
             ImGui::End();
         }
@@ -676,131 +1026,20 @@ public:
     
     void render_debug(Player& player) {
         Shader* shader = Shader_manager::get_shader(debug_shader);
-        glm::mat4 projection = glm::perspective(glm::radians(player.camera.zoom), (float)scr_width / (float)scr_height, 0.1f, FAR_PLANE);
-        shader->setMat4("projection", projection);
-        glm::mat4 view = player.camera.get_view_matrix();
-        shader->setMat4("view", view);
+        frame_uniforms.bind_view(VIEW_CAMERA);
 
         if (editor_mode) {
             int half_width = scr_width / 2;
             int half_height = scr_height / 2;
             glViewport(0, half_height, half_width, half_height);
-            debug_renderer.render(shader, projection, view);
+            debug_renderer.render(shader);
             glViewport(0, 0, scr_width, scr_height);
         } 
         else 
-            debug_renderer.render(shader, projection, view);
+            debug_renderer.render(shader);
 
     }
 
-    //void render_scene_deferred(Player& player, Scene& scene, float delta_time) {
-    //    // 1. Geometry Pass: Render scene to G-buffer
-    //    glBindFramebuffer(GL_FRAMEBUFFER, g_buffer);
-    //    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    //    glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
-    //    
-    //    // Prepare matrices
-    //    glm::mat4 projection = glm::perspective(glm::radians(player.camera.zoom), (float)scr_width / (float)scr_height, 0.1f, FAR_PLANE);
-    //    glm::mat4 view = player.camera.get_view_matrix();
-
-    //    // Use deferred geometry shader for G-buffer pass
-    //    deferred_shader.use();
-    //    deferred_shader.setMat4("projection", projection);
-    //    deferred_shader.setMat4("view", view);
-
-    //    // Render scene entities to G-buffer
-    //    for (Entity& entity : scene.entities) {
-    //        glm::mat4 model = entity.get_model_matrix();
-    //        deferred_shader.setMat4("model", model);
-    //        
-    //        // Calculate normal matrix (inverse transpose of the model matrix)
-    //        glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(model)));
-    //        deferred_shader.setMat3("normal_matrix", normal_matrix);
-    //        
-    //        entity.draw(deferred_shader);
-    //    }
-
-    //    // 2. Lighting Pass: Render lighting using G-buffer
-    //    glBindFramebuffer(GL_FRAMEBUFFER, 0); // Back to default framebuffer
-    //    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    //    glDisable(GL_DEPTH_TEST);
-    //    
-    //    // Use lighting shader
-    //    deferred_lighting_shader.use();
-    //    
-    //    // Bind G-buffer textures
-    //    glActiveTexture(GL_TEXTURE0);
-    //    glBindTexture(GL_TEXTURE_2D, g_position);
-    //    glActiveTexture(GL_TEXTURE1);
-    //    glBindTexture(GL_TEXTURE_2D, g_normal);
-    //    glActiveTexture(GL_TEXTURE2);
-    //    glBindTexture(GL_TEXTURE_2D, g_albedo_specular);
-
-    //    // Set lighting uniforms
-    //    deferred_lighting_shader.setVec3("viewPos", player.camera.position);
-    //    
-    //    // Set light parameters
-    //    deferred_lighting_shader.setVec3("light.Position", light.position);
-    //    deferred_lighting_shader.setVec3("light.Color", light.color);
-    //    deferred_lighting_shader.setFloat("light.Linear", 0.09f);
-    //    deferred_lighting_shader.setFloat("light.Quadratic", 0.032f);
-    //    deferred_lighting_shader.setFloat("light.Intensity", light.intensity);
-
-    //    // glUniform1i(glGetUniformLocation(deferred_lighting_shader.ID, "debug_mode"), 999);
-
-    //    // Render a screen-filling quad
-    //    // render_quad();
-    //    // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    //    glBindVertexArray(quadVAO);
-    //    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    //    glBindVertexArray(0);
-    //    // glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-    //    glEnable(GL_DEPTH_TEST);
-
-    //    // Optional: Render debug information
-    //    if (!player.key_toggles[(unsigned)'r']) {
-    //        // debug_renderer.render(debug_shader, projection, view);
-    //        debug_visualize_gbuffer(player);
-    //    }
-    //}
-
-    //void debug_visualize_gbuffer(Player& player) {
-    //    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    //    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    //
-    //    debug_gbuffer_shader.use();
-    //
-    //    // Bind G-buffer textures
-    //    glActiveTexture(GL_TEXTURE0);
-    //    glBindTexture(GL_TEXTURE_2D, g_position);
-    //    glActiveTexture(GL_TEXTURE1);
-    //    glBindTexture(GL_TEXTURE_2D, g_normal);
-    //    glActiveTexture(GL_TEXTURE2);
-    //    glBindTexture(GL_TEXTURE_2D, g_albedo_specular);
-    //
-    //    const char* mode_names[] = {
-    //        "Position", "Normal", "Albedo", "Specular", "Depth"
-    //    };
-    //    static int current_mode = 0;
-    //
-    //    for (int i = 0; i < 4; ++i) {
-    //        debug_gbuffer_shader.setInt("debug_mode", i);
-    //
-    //        int x = (i % 2) * (scr_width / 2);
-    //        int y = (i / 2) * (scr_height / 2);
-    //        glViewport(x, y, scr_width / 2, scr_height / 2);
-    //
-    //        // render_quad();
-    //        glBindVertexArray(quadVAO);
-    //        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    //        glBindVertexArray(0);    
-    //    }
-    //
-    //    // Reset viewport
-    //    glViewport(0, 0, scr_width, scr_height);
-    //}
-    
     //void draw_player_stuff(Player& player, glm::vec3& clr, glm::vec3& emis_clr, glm::vec3& fres_clr, float expon, const Skybox& skybox) {
     //    // glDisable(GL_DEPTH_TEST);
     //    weapon_shader2.use();
@@ -829,16 +1068,12 @@ public:
 
     //}
 
-    void render_skybox(const Skybox& skybox, const glm::mat4& view, const glm::mat4& projection) {
+    // uses whatever view is bound, the shader drops the translation
+    void render_skybox(const Skybox& skybox) {
         glDepthFunc(GL_LEQUAL);
         Shader* shader = Shader_manager::get_shader(skybox_shader);
         shader->use();
 
-        glm::mat4 viewNoTranslation = glm::mat4(glm::mat3(view));
-
-        shader->setMat4("view", viewNoTranslation);
-        shader->setMat4("projection", projection);
-
         skybox.draw();
 
         glDepthFunc(GL_LESS);
@@ -875,20 +1110,40 @@ public:
         debug_renderer.add_sphere(pos, 1.0f, glm::vec3(1.0f, 1.0f, 0.0f));
     }
     
+    // the window's framebuffer, or the offscreen target when headless
+    void bind_output() {
+        glBindFramebuffer(GL_FRAMEBUFFER, output_fbo);
+        glViewport(0, 0, scr_width, scr_height);
+    }
+
     void flush() {
+        // no window to present to or poll when headless
+        if (headless)
+            return;
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
     void shutdown() {
-        glDeleteFramebuffers(1, &g_buffer);
-        glDeleteTextures(1, &g_position);
-        glDeleteTextures(1, &g_normal);
-        glDeleteTextures(1, &g_albedo_specular);
+        if (headless)
+            offscreen.shutdown();
+        g_buffer.shutdown();
+        graph.shutdown();
+        glDeleteTextures(1, &occlusion_texture);
+        for (Util::gpu_query* q : { &forward_time, &geometry_time, &lighting_time, &forward_samples, &geometry_samples, &lighting_samples })
+            q->shutdown();
+        render_queue.shutdown();
+        frame_uniforms.shutdown();
+        clustered_lights.shutdown();
+        shadow_cascades.shutdown();
+        shadow_cache.shutdown();
+        shadow_atlas.shutdown();
+        Geometry_pool::cleanup();
         
-        glDeleteVertexArrays(1, &quadVAO);
-        
-        glfwTerminate();
+        if (headless)
+            Headless::destroy_context();
+        else
+            glfwTerminate();
     }
 
     ortho_view_data* get_viewport_at_mouse(double xpos, double ypos) {
@@ -939,7 +1194,17 @@ public:
                         }
                     }
                 }
-                // Add other editor mouse button handling here (selection, etc.)
+                // selection, resolved against the scene bvh in render_gizmo
+                else if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+                    double xpos, ypos;
+                    glfwGetCursorPos(window, &xpos, &ypos);
+
+                    ortho_view_data* active_viewport = renderer->get_viewport_at_mouse(xpos, ypos);
+                    if (active_viewport && active_viewport->type == ortho_view::SCENE) {
+                        renderer->pick_pending = true;
+                        renderer->pick_mouse = glm::vec2(xpos, ypos);
+                    }
+                }
             }
             else {
                 // Game mode mouse button handling - forward to player if they have this method
@@ -1010,6 +1275,12 @@ public:
         // exit
         if (key == GLFW_KEY_C && (mods & GLFW_MOD_CONTROL))
             glfwSetWindowShouldClose(window, true);
+
+#ifdef GLOW_PROFILE
+        // dump the profiler rings as a chrome trace
+        if (key == GLFW_KEY_F11 && action == GLFW_PRESS)
+            Profiler::request_trace();
+#endif
                
         if (renderer && renderer->current_player) {
             // if (renderer->editor_mode) {
@@ -1073,6 +1344,7 @@ public:
 
     Light spotlight;
     Light directional_light;
+    std::vector<Light> point_lights; // binned per cluster every frame, shadowed ones get atlas tiles
 
     shader_handle pbr_shader;
     shader_handle skybox_shader;
@@ -1088,12 +1360,64 @@ public:
     editor_viewports_struct editor_viewports;
     shader_handle editor_shader;
     bool editor_mode;
-
-    size_t target_entity = 0;
-
-    // deferred pipeline
-    Shader deferred_shader, deferred_lighting_shader, debug_gbuffer_shader;
-    unsigned int g_buffer, g_position, g_normal, g_albedo_specular;
-    unsigned int quadVAO;
+    bool headless = false;
+    Offscreen_target offscreen; // headless only
+    unsigned int output_fbo = 0;
+
+    entity_handle target_entity;
+    bool pick_pending = false;
+    glm::vec2 pick_mouse;
+
+    // per view dense indices into scene.entities, refilled every frame
+    std::vector<uint32_t> visible[VIEW_COUNT];
+    Culling::stats cull_stats[VIEW_COUNT];
+    Occlusion_culler occlusion; // camera view only
+    std::vector<std::pair<float, uint32_t>> occluder_candidates; // screen size, dense index
+    std::vector<uint8_t> occlusion_pixels;
+    unsigned int occlusion_texture = 0;
+    Render_queue render_queue;
+    Frame_uniforms frame_uniforms;
+    Clustered_lights clustered_lights;
+    Shadow_cascades shadow_cascades;
+    unsigned int cascades_due = 0; // bit per cascade redrawn this frame
+    Shadow_cache shadow_cache;
+    int spot_cache_slot = 0;
+    std::vector<uint32_t> resting_casters, awake_casters; // scratch, split of a shadow view's visible list
+    Shadow_atlas shadow_atlas;
+    struct atlas_draw {
+        Shadow_atlas::tile tile;
+        float far_plane;
+    };
+    std::vector<atlas_draw> atlas_draws; // faces to draw this frame, i uses view VIEW_ATLAS_0 + i
+    std::vector<Shadow_atlas::request> atlas_requests;
+    std::vector<uint32_t> atlas_order;
+    std::vector<Util::aabb> awake_bounds;
+
+    Render_graph graph; // rebuilt every render()
+
+    // deferred path, forward stays the default
+    G_buffer g_buffer;
+    G_buffer::targets gbuffer_targets; // this frame's, valid while the graph executes
+    shader_handle deferred_shader;
+    shader_handle deferred_lighting_shader;
+    shader_handle debug_gbuffer_shader;
+    bool deferred = false;
+    bool compare_paths = false; // also draws the path not shown every frame so both have numbers
+    int gbuffer_view = -1;      // >= 0 shows that g-buffer channel instead of the lit image
+    Util::gpu_query forward_time, geometry_time, lighting_time;
+    Util::gpu_query forward_samples, geometry_samples, lighting_samples;
+
+    // mesh lods, levels are picked per entity and view from the screen size of their error
+    bool lods_enabled = true;
+    float lod_threshold = 1.0f;   // pixels of error allowed at bias 0
+    float lod_bias = 0.0f;        // log2 on the threshold, up is coarser everywhere
+    float shadow_lod_bias = 1.0f; // added in shadow views
+    float lod_hysteresis = 0.25f; // fraction of the threshold a camera lod has to cross before it changes
+    struct lod_frame_stats {
+        uint32_t entities[Mesh_lod::MAX_LODS] = {}; // draws per level, every view
+        uint64_t triangles = 0, full_triangles = 0; // color views, full is what lod 0 everywhere would be
+        uint64_t shadow_triangles = 0, shadow_full_triangles = 0;
+    };
+    lod_frame_stats lod_stats;
 };
 #endif
@@ -32,7 +32,8 @@ public:
     void add_axes(const glm::vec3& position, const glm::quat& orientation, float length = 1.0f);
     void add_bbox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& color);
     void add_obb(const Util::OBB obb, const glm::vec3& color);
-    void render(Shader* debug_shader, const glm::mat4& projection, const glm::mat4& view);
+    // view and projection come from the bound view block
+    void render(Shader* debug_shader);
 
 private:
     std::vector<Debug_line> lines;
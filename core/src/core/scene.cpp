@@ -1,40 +1,129 @@
 #include "scene.h"
 
+#include <algorithm>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-Scene::Scene(std::string skybox_name) : skybox (skybox_name) {
-    entities = std::vector<Entity>();
-    timed_entities = std::vector<Entity>();
-}
+Scene::Scene(std::string skybox_name) : entities(0), timed_entities(1), skybox (skybox_name) {}
 
 Scene::~Scene() {}
 
-void Scene::include(Entity ntitty) {
-    if (ntitty.fade) {
-        timed_entities.push_back(ntitty);
-    }
-    else {
-        entities.push_back(ntitty);
+entity_handle Scene::include(const Entity& ntitty) {
+    bvh_dirty = true;
+    if (ntitty.fade)
+        return timed_entities.add(ntitty);
+    return entities.add(ntitty);
+}
+
+void Scene::remove(entity_handle h, bool timed) {
+    Entity_store& store = timed ? timed_entities : entities;
+    if (store.alive(h)) {
+        store.remove(h);
+        bvh_dirty = true;
     }
 }
 
-int Scene::cast_ray(const glm::vec3& pos, const glm::vec3& dir, glm::vec3& hit_pos) {
-    int hits = 0;
-    float min_dist = 999999999.0f;
-    glm::vec3 hit_pos_temp(0.0f);
+// inverse of T * R * S is S^-1 * R^T * -T, and S^-1 * R^T is the transposed normal matrix
+static glm::mat4 world_to_local(const glm::mat4& model, const glm::mat3& normal) {
+    glm::mat3 inv = glm::transpose(normal);
+    glm::mat4 out(inv);
+    out[3] = glm::vec4(-(inv * glm::vec3(model[3])), 1.0f);
+    return out;
+}
+
+void Scene::update(float dt) {
+    if (timed_entities.tick_ttl(dt))
+        bvh_dirty = true;
+
+    // models streamed in, bounds and bvh pointers taken from the placeholder are stale
+    if (model_epoch != Model_manager::ready_epoch()) {
+        model_epoch = Model_manager::ready_epoch();
+        entities.refresh_bounds();
+        timed_entities.refresh_bounds();
+        bvh_dirty = true;
+    }
+
+    // only bodies jolt reports as active (or that just fell asleep) are touched
+    Physics::sync_transforms(physics_sync);
+    entities.apply_transforms(physics_sync);
+    timed_entities.apply_transforms(physics_sync);
+
+    size_t count = entities.size() + timed_entities.size();
+    bool rebuild = bvh_dirty || bvh.instance_count() != count;
+    if (rebuild) {
+        instance_bounds.resize(count);
+        instance_world_to_local.resize(count);
+        world_bounds.resize(count);
+    }
+
+    size_t offset = 0;
+    bool moved = false;
+    for (const Entity_store* store : { &entities, &timed_entities }) {
+        auto update_instance = [&](size_t i) {
+            const glm::mat4& model = store->model_matrix(i);
+            instance_bounds[offset + i] = Util::transform_aabb(Model_manager::get_bvh(store->models[i]).bounds(), model);
+            world_bounds.set(offset + i, instance_bounds[offset + i]);
+            instance_world_to_local[offset + i] = world_to_local(model, store->normal_matrix(i));
+        };
 
-    for (Entity e : entities) {
-        if (e.collides(pos, dir, hit_pos_temp)) {
-            hits++;
-            float dist = glm::distance(hit_pos_temp, pos);
-            if (dist < min_dist) {
-                min_dist = dist;
-                hit_pos  = hit_pos_temp;
-            }
+        if (rebuild) {
+            for (size_t i = 0; i < store->size(); i++)
+                update_instance(i);
         }
+        else {
+            for (uint32_t i : store->changed())
+                update_instance(i);
+            moved |= !store->changed().empty();
+        }
+        offset += store->size();
+    }
+
+    if (rebuild) {
+        std::vector<const Bvh_mesh*> meshes;
+        meshes.reserve(count);
+        for (const Entity_store* store : { &entities, &timed_entities })
+            for (model_handle m : store->models)
+                meshes.push_back(&Model_manager::get_bvh(m));
+        bvh.build(instance_bounds, instance_world_to_local, meshes);
+        bvh_dirty = false;
+    }
+    else if (moved) {
+        bvh.refit(instance_bounds, instance_world_to_local);
     }
+}
+
+int Scene::cast_ray(const glm::vec3& pos, const glm::vec3& dir, glm::vec3& hit_pos) const {
+    Bvh_ray ray{ pos, dir };
+    Bvh_hit hit;
+    if (!bvh.intersect(ray, hit))
+        return 0;
+
+    hit_pos = pos + hit.t * dir;
+    return 1;
+}
+
+entity_handle Scene::pick(const glm::vec3& pos, const glm::vec3& dir, glm::vec3& hit_pos) const {
+    Bvh_ray ray{ pos, dir };
+    Bvh_hit hit;
+    // instances past entities.size() are timed, a stale bvh can also point past the store after a remove
+    if (!bvh.intersect(ray, hit) || hit.instance >= entities.size())
+        return entity_handle();
+
+    hit_pos = pos + hit.t * dir;
+    return entities.handles[hit.instance];
+}
+
+void Scene::cast_rays(const Bvh_ray* rays, Bvh_hit* hits, size_t count) const {
+    bvh.intersect(rays, hits, count);
+}
 
-    return hits;
+void Scene::cull(const Util::frustum& f, std::vector<uint32_t>& visible, Culling::stats& stats) const {
+    visible.clear();
+    // entities come first in the bounds, timed entities after them
+    size_t count = std::min(entities.size(), world_bounds.size());
+    Culling::cull(f, world_bounds, 0, count, visible);
+    stats.tested = (uint32_t)count;
+    stats.visible = (uint32_t)visible.size();
 }
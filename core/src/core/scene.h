@@ -5,6 +5,9 @@
 #include <string>
 
 #include "core/entity.h"
+#include "core/entity_store.h"
+#include "core/bvh.h"
+#include "core/culling.h"
 #include "asset/skybox.h"
 
 //struct entity_build {
@@ -25,13 +28,37 @@ public:
     Scene(std::string skybox_name);
     ~Scene();
 
-    void include(Entity ntitty);
-    // returns the number of hits
-    int cast_ray(const glm::vec3& pos, const glm::vec3& dir, glm::vec3& hit_pos);
+    // faded entities go to the timed archetype and are removed when their ttl runs out
+    entity_handle include(const Entity& ntitty);
+    void remove(entity_handle h, bool timed = false);
+    // ticks ttls, syncs moved physics bodies into the entity stores (blended by the physics interpolation alpha),
+    // then rebuilds the bvh after entities were added / removed and refits it when something moved
+    // call once per frame after Physics::step
+    void update(float dt);
+
+    // returns the number of hits (0 or 1, nearest hit only)
+    int cast_ray(const glm::vec3& pos, const glm::vec3& dir, glm::vec3& hit_pos) const;
+    // nearest hit in entities, invalid handle on a miss
+    entity_handle pick(const glm::vec3& pos, const glm::vec3& dir, glm::vec3& hit_pos) const;
+    // batched version, hits[i].instance is a dense index into entities then timed_entities
+    void cast_rays(const Bvh_ray* rays, Bvh_hit* hits, size_t count) const;
+    // clears visible and fills it with the dense indices of entities touching the frustum
+    void cull(const Util::frustum& f, std::vector<uint32_t>& visible, Culling::stats& stats) const;
+    // world boxes, entities first then timed entities, indexed like cull's output
+    const Culling::bounds_soa& bounds() const { return world_bounds; }
     void add();
 
-    std::vector<Entity> entities;
-    std::vector<Entity> timed_entities;
+    Entity_store entities;
+    Entity_store timed_entities;
     Skybox skybox;
+
+private:
+    Bvh_scene bvh;
+    bool bvh_dirty = true;
+    std::vector<Util::aabb> instance_bounds;
+    Culling::bounds_soa world_bounds; // same boxes as instance_bounds, soa for culling
+    std::vector<glm::mat4> instance_world_to_local;
+    Physics::transform_sync physics_sync;
+    uint32_t model_epoch = 0; // Model_manager::ready_epoch the bounds were taken at
 };
 #endif
@@ -0,0 +1,246 @@
+#include "shadow_atlas.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cassert>
+
+#include <glad/glad.h>
+
+static_assert(sizeof(shadow_tile_data) == 80, "shadow_tile_data has to match the std430 layout");
+
+void Shadow_atlas::init(unsigned int atlas_size, unsigned int min_size, unsigned int max_size) {
+    size = atlas_size;
+    min_tile = min_size;
+    max_tile = std::min(max_size, atlas_size);
+    levels = level_of(min_tile) + 1;
+    free_lists.assign(levels, std::vector<tile>());
+    free_lists[0].push_back({ 0, 0, (uint16_t)size, 0 });
+    entries.clear();
+
+    glGenTextures(1, &depth);
+    glBindTexture(GL_TEXTURE_2D, depth);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, size, size);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("[ATLAS] FB error: 0x%x\n", status);
+        assert(false);
+    }
+    // nothing drawn yet reads as lit
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    record_capacity = 64;
+    glGenBuffers(1, &record_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, record_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, record_capacity * sizeof(shadow_tile_data), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Shadow_atlas::shutdown() {
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &depth);
+    glDeleteBuffers(1, &record_buffer);
+    fbo = depth = record_buffer = 0;
+}
+
+int Shadow_atlas::level_of(unsigned int tile_size) const {
+    int level = 0;
+    for (unsigned int s = size; s > tile_size; s >>= 1)
+        level++;
+    return level;
+}
+
+bool Shadow_atlas::alloc_tile(int level, tile& out) {
+    if (level < 0)
+        return false;
+    std::vector<tile>& list = free_lists[level];
+    if (list.empty()) {
+        tile parent;
+        if (!alloc_tile(level - 1, parent))
+            return false;
+        // keep one child, the other 3 go to this level's free list
+        uint16_t half = (uint16_t)(size >> level);
+        list.push_back({ (uint16_t)(parent.x + half), parent.y, half, (uint8_t)level });
+        list.push_back({ parent.x, (uint16_t)(parent.y + half), half, (uint8_t)level });
+        list.push_back({ (uint16_t)(parent.x + half), (uint16_t)(parent.y + half), half, (uint8_t)level });
+        out = { parent.x, parent.y, half, (uint8_t)level };
+        return true;
+    }
+    out = list.back();
+    list.pop_back();
+    return true;
+}
+
+void Shadow_atlas::free_tile(const tile& t) {
+    if (t.level == 0) {
+        free_lists[0].push_back(t);
+        return;
+    }
+
+    // merge when the other 3 children of the parent are free too
+    unsigned int parent_size = size >> (t.level - 1);
+    uint16_t px = (uint16_t)(t.x - t.x % parent_size);
+    uint16_t py = (uint16_t)(t.y - t.y % parent_size);
+    std::vector<tile>& list = free_lists[t.level];
+    int siblings[3];
+    int found = 0;
+    for (int i = 0; i < (int)list.size() && found < 3; i++)
+        if (list[i].x - list[i].x % parent_size == px && list[i].y - list[i].y % parent_size == py)
+            siblings[found++] = i;
+
+    if (found < 3) {
+        list.push_back(t);
+        return;
+    }
+    // highest index first so the swap removes dont move the others
+    std::sort(siblings, siblings + 3, [](int a, int b) { return a > b; });
+    for (int i : siblings) {
+        list[i] = list.back();
+        list.pop_back();
+    }
+    free_tile({ px, py, (uint16_t)parent_size, (uint8_t)(t.level - 1) });
+}
+
+Shadow_atlas::entry* Shadow_atlas::find(uint32_t owner) {
+    for (entry& e : entries)
+        if (e.owner == owner)
+            return &e;
+    return nullptr;
+}
+
+void Shadow_atlas::allocate(std::vector<request>& requests) {
+    stats = atlas_stats();
+    std::sort(requests.begin(), requests.end(), [](const request& a, const request& b) { return a.priority > b.priority; });
+
+    // shrink the lowest priority requests until the total area fits, drop them once they are at the minimum
+    uint64_t capacity = (uint64_t)size * size;
+    uint64_t area = 0;
+    for (request& r : requests) {
+        r.size = std::max(min_tile, std::min(max_tile, r.size));
+        area += (uint64_t)r.faces * r.size * r.size;
+    }
+    size_t count = requests.size();
+    while (area > capacity && count > 0) {
+        bool shrunk = false;
+        for (size_t i = count; i-- > 0;) {
+            request& r = requests[i];
+            if (r.size > min_tile) {
+                area -= (uint64_t)r.faces * r.size * r.size * 3 / 4;
+                r.size >>= 1;
+                shrunk = true;
+                break;
+            }
+        }
+        if (!shrunk) {
+            count--;
+            area -= (uint64_t)requests[count].faces * requests[count].size * requests[count].size;
+        }
+    }
+    stats.dropped = (uint32_t)(requests.size() - count);
+    requests.resize(count);
+
+    // free what wasnt asked for again or changed size
+    for (size_t i = 0; i < entries.size();) {
+        entry& e = entries[i];
+        auto it = std::find_if(requests.begin(), requests.end(), [&](const request& r) { return r.owner == e.owner; });
+        if (it == requests.end() || it->size != e.requested || it->faces != e.faces) {
+            for (uint32_t f = 0; f < e.faces; f++)
+                free_tile(e.tiles[f]);
+            entries[i] = entries.back();
+            entries.pop_back();
+            continue;
+        }
+        e.priority = it->priority;
+        i++;
+    }
+
+    // new entries highest priority first, a fragmented atlas falls back to smaller tiles
+    for (const request& r : requests) {
+        if (find(r.owner))
+            continue;
+
+        entry e;
+        e.owner = r.owner;
+        e.faces = r.faces;
+        e.requested = r.size;
+        e.priority = r.priority;
+        e.drawn = false;
+        e.key = glm::vec4(0.0f);
+        e.version = 0;
+        e.record = -1;
+
+        bool ok = false;
+        for (unsigned int tile_size = r.size; tile_size >= min_tile && !ok; tile_size >>= 1) {
+            uint32_t got = 0;
+            while (got < r.faces && alloc_tile(level_of(tile_size), e.tiles[got]))
+                got++;
+            ok = got == r.faces;
+            if (!ok)
+                for (uint32_t f = 0; f < got; f++)
+                    free_tile(e.tiles[f]);
+            e.size = tile_size;
+        }
+        if (ok)
+            entries.push_back(e);
+        else
+            stats.dropped++;
+    }
+
+    for (const entry& e : entries) {
+        stats.tiles += e.faces;
+        stats.texels_used += e.faces * e.size * e.size;
+    }
+    stats.entries = (uint32_t)entries.size();
+}
+
+void Shadow_atlas::upload() {
+    records.clear();
+    float inv = 1.0f / size;
+    for (entry& e : entries) {
+        if (!e.drawn) {
+            e.record = -1;
+            continue;
+        }
+        e.record = (int)records.size();
+        for (uint32_t f = 0; f < e.faces; f++)
+            records.push_back({ e.view_projection[f], glm::vec4(e.tiles[f].x * inv, e.tiles[f].y * inv, e.size * inv, e.size * inv) });
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, record_buffer);
+    if (records.size() > record_capacity) {
+        while (record_capacity < records.size())
+            record_capacity *= 2;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, record_capacity * sizeof(shadow_tile_data), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, records.size() * sizeof(shadow_tile_data), records.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADOW_TILE_BINDING, record_buffer);
+}
+
+void Shadow_atlas::bind_write(const tile& t) {
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    glViewport(t.x, t.y, t.size, t.size);
+    glScissor(t.x, t.y, t.size, t.size);
+    glEnable(GL_SCISSOR_TEST);
+}
+
+void Shadow_atlas::end_write() {
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void Shadow_atlas::bind_read(unsigned int location) const {
+    glActiveTexture(GL_TEXTURE0 + location);
+    glBindTexture(GL_TEXTURE_2D, depth);
+}
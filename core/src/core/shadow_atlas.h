@@ -0,0 +1,111 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// one big depth texture shared by every shadowed light that isnt the main spot / sun,
+// so more lights cost tiles instead of their own fbo and a fixed 1024^2 map
+//
+//   tiles come from a quadtree: a free list per level, a node is split into 4 when a level runs dry
+//   and 4 free siblings merge back into their parent
+//   every frame the renderer asks for a tile size per light (screen coverage and importance),
+//   lights keep their tiles while the size stays the same, so the maps in them stay valid
+//   point lights take 6 tiles of the same size, one per cube face
+//
+// the fragment shader reads a shadow_tile_data record per face (binding 6), a light points at its first one
+
+const unsigned int SHADOW_TILE_BINDING = 6;
+// faces that can be redrawn in one frame, each needs its own view slot
+const int ATLAS_VIEW_COUNT = 24;
+
+// std430
+struct shadow_tile_data {
+    glm::mat4 view_projection;
+    glm::vec4 rect; // uv offset, uv scale
+};
+
+class Shadow_atlas {
+public:
+    struct request {
+        uint32_t owner;  // caller id, same light same owner every frame
+        uint32_t faces;  // 1 or 6
+        uint32_t size;   // power of two, lowered here when everything doesnt fit
+        float priority;
+    };
+
+    struct tile {
+        uint16_t x, y;
+        uint16_t size;
+        uint8_t level;
+    };
+
+    struct entry {
+        uint32_t owner;
+        uint32_t faces;
+        uint32_t size;      // can be below requested when the atlas was fragmented
+        uint32_t requested;
+        float priority;
+        tile tiles[6];
+        // filled by whoever draws the tiles, drawn says the maps match view_projection
+        bool drawn;
+        glm::vec4 key;
+        uint32_t version;
+        glm::mat4 view_projection[6];
+        int record; // first shadow_tile_data of this entry after upload, -1 when not drawn yet
+    };
+
+    struct atlas_stats {
+        uint32_t entries = 0;
+        uint32_t tiles = 0;
+        uint32_t texels_used = 0;
+        uint32_t dropped = 0;   // requests that got no tiles
+        uint32_t redrawn = 0;   // faces drawn this frame
+    };
+
+    // needs a gl context
+    void init(unsigned int size = 4096, unsigned int min_tile = 128, unsigned int max_tile = 1024);
+    void shutdown();
+
+    // fits the sizes to the atlas (lowest priority shrinks first, then drops), frees entries that were
+    // not asked for again or changed size, then allocates the new ones highest priority first
+    void allocate(std::vector<request>& requests);
+    entry* find(uint32_t owner);
+    std::vector<entry>& get_entries() { return entries; }
+
+    // records for every drawn entry, sets entry.record and binds them
+    void upload();
+
+    // fbo, viewport and scissor for one tile, end_write drops the scissor
+    void bind_write(const tile& t);
+    void end_write();
+    void bind_read(unsigned int location) const;
+    unsigned int texture() const { return depth; }
+
+    unsigned int atlas_size() const { return size; }
+    unsigned int min_tile_size() const { return min_tile; }
+    unsigned int max_tile_size() const { return max_tile; }
+    atlas_stats& get_stats() { return stats; }
+
+private:
+    bool alloc_tile(int level, tile& out);
+    void free_tile(const tile& t);
+    int level_of(unsigned int size) const;
+
+    unsigned int size = 0;
+    unsigned int min_tile = 0;
+    unsigned int max_tile = 0;
+    int levels = 0;
+    std::vector<std::vector<tile>> free_lists; // per level, level 0 is the whole atlas
+    std::vector<entry> entries;
+    std::vector<shadow_tile_data> records;
+
+    unsigned int fbo = 0;
+    unsigned int depth = 0;
+    unsigned int record_buffer = 0;
+    size_t record_capacity = 0;
+    atlas_stats stats;
+};
+#endif
@@ -0,0 +1,64 @@
+#include "shadow_cache.h"
+
+#include <glad/glad.h>
+
+void Shadow_cache::init() {
+    glGenFramebuffers(1, &fbo);
+}
+
+void Shadow_cache::shutdown() {
+    for (slot& s : slots)
+        glDeleteTextures(1, &s.texture);
+    slots.clear();
+    glDeleteFramebuffers(1, &fbo);
+    fbo = 0;
+}
+
+int Shadow_cache::add_slot(unsigned int size) {
+    slot s;
+    s.size = size;
+    s.view_projection = glm::mat4(0.0f);
+    s.rest_version = 0;
+    s.valid = false;
+
+    glGenTextures(1, &s.texture);
+    glBindTexture(GL_TEXTURE_2D, s.texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, size, size);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    slots.push_back(s);
+    return (int)slots.size() - 1;
+}
+
+bool Shadow_cache::stale(int i, const glm::mat4& view_projection, uint32_t rest_version) const {
+    const slot& s = slots[i];
+    return !enabled || !s.valid || s.rest_version != rest_version || s.view_projection != view_projection;
+}
+
+void Shadow_cache::begin_static(int i, const glm::mat4& view_projection, uint32_t rest_version) {
+    slot& s = slots[i];
+    s.view_projection = view_projection;
+    s.rest_version = rest_version;
+    s.valid = true;
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, s.texture, 0);
+    glDrawBuffer(GL_NONE);
+    glViewport(0, 0, s.size, s.size);
+    stats.static_draws++;
+}
+
+void Shadow_cache::restore(int i, unsigned int texture, unsigned int target, int layer) {
+    const slot& s = slots[i];
+    glCopyImageSubData(s.texture, GL_TEXTURE_2D, 0, 0, 0, 0,
+                       texture, target, 0, 0, 0, layer,
+                       s.size, s.size, 1);
+    stats.restores++;
+}
+
+void Shadow_cache::invalidate() {
+    for (slot& s : slots)
+        s.valid = false;
+}
@@ -0,0 +1,52 @@
+#ifndef SHADOW_CACHE_H
+#define SHADOW_CACHE_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// static caster depth per shadow view, drawn once and copied into the live map every frame
+// so only the bodies awake in jolt are drawn on top
+//   a slot is stale when its view projection or the scene's rest version changed since it was drawn,
+//   so idle scenes pay a cull and a copy instead of full shadow draws
+//   only views that hold still pay off, the spot light has a slot, the camera fitted cascades dont
+// the live maps have to be GL_DEPTH_COMPONENT24 like the slots for glCopyImageSubData
+class Shadow_cache {
+public:
+    void init();
+    void shutdown();
+
+    // one square depth layer, returns the slot
+    int add_slot(unsigned int size);
+
+    bool stale(int slot, const glm::mat4& view_projection, uint32_t rest_version) const;
+    // binds the slot for drawing the resting casters and stores the key it will be valid for
+    void begin_static(int slot, const glm::mat4& view_projection, uint32_t rest_version);
+    // copies the cached depth into layer of texture (GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY)
+    void restore(int slot, unsigned int texture, unsigned int target, int layer);
+    void invalidate();
+
+    struct cache_stats {
+        uint32_t static_draws = 0; // slots redrawn this frame
+        uint32_t restores = 0;
+    };
+    void begin_frame() { stats = cache_stats(); }
+    const cache_stats& get_stats() const { return stats; }
+
+    bool enabled = true;
+
+private:
+    struct slot {
+        unsigned int texture;
+        unsigned int size;
+        glm::mat4 view_projection;
+        uint32_t rest_version;
+        bool valid;
+    };
+
+    std::vector<slot> slots;
+    unsigned int fbo = 0;
+    cache_stats stats;
+};
+#endif
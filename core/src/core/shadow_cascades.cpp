@@ -0,0 +1,130 @@
+#include "shadow_cascades.h"
+
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <cassert>
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+void Shadow_cascades::init(unsigned int res) {
+    resolution = res;
+
+    glGenTextures(1, &shadow_maps);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadow_maps);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, CASCADE_COUNT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    // hardware compare, linear gives 2x2 pcf per tap
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    float border_color[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border_color);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow_maps, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("[CASCADES] FB error: 0x%x\n", status);
+        assert(false);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (int i = 0; i < CASCADE_COUNT; i++) {
+        views[i] = projections[i] = glm::mat4(1.0f);
+        eyes[i] = glm::vec3(0.0f);
+    }
+    force_update = true;
+}
+
+void Shadow_cascades::shutdown() {
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &shadow_maps);
+    fbo = shadow_maps = 0;
+}
+
+unsigned int Shadow_cascades::update(const glm::mat4& camera_view, float fov_y, float aspect, float near_plane, const glm::vec3& light_direction) {
+    glm::vec3 dir = glm::normalize(light_direction);
+    glm::vec4 params(shadow_distance, split_lambda, fov_y, aspect);
+    // anything that moves every cascade at once has to redraw the stale ones too
+    if (dir != last_direction || params != last_params || caster_distance != last_caster_distance) {
+        force_update = true;
+        last_direction = dir;
+        last_params = params;
+        last_caster_distance = caster_distance;
+    }
+
+    // fixed light rotation per direction, only the translation moves so the texel grid stays put
+    glm::vec3 up = std::abs(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 light_rotation = glm::lookAt(glm::vec3(0.0f), dir, up);
+    glm::mat4 light_to_world = glm::inverse(light_rotation);
+    glm::mat4 inverse_view = glm::inverse(camera_view);
+
+    // half diagonal of the frustum cross section per unit of depth
+    float tan_y = std::tan(fov_y * 0.5f);
+    float tan_x = tan_y * aspect;
+    float spread = std::sqrt(tan_x * tan_x + tan_y * tan_y);
+
+    unsigned int due = 0;
+    float slice_near = near_plane;
+    for (int i = 0; i < CASCADE_COUNT; i++) {
+        float t = (i + 1) / (float)CASCADE_COUNT;
+        float log_split = near_plane * std::pow(shadow_distance / near_plane, t);
+        float uniform_split = near_plane + (shadow_distance - near_plane) * t;
+        float slice_far = uniform_split + (log_split - uniform_split) * split_lambda;
+
+        float n = slice_near;
+        slice_near = slice_far;
+        update_interval[i] = std::max(update_interval[i], 1); // the ui can type in anything
+        if (!force_update && frame % update_interval[i] != 0)
+            continue;
+        float f = slice_far;
+
+        // smallest sphere around the slice with its center on the view axis,
+        // depends only on the slice shape so the ortho size is the same whichever way the camera faces
+        float kn = n * spread, kf = f * spread;
+        float center_depth = std::min((f * f + kf * kf - n * n - kn * kn) / (2.0f * (f - n)), f);
+        float radius = std::sqrt((f - center_depth) * (f - center_depth) + kf * kf);
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        glm::vec3 center = glm::vec3(inverse_view * glm::vec4(0.0f, 0.0f, -center_depth, 1.0f));
+        glm::vec3 light_center = glm::vec3(light_rotation * glm::vec4(center, 1.0f));
+
+        // whole texels only
+        float texel = 2.0f * radius / resolution;
+        light_center.x = std::floor(light_center.x / texel) * texel;
+        light_center.y = std::floor(light_center.y / texel) * texel;
+
+        // light looks down -z, the box reaches caster_distance further towards the light than the sphere
+        views[i] = light_rotation;
+        projections[i] = glm::ortho(light_center.x - radius, light_center.x + radius,
+                                    light_center.y - radius, light_center.y + radius,
+                                    -light_center.z - radius - caster_distance, -light_center.z + radius);
+        eyes[i] = glm::vec3(light_to_world * glm::vec4(light_center.x, light_center.y, light_center.z + radius + caster_distance, 1.0f));
+        depths[i] = 2.0f * radius + caster_distance;
+        splits[i] = f;
+        due |= 1u << i;
+    }
+
+    frame++;
+    force_update = false;
+    return due;
+}
+
+void Shadow_cascades::bind_write(int cascade) {
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow_maps, 0, cascade);
+    glViewport(0, 0, resolution, resolution);
+}
+
+void Shadow_cascades::bind_read(unsigned int location) const {
+    glActiveTexture(GL_TEXTURE0 + location);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadow_maps);
+}
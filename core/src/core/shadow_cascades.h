@@ -0,0 +1,63 @@
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// directional light shadows as CASCADE_COUNT ortho maps in one depth texture array,
+// each fitted to a slice of the camera frustum so texel density follows the camera instead of the world origin
+//
+//   splits blend log and uniform spacing (split_lambda) out to shadow_distance
+//   every cascade is the bounding sphere of its slice, so its size doesnt change when the camera turns,
+//   and the sphere center is snapped to whole texels in light space so moving doesnt shimmer
+//   cascade i is only refit and redrawn every update_interval[i] frames, the matrix it was drawn with
+//   is kept with it so stale cascades still sample correctly
+const int CASCADE_COUNT = 4;
+
+class Shadow_cascades {
+public:
+    // needs a gl context
+    void init(unsigned int resolution = 2048);
+    void shutdown();
+
+    // refits the cascades due this frame, returns a bit per cascade that has to be redrawn
+    unsigned int update(const glm::mat4& camera_view, float fov_y, float aspect, float near_plane, const glm::vec3& light_direction);
+    // forces every cascade to refit next update, light direction changes do this on their own
+    void invalidate() { force_update = true; }
+
+    void bind_write(int cascade);
+    void bind_read(unsigned int location) const;
+    unsigned int texture() const { return shadow_maps; }
+    unsigned int size() const { return resolution; }
+
+    const glm::mat4& view(int i) const { return views[i]; }
+    const glm::mat4& projection(int i) const { return projections[i]; }
+    // view space distance where cascade i ends
+    float split(int i) const { return splits[i]; }
+    // point on the light side of cascade i's box and its depth range, for the queue's depth bits
+    const glm::vec3& eye(int i) const { return eyes[i]; }
+    float depth_range(int i) const { return depths[i]; }
+
+    float shadow_distance = 100.0f;
+    float split_lambda = 0.8f;            // 0 uniform, 1 logarithmic
+    float caster_distance = 50.0f;        // how far behind a cascade (towards the light) casters are still drawn
+    int update_interval[CASCADE_COUNT] = { 1, 1, 2, 4 };
+
+private:
+    glm::mat4 views[CASCADE_COUNT];
+    glm::mat4 projections[CASCADE_COUNT];
+    float splits[CASCADE_COUNT] = {};
+    float depths[CASCADE_COUNT] = {};
+    glm::vec3 eyes[CASCADE_COUNT];
+
+    unsigned int resolution = 0;
+    unsigned int fbo = 0;
+    unsigned int shadow_maps = 0; // GL_TEXTURE_2D_ARRAY, one layer per cascade
+    uint64_t frame = 0;
+    bool force_update = true;
+    glm::vec3 last_direction = glm::vec3(0.0f);
+    glm::vec4 last_params = glm::vec4(0.0f); // shadow distance, lambda, fov, aspect
+    float last_caster_distance = 0.0f;
+};
+#endif
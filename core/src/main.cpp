@@ -3,17 +3,24 @@
 #include <dearimgui/imgui_impl_opengl3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <chrono>
+#include <cmath>
 
 #include "core/renderer.h"
 #include "core/entity.h"
 #include "core/scene.h"
 #include "core/physics.h"
+#include "core/jobs.h"
 #include "core/audio.h"
+#include "core/headless.h"
+#include "core/profiler.h"
 #include "player/player.h"
 #include "asset/crosshair.h"
 #include "asset/text.h"
 #include "asset/texture_manager.h"
 #include "asset/model_manager.h"
+#include "asset/streaming.h"
+#include "asset/asset_registry.h"
 
 // settings
 const unsigned int SCR_WIDTH = 1800;
@@ -22,14 +29,100 @@ const unsigned int SCR_HEIGHT = 900;
 float delta_time = 0.0f;
 float lastFrame = 0.0f;
 
-int main() {
+// fixed step frames along the camera path into the offscreen target, see core/headless.h
+// exit code 2 when a capture doesnt match its golden image
+static int run_headless(Renderer& renderer, Player& player, Scene& scene, const Headless::options& opts) {
+    Headless::Camera_path path;
+    if (opts.camera_path.empty())
+        path.orbit(20.0f, 8.0f, opts.frames * opts.time_step);
+    else if (!path.load(opts.camera_path))
+        return 1;
+    renderer.deferred = opts.deferred;
+    // goldens need every asset in from the first frame
+    Streaming::finish();
+
+    Headless::Frame_log log;
+    std::vector<uint8_t> pixels;
+    bool golden_ok = true;
+    bool capturing = !opts.capture_dir.empty() || !opts.golden_dir.empty();
+    printf("RENDERING %d frames headless\n", opts.frames);
+    for (int frame = 0; frame < opts.frames; frame++) {
+        PROFILE_FRAME();
+        auto start = std::chrono::steady_clock::now();
+
+        glm::vec3 position, target;
+        path.sample(frame * opts.time_step, position, target);
+        glm::vec3 front = target - position;
+        if (glm::dot(front, front) > 1e-8f) {
+            front = glm::normalize(front);
+            player.camera.yaw = glm::degrees(std::atan2(front.z, front.x));
+            player.camera.pitch = glm::degrees(std::asin(glm::clamp(front.y, -1.0f, 1.0f)));
+        }
+        player.camera.position = position;
+        player.camera.update_camera_vectors();
+
+        Physics::step(opts.time_step);
+        scene.update(opts.time_step);
+        renderer.render(player, scene, opts.time_step);
+        auto issued = std::chrono::steady_clock::now();
+        glFinish();
+        auto done = std::chrono::steady_clock::now();
+
+        Renderer::path_stats ps = renderer.get_path_stats();
+        Headless::frame_sample sample;
+        sample.frame_ms = std::chrono::duration<float, std::milli>(done - start).count();
+        sample.cpu_ms = std::chrono::duration<float, std::milli>(issued - start).count();
+        sample.gpu_ms = opts.deferred ? ps.geometry_ms + ps.lighting_ms : ps.forward_ms;
+        sample.draw_calls = renderer.render_queue.get_stats().draw_calls;
+        sample.triangles = renderer.render_queue.get_stats().triangles;
+        log.add(sample);
+
+        bool last = frame == opts.frames - 1;
+        if (capturing && (last || (opts.capture_every > 0 && frame % opts.capture_every == 0))) {
+            renderer.offscreen.read_pixels(pixels);
+            char name[32];
+            snprintf(name, sizeof(name), "frame_%05d.png", frame);
+            if (!opts.capture_dir.empty())
+                Headless::write_png(opts.capture_dir + "/" + name, opts.width, opts.height, pixels);
+            if (!opts.golden_dir.empty())
+                golden_ok &= Headless::compare_golden(opts.golden_dir + "/" + name, opts.width, opts.height, pixels, opts);
+        }
+        renderer.flush();
+    }
+
+    log.write_csv(opts.timings);
+    log.print_summary(opts.warmup);
+#ifdef GLOW_PROFILE
+    if (!opts.trace.empty()) {
+        Profiler::begin_frame(); // closes the last frame
+        Profiler::write_trace(opts.trace);
+    }
+#endif
+    return golden_ok ? 0 : 2;
+}
+
+int main(int argc, char** argv) {
+    Headless::options headless;
+    if (!Headless::parse_args(argc, argv, headless))
+        return -1;
 
     Renderer renderer;
-    if (!renderer.init(SCR_WIDTH, SCR_HEIGHT, "GLOW", false)) {
+    if (headless.enabled) {
+        if (!renderer.init(headless.width, headless.height, "GLOW", false, true))
+            return -1;
+    }
+    else if (!renderer.init(SCR_WIDTH, SCR_HEIGHT, "GLOW", false)) {
         return -1;
     };
     
-    Audio::init();
+    // the build farm has no sound device either
+    if (!headless.enabled)
+        Audio::init();
+    Jobs::init();
+#ifdef GLOW_PROFILE
+    Profiler::init();
+#endif
+    Streaming::init();
     Physics::init();
 
     //Texture_manager::init();
@@ -101,6 +194,24 @@ int main() {
     Entity e5(car232323, pos, true, scale, 1.0f, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
     scene.include(e5);
 
+    // ground 
+    JPH::BodyID ground = Physics::addBox(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(100.0f, 1.0f, 100.0f), true);
+    Physics::optimize_broad_phase();
+
+    if (headless.enabled) {
+        int code = run_headless(renderer, player, scene, headless);
+        Streaming::shutdown();
+        Model_manager::cleanup();
+        Texture_manager::cleanup();
+        Asset_registry::shutdown();
+        Physics::shutdown();
+#ifdef GLOW_PROFILE
+        Profiler::shutdown();
+#endif
+        Jobs::shutdown();
+        renderer.shutdown();
+        return code;
+    }
 
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
@@ -124,19 +235,36 @@ int main() {
     Text screen_text3(font3, u8"我爱你", 600, 200, 50.0f, glm::vec3(1.0f, 0.1f, 0.1f));
     Text screen_text4(font3, "hello world!?", 800, 300, 50.0f, glm::vec3(1.0f, 0.1f, 0.1f));*/
 
-    // ground 
-    JPH::BodyID ground = Physics::addBox(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(100.0f, 1.0f, 100.0f), true);
-    Physics::optimize_broad_phase();
+
+    std::vector<Jobs::worker_stats> job_stats;
+    float point_light_radius = 8.0f;
+    bool point_light_shadows = false;
+    bool show_occlusion_buffer = false;
+    std::vector<const char*> graph_passes;
+    std::vector<uint8_t> graph_culled;
+#ifdef GLOW_PROFILE
+    std::vector<float> frame_times;
+    std::vector<Profiler::counter_value> profile_counters;
+#endif
 
     // render loop
     unsigned int step = 0;
     printf("RENDERING\n");
     while (renderer.open()) {
+        PROFILE_FRAME();
         float currentFrame = renderer.get_time();
 
         delta_time = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        {
+            // whatever the loaders finished, up to the byte budget
+            PROFILE_SCOPE("streaming");
+            Streaming::update();
+            // over budget, unreferenced models and textures go
+            Asset_registry::update();
+        }
+
         if (!(step++ % 30)) {
             fpscounter.updateText(std::to_string((int)(1.0f / delta_time)));
             weapon_ammo_text.updateText(std::to_string(player.active_weapon->current_ammo));
@@ -153,19 +281,36 @@ int main() {
         // draws hud (weapon, etc)
 
         if (!renderer.editor_mode) {
+            PROFILE_SCOPE("simulate");
             player.controller_step(renderer.window, delta_time, scene);
-            Physics::update(); // default 1/60 delta time
+            Physics::step(delta_time); // fixed ticks, rendering blends between the last two
+        }
+        {
+            // refit the scene bvh to this frames transforms, gizmo edits move entities in editor mode too
+            PROFILE_SCOPE("scene update");
+            scene.update(delta_time);
         }
 
-        // render scene
-        renderer.render(player, scene, delta_time);
+        {
+            // render scene
+            PROFILE_SCOPE("render");
+            renderer.render(player, scene, delta_time);
+        }
 
-        if (!player.key_toggles[(unsigned)'r'])
+        if (!player.key_toggles[(unsigned)'r']) {
+            PROFILE_GPU_SCOPE("debug");
             renderer.render_debug(player);
+        }
 
-        // render scene deferred pipeline
-        // renderer.render_scene_deferred(player, scene, delta_time);
-        // TODO: clustered forward 
+        PROFILE_COUNTER("draw calls", renderer.render_queue.get_stats().draw_calls);
+        PROFILE_COUNTER("triangles", renderer.render_queue.get_stats().triangles);
+        PROFILE_COUNTER("texture binds", renderer.render_queue.get_stats().texture_binds);
+        PROFILE_COUNTER("program switches", renderer.render_queue.get_stats().program_switches);
+        PROFILE_COUNTER("fbo binds", renderer.graph.get_stats().fbo_binds);
+        PROFILE_COUNTER("active bodies", Physics::active_body_count());
+        PROFILE_COUNTER("audio voices", Audio::playing_channels());
+        PROFILE_COUNTER("streamed bytes", Streaming::get_stats().uploaded_bytes);
+        PROFILE_COUNTER("asset bytes", Asset_registry::total_bytes());
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -181,6 +326,193 @@ int main() {
         ImGui::SliderFloat3("directional_light_direction", &renderer.directional_light.direction.x, -1.0f, 1.0f);
         ImGui::SliderFloat3("directional_light_color", &renderer.directional_light.color.x, -1.0f, 1.0f);
         ImGui::SliderFloat("directional_light_intensity", &renderer.directional_light.intensity, 0.0f, 2.0f);
+        ImGui::SliderFloat("shadow distance", &renderer.shadow_cascades.shadow_distance, 10.0f, FAR_PLANE);
+        ImGui::SliderFloat("cascade split lambda", &renderer.shadow_cascades.split_lambda, 0.0f, 1.0f);
+        ImGui::SliderInt4("cascade update interval", renderer.shadow_cascades.update_interval, 1, 8, "%d", ImGuiSliderFlags_AlwaysClamp);
+        for (int i = 0; i < CASCADE_COUNT; i++)
+            ImGui::Text("cascade %d to %6.1f %s", i, renderer.shadow_cascades.split(i), renderer.cascades_due & (1u << i) ? "drawn" : "kept");
+        ImGui::Checkbox("static shadow cache", &renderer.shadow_cache.enabled);
+        ImGui::Text("static layers redrawn %u, restored %u", renderer.shadow_cache.get_stats().static_draws, renderer.shadow_cache.get_stats().restores);
+        ImGui::End();
+
+        ImGui::Begin("Point lights");
+        const cluster_stats& cs = renderer.clustered_lights.get_stats();
+        if (renderer.clustered_lights.has_compute())
+            ImGui::Checkbox("compute binning", &renderer.clustered_lights.use_compute);
+        else
+            ImGui::Text("no compute, cpu binning");
+        ImGui::SliderFloat("spawn radius", &point_light_radius, 1.0f, 30.0f);
+        ImGui::Checkbox("spawn shadowed", &point_light_shadows);
+        if (ImGui::Button("spawn 100")) {
+            for (int i = 0; i < 100; i++) {
+                glm::vec3 pos(rand() / (float)RAND_MAX * 40.0f - 20.0f, rand() / (float)RAND_MAX * 5.0f + 0.5f, rand() / (float)RAND_MAX * 40.0f - 20.0f);
+                glm::vec3 color(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+                renderer.point_lights.push_back(Light::create_point(pos, color, 5.0f, point_light_radius, point_light_shadows));
+            }
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("clear"))
+            renderer.point_lights.clear();
+        ImGui::Text("lights           %u", cs.lights);
+        ImGui::Text("bin cpu          %.3f ms", cs.bin_ms);
+        if (!renderer.clustered_lights.use_compute || !renderer.clustered_lights.has_compute()) {
+            ImGui::Text("max per cluster  %u", cs.max_per_cluster);
+            ImGui::Text("avg per cluster  %.2f", cs.average_per_cluster);
+            ImGui::Text("overflowed       %u", cs.overflowed);
+        }
+        const Shadow_atlas::atlas_stats& as = renderer.shadow_atlas.get_stats();
+        ImGui::Text("shadowed         %u (%u dropped)", as.entries, as.dropped);
+        ImGui::Text("atlas tiles      %u, %.1f%% used", as.tiles, 100.0f * as.texels_used / ((float)renderer.shadow_atlas.atlas_size() * renderer.shadow_atlas.atlas_size()));
+        ImGui::Text("faces redrawn    %u / %d", as.redrawn, ATLAS_VIEW_COUNT);
+        ImGui::End();
+
+        ImGui::Begin("Physics");
+        float tick_rate = Physics::get_tick_rate();
+        if (ImGui::SliderFloat("tick rate", &tick_rate, 10.0f, 240.0f))
+            Physics::set_tick_rate(tick_rate);
+        ImGui::Text("alpha %.2f", Physics::interpolation_alpha());
+        ImGui::End();
+
+        ImGui::Begin("Culling");
+        for (int v = 0; v <= VIEW_ATLAS_0; v++)
+            ImGui::Text("%-12s %4u / %4u visible", render_view_strs[v], renderer.cull_stats[v].visible, renderer.cull_stats[v].tested);
+        ImGui::End();
+
+        ImGui::Begin("Occlusion");
+        const Occlusion_culler::occlusion_stats& os = renderer.occlusion.get_stats();
+        ImGui::Checkbox("cpu occlusion culling", &renderer.occlusion.enabled);
+        ImGui::SliderInt("max occluders", &renderer.occlusion.max_occluders, 0, 256);
+        ImGui::SliderFloat("min occluder size", &renderer.occlusion.min_occluder_size, 0.0f, 1.0f);
+        ImGui::Text("occluders        %u, %u triangles", os.occluders, os.triangles);
+        ImGui::Text("occluded         %u / %u, %u submitted", os.occluded, os.tested, os.tested - os.occluded);
+        ImGui::Text("raster           %.3f ms", os.raster_ms);
+        ImGui::Text("test             %.3f ms", os.test_ms);
+        ImGui::Checkbox("show depth", &show_occlusion_buffer);
+        if (show_occlusion_buffer && renderer.occlusion.enabled) {
+            renderer.update_occlusion_debug();
+            // rows are stored bottom up
+            ImGui::Image((ImTextureID)(intptr_t)renderer.occlusion_texture, ImVec2(renderer.occlusion.get_width() * 2.0f, renderer.occlusion.get_height() * 2.0f), ImVec2(0, 1), ImVec2(1, 0));
+        }
+        ImGui::End();
+
+        ImGui::Begin("LOD");
+        const auto& ls = renderer.lod_stats;
+        ImGui::Checkbox("mesh lods", &renderer.lods_enabled);
+        ImGui::SliderFloat("error (px)", &renderer.lod_threshold, 0.25f, 8.0f);
+        ImGui::SliderFloat("bias", &renderer.lod_bias, -2.0f, 4.0f);
+        ImGui::SliderFloat("shadow bias", &renderer.shadow_lod_bias, 0.0f, 4.0f);
+        ImGui::SliderFloat("hysteresis", &renderer.lod_hysteresis, 0.0f, 0.9f);
+        ImGui::Text("draws per level  %u %u %u %u", ls.entities[0], ls.entities[1], ls.entities[2], ls.entities[3]);
+        ImGui::Text("triangles        %llu / %llu", (unsigned long long)ls.triangles, (unsigned long long)ls.full_triangles);
+        ImGui::Text("shadow triangles %llu / %llu", (unsigned long long)ls.shadow_triangles, (unsigned long long)ls.shadow_full_triangles);
+        ImGui::End();
+
+        ImGui::Begin("Render queue");
+        const render_stats& rs = renderer.render_queue.get_stats();
+        ImGui::Checkbox("multi draw indirect", &renderer.render_queue.use_indirect);
+        ImGui::Text("submit cpu       %.3f ms", rs.submit_ms);
+        ImGui::Text("draw calls       %u", rs.draw_calls);
+        ImGui::Text("commands         %u", rs.commands);
+        ImGui::Text("instances        %u", rs.instances);
+        ImGui::Text("triangles        %u", rs.triangles);
+        ImGui::Text("texture binds    %u", rs.texture_binds);
+        ImGui::Text("program switches %u", rs.program_switches);
+        ImGui::Text("vao binds        %u", rs.vao_binds);
+        Geometry_pool::pool_stats ps = Geometry_pool::get_stats();
+        ImGui::Text("geometry         %u / %u vertices, %u / %u indices", ps.vertices_used, ps.vertex_capacity, ps.indices_used, ps.index_capacity);
+        ImGui::Text("free ranges      %u", ps.free_ranges);
+        if (ImGui::Button("defragment"))
+            Geometry_pool::defragment();
+        ImGui::End();
+
+        ImGui::Begin("Deferred");
+        ImGui::Checkbox("deferred", &renderer.deferred);
+        ImGui::Checkbox("compare with the other path", &renderer.compare_paths);
+        const char* gbuffer_views[] = { "lit", "albedo", "normal", "metallic", "roughness", "depth" };
+        int gbuffer_view = renderer.gbuffer_view + 1;
+        if (ImGui::Combo("show", &gbuffer_view, gbuffer_views, IM_ARRAYSIZE(gbuffer_views)))
+            renderer.gbuffer_view = gbuffer_view - 1;
+        Renderer::path_stats path = renderer.get_path_stats();
+        ImGui::Text("forward          %.3f ms  %7.1f MB", path.forward_ms, path.forward_mb);
+        ImGui::Text("deferred         %.3f ms  %7.1f MB", path.geometry_ms + path.lighting_ms, path.deferred_mb);
+        ImGui::Text("  geometry       %.3f ms", path.geometry_ms);
+        ImGui::Text("  lighting       %.3f ms", path.lighting_ms);
+        ImGui::Text("  unpacked       %7.1f MB (position target layout)", path.unpacked_mb);
+        ImGui::Text("g-buffer         %u B/px, was %u", G_buffer::BYTES_PER_PIXEL, G_buffer::UNPACKED_BYTES_PER_PIXEL);
+        ImGui::End();
+
+        ImGui::Begin("Render graph");
+        const Render_graph::graph_stats& gs = renderer.graph.get_stats();
+        renderer.graph.describe(graph_passes, graph_culled);
+        for (size_t i = 0; i < graph_passes.size(); i++)
+            ImGui::Text("%s%s", graph_passes[i], graph_culled[i] ? "  (culled)" : "");
+        ImGui::Text("passes           %u, %u culled", gs.passes, gs.culled);
+        ImGui::Text("fbo binds        %u, %u skipped", gs.fbo_binds, gs.fbo_binds_skipped);
+        const float mb = 1.0f / (1024.0f * 1024.0f);
+        ImGui::Text("transients       %u, %.1f MB unaliased, %.1f MB used", gs.transients, gs.transient_bytes * mb, gs.aliased_bytes * mb);
+        ImGui::Text("pool             %u textures, %.1f MB", gs.pooled_textures, gs.pool_bytes * mb);
+        ImGui::End();
+
+#ifdef GLOW_PROFILE
+        ImGui::Begin("Profiler");
+        ImGui::Checkbox("record", &Profiler::enabled);
+        ImGui::SameLine();
+        if (ImGui::Button("write trace (F11)"))
+            Profiler::request_trace();
+        Profiler::frame_stats fs = Profiler::get_frame_stats();
+        Profiler::frame_history(frame_times);
+        if (!frame_times.empty())
+            ImGui::PlotLines("##frame times", frame_times.data(), (int)frame_times.size(), 0, nullptr, 0.0f, std::max(fs.p99_ms * 1.5f, 1.0f), ImVec2(-1, 60));
+        ImGui::Text("frame ms  mean %.2f  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f", fs.mean_ms, fs.p50_ms, fs.p95_ms, fs.p99_ms, fs.max_ms);
+        // bars are fractions of the median frame, gpu results lag a few frames
+        float budget = std::max(fs.p50_ms, 0.001f);
+        char bar[64];
+        for (const Profiler::pass_timing& pt : Profiler::passes()) {
+            ImGui::Text("%*s%-16s", pt.depth * 2, "", pt.name);
+            ImGui::SameLine(180.0f);
+            snprintf(bar, sizeof(bar), "cpu %.3f", pt.cpu_ms);
+            ImGui::ProgressBar(pt.cpu_ms / budget, ImVec2(140.0f, 0.0f), bar);
+            ImGui::SameLine();
+            snprintf(bar, sizeof(bar), "gpu %.3f", pt.gpu_ms);
+            ImGui::ProgressBar(pt.gpu_ms / budget, ImVec2(140.0f, 0.0f), bar);
+        }
+        Profiler::counters(profile_counters);
+        for (const Profiler::counter_value& c : profile_counters)
+            ImGui::Text("%-16s %lld", c.name, (long long)c.value);
+        ImGui::End();
+#endif
+
+        ImGui::Begin("Streaming");
+        Streaming::stream_stats ss = Streaming::get_stats();
+        int budget_kb = (int)(Streaming::frame_budget / 1024);
+        if (ImGui::SliderInt("budget (KB/frame)", &budget_kb, 64, 65536))
+            Streaming::frame_budget = (size_t)budget_kb * 1024;
+        ImGui::Text("loading          %u", ss.loading);
+        ImGui::Text("staged uploads   %u", ss.staged);
+        ImGui::Text("last frame       %u uploads, %.1f KB", ss.uploads, ss.uploaded_bytes / 1024.0f);
+        ImGui::End();
+
+        ImGui::Begin("Assets");
+        int budget_mb = (int)(Asset_registry::budget >> 20);
+        if (ImGui::SliderInt("budget (MB, 0 is off)", &budget_mb, 0, 8192))
+            Asset_registry::budget = (uint64_t)budget_mb << 20;
+        ImGui::Text("resident         %.1f MB", Asset_registry::total_bytes() / (1024.0f * 1024.0f));
+        const char* asset_types[] = { "models", "textures", "shaders" };
+        for (int t = 0; t < Asset_registry::TYPE_COUNT; t++) {
+            Asset_registry::type_stats as = Asset_registry::get_stats((Asset_registry::asset_type)t);
+            ImGui::Text("%-8s %4u, %4u resident, %4u referenced, cpu %7.1f MB, gpu %7.1f MB, %u evicted", asset_types[t],
+                as.assets, as.resident, as.referenced, as.cpu_bytes / (1024.0f * 1024.0f), as.gpu_bytes / (1024.0f * 1024.0f), as.evictions);
+        }
+        ImGui::End();
+
+        ImGui::Begin("Jobs");
+        Jobs::collect_stats(job_stats);
+        for (size_t i = 0; i < job_stats.size(); i++) {
+            const Jobs::worker_stats& s = job_stats[i];
+            double total = s.busy_ms + s.idle_ms;
+            ImGui::Text("%s %zu: %5.1f%% busy  %llu jobs  %llu steals", i == 0 ? "main" : "worker", i,
+                total > 0.0 ? 100.0 * s.busy_ms / total : 0.0, (unsigned long long)s.jobs, (unsigned long long)s.steals);
+        }
         ImGui::End();
 
         //player.debug_hud();
@@ -197,9 +529,15 @@ int main() {
             renderer.render_hud_text(player_holding);
         }
         ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        
-        renderer.flush();
+        {
+            PROFILE_GPU_SCOPE("imgui");
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+
+        {
+            PROFILE_SCOPE("present");
+            renderer.flush();
+        }
         Audio::update();
     }
 
@@ -207,9 +545,16 @@ int main() {
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    //Model_manager::cleanup();
+    // loaders touch the managers, they go first
+    Streaming::shutdown();
+    Model_manager::cleanup();
     Texture_manager::cleanup();
+    Asset_registry::shutdown();
     Physics::shutdown();
+#ifdef GLOW_PROFILE
+    Profiler::shutdown();
+#endif
+    Jobs::shutdown();
     renderer.shutdown();
     return 0;
 }
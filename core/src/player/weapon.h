@@ -6,7 +6,7 @@
 
 #include <core/audio.h>
 #include <core/physics.h>
-#include <asset/model_ass.h>
+#include <asset/model_manager.h>
 
 enum class Weapon_id {
     M4A1,
@@ -19,7 +19,7 @@ enum class Weapon_id {
 
 class Weapon {
 public:
-    Model_ass model;
+    model_handle model = 0; // referenced for as long as the weapon exists, weapons are never freed
 
     // Visual properties
     glm::vec3 wep_pos;      // Current position
@@ -89,9 +89,8 @@ public:
     
     static Weapon M4A1() {
         Weapon weapon;
-        printf("here\n");
-        weapon.model.load_model("../resources/models/m4a1/M4A1.obj");
-        printf("here23\n");
+        weapon.model = Model_manager::load_model("m4a1/M4A1.obj", 0);
+        Model_manager::acquire(weapon.model);
         weapon.id = Weapon_id::M4A1;
         weapon.name = "m4a1";
         weapon.min_pos = glm::vec3(0.6f, -0.5f, -1.6f);
@@ -121,7 +120,8 @@ public:
     
     static Weapon GLOCK() {
         Weapon weapon;
-        weapon.model.load_model("../resources/models/glock/glock.gltf");
+        weapon.model = Model_manager::load_model("glock/glock.gltf", 0);
+        Model_manager::acquire(weapon.model);
         weapon.id = Weapon_id::GLOCK;
         weapon.name = "glock";
         weapon.min_pos = glm::vec3(0.4f, -0.4f, -1.3f);
@@ -0,0 +1,149 @@
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include <stb_image.h>
+
+#include "asset/model_ass.h"
+#include "asset/cooked_mesh.h"
+#include "asset/texture_codec.h"
+#include "asset/ktx2.h"
+
+// offline asset cooker, the cook target runs it over resources/models
+//   every model file under the given directories (or given directly) is imported with assimp
+//   and written next to itself as a .glwm, see asset/cooked_mesh.h
+//   then every texture those models use is cooked into a block compressed .ktx2 next to it (asset/ktx2.h),
+//   how a model uses it (albedo, normal, metallic roughness) picks the format
+//   anything whose cooked file is newer than its source is skipped unless --force
+//   --hq encodes albedo as bc7 instead of bc1 / bc3
+// usage: glwm_cook [--force] [--hq] <dir or model>...
+
+typedef std::map<std::string, Texture_codec::usage> texture_uses;
+
+static bool is_model(const std::filesystem::path& p) {
+    std::string ext = p.extension().string();
+    for (char& c : ext)
+        c = (char)tolower(c);
+    return ext == ".gltf" || ext == ".glb" || ext == ".obj" || ext == ".fbx" || ext == ".dae";
+}
+
+static void add_use(texture_uses& textures, const std::string& path, Texture_codec::usage use) {
+    if (path.empty())
+        return;
+    auto it = textures.emplace(path, use).first;
+    if (it->second != use)
+        printf("[COOK] %s is used as %s and %s, cooking it as the first\n", path.c_str(), Texture_codec::usage_name(it->second), Texture_codec::usage_name(use));
+}
+
+// 0 cooked or up to date, 1 failed
+static int cook_model(const std::string& path, bool force, texture_uses& textures) {
+    Model_ass model;
+    if (!force && Cooked_mesh::fresh(path)) {
+        // still loaded (from the .glwm) for its texture list
+        if (model.import(path)) {
+            printf("[COOK] failed      %s\n", path.c_str());
+            return 1;
+        }
+        printf("[COOK] up to date  %s\n", path.c_str());
+    }
+    else {
+        auto start = std::chrono::steady_clock::now();
+        if (model.import_source(path) || model.cook(Cooked_mesh::cooked_path(path))) {
+            printf("[COOK] failed      %s\n", path.c_str());
+            return 1;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::error_code ec;
+        uintmax_t bytes = std::filesystem::file_size(Cooked_mesh::cooked_path(path), ec);
+        printf("[COOK] cooked      %s, %.1f KB in %.0f ms\n", path.c_str(), ec ? 0.0 : bytes / 1024.0, ms);
+    }
+    for (const Model_ass::texture_paths& t : model.get_texture_paths()) {
+        add_use(textures, t.albedo, Texture_codec::ALBEDO);
+        add_use(textures, t.normal, Texture_codec::NORMAL);
+        add_use(textures, t.metallic_roughness, Texture_codec::METALLIC_ROUGHNESS);
+    }
+    return 0;
+}
+
+static int cook_texture(const std::string& path, Texture_codec::usage use, bool force, bool high_quality) {
+    if (!force && Ktx2::fresh(path)) {
+        printf("[COOK] up to date  %s\n", path.c_str());
+        return 0;
+    }
+    auto start = std::chrono::steady_clock::now();
+    int width, height, components;
+    unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &components, 4);
+    if (!pixels) {
+        printf("[COOK] failed      %s, %s\n", path.c_str(), stbi_failure_reason());
+        return 1;
+    }
+    Texture_codec::image source;
+    source.width = (uint32_t)width;
+    source.height = (uint32_t)height;
+    source.rgba.assign(pixels, pixels + (size_t)width * height * 4);
+    stbi_image_free(pixels);
+    // grey sources lose nothing in one channel, normal maps need their two either way
+    if (components == 1 && use != Texture_codec::NORMAL)
+        use = Texture_codec::SINGLE_CHANNEL;
+
+    Texture_codec::cooked_texture cooked;
+    Texture_codec::cook(source, use, high_quality, cooked);
+    if (Ktx2::write(Ktx2::cooked_path(path), cooked)) {
+        printf("[COOK] failed      %s\n", path.c_str());
+        return 1;
+    }
+    size_t bytes = 0;
+    for (const std::vector<uint8_t>& level : cooked.levels)
+        bytes += level.size();
+    // what the png path would have uploaded, mips included
+    size_t raw = (size_t)width * height * components * 4 / 3;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("[COOK] cooked      %s, %s %s, %.1f KB (%.1fx smaller) in %.0f ms\n", path.c_str(), Texture_codec::usage_name(use),
+        Texture_codec::format_name(cooked.block_format), bytes / 1024.0, (double)raw / bytes, ms);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    bool force = false;
+    bool high_quality = false;
+    std::vector<std::string> models;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--force") == 0) {
+            force = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--hq") == 0) {
+            high_quality = true;
+            continue;
+        }
+        std::error_code ec;
+        if (std::filesystem::is_directory(argv[i], ec)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[i], ec))
+                if (entry.is_regular_file() && is_model(entry.path()))
+                    models.push_back(entry.path().generic_string());
+        } else if (std::filesystem::is_regular_file(argv[i], ec)) {
+            models.push_back(argv[i]);
+        } else {
+            printf("[COOK] no such file or directory %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (models.empty()) {
+        printf("usage: glwm_cook [--force] [--hq] <dir or model>...\n");
+        return 1;
+    }
+
+    int failed = 0;
+    texture_uses textures;
+    for (const std::string& path : models)
+        failed += cook_model(path, force, textures);
+    for (const auto& t : textures)
+        failed += cook_texture(t.first, t.second, force, high_quality);
+    printf("[COOK] %zu models, %zu textures, %d failed\n", models.size(), textures.size(), failed);
+    return failed ? 1 : 0;
+}
@@ -7,5 +7,19 @@ namespace Util {
 		glm::vec3 min;
 		glm::vec3 max;
 	};
+
+	// world aabb of a transformed box (arvo), tighter than transforming the 8 corners and cheaper
+	inline aabb transform_aabb(const aabb& box, const glm::mat4& m) {
+		aabb out{ glm::vec3(m[3]), glm::vec3(m[3]) };
+		for (int c = 0; c < 3; c++) {
+			for (int r = 0; r < 3; r++) {
+				float a = m[c][r] * box.min[c];
+				float b = m[c][r] * box.max[c];
+				out.min[r] += glm::min(a, b);
+				out.max[r] += glm::max(a, b);
+			}
+		}
+		return out;
+	}
 }
 
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+namespace Util {
+	// GL_TIME_ELAPSED or GL_SAMPLES_PASSED around a pass, read back a few frames late so it never stalls
+	// only one query per target can be open at a time
+	struct gpu_query {
+		static const int LATENCY = 3;
+
+		GLenum target = GL_TIME_ELAPSED;
+		unsigned int ids[LATENCY] = {};
+		bool pending[LATENCY] = {};
+		int current = 0;
+		uint64_t value = 0; // latest result, nanoseconds or samples
+
+		void init(GLenum query_target) {
+			target = query_target;
+			glGenQueries(LATENCY, ids);
+		}
+
+		void shutdown() {
+			glDeleteQueries(LATENCY, ids);
+		}
+
+		void begin() {
+			// oldest slot gets reused, grab its result first if the gpu is done with it
+			collect(current);
+			glBeginQuery(target, ids[current]);
+		}
+
+		void end() {
+			glEndQuery(target);
+			pending[current] = true;
+			current = (current + 1) % LATENCY;
+		}
+
+		// drops results that arent ready yet instead of waiting on them
+		void collect(int slot) {
+			if (!pending[slot])
+				return;
+			GLint ready = 0;
+			glGetQueryObjectiv(ids[slot], GL_QUERY_RESULT_AVAILABLE, &ready);
+			if (ready) {
+				GLuint64 result = 0;
+				glGetQueryObjectui64v(ids[slot], GL_QUERY_RESULT, &result);
+				value = result;
+			}
+			pending[slot] = false;
+		}
+
+		float ms() const { return value / 1000000.0f; }
+	};
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Util {
+	// whole file mapped read only, unmapped on destruction
+	class mapped_file {
+	public:
+		mapped_file() = default;
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+		~mapped_file() { close(); }
+
+		bool open(const std::string& path) {
+			close();
+#ifdef _WIN32
+			HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				return false;
+			LARGE_INTEGER file_size;
+			if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+				CloseHandle(file);
+				return false;
+			}
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(file);
+			if (!mapping)
+				return false;
+			ptr = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping); // the view keeps it alive
+			if (!ptr)
+				return false;
+			length = (size_t)file_size.QuadPart;
+#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return false;
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size == 0) {
+				::close(fd);
+				return false;
+			}
+			void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd); // the mapping keeps it alive
+			if (p == MAP_FAILED)
+				return false;
+			ptr = (const uint8_t*)p;
+			length = (size_t)st.st_size;
+#endif
+			return true;
+		}
+
+		void close() {
+			if (!ptr)
+				return;
+#ifdef _WIN32
+			UnmapViewOfFile(ptr);
+#else
+			munmap((void*)ptr, length);
+#endif
+			ptr = nullptr;
+			length = 0;
+		}
+
+		// faults every page in on the calling thread, so whoever reads it later (the gl upload) doesnt hit the disk
+		void prefetch() const {
+			if (!ptr)
+				return;
+#ifndef _WIN32
+			madvise((void*)ptr, length, MADV_WILLNEED);
+#endif
+			volatile uint8_t sink = 0;
+			for (size_t i = 0; i < length; i += 4096)
+				sink ^= ptr[i];
+			(void)sink;
+		}
+
+		const uint8_t* data() const { return ptr; }
+		size_t size() const { return length; }
+
+	private:
+		const uint8_t* ptr = nullptr;
+		size_t length = 0;
+	};
+}
@@ -1,63 +1,3 @@
-// #include <glm/glm.hpp>
-// #include <glad/glad.h>
-
-// #include <camera.h>
-
-// namespace Compute {
-
-//     constexpr unsigned int gridSizeX = 12;
-//     constexpr unsigned int gridSizeY = 12;
-//     constexpr unsigned int gridSizeZ = 24;
-//     constexpr unsigned int numClusters = gridSizeX * gridSizeY * gridSizeZ;
-
-//     struct alignas(16) Cluster {
-//         glm::vec4 minPoint;
-//         glm::vec4 maxPoint;
-//         unsigned int count;
-//         unsigned int lightIndices[100];
-//     };
-
-//     unsigned int clusterGridSSBO;
-
-//     void init_ssbos() {
-//         // clusterGridSSBO
-//         glGenBuffers(1, &clusterGridSSBO);
-//         glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterGridSSBO);
-
-//         // NOTE: we only need to allocate memory. No need for initialization because
-//         // comp shader builds the AABBs.
-//         glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Cluster) * numClusters,
-//                     nullptr, GL_STATIC_COPY);
-//         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, clusterGridSSBO);
-//     }
-
-//     Shader clusterComp;
-
-//     void cull_lights_compute(const Camera &camera) {
-//         auto [width, height] = Core::get_framebuffer_size();
-
-//         // build AABBs every frame
-//         clusterComp.use();
-//         clusterComp.set_float("zNear", 0.1f);
-//         clusterComp.set_float("zFar", 300.0f);
-
-//         glm::mat4 projection = glm::perspective(glm::radians(player.camera.zoom), (float)scr_width / (float)scr_height, 0.1f, 300.0f);
-        
-//         clusterComp.set_mat4("inverseProjection", glm::inverse(camera.projection));
-//         clusterComp.set_uvec3("gridSize", {gridSizeX, gridSizeY, gridSizeZ});
-//         clusterComp.set_uvec2("screenDimensions", {width, height});
-
-//         glDispatchCompute(gridSizeX, gridSizeY, gridSizeZ);
-//         glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-//     }
-
-//     void init() {
-//         init_ssbos();
-//         // load shaders
-//         clusterComp = Shader("clusterShader.comp");
-//     }
-// }
-
 #ifndef SHADER_COMPUTE_H
 #define SHADER_COMPUTE_H
 
@@ -146,6 +86,10 @@ public:
         glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
     }
     
+    void setUint(const std::string &name, unsigned int value) const {
+        glUniform1ui(glGetUniformLocation(ID, name.c_str()), value);
+    }
+    
     void setFloat(const std::string &name, float value) const {
         glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
     }
@@ -166,6 +110,10 @@ public:
         glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
     }
     
+    void setUvec3(const std::string &name, const glm::uvec3 &value) const {
+        glUniform3uiv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    }
+    
     void setVec4(const std::string &name, const glm::vec4 &value) const {
         glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
     }
@@ -0,0 +1,97 @@
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "core/cluster_binner.h"
+#include "core/jobs.h"
+
+// Cluster_binner against a brute force sphere / box test in doubles
+// lights within a hair of a box are skipped, float and double may fairly disagree there
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("[TEST] failed: " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+static const double EDGE = 1e-4;
+
+// 1 inside, 0 outside, -1 too close to call
+static int touches(const cluster_bounds& b, const glm::dvec3& p, double radius) {
+    glm::dvec3 closest = glm::clamp(p, glm::dvec3(b.min), glm::dvec3(b.max));
+    double d = glm::length(p - closest);
+    if (std::abs(d - radius) < EDGE * (1.0 + radius))
+        return -1;
+    return d <= radius ? 1 : 0;
+}
+
+static void compare(const char* name, const std::vector<cluster_bounds>& bounds, const std::vector<point_light>& lights, const glm::mat4& view) {
+    Cluster_binner binner;
+    uint32_t overflowed = binner.bin(bounds, lights, view);
+    CHECK(binner.counts.size() == CLUSTER_COUNT, "%s: %zu counts", name, binner.counts.size());
+
+    uint32_t overflow_min = 0, overflow_max = 0, mismatches = 0;
+    for (uint32_t c = 0; c < CLUSTER_COUNT; c++) {
+        const uint32_t* got = &binner.indices[c * MAX_LIGHTS_PER_CLUSTER];
+        uint32_t n = binner.counts[c], k = 0, hits = 0, close = 0;
+        for (uint32_t i = 0; i < lights.size(); i++) {
+            glm::dvec3 p = glm::dvec3(glm::dmat4(view) * glm::dvec4(glm::dvec3(lights[i].position_radius), 1.0));
+            int t = touches(bounds[c], p, lights[i].position_radius.w);
+            hits += t == 1;
+            close += t == -1;
+            // a full cluster stops listing, whatever comes after its last entry isnt checked
+            if (n == MAX_LIGHTS_PER_CLUSTER && k == n)
+                continue;
+            bool listed = k < n && got[k] == i;
+            if (listed)
+                k++;
+            if (t >= 0 && listed != (t == 1))
+                mismatches++;
+        }
+        CHECK(k == n, "%s: cluster %u lists lights out of order or twice", name, c);
+        overflow_min += hits > MAX_LIGHTS_PER_CLUSTER;
+        overflow_max += hits + close > MAX_LIGHTS_PER_CLUSTER;
+    }
+    CHECK(mismatches == 0, "%s: %u cluster / light pairs disagree with brute force", name, mismatches);
+    CHECK(overflowed >= overflow_min && overflowed <= overflow_max, "%s: %u overflowed, expected %u to %u", name, overflowed, overflow_min, overflow_max);
+}
+
+int main() {
+    std::vector<cluster_bounds> bounds;
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+    Cluster_binner::build_bounds(projection, 0.1f, 200.0f, 1920, 1080, bounds);
+    CHECK(bounds.size() == CLUSTER_COUNT, "%zu boxes", bounds.size());
+    for (const cluster_bounds& b : bounds)
+        CHECK(b.min.x <= b.max.x && b.min.y <= b.max.y && b.min.z <= b.max.z && b.max.z < 0.0f, "inverted or behind the eye box");
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> spread(-60.0f, 60.0f), height(0.0f, 20.0f), radius(0.5f, 15.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(3.0f, 4.0f, 10.0f), glm::vec3(0.0f, 2.0f, -20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    compare("no lights", bounds, {}, view);
+
+    std::vector<point_light> lights;
+    for (int i = 0; i < 301; i++) // not a multiple of 8, the padded tail is exercised
+        lights.push_back({ glm::vec4(spread(rng), height(rng), spread(rng), radius(rng)), glm::vec4(1.0f), glm::ivec4(-1) });
+    compare("scattered", bounds, lights, view);
+
+    // a pile in front of the camera, more than a cluster can hold
+    std::vector<point_light> pile;
+    for (int i = 0; i < 200; i++)
+        pile.push_back({ glm::vec4(0.0f, 2.0f, -5.0f, 3.0f + i * 0.01f), glm::vec4(1.0f), glm::ivec4(-1) });
+    compare("overflow", bounds, pile, view);
+
+    // same lights split over worker threads
+    Jobs::init(4);
+    compare("scattered, jobs", bounds, lights, view);
+    compare("overflow, jobs", bounds, pile, view);
+    Jobs::shutdown();
+
+    if (failures) {
+        printf("[TEST] cluster_binner: %d failed\n", failures);
+        return 1;
+    }
+    printf("[TEST] cluster_binner: ok\n");
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+
+#include "asset/texture_codec.h"
+#include "asset/ktx2.h"
+
+// the texture cooker: block quality per format, the mip filter, and .ktx2 files in and out of the loader
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("[TEST] failed: " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+// smooth color with some detail and an alpha ramp, roughly what albedo / mask textures look like
+static Texture_codec::image make_image(uint32_t width, uint32_t height) {
+    Texture_codec::image img;
+    img.width = width;
+    img.height = height;
+    img.rgba.resize((size_t)width * height * 4);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            uint8_t* p = &img.rgba[((size_t)y * width + x) * 4];
+            float u = x / (float)width, v = y / (float)height;
+            p[0] = (uint8_t)(127.5f + 127.5f * std::sin(6.0f * u + 2.0f * v));
+            p[1] = (uint8_t)(127.5f + 127.5f * std::sin(4.0f * v - 3.0f * u + 1.0f));
+            p[2] = (uint8_t)(255.0f * u * v);
+            p[3] = (uint8_t)(255.0f * (0.5f + 0.5f * std::cos(5.0f * u)));
+        }
+    }
+    return img;
+}
+
+// over the channels the format keeps
+static double psnr(Texture_codec::format f, const Texture_codec::image& img) {
+    static const int CHANNELS[Texture_codec::FORMAT_COUNT] = { 3, 4, 1, 2, 4 };
+    std::vector<uint8_t> blocks;
+    Texture_codec::encode(img, f, blocks);
+
+    double error = 0.0;
+    size_t samples = 0, offset = 0;
+    uint8_t texels[Texture_codec::BLOCK_TEXELS * 4];
+    for (uint32_t by = 0; by < img.height / 4; by++) {
+        for (uint32_t bx = 0; bx < img.width / 4; bx++, offset += Texture_codec::block_bytes(f)) {
+            Texture_codec::decode_block(f, &blocks[offset], texels);
+            for (int i = 0; i < Texture_codec::BLOCK_TEXELS; i++) {
+                const uint8_t* source = &img.rgba[((size_t)(by * 4 + i / 4) * img.width + bx * 4 + i % 4) * 4];
+                for (int c = 0; c < CHANNELS[f]; c++) {
+                    double d = (double)source[c] - texels[i * 4 + c];
+                    error += d * d;
+                    samples++;
+                }
+            }
+        }
+    }
+    double mse = error / samples;
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+static void test_quality() {
+    Texture_codec::image img = make_image(64, 64);
+    // a few db under what the encoder gets today, a regression in endpoint fitting drops well past these
+    const double MIN_PSNR[Texture_codec::FORMAT_COUNT] = { 32.0, 33.0, 42.0, 43.0, 34.0 };
+    for (int f = 0; f < Texture_codec::FORMAT_COUNT; f++) {
+        double db = psnr((Texture_codec::format)f, img);
+        printf("[TEST] %s %.1f db\n", Texture_codec::format_name((Texture_codec::format)f), db);
+        CHECK(db >= MIN_PSNR[f], "%s psnr %.1f under %.1f", Texture_codec::format_name((Texture_codec::format)f), db, MIN_PSNR[f]);
+    }
+}
+
+// linear usage, each level against a plain 2x2 average of the one above (the avx2 path when built with it)
+static void test_mips() {
+    Texture_codec::image img = make_image(37, 20); // odd width, the last column is dropped
+    std::vector<Texture_codec::image> levels;
+    Texture_codec::build_mips(img, Texture_codec::SINGLE_CHANNEL, levels);
+    CHECK(levels.size() == 6, "%zu levels for 37x20, expected 6", levels.size());
+    CHECK(levels.back().width == 1 && levels.back().height == 1, "last level isnt 1x1");
+
+    const Texture_codec::image& top = levels[0];
+    const Texture_codec::image& next = levels[1];
+    CHECK(next.width == 18 && next.height == 10, "level 1 is %ux%u", next.width, next.height);
+    int worst = 0;
+    for (uint32_t y = 0; y < next.height; y++) {
+        for (uint32_t x = 0; x < next.width; x++) {
+            for (int c = 0; c < 4; c++) {
+                auto at = [&](uint32_t sx, uint32_t sy) { return top.rgba[((size_t)sy * top.width + sx) * 4 + c]; };
+                float average = (at(2 * x, 2 * y) + at(2 * x + 1, 2 * y) + at(2 * x, 2 * y + 1) + at(2 * x + 1, 2 * y + 1)) / 4.0f;
+                worst = std::max(worst, (int)std::abs(next.rgba[((size_t)y * next.width + x) * 4 + c] - average) );
+            }
+        }
+    }
+    CHECK(worst <= 1, "level 1 is %d off a 2x2 average", worst);
+}
+
+static std::vector<uint8_t> read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void test_ktx2(Texture_codec::usage use, bool high_quality) {
+    const char* name = Texture_codec::usage_name(use);
+    Texture_codec::cooked_texture cooked;
+    Texture_codec::cook(make_image(40, 24), use, high_quality, cooked);
+
+    std::string path = (std::filesystem::temp_directory_path() / (std::string("glow_texture_codec_test_") + name + Ktx2::EXTENSION)).string();
+    CHECK(Ktx2::write(path, cooked) == 0, "%s: write failed", name);
+    std::vector<uint8_t> bytes = read_file(path);
+    std::filesystem::remove(path);
+
+    Ktx2::texture parsed;
+    CHECK(Ktx2::parse(bytes.data(), bytes.size(), parsed), "%s: doesnt parse back", name);
+    CHECK(parsed.block_format == cooked.block_format && parsed.use == cooked.use && parsed.srgb == cooked.srgb, "%s: format, usage or srgb changed", name);
+    CHECK(parsed.width == cooked.width && parsed.height == cooked.height, "%s: size changed", name);
+    CHECK(parsed.levels.size() == cooked.levels.size(), "%s: %zu levels, wrote %zu", name, parsed.levels.size(), cooked.levels.size());
+    for (size_t l = 0; l < parsed.levels.size() && l < cooked.levels.size(); l++) {
+        bool same = parsed.levels[l].size == cooked.levels[l].size() && std::equal(cooked.levels[l].begin(), cooked.levels[l].end(), parsed.levels[l].data);
+        CHECK(same, "%s: level %zu differs", name, l);
+    }
+
+    // level 0 is stored last, so every cut reaches into some level or the header
+    size_t accepted = 0;
+    for (size_t size = 0; size < bytes.size(); size++)
+        accepted += Ktx2::parse(bytes.data(), size, parsed);
+    CHECK(accepted == 0, "%s: %zu truncated files parsed", name, accepted);
+
+    std::vector<uint8_t> bad = bytes;
+    bad[5] = '1'; // KTX 10
+    CHECK(!Ktx2::parse(bad.data(), bad.size(), parsed), "%s: wrong identifier parsed", name);
+}
+
+int main() {
+    test_quality();
+    test_mips();
+    test_ktx2(Texture_codec::ALBEDO, false);
+    test_ktx2(Texture_codec::ALBEDO, true);
+    test_ktx2(Texture_codec::NORMAL, false);
+    test_ktx2(Texture_codec::METALLIC_ROUGHNESS, false);
+    test_ktx2(Texture_codec::SINGLE_CHANNEL, false);
+
+    if (failures) {
+        printf("[TEST] texture_codec: %d failed\n", failures);
+        return 1;
+    }
+    printf("[TEST] texture_codec: ok\n");
+    return 0;
+}